@@ -31,6 +31,7 @@
 #include <zlib.h>
 #include <QByteArray>
 #include <QDebug>
+#include <QString>
 
 using namespace Tiled;
 
@@ -111,10 +112,186 @@ QByteArray Tiled::decompress(const QByteArray &data, int expectedSize)
     return out;
 }
 
+namespace {
+
+// Maps a Latin-1 character to its base64 value, or -1 if it isn't part of the
+// base64 alphabet.
+const signed char base64Values[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,
+    -1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+    -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+/**
+ * Decodes base64 text incrementally into caller-supplied buffers.  Characters
+ * outside the base64 alphabet (such as the whitespace around layer data) are
+ * skipped and decoding stops at the first '=', matching
+ * QByteArray::fromBase64().
+ */
+class Base64Decoder
+{
+public:
+    Base64Decoder(const QChar *text, int length)
+        : mText(reinterpret_cast<const ushort*>(text))
+        , mEnd(mText + length)
+        , mBuffer(0)
+        , mBits(0)
+    {}
+
+    /**
+     * Decodes up to \a maxSize bytes into \a out. Returns the number of bytes
+     * written, which is less than \a maxSize only when the input ran out.
+     */
+    int read(char *out, int maxSize)
+    {
+        char *o = out;
+        char *const oEnd = out + maxSize;
+
+        while (o < oEnd && mText < mEnd) {
+            if (mBits == 0) {
+                // Decode whole quads while there's no whitespace in the way.
+                while (oEnd - o >= 3 && mEnd - mText >= 4) {
+                    const int a = value(mText[0]);
+                    const int b = value(mText[1]);
+                    const int c = value(mText[2]);
+                    const int d = value(mText[3]);
+                    if ((a | b | c | d) < 0)
+                        break;
+                    const uint v = (a << 18) | (b << 12) | (c << 6) | d;
+                    o[0] = char(v >> 16);
+                    o[1] = char(v >> 8);
+                    o[2] = char(v);
+                    o += 3;
+                    mText += 4;
+                }
+                if (o == oEnd || mText == mEnd)
+                    break;
+            }
+
+            const ushort ch = *mText++;
+            if (ch == '=') {
+                mText = mEnd;
+                break;
+            }
+            const int v = value(ch);
+            if (v < 0)
+                continue;
+            mBuffer = (mBuffer << 6) | v;
+            mBits += 6;
+            if (mBits >= 8) {
+                mBits -= 8;
+                *o++ = char(mBuffer >> mBits);
+                mBuffer &= (1 << mBits) - 1;
+            }
+        }
+
+        return o - out;
+    }
+
+    /**
+     * Returns true when no more bytes can be decoded from the input.
+     */
+    bool atEnd() const
+    {
+        int bits = mBits;
+        for (const ushort *p = mText; p < mEnd && *p != '='; ++p) {
+            if (value(*p) >= 0 && (bits += 6) >= 8)
+                return false;
+        }
+        return true;
+    }
+
+private:
+    static int value(ushort ch)
+    { return ch < 256 ? base64Values[ch] : -1; }
+
+    const ushort *mText;
+    const ushort *mEnd;
+    uint mBuffer;
+    int mBits;
+};
+
+} // anonymous namespace
+
+bool Tiled::decodeBase64(const QChar *text, int length,
+                         char *out, int outSize, bool compressed)
+{
+    Base64Decoder decoder(text, length);
+
+    if (!compressed)
+        return decoder.read(out, outSize) == outSize && decoder.atEnd();
+
+    // The decoded bytes are fed to zlib in small pieces, so the compressed
+    // data never exists in memory as a whole.
+    char in[16 * 1024];
+
+    z_stream strm;
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    strm.next_in = Z_NULL;
+    strm.avail_in = 0;
+    strm.next_out = (Bytef *) out;
+    strm.avail_out = outSize;
+
+    int ret = inflateInit2(&strm, 15 + 32);
+
+    if (ret != Z_OK) {
+        logZlibError(ret);
+        return false;
+    }
+
+    do {
+        if (strm.avail_in == 0) {
+            const int n = decoder.read(in, sizeof(in));
+            if (n == 0)
+                break; // truncated input
+            strm.next_in = (Bytef *) in;
+            strm.avail_in = n;
+        }
+
+        ret = inflate(&strm, Z_SYNC_FLUSH);
+
+        switch (ret) {
+            case Z_NEED_DICT:
+            case Z_STREAM_ERROR:
+                ret = Z_DATA_ERROR;
+            case Z_DATA_ERROR:
+            case Z_MEM_ERROR:
+                inflateEnd(&strm);
+                logZlibError(ret);
+                return false;
+        }
+
+        // More data than expected
+        if (ret != Z_STREAM_END && strm.avail_out == 0)
+            break;
+    } while (ret != Z_STREAM_END);
+
+    inflateEnd(&strm);
+
+    return ret == Z_STREAM_END
+            && strm.avail_out == 0
+            && strm.avail_in == 0
+            && decoder.atEnd();
+}
+
 QByteArray Tiled::compress(const QByteArray &data, CompressionMethod method)
 {
     QByteArray out;
-    out.resize(1024);
     int err;
     z_stream strm;
     strm.zalloc = Z_NULL;
@@ -122,8 +299,6 @@ QByteArray Tiled::compress(const QByteArray &data, CompressionMethod method)
     strm.opaque = Z_NULL;
     strm.next_in = (Bytef *) data.data();
     strm.avail_in = data.length();
-    strm.next_out = (Bytef *) out.data();
-    strm.avail_out = out.size();
 
     const int windowBits = (method == Gzip) ? 15 + 16 : 15;
 
@@ -134,6 +309,12 @@ QByteArray Tiled::compress(const QByteArray &data, CompressionMethod method)
         return QByteArray();
     }
 
+    // Size the output for the worst case so deflate normally finishes in
+    // a single pass.
+    out.resize(int(deflateBound(&strm, data.length())));
+    strm.next_out = (Bytef *) out.data();
+    strm.avail_out = out.size();
+
     do {
         err = deflate(&strm, Z_FINISH);
         Q_ASSERT(err != Z_STREAM_ERROR);
@@ -32,6 +32,7 @@
 #include "tiled_global.h"
 
 class QByteArray;
+class QChar;
 
 namespace Tiled {
 
@@ -55,6 +56,19 @@ enum CompressionMethod {
 QByteArray TILEDSHARED_EXPORT decompress(const QByteArray &data,
                                          int expectedSize = 1024);
 
+/**
+ * Decodes the base64 encoded \a text straight into \a out, which must hold
+ * exactly \a outSize bytes of decoded data. When \a compressed is true the
+ * decoded bytes are inflated (zlib or gzip) as they are decoded, without
+ * building any intermediate buffers.
+ *
+ * @return true on success, false when the data is corrupt or its decoded
+ *         size doesn't match \a outSize
+ */
+bool TILEDSHARED_EXPORT decodeBase64(const QChar *text, int length,
+                                     char *out, int outSize,
+                                     bool compressed);
+
 /**
  * Compresses the give data in either gzip or zlib format. Returns a null
  * QByteArray if compression failed.
@@ -94,18 +94,11 @@ uint GidMapper::cellToGid(const Cell &cell) const
     if (cell.isEmpty())
         return 0;
 
-    const Tileset *tileset = cell.tile->tileset();
-
-    // Find the first GID for the tileset
-    QMap<uint, Tileset*>::const_iterator i = mFirstGidToTileset.begin();
-    QMap<uint, Tileset*>::const_iterator i_end = mFirstGidToTileset.end();
-    while (i != i_end && i.value() != tileset)
-        ++i;
-
-    if (i == i_end) // tileset not found
+    const uint firstGid = mTilesetToFirstGid.value(cell.tile->tileset());
+    if (firstGid == 0) // tileset not found
         return 0;
 
-    uint gid = i.key() + cell.tile->id();
+    uint gid = firstGid + cell.tile->id();
     if (cell.flippedHorizontally)
         gid |= FlippedHorizontallyFlag;
     if (cell.flippedVertically)
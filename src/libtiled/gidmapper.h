@@ -23,6 +23,7 @@
 
 #include "tilelayer.h"
 
+#include <QHash>
 #include <QMap>
 
 namespace Tiled {
@@ -48,12 +49,28 @@ public:
      * Insert the given \a tileset with \a firstGid as its first global ID.
      */
     void insert(uint firstGid, Tileset *tileset)
-    { mFirstGidToTileset.insert(firstGid, tileset); }
+    {
+        mFirstGidToTileset.insert(firstGid, tileset);
+        mTilesetToFirstGid.insert(tileset, firstGid);
+    }
+
+    /**
+     * Makes cellToGid() and firstGid() map tiles of \a tileset onto the
+     * global IDs starting at \a firstGid, without changing which tileset
+     * gidToCell() returns for those IDs.  Used when several tilesets are
+     * written out as one.
+     */
+    void insertAlias(uint firstGid, const Tileset *tileset)
+    { mTilesetToFirstGid.insert(tileset, firstGid); }
 
     /**
      * Clears the gid mapper, so that it can be reused.
      */
-    void clear() { mFirstGidToTileset.clear(); }
+    void clear()
+    {
+        mFirstGidToTileset.clear();
+        mTilesetToFirstGid.clear();
+    }
 
     /**
      * Returns true when no tilesets are known to this gid mapper.
@@ -72,6 +89,13 @@ public:
      */
     uint cellToGid(const Cell &cell) const;
 
+    /**
+     * Returns the first global ID of the given \a tileset, or 0 when the
+     * tileset isn't known to this gid mapper.
+     */
+    uint firstGid(const Tileset *tileset) const
+    { return mTilesetToFirstGid.value(tileset); }
+
     /**
      * This sets the original tileset width. In case the image size has
      * changed, the tile indexes will be adjusted automatically when using
@@ -81,6 +105,7 @@ public:
 
 private:
     QMap<uint, Tileset*> mFirstGidToTileset;
+    QHash<const Tileset*, uint> mTilesetToFirstGid;
     QMap<const Tileset*, int> mTilesetColumnCounts;
 };
 
@@ -4,6 +4,9 @@ include(../zlib/zlib.pri)
 
 TEMPLATE = lib
 TARGET = tiled
+greaterThan(QT_MAJOR_VERSION, 4) {
+    QT += concurrent
+}
 isEmpty(INSTALL_ONLY_BUILD) {
     target.path = $${LIBDIR}
     INSTALLS += target
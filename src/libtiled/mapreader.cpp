@@ -44,6 +44,7 @@
 #include <QDebug>
 #include <QDir>
 #include <QFileInfo>
+#include <QtEndian>
 #ifdef ZOMBOID
 #include <QImageReader>
 #include "qtlockedfile.h"
@@ -93,7 +94,7 @@ private:
     void decodeBinaryLayerData(TileLayer *tileLayer,
                                const QStringRef &text,
                                const QStringRef &compression);
-    void decodeCSVLayerData(TileLayer *tileLayer, const QString &text);
+    void decodeCSVLayerData(TileLayer *tileLayer, const QStringRef &text);
 
     /**
      * Returns the cell for the given global tile ID. Errors are raised with
@@ -136,6 +137,7 @@ private:
     QString mPath;
     Map *mMap;
     GidMapper mGidMapper;
+    QVector<uint> mGidBuffer;
     bool mReadingExternalTileset;
 
     QXmlStreamReader xml;
@@ -490,7 +492,7 @@ void MapReaderPrivate::readLayerData(TileLayer *tileLayer)
                                       xml.text(),
                                       compression);
             } else if (encoding == QLatin1String("csv")) {
-                decodeCSVLayerData(tileLayer, xml.text().toString());
+                decodeCSVLayerData(tileLayer, xml.text());
             } else {
                 xml.raiseError(tr("Unknown encoding: %1")
                                .arg(encoding.toString()));
@@ -504,184 +506,97 @@ void MapReaderPrivate::decodeBinaryLayerData(TileLayer *tileLayer,
                                              const QStringRef &text,
                                              const QStringRef &compression)
 {
-#if QT_VERSION < 0x040800
-    const QString textData = QString::fromRawData(text.unicode(), text.size());
-    const QByteArray latin1Text = textData.toLatin1();
-#else
-    const QByteArray latin1Text = text.toLatin1();
-#endif
-    QByteArray tileData = QByteArray::fromBase64(latin1Text);
-    const int size = (tileLayer->width() * tileLayer->height()) * 4;
-
+    bool compressed = false;
     if (compression == QLatin1String("zlib")
         || compression == QLatin1String("gzip")) {
-        tileData = decompress(tileData, size);
+        compressed = true;
     } else if (!compression.isEmpty()) {
         xml.raiseError(tr("Compression method '%1' not supported")
                        .arg(compression.toString()));
         return;
     }
 
-    if (size != tileData.length()) {
+    // The gid buffer is reused for every layer of the map.
+    const int count = tileLayer->width() * tileLayer->height();
+    mGidBuffer.resize(count);
+    uint *gids = mGidBuffer.data();
+
+    if (!decodeBase64(text.unicode(), text.size(),
+                      reinterpret_cast<char*>(gids), count * 4,
+                      compressed)) {
         xml.raiseError(tr("Corrupt layer data for layer '%1'")
                        .arg(tileLayer->name()));
         return;
     }
 
-    const unsigned char *data =
-            reinterpret_cast<const unsigned char*>(tileData.constData());
-    int x = 0;
-    int y = 0;
-
-    for (int i = 0; i < size - 3; i += 4) {
-        const uint gid = data[i] |
-                         data[i + 1] << 8 |
-                         data[i + 2] << 16 |
-                         data[i + 3] << 24;
-
-        tileLayer->setCell(x, y, cellForGid(gid));
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    for (int i = 0; i < count; ++i)
+        gids[i] = qFromLittleEndian(gids[i]);
+#endif
 
-        x++;
-        if (x == tileLayer->width()) {
-            x = 0;
-            y++;
-        }
-    }
+    uint invalidGid;
+    if (!tileLayer->setCells(gids, mGidMapper, invalidGid))
+        cellForGid(invalidGid); // raises the error
 }
 
-#if defined(ZOMBOID) /*&& defined(_DEBUG)*/
-void QString_split(const QChar &sep, QString::SplitBehavior behavior, Qt::CaseSensitivity cs, const QString &in, QVector<int>& out)
+static inline bool isCsvSpace(ushort ch)
 {
-    int start = 0;
-    int end;
-    while ((end = in.indexOf(sep, start, cs)) != -1) {
-        if (start != end || behavior == QString::KeepEmptyParts) {
-            out.append(start);
-            out.append(end - start);
-        }
-        start = end + 1;
-    }
-    if (start != in.size() || behavior == QString::KeepEmptyParts) {
-        out.append(start);
-        out.append(in.size() - start);
-    }
+    return ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t';
 }
-#endif
 
-void MapReaderPrivate::decodeCSVLayerData(TileLayer *tileLayer, const QString &text)
+void MapReaderPrivate::decodeCSVLayerData(TileLayer *tileLayer,
+                                          const QStringRef &text)
 {
-#if defined(ZOMBOID) /*&& defined(_DEBUG)*/
-
-    int start = 0;
-    int end = text.length();
-    while (start < end && text.at(start).isSpace())
-        start++;
-    int x = 0, y = 0;
-    const QChar sep(QLatin1Char(','));
-    const QChar nullChar(QLatin1Char('0'));
-    const Cell emptyCell = cellForGid(0);
-    while ((end = text.indexOf(sep, start, Qt::CaseSensitive)) != -1) {
-        if (end - start == 1 && text.at(start) == nullChar) {
-            tileLayer->setCell(x, y, emptyCell);
-        } else {
-            bool conversionOk;
-            uint gid = text.mid(start, end - start).toUInt(&conversionOk);
-            if (!conversionOk) {
-                xml.raiseError(
-                        tr("Unable to parse tile at (%1,%2) on layer '%3'")
-                               .arg(x + 1).arg(y + 1).arg(tileLayer->name()));
-                return;
-            }
-            tileLayer->setCell(x, y, cellForGid(gid));
-        }
-        start = end + 1;
-        if (++x == tileLayer->width()) {
-            ++y;
-            if (y >= tileLayer->height()) {
-                xml.raiseError(tr("Corrupt layer data for layer '%1'")
-                               .arg(tileLayer->name()));
-                return;
-            }
-            x = 0;
+    const int width = tileLayer->width();
+    const int count = width * tileLayer->height();
+
+    // The gid buffer is reused for every layer of the map.
+    mGidBuffer.fill(0, count);
+    uint *gids = mGidBuffer.data();
+
+    const ushort *p = reinterpret_cast<const ushort*>(text.unicode());
+    const ushort *end = p + text.size();
+    int index = 0;
+
+    while (true) {
+        while (p < end && isCsvSpace(*p))
+            ++p;
+
+        // Scan one gid
+        const ushort *start = p;
+        quint64 gid = 0;
+        while (p < end && *p >= '0' && *p <= '9' && gid <= 0xFFFFFFFFu) {
+            gid = gid * 10 + (*p - '0');
+            ++p;
         }
-    }
-    end = text.size();
-    while (start < end && text.at(end-1).isSpace())
-        end--;
-    if (end - start == 1 && text.at(start) == nullChar) {
-        tileLayer->setCell(x, y, emptyCell);
-    } else {
-        bool conversionOk;
-        uint gid = text.mid(start, end - start).toUInt(&conversionOk);
-        if (!conversionOk) {
+        const bool empty = (p == start);
+
+        while (p < end && isCsvSpace(*p))
+            ++p;
+
+        if (empty || gid > 0xFFFFFFFFu || (p < end && *p != ',')) {
             xml.raiseError(
                     tr("Unable to parse tile at (%1,%2) on layer '%3'")
-                           .arg(x + 1).arg(y + 1).arg(tileLayer->name()));
+                           .arg(index % width + 1).arg(index / width + 1)
+                           .arg(tileLayer->name()));
             return;
         }
-        tileLayer->setCell(x, y, cellForGid(gid));
-    }
-#elif 0
-    QString trimText = text.trimmed();
-    static QVector<int> tiles;
-    tiles.reserve(300*300*2);
-    tiles.clear();
-    QString_split(QLatin1Char(','), QString::KeepEmptyParts, Qt::CaseSensitive, trimText, tiles);
-
-    if (tiles.count() / 2 != tileLayer->width() * tileLayer->height()) {
-        xml.raiseError(tr("Corrupt layer data for layer '%1'")
-                       .arg(tileLayer->name()));
-        return;
-    }
 
-    QString tile;
-
-    for (int y = 0; y < tileLayer->height(); y++) {
-        for (int x = 0; x < tileLayer->width(); x++) {
-            bool conversionOk;
-            int k = (y * tileLayer->width() + x) * 2;
-            tile = trimText.mid(tiles[k], tiles[k + 1]);
-            const uint gid = tile.toUInt(&conversionOk);
-            if (!conversionOk) {
-                xml.raiseError(
-                        tr("Unable to parse tile at (%1,%2) on layer '%3'")
-                               .arg(x + 1).arg(y + 1).arg(tileLayer->name()));
-                return;
-            }
-            tileLayer->setCell(x, y, cellForGid(gid));
+        if (index == count) {
+            xml.raiseError(tr("Corrupt layer data for layer '%1'")
+                           .arg(tileLayer->name()));
+            return;
         }
-#if 1
-        // Hack to keep the app responsive.
-        // TODO: Move map reading to a worker thread. Only issue is tileset images
-        // cannot be accessed outside the GUI thread.
-        qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
-#endif
-    }
-#else
-    QString trimText = text.trimmed();
-    QStringList tiles = trimText.split(QLatin1Char(','));
+        gids[index++] = uint(gid);
 
-    if (tiles.length() != tileLayer->width() * tileLayer->height()) {
-        xml.raiseError(tr("Corrupt layer data for layer '%1'")
-                       .arg(tileLayer->name()));
-        return;
+        if (p == end)
+            break;
+        ++p; // skip ','
     }
 
-    for (int y = 0; y < tileLayer->height(); y++) {
-        for (int x = 0; x < tileLayer->width(); x++) {
-            bool conversionOk;
-            const uint gid = tiles.at(y * tileLayer->width() + x)
-                    .toUInt(&conversionOk);
-            if (!conversionOk) {
-                xml.raiseError(
-                        tr("Unable to parse tile at (%1,%2) on layer '%3'")
-                               .arg(x + 1).arg(y + 1).arg(tileLayer->name()));
-                return;
-            }
-            tileLayer->setCell(x, y, cellForGid(gid));
-        }
-    }
-#endif
+    uint invalidGid;
+    if (!tileLayer->setCells(gids, mGidMapper, invalidGid))
+        cellForGid(invalidGid); // raises the error
 }
 
 Cell MapReaderPrivate::cellForGid(uint gid)
@@ -42,6 +42,7 @@
 
 #include <QCoreApplication>
 #include <QDir>
+#include <QtConcurrentMap>
 #include <QXmlStreamWriter>
 #ifdef ZOMBOID
 #include "qtlockedfile.h"
@@ -81,7 +82,8 @@ private:
     void writeMap(QXmlStreamWriter &w, const Map *map);
     void writeTileset(QXmlStreamWriter &w, const Tileset *tileset,
                       uint firstGid);
-    void writeTileLayer(QXmlStreamWriter &w, const TileLayer *tileLayer);
+    void writeTileLayer(QXmlStreamWriter &w, const TileLayer *tileLayer,
+                        const QString &tileData);
     void writeLayerAttributes(QXmlStreamWriter &w, const Layer *layer);
     void writeObjectGroup(QXmlStreamWriter &w, const ObjectGroup *objectGroup);
     void writeObject(QXmlStreamWriter &w, const MapObject *mapObject);
@@ -104,6 +106,80 @@ private:
 } // namespace Tiled
 
 
+namespace {
+
+/**
+ * Produces the character data of a tile layer's <data> element for the CSV
+ * and base64 layer data formats.  This is run on several layers at once, so
+ * it only reads from the layer and the gid mapper.
+ */
+class LayerDataEncoder
+{
+public:
+    typedef QString result_type;
+
+    LayerDataEncoder(const GidMapper &gidMapper,
+                     MapWriter::LayerDataFormat format)
+        : mGidMapper(gidMapper)
+        , mFormat(format)
+    {}
+
+    QString operator()(const TileLayer *tileLayer) const
+    {
+        if (mFormat == MapWriter::CSV)
+            return csv(tileLayer);
+        return base64(tileLayer);
+    }
+
+private:
+    QString csv(const TileLayer *tileLayer) const
+    {
+        QString tileData;
+
+        for (int y = 0; y < tileLayer->height(); ++y) {
+            for (int x = 0; x < tileLayer->width(); ++x) {
+                const uint gid = mGidMapper.cellToGid(tileLayer->cellAt(x, y));
+                tileData.append(QString::number(gid));
+                if (x != tileLayer->width() - 1
+                    || y != tileLayer->height() - 1)
+                    tileData.append(QLatin1String(","));
+            }
+            tileData.append(QLatin1String("\n"));
+        }
+
+        return tileData;
+    }
+
+    QString base64(const TileLayer *tileLayer) const
+    {
+        QByteArray tileData;
+        tileData.resize(tileLayer->height() * tileLayer->width() * 4);
+        char *out = tileData.data();
+
+        for (int y = 0; y < tileLayer->height(); ++y) {
+            for (int x = 0; x < tileLayer->width(); ++x) {
+                const uint gid = mGidMapper.cellToGid(tileLayer->cellAt(x, y));
+                *out++ = (char) (gid);
+                *out++ = (char) (gid >> 8);
+                *out++ = (char) (gid >> 16);
+                *out++ = (char) (gid >> 24);
+            }
+        }
+
+        if (mFormat == MapWriter::Base64Gzip)
+            tileData = compress(tileData, Gzip);
+        else if (mFormat == MapWriter::Base64Zlib)
+            tileData = compress(tileData, Zlib);
+
+        return QString::fromLatin1(tileData.toBase64());
+    }
+
+    const GidMapper &mGidMapper;
+    const MapWriter::LayerDataFormat mFormat;
+};
+
+} // anonymous namespace
+
 MapWriterPrivate::MapWriterPrivate()
     : mLayerDataFormat(MapWriter::Base64Gzip)
     , mDtdEnabled(false)
@@ -204,14 +280,31 @@ void MapWriterPrivate::writeMap(QXmlStreamWriter &w, const Map *map)
         firstGid += tileset->tileCount();
     }
 
+    // Packing, compressing and encoding the tile layer data is done for all
+    // layers in parallel, then the XML is written out in order.
+    QList<const TileLayer*> tileLayers;
+    foreach (const Layer *layer, map->layers())
+        if (layer->type() == Layer::TileLayerType)
+            tileLayers += static_cast<const TileLayer*>(layer);
+
+    QList<QString> tileData;
+    if (mLayerDataFormat != MapWriter::XML) {
+        tileData = QtConcurrent::blockingMapped<QList<QString> >(
+                    tileLayers, LayerDataEncoder(mGidMapper, mLayerDataFormat));
+    }
+
+    int tileLayerIndex = 0;
     foreach (const Layer *layer, map->layers()) {
         const Layer::Type type = layer->type();
-        if (type == Layer::TileLayerType)
-            writeTileLayer(w, static_cast<const TileLayer*>(layer));
-        else if (type == Layer::ObjectGroupType)
+        if (type == Layer::TileLayerType) {
+            writeTileLayer(w, static_cast<const TileLayer*>(layer),
+                           tileData.value(tileLayerIndex));
+            ++tileLayerIndex;
+        } else if (type == Layer::ObjectGroupType) {
             writeObjectGroup(w, static_cast<const ObjectGroup*>(layer));
-        else if (type == Layer::ImageLayerType)
+        } else if (type == Layer::ImageLayerType) {
             writeImageLayer(w, static_cast<const ImageLayer*>(layer));
+        }
     }
 
 #ifdef ZOMBOID
@@ -319,7 +412,8 @@ void MapWriterPrivate::writeTileset(QXmlStreamWriter &w, const Tileset *tileset,
 }
 
 void MapWriterPrivate::writeTileLayer(QXmlStreamWriter &w,
-                                      const TileLayer *tileLayer)
+                                      const TileLayer *tileLayer,
+                                      const QString &tileData)
 {
     w.writeStartElement(QLatin1String("layer"));
     writeLayerAttributes(w, tileLayer);
@@ -358,42 +452,11 @@ void MapWriterPrivate::writeTileLayer(QXmlStreamWriter &w,
             }
         }
     } else if (mLayerDataFormat == MapWriter::CSV) {
-        QString tileData;
-
-        for (int y = 0; y < tileLayer->height(); ++y) {
-            for (int x = 0; x < tileLayer->width(); ++x) {
-                const uint gid = mGidMapper.cellToGid(tileLayer->cellAt(x, y));
-                tileData.append(QString::number(gid));
-                if (x != tileLayer->width() - 1
-                    || y != tileLayer->height() - 1)
-                    tileData.append(QLatin1String(","));
-            }
-            tileData.append(QLatin1String("\n"));
-        }
-
         w.writeCharacters(QLatin1String("\n"));
         w.writeCharacters(tileData);
     } else {
-        QByteArray tileData;
-        tileData.reserve(tileLayer->height() * tileLayer->width() * 4);
-
-        for (int y = 0; y < tileLayer->height(); ++y) {
-            for (int x = 0; x < tileLayer->width(); ++x) {
-                const uint gid = mGidMapper.cellToGid(tileLayer->cellAt(x, y));
-                tileData.append((char) (gid));
-                tileData.append((char) (gid >> 8));
-                tileData.append((char) (gid >> 16));
-                tileData.append((char) (gid >> 24));
-            }
-        }
-
-        if (mLayerDataFormat == MapWriter::Base64Gzip)
-            tileData = compress(tileData, Gzip);
-        else if (mLayerDataFormat == MapWriter::Base64Zlib)
-            tileData = compress(tileData, Zlib);
-
         w.writeCharacters(QLatin1String("\n   "));
-        w.writeCharacters(QString::fromLatin1(tileData.toBase64()));
+        w.writeCharacters(tileData);
         w.writeCharacters(QLatin1String("\n  "));
     }
 
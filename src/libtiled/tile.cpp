@@ -39,40 +39,58 @@ using namespace Tiled;
 void Tile::setImage(const QImage &image)
 {
     mImage = QImage();
+    mMips.clear();
     mImageOffset = QPoint(0, 0);
     mImageSize = image.size();
 
-    int top = 0;
-    while (top < image.height() && isRowTransparent(image, top))
-        top++;
-    if (top == image.height()) {
+    QRect bounds = opaqueBounds(image);
+    if (bounds.isNull())
         return;
-    }
-    mImageOffset.setY(top);
-
-    int bottom = image.height() - 1;
-    while (bottom > top && isRowTransparent(image, bottom))
-        bottom--;
-
-    int left = 0;
-    while (left < image.width() && isColumnTransparent(image, left))
-        left++;
-    mImageOffset.setX(left);
-
-    int right = image.width() - 1;
-    while (right > left && isColumnTransparent(image, right))
-        right--;
+    mImageOffset = bounds.topLeft();
 
-    mImage = image.copy(left, top, right - left + 1, bottom - top + 1);
+    mImage = image.copy(bounds);
 }
 
 void Tile::setEmptyImage(int width, int height)
 {
     mImage = QImage();
+    mMips.clear();
     mImageOffset = QPoint(0, 0);
     mImageSize = QSize(width, height);
 }
 
+#if QT_VERSION >= 0x050000
+static void releaseAtlas(void *atlas)
+{
+    delete static_cast<QImage*>(atlas);
+}
+#endif
+
+void Tile::setImage(const QImage &atlas, const QRect &rect, const QPoint &offset,
+                    const QSize &size)
+{
+    mImage = QImage();
+    mMips.clear();
+    mImageOffset = offset;
+    mImageSize = size;
+
+    if (rect.isEmpty())
+        return;
+
+    Q_ASSERT(atlas.depth() == 32);
+#if QT_VERSION >= 0x050000
+    // The image holds a reference to the atlas, so the atlas lives as long as
+    // any copy of the image does.  The data is const, so writing to a copy
+    // of the image detaches it instead of changing the atlas.
+    QImage *ref = new QImage(atlas);
+    mImage = QImage(ref->constScanLine(rect.y()) + rect.x() * 4,
+                    rect.width(), rect.height(), ref->bytesPerLine(),
+                    ref->format(), releaseAtlas, ref);
+#else
+    mImage = atlas.copy(rect);
+#endif
+}
+
 QMargins Tile::drawMargins(float scale)
 {
     float tileScale = tileset()->imageSource2x().isEmpty() ? 1.0f : 0.5f;
@@ -96,26 +114,109 @@ QImage Tile::finalImage(int width, int height)
 void Tile::setImage(const Tile *tile)
 {
     mImage = tile->mImage;
+    mMips = tile->mMips;
     mImageOffset = tile->mImageOffset;
     mImageSize = tile->mImageSize;
 }
 
-bool Tile::isRowTransparent(const QImage &image, int row)
+void Tile::createMips()
 {
-    for (int x = 0; x < image.width(); x++) {
-        QRgb rgb = image.pixel(x, row);
-        if (qAlpha(rgb) > 0)
-            return false;
+    mMips.clear();
+    if (mImage.isNull())
+        return;
+
+    const QImage *source = &mImage;
+    mMips.reserve(3);
+    for (int level = 1; level <= 3; level++) {
+        const int divisor = 1 << level;
+        const QSize size(qMax(1, (mImage.width() + divisor - 1) / divisor),
+                         qMax(1, (mImage.height() + divisor - 1) / divisor));
+        // Each level is scaled from the previous one, which is cheaper and
+        // filters better than one big step.
+        mMips += source->scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        source = &mMips.last();
     }
-    return true;
 }
 
-bool Tile::isColumnTransparent(const QImage &image, int col)
+const QImage &Tile::mipImage(qreal scale) const
 {
-    for (int y = 0; y < image.height(); y++) {
-        QRgb rgb = image.pixel(col, y);
-        if (qAlpha(rgb) > 0)
-            return false;
+    int level = 0;
+    while (level < mMips.size() && scale <= 0.5 / (1 << level))
+        ++level;
+    return level ? mMips.at(level - 1) : mImage;
+}
+
+qint64 Tile::mipBytes() const
+{
+    qint64 bytes = 0;
+    foreach (const QImage &image, mMips)
+        bytes += image.bytesPerLine() * image.height();
+    return bytes;
+}
+
+QRect Tile::opaqueBounds(const QImage &image, const QRect &rect)
+{
+    QRect r = rect & image.rect();
+    if (r.isEmpty())
+        return QRect();
+    const QPoint origin = r.topLeft();
+
+    QImage argb;
+    const QImage *source = &image;
+    switch (image.format()) {
+    case QImage::Format_ARGB32:
+    case QImage::Format_ARGB32_Premultiplied:
+        break;
+    case QImage::Format_RGB32:
+        return r;
+    default:
+        // Only convert the area being scanned, callers often pass one tile
+        // of a much larger tilesheet.
+        argb = image.copy(r).convertToFormat(QImage::Format_ARGB32);
+        source = &argb;
+        r.moveTo(0, 0);
+        break;
+    }
+
+    // In both 32-bit formats the alpha is the top byte of each QRgb, so a
+    // pixel is visible when (pixel & AlphaMask) != 0.
+    const QRgb AlphaMask = 0xFF000000;
+    const int width = r.width();
+    int top = -1, bottom = -1;
+    int left = width, right = -1;
+
+    for (int y = r.top(); y <= r.bottom(); ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb*>(source->constScanLine(y)) + r.left();
+
+        // Branch-free OR over the row, which the compiler can vectorize.
+        QRgb any = 0;
+        for (int x = 0; x < width; ++x)
+            any |= line[x];
+        if (!(any & AlphaMask))
+            continue;
+
+        if (top == -1)
+            top = y;
+        bottom = y;
+
+        // Only the columns outside the bounds found so far need testing.
+        for (int x = 0; x < left; ++x) {
+            if (line[x] & AlphaMask) {
+                left = x;
+                break;
+            }
+        }
+        for (int x = width - 1; x > right; --x) {
+            if (line[x] & AlphaMask) {
+                right = x;
+                break;
+            }
+        }
     }
-    return true;
+
+    if (top == -1)
+        return QRect();
+
+    return QRect(origin.x() + left, origin.y() + top - r.top(),
+                 right - left + 1, bottom - top + 1);
 }
@@ -33,6 +33,9 @@
 #include "object.h"
 
 #include <QPixmap>
+#ifdef ZOMBOID
+#include <QVector>
+#endif
 
 namespace Tiled {
 
@@ -93,6 +96,15 @@ public:
     void setImage(const Tile *tile);
     void setEmptyImage(int width, int height);
 
+    /**
+     * Sets the image of this tile to the already-trimmed \a rect of
+     * \a atlas, without copying the pixels where possible.  \a offset and
+     * \a size are the trimmed image's position in the tile and the size of
+     * the untrimmed tile.
+     */
+    void setImage(const QImage &atlas, const QRect &rect, const QPoint &offset,
+                  const QSize &size);
+
     /**
      * Returns the width of this tile.
      */
@@ -113,9 +125,33 @@ public:
     QMargins drawMargins(float scale);
     QImage finalImage(int width, int height);
 
-private:
-    bool isRowTransparent(const QImage &image, int row);
-    bool isColumnTransparent(const QImage &image, int col);
+    /**
+     * Builds half-, quarter- and eighth-size copies of image(), used when
+     * the tile is drawn zoomed out.  Like image() they are trimmed, and are
+     * drawn into the same rectangle as image().
+     */
+    void createMips();
+    bool hasMips() const { return !mMips.isEmpty(); }
+
+    /**
+     * Returns the smallest mip level still at least \a scale times the size
+     * of image(), or image() itself if there are no mips.
+     */
+    const QImage &mipImage(qreal scale) const;
+
+    /**
+     * Returns the memory used by the mips, in bytes.
+     */
+    qint64 mipBytes() const;
+
+    /**
+     * Returns the smallest rectangle inside \a rect containing every pixel
+     * of \a image with a non-zero alpha, or a null rectangle when the area
+     * is fully transparent. The image is scanned once, a row at a time.
+     */
+    static QRect opaqueBounds(const QImage &image, const QRect &rect);
+    static QRect opaqueBounds(const QImage &image)
+    { return opaqueBounds(image, image.rect()); }
 #else
     /**
      * Returns the image of this tile.
@@ -150,6 +186,7 @@ private:
     QImage mImage;
     QPoint mImageOffset;
     QSize mImageSize;
+    QVector<QImage> mMips;
 #else
     QPixmap mImage;
 #endif
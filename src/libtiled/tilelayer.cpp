@@ -29,6 +29,7 @@
 
 #include "tilelayer.h"
 
+#include "gidmapper.h"
 #include "layer.h"
 #include "map.h"
 #include "tile.h"
@@ -36,6 +37,88 @@
 
 using namespace Tiled;
 
+#if SPARSE_TILELAYER
+SparseTileGrid::SparseTileGrid(int width, int height)
+    : mWidth(width)
+    , mHeight(height)
+    , mChunksWide((width + ChunkSize - 1) / ChunkSize)
+    , mChunksHigh((height + ChunkSize - 1) / ChunkSize)
+    , mUsedChunks(0)
+{
+    mCells.append(Cell());
+}
+
+void SparseTileGrid::replace(int x, int y, const Cell &cell)
+{
+    if (mChunks.isEmpty()) {
+        if (cell.isEmpty())
+            return;
+        mChunks.resize(mChunksWide * mChunksHigh);
+    }
+
+    const quint32 index = cellIndex(cell);
+    Chunk &chunk = mChunks[(y / ChunkSize) * mChunksWide + x / ChunkSize];
+    const int i = (y % ChunkSize) * ChunkSize + x % ChunkSize;
+
+    if (chunk.cells.isEmpty()) {
+        if (chunk.uniform == index)
+            return;
+        if (chunk.isEmpty())
+            ++mUsedChunks;
+        chunk.cells.fill(chunk.uniform, ChunkSize * ChunkSize);
+        chunk.cells[i] = index;
+        return;
+    }
+
+    quint32 *cells = chunk.cells.data();
+    if (cells[i] == index)
+        return;
+    cells[i] = index;
+
+    // Collapse the chunk when every cell is the same.
+    for (int n = 0; n < ChunkSize * ChunkSize; ++n)
+        if (cells[n] != index)
+            return;
+    chunk.cells.clear();
+    chunk.uniform = index;
+    if (chunk.isEmpty() && --mUsedChunks == 0)
+        clear();
+}
+
+void SparseTileGrid::clear()
+{
+    mChunks.clear();
+    mUsedChunks = 0;
+    mCells.resize(1);
+    mCellIndex.clear();
+}
+
+qint64 SparseTileGrid::memoryUsage() const
+{
+    // A QHash node holds the key, the value and the next pointer and hash.
+    const qint64 hashNode = sizeof(Cell) + sizeof(quint32) + sizeof(void*) + sizeof(uint);
+    qint64 bytes = mChunks.capacity() * sizeof(Chunk)
+            + mCells.capacity() * sizeof(Cell)
+            + mCellIndex.size() * hashNode;
+    foreach (const Chunk &chunk, mChunks)
+        bytes += chunk.cells.capacity() * sizeof(quint32);
+    return bytes;
+}
+
+quint32 SparseTileGrid::cellIndex(const Cell &cell)
+{
+    if (cell.isEmpty())
+        return 0;
+    QHash<Cell,quint32>::const_iterator it = mCellIndex.find(cell);
+    if (it != mCellIndex.constEnd())
+        return *it;
+    const quint32 index = mCells.size();
+    mCells.append(cell);
+    mCellIndex.insert(cell, index);
+    return index;
+}
+#endif // SPARSE_TILELAYER
+
 TileLayer::TileLayer(const QString &name, int x, int y, int width, int height):
     Layer(TileLayerType, name, x, y, width, height),
     mMaxTileSize(0, 0),
@@ -183,6 +266,37 @@ void TileLayer::setCells(int x, int y, TileLayer *layer,
                 setCell(_x, _y, layer->cellAt(_x - x, _y - y));
 }
 
+bool TileLayer::setCells(const uint *gids, const GidMapper &gidMapper,
+                         uint &invalidGid)
+{
+    uint lastGid = 0;
+    Cell lastCell;
+
+    for (int y = 0; y < mHeight; ++y) {
+        const uint *row = gids + y * mWidth;
+        for (int x = 0; x < mWidth; ++x) {
+            const uint gid = row[x];
+            if (gid == 0) {
+                if (!cellAt(x, y).isEmpty())
+                    setCell(x, y, Cell());
+                continue;
+            }
+            if (gid != lastGid) {
+                bool ok;
+                lastCell = gidMapper.gidToCell(gid, ok);
+                if (!ok) {
+                    invalidGid = gid;
+                    return false;
+                }
+                lastGid = gid;
+            }
+            setCell(x, y, lastCell);
+        }
+    }
+
+    return true;
+}
+
 void TileLayer::erase(const QRegion &area)
 {
     const Cell emptyCell;
@@ -552,6 +666,17 @@ bool TileLayer::isEmpty() const
 #endif
 }
 
+#ifdef ZOMBOID
+qint64 TileLayer::memoryUsage() const
+{
+#if SPARSE_TILELAYER
+    return sizeof(TileLayer) + mGrid.memoryUsage();
+#else
+    return sizeof(TileLayer) + mGrid.capacity() * sizeof(Cell);
+#endif
+}
+#endif
+
 /**
  * Returns a duplicate of this TileLayer.
  *
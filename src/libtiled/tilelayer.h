@@ -37,12 +37,14 @@
 #include "ztilelayergroup.h"
 #endif
 
+#include <QHash>
 #include <QMargins>
 #include <QString>
 #include <QVector>
 
 namespace Tiled {
 
+class GidMapper;
 class Tile;
 class Tileset;
 
@@ -93,63 +95,59 @@ public:
 #ifdef ZOMBOID
 #define SPARSE_TILELAYER 1
 
+inline uint qHash(const Cell &cell)
+{
+    return uint(quintptr(cell.tile) >> 3)
+            ^ (uint(cell.flippedHorizontally) << 29)
+            ^ (uint(cell.flippedVertically) << 30)
+            ^ (uint(cell.flippedAntiDiagonally) << 31);
+}
+
 /**
-  * This is a QHash-based tile grid.  Project Zomboid maps can be 300x300 with over
-  * 100 tile layers, most of which are mostly empty.  Using a sparse array results in
-  * massive memory savings.
+  * This is a chunked tile grid.  Project Zomboid maps can be 300x300 with over
+  * 100 tile layers, most of which are mostly empty.
+  *
+  * The grid is divided into ChunkSize x ChunkSize chunks (the same size as the
+  * chunks in .lotpack files).  Each chunk is either uniform (every cell the
+  * same, which includes the common all-empty case) or dense.  Dense chunks
+  * store one 32-bit index per cell into a table of the distinct cells
+  * (tile plus flip flags) used in the grid.  Index 0 is always the empty cell.
+  *
+  * Looking up a cell is O(1) with no hashing, and memory scales with the
+  * painted area rather than the size of the layer.  The chunk table itself
+  * isn't allocated until the first non-empty cell is set.
   */
-class SparseTileGrid
+class TILEDSHARED_EXPORT SparseTileGrid
 {
 public:
-    SparseTileGrid(int width, int height)
-        : mWidth(width)
-        , mHeight(height)
-        , mUseVector(false)
-    {
-    }
+    enum { ChunkSize = 10 };
+
+    SparseTileGrid(int width, int height);
 
     int size() const
     { return mWidth * mHeight; }
 
     const Cell &at(int index) const
     {
-        if (mUseVector)
-            return mCellsVector[index];
-        QHash<int,Cell>::const_iterator it = mCells.find(index);
-        if (it != mCells.end())
-            return *it;
-        return mEmptyCell;
+        return at(index % mWidth, index / mWidth);
     }
 
     const Cell &at(int x, int y) const
     {
-        return at(y * mWidth + x);
+        if (mChunks.isEmpty())
+            return mCells.at(0);
+        const Chunk &chunk = mChunks.at((y / ChunkSize) * mChunksWide + x / ChunkSize);
+        if (chunk.cells.isEmpty())
+            return mCells.at(chunk.uniform);
+        return mCells.at(chunk.cells.at((y % ChunkSize) * ChunkSize + x % ChunkSize));
     }
 
     void replace(int index, const Cell &cell)
     {
-        if (mUseVector) {
-            mCellsVector[index] = cell;
-            return;
-        }
-        QHash<int,Cell>::iterator it = mCells.find(index);
-        if (it == mCells.end()) {
-            if (cell.isEmpty())
-                return;
-            mCells.insert(index, cell);
-        } else if (!cell.isEmpty())
-            (*it) = cell;
-        else
-            mCells.erase(it);
-        if (mCells.size() > 300 * 300 / 3)
-            swapToVector();
+        replace(index % mWidth, index / mWidth, cell);
     }
 
-    void replace(int x, int y, const Cell &cell)
-    {
-        int index = y * mWidth + x;
-        replace(index, cell);
-    }
+    void replace(int x, int y, const Cell &cell);
 
     void setTile(int index, Tile *tile)
     {
@@ -159,35 +157,35 @@ public:
     }
 
     bool isEmpty() const
-    { return !mUseVector && mCells.isEmpty(); }
+    { return mChunks.isEmpty(); }
 
-    void clear()
-    {
-        if (mUseVector)
-            mCellsVector.fill(mEmptyCell);
-        else
-            mCells.clear();
-    }
+    void clear();
+
+    /**
+      * Returns roughly how many bytes the grid has allocated.
+      */
+    qint64 memoryUsage() const;
 
 private:
-    void swapToVector()
+    quint32 cellIndex(const Cell &cell);
+
+    struct Chunk
     {
-        Q_ASSERT(!mUseVector);
-        mCellsVector.resize(size());
-        QHash<int,Cell>::const_iterator it = mCells.begin();
-        while (it != mCells.end()) {
-            mCellsVector[it.key()] = (*it);
-            ++it;
-        }
-        mCells.clear();
-        mUseVector = true;
-    }
+        Chunk() : uniform(0) {}
+
+        bool isEmpty() const
+        { return cells.isEmpty() && !uniform; }
+
+        QVector<quint32> cells;
+        quint32 uniform;
+    };
 
     int mWidth, mHeight;
-    QHash<int,Cell> mCells;
-    QVector<Cell> mCellsVector;
-    bool mUseVector;
-    Cell mEmptyCell;
+    int mChunksWide, mChunksHigh;
+    QVector<Chunk> mChunks;
+    int mUsedChunks;
+    QVector<Cell> mCells;
+    QHash<Cell,quint32> mCellIndex;
 };
 #endif
 
@@ -256,7 +254,11 @@ public:
      * coordinates have to be within this layer.
      */
     const Cell &cellAt(int x, int y) const
+#if SPARSE_TILELAYER
+    { return mGrid.at(x, y); }
+#else
     { return mGrid.at(x + y * mWidth); }
+#endif
 
     const Cell &cellAt(const QPoint &point) const
     { return cellAt(point.x(), point.y()); }
@@ -301,6 +303,17 @@ public:
     void setCells(int x, int y, TileLayer *tileLayer,
                   const QRegion &mask = QRegion());
 
+    /**
+     * Sets every cell of this layer from \a gids, an array of width * height
+     * global tile IDs in row order. Empty gids don't touch cells that are
+     * already empty, and consecutive identical gids are only resolved once.
+     *
+     * Returns false and sets \a invalidGid when \a gidMapper can't resolve
+     * one of the gids.
+     */
+    bool setCells(const uint *gids, const GidMapper &gidMapper,
+                  uint &invalidGid);
+
     /**
      * Flip this tile layer in the given \a direction. Direction must be
      * horizontal or vertical. This doesn't change the dimensions of the
@@ -374,6 +387,13 @@ public:
      */
     bool isEmpty() const;
 
+#ifdef ZOMBOID
+    /**
+     * Returns roughly how many bytes this layer's cells use.
+     */
+    qint64 memoryUsage() const;
+#endif
+
     virtual Layer *clone() const;
 
 #ifdef ZOMBOID
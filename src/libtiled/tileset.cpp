@@ -31,6 +31,11 @@
 #include "tile.h"
 
 #include <QBitmap>
+#ifdef ZOMBOID
+#include <QDir>
+#endif
+
+#include <string.h>
 
 using namespace Tiled;
 
@@ -52,42 +57,18 @@ bool Tileset::loadFromImage(const QImage &image, const QString &fileName)
         return false;
 
 #ifdef ZOMBOID
-    int mTileWidth = this->mTileWidth;
-    int mTileHeight = this->mTileHeight;
-    if (!mImageSource2x.isEmpty()) {
-        mTileWidth *= 2;
-        mTileHeight *= 2;
-    }
-#endif
-
+    TilesetAtlas atlas;
+    createAtlas(image, atlas);
+    return loadFromAtlas(atlas, fileName);
+#else
     const int stopWidth = image.width() - mTileWidth;
     const int stopHeight = image.height() - mTileHeight;
 
     int oldTilesetSize = mTiles.size();
     int tileNum = 0;
-#ifdef ZOMBOID
-    QImage image2 = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
-#endif
+
     for (int y = mMargin; y <= stopHeight; y += mTileHeight + mTileSpacing) {
         for (int x = mMargin; x <= stopWidth; x += mTileWidth + mTileSpacing) {
-#ifdef ZOMBOID
-            QImage tileImage = image2.copy(x, y, mTileWidth, mTileHeight);
-
-            if (mTransparentColor.isValid()) {
-                for (int x = 0; x < mTileWidth; x++) {
-                    for (int y = 0; y < mTileHeight; y++) {
-                        if (tileImage.pixel(x, y) == mTransparentColor.rgba())
-                            tileImage.setPixel(x, y, qRgba(0,0,0,0));
-                    }
-                }
-            }
-
-            if (tileNum < oldTilesetSize) {
-                mTiles.at(tileNum)->setImage(tileImage);
-            } else {
-                mTiles.append(new Tile(tileImage, tileNum, this));
-            }
-#else
             const QImage tileImage = image.copy(x, y, mTileWidth, mTileHeight);
             QPixmap tilePixmap = QPixmap::fromImage(tileImage);
 
@@ -102,32 +83,135 @@ bool Tileset::loadFromImage(const QImage &image, const QString &fileName)
             } else {
                 mTiles.append(new Tile(tilePixmap, tileNum, this));
             }
-#endif
             ++tileNum;
         }
     }
 
     // Blank out any remaining tiles to avoid confusion
     while (tileNum < oldTilesetSize) {
-#ifdef ZOMBOID
-        mTiles.at(tileNum)->setEmptyImage(mTileWidth, mTileHeight);
-#else
         QPixmap tilePixmap = QPixmap(mTileWidth, mTileHeight);
         tilePixmap.fill();
         mTiles.at(tileNum)->setImage(tilePixmap);
-#endif
         ++tileNum;
     }
 
     mImageWidth = image.width();
     mImageHeight = image.height();
     mColumnCount = columnCountForWidth(mImageWidth);
+    mImageSource = fileName;
+    return true;
+#endif
+}
+
 #ifdef ZOMBOID
+void Tileset::createAtlas(const QImage &image, TilesetAtlas &atlas) const
+{
+    int mTileWidth = this->mTileWidth;
+    int mTileHeight = this->mTileHeight;
+    if (!mImageSource2x.isEmpty()) {
+        mTileWidth *= 2;
+        mTileHeight *= 2;
+    }
+
+    const int stopWidth = image.width() - mTileWidth;
+    const int stopHeight = image.height() - mTileHeight;
+
+    QImage image2 = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    if (mTransparentColor.isValid()) {
+        const QRgb transparent = mTransparentColor.rgba();
+        for (int y = 0; y < image2.height(); y++) {
+            for (int x = 0; x < image2.width(); x++) {
+                if (image2.pixel(x, y) == transparent)
+                    image2.setPixel(x, y, qRgba(0,0,0,0));
+            }
+        }
+    }
+
+    // Trim each tile, then pack the trimmed tiles row by row into a single
+    // atlas image.  The tiles' images point into the atlas, so a tileset
+    // costs one allocation instead of one per tile.
+    QVector<QRect> trimmed;
+    QVector<QPoint> atlasPos;
+    atlas.rects.clear();
+    atlas.offsets.clear();
+    const int atlasWidth = image2.width();
+    int atlasX = 0, atlasY = 0, rowHeight = 0;
+    for (int y = mMargin; y <= stopHeight; y += mTileHeight + mTileSpacing) {
+        for (int x = mMargin; x <= stopWidth; x += mTileWidth + mTileSpacing) {
+            QRect bounds = Tile::opaqueBounds(image2, QRect(x, y, mTileWidth, mTileHeight));
+            trimmed += bounds;
+            if (bounds.isNull()) {
+                atlasPos += QPoint();
+                atlas.rects += QRect();
+                atlas.offsets += QPoint();
+                continue;
+            }
+            if (atlasX + bounds.width() > atlasWidth) {
+                atlasX = 0;
+                atlasY += rowHeight;
+                rowHeight = 0;
+            }
+            atlasPos += QPoint(atlasX, atlasY);
+            atlas.rects += QRect(atlasPos.last(), bounds.size());
+            atlas.offsets += bounds.topLeft() - QPoint(x, y);
+            atlasX += bounds.width();
+            rowHeight = qMax(rowHeight, bounds.height());
+        }
+    }
+
+    atlas.image = QImage(atlasWidth, qMax(atlasY + rowHeight, 1), QImage::Format_ARGB32_Premultiplied);
+    atlas.image.fill(Qt::transparent);
+    for (int i = 0; i < trimmed.size(); i++) {
+        const QRect &bounds = trimmed[i];
+        for (int y = 0; y < bounds.height(); y++) {
+            memcpy(atlas.image.scanLine(atlasPos[i].y() + y) + atlasPos[i].x() * 4,
+                   image2.constScanLine(bounds.y() + y) + bounds.x() * 4,
+                   bounds.width() * 4);
+        }
+    }
+
+    atlas.imageSize = image.size();
+}
+
+bool Tileset::loadFromAtlas(const TilesetAtlas &atlas, const QString &fileName)
+{
+    Q_ASSERT(mTileWidth > 0 && mTileHeight > 0);
+
+    if (atlas.image.isNull() || atlas.rects.size() != atlas.offsets.size())
+        return false;
+
+    int mTileWidth = this->mTileWidth;
+    int mTileHeight = this->mTileHeight;
+    if (!mImageSource2x.isEmpty()) {
+        mTileWidth *= 2;
+        mTileHeight *= 2;
+    }
+
+    int oldTilesetSize = mTiles.size();
+    int tileNum = 0;
+    for (; tileNum < atlas.rects.size(); ++tileNum) {
+        if (tileNum >= oldTilesetSize)
+            mTiles.append(new Tile(mTileWidth, mTileHeight, tileNum, this));
+        mTiles.at(tileNum)->setImage(atlas.image, atlas.rects[tileNum],
+                                     atlas.offsets[tileNum],
+                                     QSize(mTileWidth, mTileHeight));
+    }
+
+    // Blank out any remaining tiles to avoid confusion
+    while (tileNum < oldTilesetSize) {
+        mTiles.at(tileNum)->setEmptyImage(mTileWidth, mTileHeight);
+        ++tileNum;
+    }
+
+    mImageWidth = atlas.imageSize.width();
+    mImageHeight = atlas.imageSize.height();
+    mColumnCount = columnCountForWidth(mImageWidth);
     mLoaded = true;
-#endif
     mImageSource = fileName;
     return true;
 }
+#endif
 
 #ifdef ZOMBOID
 bool Tileset::loadFromCache(Tileset *cached)
@@ -209,6 +293,29 @@ bool Tileset::loadFromNothing(const QSize &imageSize, const QString &fileName)
     return true;
 }
 
+void Tileset::createMips()
+{
+    foreach (Tile *tile, mTiles)
+        tile->createMips();
+}
+
+bool Tileset::hasMips() const
+{
+    foreach (Tile *tile, mTiles) {
+        if (tile->hasMips())
+            return true;
+    }
+    return false;
+}
+
+qint64 Tileset::mipBytes() const
+{
+    qint64 bytes = 0;
+    foreach (Tile *tile, mTiles)
+        bytes += tile->mipBytes();
+    return bytes;
+}
+
 #endif // ZOMBOID
 
 Tileset *Tileset::findSimilarTileset(const QList<Tileset*> &tilesets) const
@@ -253,6 +360,31 @@ Tileset *Tileset::clone() const
     return clone;
 }
 
+TilesetImageKey::TilesetImageKey(const QString &source, const Tileset *ts) :
+    source(QDir::cleanPath(source)),
+    tileWidth(ts->tileWidth()),
+    tileHeight(ts->tileHeight()),
+    tileSpacing(ts->tileSpacing()),
+    margin(ts->margin()),
+    transparentColor(ts->transparentColor())
+{
+}
+
+uint Tiled::qHash(const TilesetImageKey &key)
+{
+    uint h = qHash(key.source);
+    h = h * 31 + uint(key.tileWidth);
+    h = h * 31 + uint(key.tileHeight);
+    h = h * 31 + uint(key.tileSpacing);
+    h = h * 31 + uint(key.margin);
+    return h * 31 + (key.transparentColor.isValid() ? key.transparentColor.rgba() : 0);
+}
+
+TilesetImageCache::TilesetImageCache() :
+    mLookups(0)
+{
+}
+
 TilesetImageCache::~TilesetImageCache()
 {
     qDeleteAll(mTilesets);
@@ -276,8 +408,19 @@ Tileset *TilesetImageCache::addTileset(Tileset *ts)
         cached->mTiles.append(new Tile(tile, tileNum, cached));
     }
 
+    const int index = mTilesets.size();
     mTilesets.append(cached);
 
+    // Only the first tileset with a key is ever found by findMatch().
+    TilesetImageKey key1x(cached->imageSource(), cached);
+    if (!mIndex1x.contains(key1x))
+        mIndex1x.insert(key1x, index);
+    if (!cached->imageSource2x().isEmpty()) {
+        TilesetImageKey key2x(cached->imageSource2x(), cached);
+        if (!mIndex2x.contains(key2x))
+            mIndex2x.insert(key2x, index);
+    }
+
 //    qDebug() << "added tileset image " << ts->imageSource() << " to cache";
 
     return cached;
@@ -285,18 +428,20 @@ Tileset *TilesetImageCache::addTileset(Tileset *ts)
 
 Tileset *TilesetImageCache::findMatch(Tileset *ts, const QString &imageSource, const QString &imageSource2x)
 {
-    foreach (Tileset *candidate, mTilesets) {
-        if (((candidate->imageSource() == imageSource) || (!imageSource2x.isEmpty() && (candidate->imageSource2x() == imageSource2x)))
-                && candidate->tileWidth() == ts->tileWidth()
-                && candidate->tileHeight() == ts->tileHeight()
-                && candidate->tileSpacing() == ts->tileSpacing()
-                && candidate->margin() == ts->margin()
-                && candidate->transparentColor() == ts->transparentColor()) {
-//            qDebug() << "retrieved tileset image " << candidate->imageSource() << " from cache";
-            return candidate;
-        }
+    ++mLookups;
+
+    // The first cached tileset whose 1x or 2x image matches, as if the
+    // list was searched in order.
+    int index = mIndex1x.value(TilesetImageKey(imageSource, ts), -1);
+    if (!imageSource2x.isEmpty()) {
+        int index2x = mIndex2x.value(TilesetImageKey(imageSource2x, ts), -1);
+        if (index2x != -1 && (index == -1 || index2x < index))
+            index = index2x;
     }
-    return NULL;
+    if (index == -1)
+        return NULL;
+//    qDebug() << "retrieved tileset image " << mTilesets[index]->imageSource() << " from cache";
+    return mTilesets[index];
 }
 
 #endif
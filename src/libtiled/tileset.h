@@ -36,7 +36,11 @@
 #include <QList>
 #include <QPoint>
 #ifdef ZOMBOID
+#include <QHash>
+#include <QImage>
+#include <QRect>
 #include <QSize>
+#include <QVector>
 #endif
 #include <QString>
 
@@ -48,13 +52,63 @@ class Tile;
 
 #ifdef ZOMBOID
 class Tileset;
+/**
+  * Identifies the tiles a tileset image produces: the image file plus
+  * everything loadFromImage() uses to cut it into tiles.
+  */
+struct TilesetImageKey
+{
+    TilesetImageKey(const QString &source, const Tileset *ts);
+
+    bool operator==(const TilesetImageKey &other) const
+    {
+        return source == other.source && tileWidth == other.tileWidth &&
+                tileHeight == other.tileHeight && tileSpacing == other.tileSpacing &&
+                margin == other.margin && transparentColor == other.transparentColor;
+    }
+
+    QString source;
+    int tileWidth;
+    int tileHeight;
+    int tileSpacing;
+    int margin;
+    QColor transparentColor;
+};
+
+uint qHash(const TilesetImageKey &key);
+
+/**
+  * The trimmed tiles of a tileset image packed into a single image, see
+  * Tileset::createAtlas().  Fully transparent tiles have a null rect.
+  */
+struct TilesetAtlas
+{
+    QImage image;
+    QVector<QRect> rects;       // each tile's pixels in image
+    QVector<QPoint> offsets;    // each tile's pixels relative to its cell
+    QSize imageSize;            // the tileset image the atlas was made from
+};
+
 class TILEDSHARED_EXPORT TilesetImageCache
 {
 public:
+    TilesetImageCache();
     ~TilesetImageCache();
     Tileset *addTileset(Tileset *ts);
     Tileset *findMatch(Tileset *ts, const QString &imageSource, const QString &imageSource2x);
     QList<Tileset*> mTilesets;
+
+    /**
+      * Returns how many times findMatch() was called.
+      */
+    int lookupCount() const
+    { return mLookups; }
+
+private:
+    // Index into mTilesets of the first tileset with each key.
+    QHash<TilesetImageKey,int> mIndex1x;
+    QHash<TilesetImageKey,int> mIndex2x;
+    int mLookups;
 };
 
 #endif
@@ -214,12 +268,31 @@ public:
     bool loadFromImage(const QImage &image, const QString &fileName);
 
 #ifdef ZOMBOID
+    /**
+     * Cuts \a image into tiles, trims them, and packs them into \a atlas.
+     * This is the slow part of loadFromImage(); the result can be saved and
+     * handed to loadFromAtlas() later.
+     */
+    void createAtlas(const QImage &image, TilesetAtlas &atlas) const;
+
+    /**
+     * Sets the tile images from an atlas made by createAtlas().
+     */
+    bool loadFromAtlas(const TilesetAtlas &atlas, const QString &fileName);
+
     bool loadFromCache(Tileset *cached);
     friend class TilesetImageCache;
 #endif
 
 #ifdef ZOMBOID
     bool loadFromNothing(const QSize &imageSize, const QString &fileName);
+
+    /**
+     * Builds the zoomed-out mip levels of every tile, see Tile::createMips().
+     */
+    void createMips();
+    bool hasMips() const;
+    qint64 mipBytes() const;
 #endif
 
     /**
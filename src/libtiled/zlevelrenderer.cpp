@@ -253,6 +253,8 @@ void ZLevelRenderer::drawTileLayer(QPainter *painter,
     bool shifted = inUpperHalf ^ inLeftHalf;
 
     QTransform baseTransform = painter->transform();
+    // How much the painter shrinks or grows a tile, to pick a mip level.
+    const qreal painterScale = std::sqrt(qAbs(baseTransform.determinant()));
 
     for (int y = startPos.y(); y - tileHeight < rect.bottom();
          y += tileHeight / 2)
@@ -301,22 +303,28 @@ void ZLevelRenderer::drawTileLayer(QPainter *painter,
                                                          : img.height();
                     }
 
+                    qreal tileScale = painterScale;
                     if (tileWidth == cell.tile->width() * 2) {
                         m11 *= 2.0f;
                         m22 *= 2.0f;
                         dx += cell.tile->offset().x();
                         dy -= cell.tile->height() - cell.tile->offset().y();
+                        tileScale *= 2;
                     } else if (tileWidth == cell.tile->width() / 2) {
                         float scale = 0.5f;
                         m11 *= scale;
                         m22 *= scale;
                         dy += cell.tile->height() / 2;
+                        tileScale *= scale;
                     }
 
                     const QTransform transform(m11, m12, m21, m22, dx, dy);
                     painter->setTransform(transform * baseTransform);
 
-                    painter->drawImage(0, 0, img);
+                    if (cell.tile->hasMips())
+                        painter->drawImage(QRectF(QPointF(), img.size()), cell.tile->mipImage(tileScale));
+                    else
+                        painter->drawImage(0, 0, img);
                 }
             }
 
@@ -396,6 +404,8 @@ void ZLevelRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *laye
     bool shifted = inUpperHalf ^ inLeftHalf;
 
     QTransform baseTransform = painter->transform();
+    // How much the painter shrinks or grows a tile, to pick a mip level.
+    const qreal painterScale = std::sqrt(qAbs(baseTransform.determinant()));
 
     /*static*/ QVector<const Cell*> cells(40); // or QVarLengthArray
     /*static*/ QVector<qreal> opacities(40); // or QVarLengthArray
@@ -464,11 +474,13 @@ void ZLevelRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *laye
                                                              : img.height();
                         }
 
+                        qreal tileScale = painterScale;
                         if (tileWidth == tile->width() * 2) {
                             m11 *= 2.0f;
                             m22 *= 2.0f;
                             dx += tile->offset().x();
                             dy -= tile->height() - tile->offset().y();
+                            tileScale *= 2;
                         } else if (tileWidth == tile->width() / 2) {
                             float scale = 0.5f;
                             m11 *= scale;
@@ -477,6 +489,7 @@ void ZLevelRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *laye
 //                            dy += (tile->tileset()->tileHeight() - img.height() * scale);
 //                            dy -= (tileHeight - tileHeight * scale) / 2;
                             dy += tile->height() / 2;
+                            tileScale *= scale;
                         }
 
                         const QTransform transform(m11, m12, m21, m22, dx, dy);
@@ -484,7 +497,10 @@ void ZLevelRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *laye
 
                         painter->setOpacity(opacities[i] * opacity);
 
-                        painter->drawImage(0, 0, img);
+                        if (tile->hasMips())
+                            painter->drawImage(QRectF(QPointF(), img.size()), tile->mipImage(tileScale));
+                        else
+                            painter->drawImage(0, 0, img);
                     }
                 }
             }
@@ -22,6 +22,7 @@
 #include "buildingtemplates.h"
 #include "buildingtiles.h"
 #include "furnituregroups.h"
+#include "tilenameatoms.h"
 
 #include <QSet>
 
@@ -181,15 +182,9 @@ QStringList Building::tilesetNames() const
         foreach (QString layerName, floor->grimeLayers()) {
             for (int y = 0; y < floor->height(); y++) {
                 for (int x = 0; x < floor->width(); x++) {
-                    QString tileName = floor->grime()[layerName]->at(x, y);
-                    if (tileName.isEmpty())
-                        continue;
-                    QString tilesetName;
-                    int index;
-                    if (BuildingTilesMgr::instance()->parseTileName(tileName,
-                                                                    tilesetName,
-                                                                    index))
-                        ret += tilesetName;
+                    int atom = floor->grime()[layerName]->atomAt(x, y);
+                    if (atom && TileNameAtoms::index(atom) >= 0)
+                        ret += TileNameAtoms::tilesetName(atom);
                 }
             }
         }
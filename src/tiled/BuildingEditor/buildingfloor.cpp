@@ -23,6 +23,7 @@
 #include "buildingtiles.h"
 #include "furnituregroups.h"
 #include "roofhiding.h"
+#include "tilenameatoms.h"
 
 #if defined(Q_OS_WIN) && (_MSC_VER >= 1600)
 // Hmmmm.  libtiled.dll defines the MapRands class as so:
@@ -47,31 +48,26 @@ FloorTileGrid::FloorTileGrid(int width, int height) :
 
 const QString &FloorTileGrid::at(int index) const
 {
-    if (mUseVector)
-        return mCellsVector[index];
-    QHash<int,QString>::const_iterator it = mCells.find(index);
-    if (it != mCells.end())
-        return *it;
-    return mEmptyCell;
+    return TileNameAtoms::name(atomAt(index));
 }
 
-void FloorTileGrid::replace(int index, const QString &tile)
+void FloorTileGrid::replaceAtom(int index, int atom)
 {
     if (mUseVector) {
-        if (!mCellsVector[index].isEmpty() && tile.isEmpty()) mCount--;
-        if (mCellsVector[index].isEmpty() && !tile.isEmpty()) mCount++;
-        mCellsVector[index] = tile;
+        int &cell = mCellsVector[index];
+        if (cell && !atom) mCount--;
+        if (!cell && atom) mCount++;
+        cell = atom;
         return;
     }
-    QHash<int,QString>::iterator it = mCells.find(index);
+    QHash<int,int>::iterator it = mCells.find(index);
     if (it == mCells.end()) {
-        if (tile.isEmpty())
+        if (!atom)
             return;
-        mCells.insert(index, tile);
-        mCount++;
-    } else if (!tile.isEmpty()) {
-        (*it) = tile;
+        mCells.insert(index, atom);
         mCount++;
+    } else if (atom) {
+        (*it) = atom;
     } else {
         mCells.erase(it);
         mCount--;
@@ -80,6 +76,11 @@ void FloorTileGrid::replace(int index, const QString &tile)
         swapToVector();
 }
 
+void FloorTileGrid::replace(int index, const QString &tile)
+{
+    replaceAtom(index, TileNameAtoms::atom(tile));
+}
+
 void FloorTileGrid::replace(int x, int y, const QString &tile)
 {
     Q_ASSERT(contains(x, y));
@@ -88,27 +89,19 @@ void FloorTileGrid::replace(int x, int y, const QString &tile)
 
 bool FloorTileGrid::replace(const QString &tile)
 {
-    bool changed = false;
-    for (int x = 0; x < mWidth; x++) {
-        for (int y = 0; y < mHeight; y++) {
-            if (at(x, y) != tile) {
-                replace(x, y, tile);
-                changed = true;
-            }
-        }
-    }
-    return changed;
+    return replace(bounds(), tile);
 }
 
 bool FloorTileGrid::replace(const QRegion &rgn, const QString &tile)
 {
+    const int atom = TileNameAtoms::atom(tile);
     bool changed = false;
     foreach (QRect r2, rgn.rects()) {
         r2 &= bounds();
         for (int x = r2.left(); x <= r2.right(); x++) {
             for (int y = r2.top(); y <= r2.bottom(); y++) {
-                if (at(x, y) != tile) {
-                    replace(x, y, tile);
+                if (atomAt(x, y) != atom) {
+                    replaceAtom(x, y, atom);
                     changed = true;
                 }
             }
@@ -126,9 +119,9 @@ bool FloorTileGrid::replace(const QRegion &rgn, const QPoint &p,
         r2 &= bounds();
         for (int x = r2.left(); x <= r2.right(); x++) {
             for (int y = r2.top(); y <= r2.bottom(); y++) {
-                QString tile = other->at(x - p.x(), y - p.y());
-                if (at(x, y) != tile) {
-                    replace(x, y, tile);
+                int atom = other->atomAt(x - p.x(), y - p.y());
+                if (atomAt(x, y) != atom) {
+                    replaceAtom(x, y, atom);
                     changed = true;
                 }
             }
@@ -139,11 +132,12 @@ bool FloorTileGrid::replace(const QRegion &rgn, const QPoint &p,
 
 bool FloorTileGrid::replace(const QRect &r, const QString &tile)
 {
+    const int atom = TileNameAtoms::atom(tile);
     bool changed = false;
     for (int x = r.left(); x <= r.right(); x++) {
         for (int y = r.top(); y <= r.bottom(); y++) {
-            if (at(x, y) != tile) {
-                replace(x, y, tile);
+            if (atomAt(x, y) != atom) {
+                replaceAtom(x, y, atom);
                 changed = true;
             }
         }
@@ -157,9 +151,9 @@ bool FloorTileGrid::replace(const QPoint &p, const FloorTileGrid *other)
     bool changed = false;
     for (int x = r.left(); x <= r.right(); x++) {
         for (int y = r.top(); y <= r.bottom(); y++) {
-            QString tile = other->at(x - p.x(), y - p.y());
-            if (at(x, y) != tile) {
-                replace(x, y, tile);
+            int atom = other->atomAt(x - p.x(), y - p.y());
+            if (atomAt(x, y) != atom) {
+                replaceAtom(x, y, atom);
                 changed = true;
             }
         }
@@ -170,7 +164,7 @@ bool FloorTileGrid::replace(const QPoint &p, const FloorTileGrid *other)
 void FloorTileGrid::clear()
 {
     if (mUseVector)
-        mCellsVector.fill(mEmptyCell);
+        mCellsVector.fill(0);
     else
         mCells.clear();
     mCount = 0;
@@ -185,9 +179,13 @@ FloorTileGrid *FloorTileGrid::clone(const QRect &r)
 {
     FloorTileGrid *klone = new FloorTileGrid(r.width(), r.height());
     const QRect r2 = r & bounds();
+    // A copy of most of a full grid would fill the hash with a node per
+    // tile before swapping to the vector anyway.
+    if (mUseVector && r2.width() * r2.height() > 300 * 300 / 3)
+        klone->swapToVector();
     for (int x = r2.left(); x <= r2.right(); x++) {
         for (int y = r2.top(); y <= r2.bottom(); y++) {
-            klone->replace(x - r.x(), y - r.y(), at(x, y));
+            klone->replaceAtom(x - r.x(), y - r.y(), atomAt(x, y));
         }
     }
     return klone;
@@ -200,7 +198,7 @@ FloorTileGrid *FloorTileGrid::clone(const QRect &r, const QRegion &rgn)
         r2 &= bounds() & r;
         for (int x = r2.left(); x <= r2.right(); x++) {
             for (int y = r2.top(); y <= r2.bottom(); y++) {
-                klone->replace(x - r.x(), y - r.y(), at(x, y));
+                klone->replaceAtom(x - r.x(), y - r.y(), atomAt(x, y));
             }
         }
     }
@@ -211,7 +209,7 @@ void FloorTileGrid::swapToVector()
 {
     Q_ASSERT(!mUseVector);
     mCellsVector.resize(size());
-    QHash<int,QString>::const_iterator it = mCells.begin();
+    QHash<int,int>::const_iterator it = mCells.begin();
     while (it != mCells.end()) {
         mCellsVector[it.key()] = (*it);
         ++it;
@@ -299,13 +297,13 @@ void BuildingFloor::setGrid(const QVector<QVector<Room *> > &grid)
 
 static void ReplaceRoofSlope(RoofObject *ro, const QRect &r,
                              QVector<QVector<BuildingFloor::Square> > &squares,
-                             RoofObject::RoofTile tile)
+                             RoofObject::RoofTile tile, const QRect &clip)
 {
     if (r.isEmpty()) return;
     int offset = ro->getOffset(tile);
     QPoint tileOffset = ro->slopeTiles()->offset(offset);
     QRect bounds(0, 0, squares.size(), squares[0].size());
-    QRect rOffset = r.translated(tileOffset) & bounds;
+    QRect rOffset = r.translated(tileOffset) & bounds & clip;
     for (int x = rOffset.left(); x <= rOffset.right(); x++)
         for (int y = rOffset.top(); y <= rOffset.bottom(); y++)
             squares[x][y].ReplaceRoof(ro->slopeTiles(), offset);
@@ -313,23 +311,24 @@ static void ReplaceRoofSlope(RoofObject *ro, const QRect &r,
 
 static void ReplaceRoofSlope(RoofObject *ro, const QRect &r,
                            const QVector<RoofObject::RoofTile> &tiles,
-                           QVector<QVector<BuildingFloor::Square> > &squares)
+                           QVector<QVector<BuildingFloor::Square> > &squares,
+                           const QRect &clip)
 {
     if (tiles.isEmpty()) return;
     for (int y = r.top(); y <= r.bottom(); y++)
         for (int x = r.left(); x <= r.right(); x++)
-            ReplaceRoofSlope(ro, QRect(x, y, 1, 1), squares, tiles.at(x - r.left() + (y - r.top()) * r.width()));
+            ReplaceRoofSlope(ro, QRect(x, y, 1, 1), squares, tiles.at(x - r.left() + (y - r.top()) * r.width()), clip);
 }
 
 static void ReplaceRoofGap(RoofObject *ro, const QRect &r,
                            QVector<QVector<BuildingFloor::Square> > &squares,
-                           RoofObject::RoofTile tile)
+                           RoofObject::RoofTile tile, const QRect &clip)
 {
     if (r.isEmpty()) return;
     int offset = ro->getOffset(tile);
     QPoint tileOffset = ro->capTiles()->offset(offset);
     QRect bounds(0, 0, squares.size(), squares[0].size());
-    QRect rOffset = r.translated(tileOffset) & bounds;
+    QRect rOffset = r.translated(tileOffset) & bounds & clip;
     for (int x = rOffset.left(); x <= rOffset.right(); x++)
         for (int y = rOffset.top(); y <= rOffset.bottom(); y++)
             squares[x][y].ReplaceRoofCap(ro->capTiles(), offset);
@@ -337,28 +336,30 @@ static void ReplaceRoofGap(RoofObject *ro, const QRect &r,
 
 static void ReplaceRoofCap(RoofObject *ro, int x, int y,
                            QVector<QVector<BuildingFloor::Square> > &squares,
-                           RoofObject::RoofTile tile)
+                           RoofObject::RoofTile tile, const QRect &clip)
 {
     int offset = ro->getOffset(tile);
     QPoint tileOffset = ro->capTiles()->offset(offset);
     QRect bounds(0, 0, squares.size(), squares[0].size());
     QPoint p = QPoint(x, y) + tileOffset;
-    if (bounds.contains(p))
+    if (bounds.contains(p) && clip.contains(p))
         squares[p.x()][p.y()].ReplaceRoofCap(ro->capTiles(), offset);
 }
 
 static void ReplaceRoofCap(RoofObject *ro, const QRect &r,
                            const QVector<RoofObject::RoofTile> &tiles,
-                           QVector<QVector<BuildingFloor::Square> > &squares)
+                           QVector<QVector<BuildingFloor::Square> > &squares,
+                           const QRect &clip)
 {
     if (tiles.isEmpty()) return;
     for (int y = r.top(); y <= r.bottom(); y++)
         for (int x = r.left(); x <= r.right(); x++)
-            ReplaceRoofCap(ro, x, y, squares, tiles.at(x - r.left() + (y - r.top()) * r.width()));
+            ReplaceRoofCap(ro, x, y, squares, tiles.at(x - r.left() + (y - r.top()) * r.width()), clip);
 }
 
 static void ReplaceRoofTop(RoofObject *ro, const QRect &r,
-                           QVector<QVector<BuildingFloor::Square> > &squares)
+                           QVector<QVector<BuildingFloor::Square> > &squares,
+                           const QRect &clip)
 {
     if (r.isEmpty()) return;
     int offset = 0;
@@ -372,7 +373,7 @@ static void ReplaceRoofTop(RoofObject *ro, const QRect &r,
         offset = ro->isN() ? BTC_RoofTops::North3 : BTC_RoofTops::West3;
     QPoint tileOffset = ro->topTiles()->offset(offset);
     QRect bounds(0, 0, squares.size(), squares[0].size());
-    QRect rOffset = r.translated(tileOffset) & bounds;
+    QRect rOffset = r.translated(tileOffset) & bounds & clip;
     for (int x = rOffset.left(); x <= rOffset.right(); x++)
         for (int y = rOffset.top(); y <= rOffset.bottom(); y++)
             (ro->depth() == RoofObject::Zero || ro->depth() == RoofObject::Three)
@@ -382,26 +383,27 @@ static void ReplaceRoofTop(RoofObject *ro, const QRect &r,
 
 static void ReplaceRoofCorner(RoofObject *ro, int x, int y,
                               QVector<QVector<BuildingFloor::Square> > &squares,
-                              RoofObject::RoofTile tile)
+                              RoofObject::RoofTile tile, const QRect &clip)
 {
     int offset = ro->getOffset(tile);
     QPoint tileOffset = ro->slopeTiles()->offset(offset);
     QRect bounds(0, 0, squares.size(), squares[0].size());
     QPoint p = QPoint(x, y) + tileOffset;
-    if (bounds.contains(p))
+    if (bounds.contains(p) && clip.contains(p))
         squares[p.x()][p.y()].ReplaceRoof(ro->slopeTiles(), offset);
 }
 
 static void ReplaceRoofCorner(RoofObject *ro, const QRect &r,
                               const QVector<RoofObject::RoofTile> &tiles,
-                              QVector<QVector<BuildingFloor::Square> > &squares)
+                              QVector<QVector<BuildingFloor::Square> > &squares,
+                              const QRect &clip)
 {
     if (tiles.isEmpty()) return;
     for (int y = r.top(); y <= r.bottom(); y++)
         for (int x = r.left(); x <= r.right(); x++) {
             RoofObject::RoofTile tile = tiles.at(x - r.left() + (y - r.top()) * r.width());
             if (tile != RoofObject::TileCount)
-                ReplaceRoofCorner(ro, x, y, squares, tile);
+                ReplaceRoofCorner(ro, x, y, squares, tile, clip);
         }
 }
 
@@ -410,21 +412,22 @@ static void ReplaceFurniture(int x, int y,
                              BuildingTile *btile,
                              BuildingFloor::Square::SquareSection sectionMin,
                              BuildingFloor::Square::SquareSection sectionMax,
-                             int dw = 0, int dh = 0)
+                             const QRect &clip, int dw = 0, int dh = 0)
 {
     if (!btile)
         return;
     Q_ASSERT(dw <= 1 && dh <= 1);
     QRect bounds(0, 0, squares.size() - 1 + dw, squares[0].size() - 1 + dh);
-    if (bounds.contains(x, y))
+    if (bounds.contains(x, y) && clip.contains(x, y))
         squares[x][y].ReplaceFurniture(btile, sectionMin, sectionMax);
 }
 
-static void ReplaceDoor(Door *door, QVector<QVector<BuildingFloor::Square> > &squares)
+static void ReplaceDoor(Door *door, QVector<QVector<BuildingFloor::Square> > &squares,
+                        const QRect &clip)
 {
     int x = door->x(), y = door->y();
     QRect bounds(0, 0, squares.size(), squares[0].size());
-    if (bounds.contains(x, y)) {
+    if (bounds.contains(x, y) && clip.contains(x, y)) {
         squares[x][y].ReplaceDoor(door->tile(),
                                   door->isW() ? BTC_Doors::West
                                               : BTC_Doors::North);
@@ -434,39 +437,45 @@ static void ReplaceDoor(Door *door, QVector<QVector<BuildingFloor::Square> > &sq
     }
 }
 
-static void ReplaceWindow(Window *window, QVector<QVector<BuildingFloor::Square> > &squares)
+static void ReplaceWindow(Window *window, QVector<QVector<BuildingFloor::Square> > &squares,
+                          const QRect &clip)
 {
     int x = window->x(), y = window->y();
     QRect bounds(0, 0, squares.size(), squares[0].size());
     if (bounds.contains(x, y)) {
-        squares[x][y].ReplaceWindow(window->tile(),
-                                    window->isW() ? BTC_Windows::West
-                                                  : BTC_Windows::North);
+        if (clip.contains(x, y))
+            squares[x][y].ReplaceWindow(window->tile(),
+                                        window->isW() ? BTC_Windows::West
+                                                      : BTC_Windows::North);
 
         // Window curtains on exterior walls must be *inside* the
         // room.
         if (squares[x][y].mExterior) {
             int dx = window->isW() ? 1 : 0;
             int dy = window->isN() ? 1 : 0;
-            if ((x - dx >= 0) && (y - dy >= 0))
+            if ((x - dx >= 0) && (y - dy >= 0) && clip.contains(x - dx, y - dy))
                 squares[x - dx][y - dy].ReplaceCurtains(window, true);
-        } else
+        } else if (clip.contains(x, y))
             squares[x][y].ReplaceCurtains(window, false);
 
         if (squares[x][y].mExterior) {
             if (window->isN()) {
-                if (x > 0)
+                if (x > 0 && clip.contains(x - 1, y))
                     squares[x-1][y].ReplaceShutters(window, true);
-                squares[x][y].ReplaceShutters(window, true);
-                squares[x][y].ReplaceShutters(window, false);
-                if (x < bounds.right())
+                if (clip.contains(x, y)) {
+                    squares[x][y].ReplaceShutters(window, true);
+                    squares[x][y].ReplaceShutters(window, false);
+                }
+                if (x < bounds.right() && clip.contains(x + 1, y))
                     squares[x + 1][y].ReplaceShutters(window, false);
             } else {
-                if (y > 0)
+                if (y > 0 && clip.contains(x, y - 1))
                     squares[x][y - 1].ReplaceShutters(window, true);
-                squares[x][y].ReplaceShutters(window, true);
-                squares[x][y].ReplaceShutters(window, false);
-                if (y < bounds.bottom())
+                if (clip.contains(x, y)) {
+                    squares[x][y].ReplaceShutters(window, true);
+                    squares[x][y].ReplaceShutters(window, false);
+                }
+                if (y < bounds.bottom() && clip.contains(x, y + 1))
                     squares[x][y + 1].ReplaceShutters(window, false);
             }
         } else {
@@ -475,15 +484,61 @@ static void ReplaceWindow(Window *window, QVector<QVector<BuildingFloor::Square>
     }
 }
 
-void BuildingFloor::LayoutToSquares()
+// The parts of a square that LayoutToSquares() reads from the squares east
+// and south of it.
+static bool sameEdge(const BuildingFloor::Square &a, const BuildingFloor::Square &b)
+{
+    return a.mWallN.entry == b.mWallN.entry && a.mWallW.entry == b.mWallW.entry &&
+            a.mWallN.trim == b.mWallN.trim && a.mWallW.trim == b.mWallW.trim &&
+            a.mSolidWallN == b.mSolidWallN && a.mSolidWallW == b.mSolidWallW;
+}
+
+// How far a change to one square can reach the squares around it.  A room
+// change moves the walls of the squares east and south of it, and their
+// corner pieces and trim depend on the walls of the squares west and north.
+#define LAYOUT_PADDING 2
+
+QRect BuildingFloor::LayoutToSquares(const QRect &dirty)
 {
     int w = width() + 1;
     int h = height() + 1;
     // +1 for the outside walls;
     static const Square empty;
-    squares.resize(w);
-    for (int x = 0; x < w; x++)
-        squares[x].fill(empty, h);
+
+    // Squares outside 'area' keep their contents.  Nothing below writes
+    // outside it.
+    QRect area = bounds(1, 1);
+    bool partial = false;
+    QVector<Square> oldRight, oldBottom;
+    if (!dirty.isEmpty() && squares.size() == w && squares[0].size() == h) {
+        area &= dirty.adjusted(-LAYOUT_PADDING, -LAYOUT_PADDING,
+                               LAYOUT_PADDING, LAYOUT_PADDING);
+        partial = (area != bounds(1, 1));
+    }
+    if (partial) {
+        // The squares east and south of the area read its right column and
+        // bottom row.  Keep the old ones to see whether those changed.
+        if (area.right() + 1 < w) {
+            for (int y = area.top(); y <= area.bottom(); y++)
+                oldRight += squares[area.right()][y];
+        }
+        if (area.bottom() + 1 < h) {
+            for (int x = area.left(); x <= area.right(); x++)
+                oldBottom += squares[x][area.bottom()];
+        }
+        for (int x = area.left(); x <= area.right(); x++)
+            for (int y = area.top(); y <= area.bottom(); y++)
+                squares[x][y] = empty;
+    } else {
+        squares.resize(w);
+        for (int x = 0; x < w; x++)
+            squares[x].fill(empty, h);
+    }
+
+    // The floor squares of the area, and the floor squares the walls in the
+    // area look at.
+    QRect floorArea = area & bounds();
+    QRect indexArea = area.adjusted(-1, -1, 0, 0) & bounds();
 
     BuildingTileEntry *wtype = 0;
 
@@ -499,18 +554,19 @@ void BuildingFloor::LayoutToSquares()
         floors += room->tile(Room::Floor);
     }
 
-    for (int x = 0; x < width(); x++) {
-        for (int y = 0; y < height(); y++) {
+    for (int x = indexArea.left(); x <= indexArea.right(); x++) {
+        for (int y = indexArea.top(); y <= indexArea.bottom(); y++) {
             Room *room = mRoomAtPos[x][y];
             if (room != nullptr && RoofHiding::isEmptyOutside(room->Name))
                 room = nullptr;
             mIndexAtPos[x][y] = room ? mBuilding->indexOf(room) : -1;
-            squares[x][y].mExterior = room == 0;
+            if (floorArea.contains(x, y))
+                squares[x][y].mExterior = room == 0;
         }
     }
 
-    for (int x = 0; x < width() + 1; x++) {
-        for (int y = 0; y < height() + 1; y++) {
+    for (int x = area.left(); x <= area.right(); x++) {
+        for (int y = area.top(); y <= area.bottom(); y++) {
             // Place N walls...
             if (x < width()) {
                 if (y == height() && mIndexAtPos[x][y - 1] >= 0) {
@@ -549,7 +605,7 @@ void BuildingFloor::LayoutToSquares()
         if (WallObject *wall = object->asWall()) {
             int x = wall->x(), y = wall->y();
             if (wall->isN()) {
-                QRect r = wall->bounds() & bounds(1, 0);
+                QRect r = wall->bounds() & bounds(1, 0) & area;
                 for (y = r.top(); y <= r.bottom(); y++) {
                     squares[x][y].SetWallW(wall->tile(squares[x][y].mExterior
                                                       ? WallObject::TileExterior
@@ -559,7 +615,7 @@ void BuildingFloor::LayoutToSquares()
                                                           : WallObject::TileInteriorTrim));
                 }
             } else {
-                QRect r = wall->bounds() & bounds(0, 1);
+                QRect r = wall->bounds() & bounds(0, 1) & area;
                 for (x = r.left(); x <= r.right(); x++) {
                     squares[x][y].SetWallN(wall->tile(squares[x][y].mExterior
                                                       ? WallObject::TileExterior
@@ -604,7 +660,7 @@ void BuildingFloor::LayoutToSquares()
                 for (int i = 0; i < ftile->size().height(); i++) {
                     for (int j = 0; j < ftile->size().width(); j++) {
                         int sx = x + j + dx, sy = y + i + dy;
-                        if (bounds(1, 1).contains(sx, sy)) {
+                        if (area.contains(sx, sy)) {
                             Square &sq = squares[sx][sy];
                             if (killW)
                                 sq.SetWallW(fo->furnitureTile(), ftile->tile(j, i));
@@ -617,8 +673,8 @@ void BuildingFloor::LayoutToSquares()
         }
     }
 
-    for (int x = 0; x < width() + 1; x++) {
-        for (int y = 0; y < height() + 1; y++) {
+    for (int x = area.left(); x <= area.right(); x++) {
+        for (int y = area.top(); y <= area.bottom(); y++) {
             Square &s = squares[x][y];
             BuildingTileEntry *wallN = s.mWallN.entry;
             BuildingTileEntry *wallW = s.mWallW.entry;
@@ -644,11 +700,17 @@ void BuildingFloor::LayoutToSquares()
                     s.mWallOrientation = Square::WallOrientNW;
                 }
             }
+            s.mSolidWallW = s.IsWallOrient(Square::WallOrientW) ||
+                    s.IsWallOrient(Square::WallOrientNW);
+            s.mSolidWallN = s.IsWallOrient(Square::WallOrientN) ||
+                    s.IsWallOrient(Square::WallOrientNW);
         }
     }
 
-    for (int x = 0; x < width() + 1; x++) {
-        for (int y = 0; y < height() + 1; y++) {
+    // The corner pieces read mSolidWallW/N rather than IsWallOrient(), since
+    // later steps change the walls of squares outside a partial layout.
+    for (int x = area.left(); x <= area.right(); x++) {
+        for (int y = area.top(); y <= area.bottom(); y++) {
             Square &sq = squares[x][y];
             if ((sq.mEntries[Square::SectionWall] &&
                     !sq.mEntries[Square::SectionWall]->isNone()) ||
@@ -656,10 +718,8 @@ void BuildingFloor::LayoutToSquares()
                 continue;
             // Put in the SE piece...
             if ((x > 0) && (y > 0) &&
-                    (squares[x][y - 1].IsWallOrient(Square::WallOrientW) ||
-                     squares[x][y - 1].IsWallOrient(Square::WallOrientNW)) &&
-                    (squares[x - 1][y].IsWallOrient(Square::WallOrientN) ||
-                     squares[x - 1][y].IsWallOrient(Square::WallOrientNW))) {
+                    squares[x][y - 1].mSolidWallW &&
+                    squares[x - 1][y].mSolidWallN) {
 
                 // With WallObjects, there could be 2 different tiles meeting
                 // at this SE corner.
@@ -668,18 +728,14 @@ void BuildingFloor::LayoutToSquares()
                 sq.ReplaceWall(wtype, Square::WallOrientSE);
             }
             // South end of a north-south wall.
-            else if ((y > 0) &&
-                     (squares[x][y - 1].IsWallOrient(Square::WallOrientW) ||
-                      squares[x][y - 1].IsWallOrient(Square::WallOrientNW))) {
+            else if ((y > 0) && squares[x][y - 1].mSolidWallW) {
                 wtype = squares[x][y - 1].mWallW.entry;
                 sq.mEntries[Square::SectionWall] = wtype;
                 sq.mEntryEnum[Square::SectionWall] = BTC_Walls::SouthEast;
                 sq.mWallOrientation = Square::WallOrientInvalid;
             }
             // East end of a west-east wall.
-            else if ((x > 0) &&
-                     (squares[x - 1][y].IsWallOrient(Square::WallOrientN) ||
-                      squares[x - 1][y].IsWallOrient(Square::WallOrientNW))) {
+            else if ((x > 0) && squares[x - 1][y].mSolidWallN) {
                 wtype = squares[x - 1][y].mWallN.entry;
                 sq.mEntries[Square::SectionWall] = wtype;
                 sq.mEntryEnum[Square::SectionWall] = BTC_Walls::SouthEast;
@@ -695,10 +751,10 @@ void BuildingFloor::LayoutToSquares()
         int x = object->x();
         int y = object->y();
         if (Door *door = object->asDoor()) {
-            ReplaceDoor(door, squares);
+            ReplaceDoor(door, squares, area);
         }
         if (Window *window = object->asWindow()) {
-            ReplaceWindow(window, squares);
+            ReplaceWindow(window, squares, area);
         }
         if (Stairs *stairs = object->asStairs()) {
             // Stair objects are 5 tiles long but only have 3 tiles.
@@ -707,13 +763,13 @@ void BuildingFloor::LayoutToSquares()
                     ReplaceFurniture(x, y + i, squares,
                                      stairs->tile()->tile(stairs->getOffset(x, y + i)),
                                      Square::SectionFurniture,
-                                     Square::SectionFurniture4);
+                                     Square::SectionFurniture4, area);
             } else {
                 for (int i = 1; i <= 3; i++)
                     ReplaceFurniture(x + i, y, squares,
                                      stairs->tile()->tile(stairs->getOffset(x + i, y)),
                                      Square::SectionFurniture,
-                                     Square::SectionFurniture4);
+                                     Square::SectionFurniture4, area);
             }
             mStairs += stairs;
         }
@@ -736,18 +792,20 @@ void BuildingFloor::LayoutToSquares()
                                          squares, ftile->tile(j, i),
                                          Square::SectionRoofCap,
                                          Square::SectionRoofCap2,
-                                         dx, dy);
+                                         area, dx, dy);
                         break;
                     }
                     case FurnitureTiles::LayerWallOverlay:
                         ReplaceFurniture(x + j, y + i, squares, ftile->tile(j, i),
                                          (ftile->isW() || ftile->isN()) ? Square::SectionWallOverlay : Square::SectionWallOverlay3,
-                                         (ftile->isW() || ftile->isN()) ? Square::SectionWallOverlay2 : Square::SectionWallOverlay4);
+                                         (ftile->isW() || ftile->isN()) ? Square::SectionWallOverlay2 : Square::SectionWallOverlay4,
+                                         area);
                         break;
                     case FurnitureTiles::LayerWallFurniture:
                         ReplaceFurniture(x + j, y + i, squares, ftile->tile(j, i),
                                          (ftile->isW() || ftile->isN()) ? Square::SectionWallFurniture : Square::SectionWallFurniture3,
-                                         (ftile->isW() || ftile->isN()) ? Square::SectionWallFurniture2 : Square::SectionWallFurniture4);
+                                         (ftile->isW() || ftile->isN()) ? Square::SectionWallFurniture2 : Square::SectionWallFurniture4,
+                                         area);
                         break;
                     case FurnitureTiles::LayerFrames: {
                         int dx = 0, dy = 0;
@@ -757,7 +815,7 @@ void BuildingFloor::LayoutToSquares()
                                          squares, ftile->tile(j, i),
                                          Square::SectionFrame,
                                          Square::SectionFrame,
-                                         dx, dy);
+                                         area, dx, dy);
                         break;
                     }
                     case FurnitureTiles::LayerDoors: {
@@ -768,18 +826,18 @@ void BuildingFloor::LayoutToSquares()
                                          squares, ftile->tile(j, i),
                                          Square::SectionDoor,
                                          Square::SectionDoor,
-                                         dx, dy);
+                                         area, dx, dy);
                         break;
                     }
                     case FurnitureTiles::LayerFurniture:
                         ReplaceFurniture(x + j, y + i, squares, ftile->tile(j, i),
                                          Square::SectionFurniture,
-                                         Square::SectionFurniture4);
+                                         Square::SectionFurniture4, area);
                         break;
                     case FurnitureTiles::LayerRoof:
                         ReplaceFurniture(x + j, y + i, squares, ftile->tile(j, i),
                                          Square::SectionRoof,
-                                         Square::SectionRoof2);
+                                         Square::SectionRoof2, area);
                         break;
                     default:
                         Q_ASSERT(false);
@@ -865,24 +923,24 @@ void BuildingFloor::LayoutToSquares()
             ReplaceRoofSlope(ro, squares, RoofObject::ShallowSlopeS2);
 #else
             tiles = ro->slopeTiles(tileRect);
-            ReplaceRoofSlope(ro, tileRect, tiles, squares);
+            ReplaceRoofSlope(ro, tileRect, tiles, squares, area);
 #endif
 
             tiles = ro->westCapTiles(tileRect);
-            ReplaceRoofCap(ro, tileRect, tiles, squares);
+            ReplaceRoofCap(ro, tileRect, tiles, squares, area);
 
             tiles = ro->eastCapTiles(tileRect);
-            ReplaceRoofCap(ro, tileRect, tiles, squares);
+            ReplaceRoofCap(ro, tileRect, tiles, squares, area);
 
             tiles = ro->northCapTiles(tileRect);
-            ReplaceRoofCap(ro, tileRect, tiles, squares);
+            ReplaceRoofCap(ro, tileRect, tiles, squares, area);
 
             tiles = ro->southCapTiles(tileRect);
-            ReplaceRoofCap(ro, tileRect, tiles, squares);
+            ReplaceRoofCap(ro, tileRect, tiles, squares, area);
 
 #if 1
             tiles = ro->cornerTiles(tileRect);
-            ReplaceRoofCorner(ro, tileRect, tiles, squares);
+            ReplaceRoofCorner(ro, tileRect, tiles, squares, area);
 #else
             // Inner corner
             bool slopeE, slopeS;
@@ -1077,7 +1135,7 @@ void BuildingFloor::LayoutToSquares()
             // Roof tops with depth of 3 are placed in the floor layer of the
             // floor above.
             if (ro->depth() != RoofObject::Three)
-                ReplaceRoofTop(ro, ro->flatTop(), squares);
+                ReplaceRoofTop(ro, ro->flatTop(), squares, area);
             else if (!ro->flatTop().isEmpty())
                 mFlatRoofsWithDepthThree += ro;
 #if 0
@@ -1536,7 +1594,7 @@ void BuildingFloor::LayoutToSquares()
         }
         for (int i = 0; i < ftile->size().height(); i++) {
             for (int j = 0; j < ftile->size().width(); j++) {
-                if (bounds(1, 1).contains(x + j + dx, y + i + dy)) {
+                if (area.contains(x + j + dx, y + i + dy)) {
                     Square &s = squares[x + j + dx][y + i + dy];
                     Square::SquareSection section = Square::SectionWall;
                     if (s.mEntries[section] && !s.mEntries[section]->isNone()) {
@@ -1575,8 +1633,8 @@ void BuildingFloor::LayoutToSquares()
     }
 
     // Place floors
-    for (int x = 0; x < width(); x++) {
-        for (int y = 0; y < height(); y++) {
+    for (int x = floorArea.left(); x <= floorArea.right(); x++) {
+        for (int y = floorArea.top(); y <= floorArea.bottom(); y++) {
             if (mIndexAtPos[x][y] >= 0)
                 squares[x][y].ReplaceFloor(floors[mIndexAtPos[x][y]], 0);
         }
@@ -1585,7 +1643,7 @@ void BuildingFloor::LayoutToSquares()
     if (BuildingFloor *floorBelow = this->floorBelow()) {
         // Place flat roof tops above roofs on the floor below
         foreach (RoofObject *ro, floorBelow->mFlatRoofsWithDepthThree) {
-            ReplaceRoofTop(ro, ro->flatTop(), squares);
+            ReplaceRoofTop(ro, ro->flatTop(), squares, area);
         }
 
         // Nuke floors that have stairs on the floor below.
@@ -1594,16 +1652,18 @@ void BuildingFloor::LayoutToSquares()
             if (stairs->isW()) {
                 if (x + 1 < 0 || x + 3 >= width() || y < 0 || y >= height())
                     continue;
-                squares[x+1][y].ReplaceFloor(0, 0);
-                squares[x+2][y].ReplaceFloor(0, 0);
-                squares[x+3][y].ReplaceFloor(0, 0);
+                for (int i = 1; i <= 3; i++) {
+                    if (area.contains(x + i, y))
+                        squares[x+i][y].ReplaceFloor(0, 0);
+                }
             }
             if (stairs->isN()) {
                 if (x < 0 || x >= width() || y + 1 < 0 || y + 3 >= height())
                     continue;
-                squares[x][y+1].ReplaceFloor(0, 0);
-                squares[x][y+2].ReplaceFloor(0, 0);
-                squares[x][y+3].ReplaceFloor(0, 0);
+                for (int i = 1; i <= 3; i++) {
+                    if (area.contains(x, y + i))
+                        squares[x][y+i].ReplaceFloor(0, 0);
+                }
             }
         }
     }
@@ -1611,8 +1671,8 @@ void BuildingFloor::LayoutToSquares()
     FloorTileGrid *userTilesWalls = mGrimeGrid.contains(QLatin1Literal("Walls")) ? mGrimeGrid[QLatin1Literal("Walls")] : 0;
     FloorTileGrid *userTilesWalls2 = mGrimeGrid.contains(QLatin1Literal("Walls2")) ? mGrimeGrid[QLatin1Literal("Walls2")] : 0;
 
-    for (int x = 0; x < w; x++) {
-        for (int y = 0; y < h; y++) {
+    for (int x = area.left(); x <= area.right(); x++) {
+        for (int y = area.top(); y <= area.bottom(); y++) {
             Square &sq = squares[x][y];
 
             sq.ReplaceWallTrim();
@@ -1649,6 +1709,42 @@ void BuildingFloor::LayoutToSquares()
             }
         }
     }
+
+    if (partial) {
+        // If what the neighbours read from the edges of the area changed,
+        // squares outside the area may change too.
+        for (int i = 0; i < oldRight.size(); i++) {
+            if (!sameEdge(oldRight[i], squares[area.right()][area.top() + i]))
+                return LayoutToSquares();
+        }
+        for (int i = 0; i < oldBottom.size(); i++) {
+            if (!sameEdge(oldBottom[i], squares[area.left() + i][area.bottom()]))
+                return LayoutToSquares();
+        }
+    }
+
+    return area;
+}
+
+QRect BuildingFloor::layoutBounds(BuildingObject *object)
+{
+    // Doors and windows change the squares beside them, and furniture and
+    // roof caps facing east or south go in the next square over.  Roof tiles
+    // may be offset further than that.
+    int pad = 1;
+    if (RoofObject *roof = object->asRoof()) {
+        QList<BuildingTileEntry*> entries;
+        entries << roof->slopeTiles() << roof->capTiles() << roof->topTiles();
+        foreach (BuildingTileEntry *entry, entries) {
+            if (!entry)
+                continue;
+            for (int e = 0; e < entry->category()->enumCount(); e++) {
+                QPoint offset = entry->offset(e);
+                pad = qMax(pad, 1 + qMax(qAbs(offset.x()), qAbs(offset.y())));
+            }
+        }
+    }
+    return object->bounds().adjusted(-pad, -pad, pad, pad);
 }
 
 Door *BuildingFloor::GetDoorAt(int x, int y)
@@ -1789,7 +1885,7 @@ QMap<QString,FloorTileGrid*> BuildingFloor::resizeGrime(const QSize &newSize) co
         grid[key] = new FloorTileGrid(newSize.width(), newSize.height());
         for (int x = 0; x < qMin(mGrimeGrid[key]->width(), newSize.width()); x++)
             for (int y = 0; y < qMin(mGrimeGrid[key]->height(), newSize.height()); y++)
-                grid[key]->replace(x, y, mGrimeGrid[key]->at(x, y));
+                grid[key]->replaceAtom(x, y, mGrimeGrid[key]->atomAt(x, y));
 
     }
 
@@ -1867,6 +1963,13 @@ QString BuildingFloor::grimeAt(const QString &layerName, int x, int y) const
     return QString();
 }
 
+int BuildingFloor::grimeAtomAt(const QString &layerName, int x, int y) const
+{
+    if (mGrimeGrid.contains(layerName))
+        return mGrimeGrid[layerName]->atomAt(x, y);
+    return 0;
+}
+
 FloorTileGrid *BuildingFloor::grimeAt(const QString &layerName, const QRect &r)
 {
     if (mGrimeGrid.contains(layerName))
@@ -1907,6 +2010,13 @@ void BuildingFloor::setGrime(const QString &layerName, int x, int y,
     mGrimeGrid[layerName]->replace(x, y, tileName);
 }
 
+void BuildingFloor::setGrimeAtom(const QString &layerName, int x, int y, int atom)
+{
+    if (!mGrimeGrid.contains(layerName))
+        mGrimeGrid[layerName] = new FloorTileGrid(width() + 1, height() + 1);
+    mGrimeGrid[layerName]->replaceAtom(x, y, atom);
+}
+
 
 void BuildingFloor::setGrime(const QString &layerName, const QPoint &p,
                              const FloorTileGrid *other)
@@ -1956,6 +2066,8 @@ BuildingFloor::Square::Square() :
     mEntryEnum(MaxSection, 0),
     mWallOrientation(WallOrientInvalid),
     mExterior(true),
+    mSolidWallW(false),
+    mSolidWallN(false),
     mTiles(MaxSection, 0)
 {
 }
@@ -2293,6 +2405,7 @@ void BuildingFloor::Square::ReplaceFloorGrime(BuildingTileEntry *grimeTile)
 #include "tiledeffile.h"
 #include "tilemetainfomgr.h"
 #include <QFileInfo>
+#include <QThread>
 
 #if defined(Q_OS_WIN) && (_MSC_VER >= 1600)
 // Hmmmm.  libtiled.dll defines the Properties class as so:
@@ -2318,6 +2431,13 @@ TileDefWatcher::TileDefWatcher() :
 
 void TileDefWatcher::check()
 {
+    {
+        QReadLocker locker(&mLock);
+        if (tileDefFileChecked)
+            return;
+    }
+
+    QWriteLocker locker(&mLock);
     if (!tileDefFileChecked) {
         QFileInfo fileInfo(TileMetaInfoMgr::instance()->tilesDirectory() + QString::fromLatin1("/newtiledefinitions.tiles"));
 #if 1
@@ -2328,7 +2448,7 @@ void TileDefWatcher::check()
         if (fileInfo.exists()) {
             qDebug() << "TileDefWatcher read " << fileInfo.absoluteFilePath();
             mTileDefFile->read(fileInfo.absoluteFilePath());
-            if (!watching) {
+            if (!watching && thread() == QThread::currentThread()) {
                 mWatcher->addPath(fileInfo.canonicalFilePath());
                 watching = true;
             }
@@ -2340,9 +2460,16 @@ void TileDefWatcher::check()
 void TileDefWatcher::fileChanged(const QString &path)
 {
     qDebug() << "TileDefWatcher.fileChanged() " << path;
-    tileDefFileChecked = false;
+    {
+        QWriteLocker locker(&mLock);
+        tileDefFileChecked = false;
+    }
     //        removePath(path);
     //        addPath(path);
+
+    // Read it again here rather than in whichever thread lays out a building
+    // next.
+    check();
 }
 
 } // namespace Internal
@@ -2381,6 +2508,7 @@ static bool tileHasGrimeProperties(BuildingTile *btile, GrimeProperties *props)
 
     Tiled::Internal::TileDefWatcher *tileDefWatcher = getTileDefWatcher();
     tileDefWatcher->check();
+    QReadLocker locker(&tileDefWatcher->mLock);
 
     if (props) {
         props->West = props->North = props->SouthEast = false;
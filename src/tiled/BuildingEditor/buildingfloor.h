@@ -21,6 +21,7 @@
 #include <QHash>
 #include <QList>
 #include <QMap>
+#include <QReadWriteLock>
 #include <QRegion>
 #include <QString>
 #include <QStringList>
@@ -63,6 +64,26 @@ public:
         return at(x + y * mWidth);
     }
 
+    int atomAt(int index) const
+    {
+        if (mUseVector)
+            return mCellsVector[index];
+        return mCells.value(index);
+    }
+
+    int atomAt(int x, int y) const
+    {
+        Q_ASSERT(contains(x, y));
+        return atomAt(x + y * mWidth);
+    }
+
+    void replaceAtom(int index, int atom);
+    void replaceAtom(int x, int y, int atom)
+    {
+        Q_ASSERT(contains(x, y));
+        replaceAtom(x + y * mWidth, atom);
+    }
+
     void replace(int index, const QString &tile);
     void replace(int x, int y, const QString &tile);
     bool replace(const QString &tile);
@@ -88,10 +109,9 @@ private:
 
     int mWidth, mHeight;
     int mCount;
-    QHash<int,QString> mCells;
-    QVector<QString> mCellsVector;
+    QHash<int,int> mCells; // tile-name atoms
+    QVector<int> mCellsVector;
     bool mUseVector;
-    QString mEmptyCell;
 };
 
 class BuildingFloor
@@ -155,6 +175,12 @@ public:
         QVector<int> mEntryEnum;
         WallOrientation mWallOrientation;
         bool mExterior;
+
+        // Whether this square has a west (north) wall that a corner piece
+        // south (east) of it joins.  LayoutToSquares() reads these from
+        // squares outside a partial layout.
+        bool mSolidWallW;
+        bool mSolidWallN;
         QVector<BuildingTile*> mTiles;
 
         struct WallInfo {
@@ -252,7 +278,18 @@ public:
     const QVector<QVector<Room*> > &grid() const
     { return mRoomAtPos; }
 
-    void LayoutToSquares();
+    /**
+      * Recalculates the squares in \a dirty, padded for neighbouring squares
+      * that depend on them.  When \a dirty is empty, or when the change
+      * reaches the edges of the padded area, every square is recalculated.
+      * Returns the area that was recalculated.
+      */
+    QRect LayoutToSquares(const QRect &dirty = QRect());
+
+    /**
+      * Returns the squares LayoutToSquares() may change because of \a object.
+      */
+    static QRect layoutBounds(BuildingObject *object);
 
     int width() const;
     int height() const;
@@ -282,6 +319,7 @@ public:
     { return mGrimeGrid.keys(); }
 
     QString grimeAt(const QString &layerName, int x, int y) const;
+    int grimeAtomAt(const QString &layerName, int x, int y) const;
     FloorTileGrid *grimeAt(const QString &layerName, const QRect &r);
     FloorTileGrid *grimeAt(const QString &layerName, const QRect &r, const QRegion &rgn);
 
@@ -289,6 +327,7 @@ public:
 
     QMap<QString,FloorTileGrid*> setGrime(const QMap<QString,FloorTileGrid*> &grime);
     void setGrime(const QString &layerName, int x, int y, const QString &tileName);
+    void setGrimeAtom(const QString &layerName, int x, int y, int atom);
     void setGrime(const QString &layerName, const QPoint &p, const FloorTileGrid *other);
     void setGrime(const QString &layerName, const QRegion &rgn, const QString &tileName);
     void setGrime(const QString &layerName, const QRegion &rgn, const QPoint &pos, const FloorTileGrid *other);
@@ -352,6 +391,10 @@ public:
     Tiled::Internal::TileDefFile *mTileDefFile;
     bool tileDefFileChecked;
     bool watching;
+
+    // Buildings are laid out by the map reader threads too.  Hold this for
+    // reading while looking at mTileDefFile.
+    QReadWriteLock mLock;
 };
 
 }
@@ -20,10 +20,12 @@
 #include "building.h"
 #include "buildingfloor.h"
 #include "buildingobjects.h"
+#include "buildingpickindex.h"
 #include "buildingroomdef.h"
 #include "buildingtemplates.h"
 #include "buildingtiles.h"
 #include "buildingtmx.h"
+#include "tilenameatoms.h"
 
 #include "bmpblender.h"
 #include "mapcomposite.h"
@@ -54,6 +56,7 @@ BuildingMap::BuildingMap(Building *building) :
     mBlendMapComposite(0),
     mBlendMap(0),
     mMapRenderer(0),
+    mPickIndex(0),
     mCursorObjectFloor(0),
     mShadowBuilding(0),
     pending(false),
@@ -61,6 +64,9 @@ BuildingMap::BuildingMap(Building *building) :
     pendingBuildingResized(false)
 {
     BuildingToMap();
+
+    connect(TilesetManager::instance(), SIGNAL(tilesetChanged(Tileset*)),
+            SLOT(tilesetChanged()));
 }
 
 BuildingMap::~BuildingMap()
@@ -81,6 +87,8 @@ BuildingMap::~BuildingMap()
         delete mMapRenderer;
     }
 
+    delete mPickIndex;
+
     if (mShadowBuilding)
         delete mShadowBuilding;
 }
@@ -113,54 +121,15 @@ QString BuildingMap::buildingTileAt(int x, int y, const QList<bool> visibleLevel
 
     for (int level = 0; level < mBuilding->floorCount(); level++) {
         if (!visibleLevels[level]) continue;
-        CompositeLayerGroup *lgBlend = mBlendMapComposite->layerGroupForLevel(level);
         CompositeLayerGroup *lg = mMapComposite->layerGroupForLevel(level);
-        QPoint tilePos = mMapRenderer->pixelToTileCoordsInt(QPoint(x, y), level);
-        for (int ty = tilePos.y() - 4; ty < tilePos.y() + 4; ty++) {
-            for (int tx = tilePos.x() - 4; tx < tilePos.x() + 4; tx++) {
-                QRectF tileBox = mMapRenderer->boundingRect(QRect(tx, ty, 1, 1), level);
-                for (int i = 0; i < lg->layerCount(); i++) {
-                    // Automatic building tiles first.
-                    // User-drawn tiles second.
-                    TileLayer *tlBlend = lgBlend->layers().at(i);
-                    TileLayer *tl = lg->layers().at(i);
-                    QString layerName = MapComposite::layerNameWithoutPrefix(tl->name());
-                    if (!mBuilding->floor(level)->layerVisibility(layerName))
-                        continue;
-                    if (!tl->contains(tx, ty)) continue;
-                    Tile *test = tl->cellAt(tx, ty).tile; // user tile
-                    if (!test)
-                        test = tlBlend->cellAt(tx, ty).tile; // building tile
-                    if (test) {
-                        Tile *realTile = test;
-                        if (test->image().isNull()) {
-                            test = TilesetManager::instance()->missingTile();
-                        }
-                        QRect imageBox(test->offset(), test->image().size());
-                        QPoint p = QPoint(x, y) - (tileBox.bottomLeft().toPoint() - QPoint(0, test->height()));
-                        // Handle double-size tiles
-                        if (qRound(tileBox.width()) == test->width() * 2) {
-                            p = QPoint(x, y) - (tileBox.bottomLeft().toPoint() - QPoint(0, test->height() * 2));
-                            p.rx() /= 2;
-                            p.ry() /= 2;
-                        } else if (qRound(tileBox.width()) == test->width() / 2) {
-
-                        }
-                        // Hit test a small box around the cursor?
-                        QRect box(p - QPoint(0, 0), p + QPoint(0, 0));
-                        for (int px = box.left(); px <= box.right(); px++) {
-                            for (int py = box.top(); py <= box.bottom(); py++) {
-                                if (imageBox.contains(px, py)) {
-                                    QRgb pixel = test->image().pixel(px - imageBox.x(), py - imageBox.y());
-                                    if (qAlpha(pixel) > 0)
-                                        tile = realTile;
-                                }
-                            }
-                        }
-                    }
-                }
-            }
+        if (!lg) continue;
+        QVector<bool> layerVisible(lg->layerCount());
+        for (int i = 0; i < lg->layerCount(); i++) {
+            QString layerName = MapComposite::layerNameWithoutPrefix(lg->layers().at(i)->name());
+            layerVisible[i] = mBuilding->floor(level)->layerVisibility(layerName);
         }
+        if (Tile *test = mPickIndex->tileAt(level, QPoint(x, y), layerVisible))
+            tile = test;
     }
 
     if (tile)
@@ -220,51 +189,107 @@ QStringList BuildingMap::requiredLayerNames()
 void BuildingMap::setCursorObject(BuildingFloor *floor, BuildingObject *object)
 {
     if (mCursorObjectFloor && (mCursorObjectFloor != floor)) {
-        pendingLayoutToSquares.insert(mCursorObjectFloor);
+        layoutLater(mCursorObjectFloor);
         if (mCursorObjectFloor->floorAbove())
-            pendingLayoutToSquares.insert(mCursorObjectFloor->floorAbove());
+            layoutLater(mCursorObjectFloor->floorAbove());
         schedulePending();
         mCursorObjectFloor = nullptr;
+        mCursorObjectBounds = QRect();
     }
 
+    // A cursor object that is already on the floor is an object being
+    // resized in place.  Its shadow has the old size until it is recreated.
+    bool resizing = object && floor && (floor->indexOf(object) != -1);
+    QRect dirty = mCursorObjectBounds;
+    if (resizing)
+        dirty |= BuildingFloor::layoutBounds(mShadowBuilding->shadowObject(object));
+
     if (mShadowBuilding->setCursorObject(floor, object)) {
-        pendingLayoutToSquares.insert(floor);
+        if (object)
+            dirty |= BuildingFloor::layoutBounds(object);
+        layoutLater(floor, dirty);
         if (floor && floor->floorAbove())
-            pendingLayoutToSquares.insert(floor->floorAbove());
+            layoutLater(floor->floorAbove(), dirty);
         schedulePending();
         mCursorObjectFloor = object ? floor : nullptr;
     }
+
+    // Remember every size a resized object had, since it gets its original
+    // size back before the cursor object is cleared.
+    if (!object)
+        mCursorObjectBounds = QRect();
+    else if (resizing)
+        mCursorObjectBounds = dirty;
+    else
+        mCursorObjectBounds = BuildingFloor::layoutBounds(object);
 }
 
 void BuildingMap::dragObject(BuildingFloor *floor, BuildingObject *object, const QPoint &offset)
 {
     mShadowBuilding->dragObject(floor, object, offset);
-    pendingLayoutToSquares.insert(floor);
+
+    QRect dirty = mDragBounds.contains(object) ? mDragBounds[object]
+            : object->floor() ? BuildingFloor::layoutBounds(object) : QRect();
+    mDragBounds[object] = BuildingFloor::layoutBounds(object).translated(offset);
+    dirty |= mDragBounds[object];
+
+    layoutLater(floor, dirty);
     if (floor->floorAbove())
-        pendingLayoutToSquares.insert(floor->floorAbove());
+        layoutLater(floor->floorAbove(), dirty);
     schedulePending();
 }
 
 void BuildingMap::resetDrag(BuildingFloor *floor, BuildingObject *object)
 {
     mShadowBuilding->resetDrag(object);
-    pendingLayoutToSquares.insert(floor);
+
+    QRect dirty = mDragBounds.take(object);
+    if (object->floor())
+        dirty |= BuildingFloor::layoutBounds(object);
+
+    layoutLater(floor, dirty);
     if (floor->floorAbove())
-        pendingLayoutToSquares.insert(floor->floorAbove());
+        layoutLater(floor->floorAbove(), dirty);
     schedulePending();
 }
 
+// Returns the bounding rect of the squares whose room differs in the two grids.
+static QRect gridChange(BuildingFloor *floor, const QVector<QVector<Room*> > &a,
+                        const QVector<QVector<Room*> > &b)
+{
+    if (a.size() != b.size())
+        return floor->bounds(1, 1);
+    QRect changed;
+    for (int x = 0; x < a.size(); x++) {
+        if (a[x].size() != b[x].size())
+            return floor->bounds(1, 1);
+        for (int y = 0; y < a[x].size(); y++) {
+            if (a[x][y] != b[x][y])
+                changed |= QRect(x, y, 1, 1);
+        }
+    }
+    return changed;
+}
+
 void BuildingMap::changeFloorGrid(BuildingFloor *floor, const QVector<QVector<Room*> > &grid)
 {
+    BuildingFloor *shadowFloor = mShadowBuilding->floor(floor->level());
+    QRect dirty = gridChange(floor, shadowFloor->grid(), grid);
     mShadowBuilding->changeFloorGrid(floor, grid);
-    pendingLayoutToSquares.insert(floor);
+    if (dirty.isEmpty())
+        return;
+    layoutLater(floor, dirty);
     schedulePending();
 }
 
 void BuildingMap::resetFloorGrid(BuildingFloor *floor)
 {
+    BuildingFloor *shadowFloor = mShadowBuilding->floor(floor->level());
+    QRect dirty = gridChange(floor, shadowFloor->grid(), floor->grid());
     mShadowBuilding->resetFloorGrid(floor);
-    pendingLayoutToSquares.insert(floor);
+    if (dirty.isEmpty())
+        return;
+    layoutLater(floor, dirty);
     schedulePending();
 }
 
@@ -322,10 +347,15 @@ Map *BuildingMap::mergedMap() const
 }
 
 void BuildingMap::loadNeededTilesets(Building *building)
+{
+    loadNeededTilesets(building->tilesetNames());
+}
+
+void BuildingMap::loadNeededTilesets(const QStringList &tilesetNames)
 {
     // If the building uses any tilesets that aren't in Tilesets.txt, then
     // try to load them in now.
-    foreach (QString tilesetName, building->tilesetNames()) {
+    foreach (QString tilesetName, tilesetNames) {
         if (!TileMetaInfoMgr::instance()->tileset(tilesetName)) {
             QString source = TileMetaInfoMgr::instance()->tilesDirectory() +
                     QLatin1Char('/') + tilesetName + QLatin1String(".png");
@@ -464,6 +494,9 @@ void BuildingMap::BuildingToMap()
         delete mMapRenderer;
     }
 
+    delete mPickIndex;
+    mPickIndex = nullptr;
+
     if (mShadowBuilding)
         delete mShadowBuilding;
     mShadowBuilding = new ShadowBuilding(mBuilding);
@@ -536,6 +569,12 @@ void BuildingMap::BuildingToMap()
     mBlendMapComposite = new MapComposite(mapInfo);
     mMapComposite->setBlendOverMap(mBlendMapComposite);
 
+    mPickIndex = new BuildingPickIndex(mMapRenderer);
+    foreach (CompositeLayerGroup *layerGroup, mMapComposite->layerGroups()) {
+        CompositeLayerGroup *blendGroup = mBlendMapComposite->layerGroupForLevel(layerGroup->level());
+        mPickIndex->setLayers(layerGroup->level(), layerGroup->layers(), blendGroup->layers());
+    }
+
     // Set the automatically-generated tiles.
     foreach (CompositeLayerGroup *layerGroup, mBlendMapComposite->layerGroups()) {
         BuildingFloor *floor = mBuilding->floor(layerGroup->level());
@@ -599,9 +638,14 @@ void BuildingMap::BuildingSquaresToTileLayers(BuildingFloor *floor,
 
             }
         }
-        layerGroup->regionAltered(tl); // possibly set mNeedsSynch
+        layerGroup->regionAltered(tl, tl->bounds()); // possibly set mNeedsSynch
         layerIndex++;
     }
+
+    if (area == floor->bounds(1, 1))
+        mPickIndex->invalidate(floor->level());
+    else
+        mPickIndex->invalidate(floor->level(), area | area.translated(offset, offset));
 }
 
 void BuildingMap::userTilesToLayer(BuildingFloor *floor,
@@ -633,29 +677,31 @@ void BuildingMap::userTilesToLayer(BuildingFloor *floor,
 
     BuildingFloor *shadowFloor = mShadowBuilding->floor(floor->level());
 
+    // Each distinct tile name is resolved once.
+    QHash<int,Tile*> tileByAtom;
+    tileByAtom[0] = nullptr;
+
     for (int x = bounds.left(); x <= bounds.right(); x++) {
         for (int y = bounds.top(); y <= bounds.bottom(); y++) {
             if (suppress.contains(QPoint(x, y))) {
                 layer->setCell(x, y, Cell());
                 continue;
             }
-            QString tileName = shadowFloor->grimeAt(layerName, x, y);
-            Tile *tile = nullptr;
-            if (!tileName.isEmpty()) {
-                tile = TilesetManager::instance()->missingTile();
-                QString tilesetName;
-                int index;
-                if (BuildingTilesMgr::parseTileName(tileName, tilesetName, index)) {
-                    if (tilesetByName.contains(tilesetName)) {
-                        tile = tilesetByName[tilesetName]->tileAt(index);
-                    }
-                }
+            int atom = shadowFloor->grimeAtomAt(layerName, x, y);
+            QHash<int,Tile*>::const_iterator it = tileByAtom.find(atom);
+            if (it == tileByAtom.end()) {
+                Tile *tile = TilesetManager::instance()->missingTile();
+                int index = TileNameAtoms::index(atom);
+                if (index >= 0 && tilesetByName.contains(TileNameAtoms::tilesetName(atom)))
+                    tile = tilesetByName[TileNameAtoms::tilesetName(atom)]->tileAt(index);
+                it = tileByAtom.insert(atom, tile);
             }
-            layer->setCell(x, y, Cell(tile));
+            layer->setCell(x, y, Cell(*it));
         }
     }
 
-    layerGroup->regionAltered(layer); // possibly set mNeedsSynch
+    layerGroup->regionAltered(layer, bounds); // possibly set mNeedsSynch
+    mPickIndex->invalidate(floor->level(), bounds);
 }
 
 void BuildingMap::floorAdded(BuildingFloor *floor)
@@ -674,7 +720,7 @@ void BuildingMap::floorEdited(BuildingFloor *floor)
 {
     mShadowBuilding->floorEdited(floor);
 
-    pendingLayoutToSquares.insert(floor);
+    layoutLater(floor);
     schedulePending();
 }
 
@@ -686,7 +732,7 @@ void BuildingMap::floorTilesChanged(BuildingFloor *floor)
 
     // Painting tiles in the Walls/Walls2 layer affects which grime tiles are chosen.
 //    if (tiles.contains(QLatin1Literal("Walls")) || tiles.contains(QLatin1Literal("Walls2")))
-        pendingLayoutToSquares.insert(floor);
+        layoutLater(floor);
 
     schedulePending();
 }
@@ -700,7 +746,7 @@ void BuildingMap::floorTilesChanged(BuildingFloor *floor, const QString &layerNa
 
     // Painting tiles in the Walls/Walls2 layer affects which grime tiles are chosen.
     if (layerName == QLatin1Literal("Walls") || layerName == QLatin1Literal("Walls2"))
-        pendingLayoutToSquares.insert(floor);
+        layoutLater(floor, bounds);
 
     schedulePending();
 }
@@ -708,13 +754,14 @@ void BuildingMap::floorTilesChanged(BuildingFloor *floor, const QString &layerNa
 void BuildingMap::objectAdded(BuildingObject *object)
 {
     BuildingFloor *floor = object->floor();
-    pendingLayoutToSquares.insert(floor);
+    QRect dirty = BuildingFloor::layoutBounds(object);
+    layoutLater(floor, dirty);
 
     // Stairs affect the floor tiles on the floor above.
     // Roofs sometimes affect the floor tiles on the floor above.
     if (BuildingFloor *floorAbove = floor->floorAbove()) {
         if (object->affectsFloorAbove())
-            pendingLayoutToSquares.insert(floorAbove);
+            layoutLater(floorAbove, dirty);
     }
 
     schedulePending();
@@ -725,17 +772,19 @@ void BuildingMap::objectAdded(BuildingObject *object)
 void BuildingMap::objectAboutToBeRemoved(BuildingObject *object)
 {
     BuildingFloor *floor = object->floor();
-    pendingLayoutToSquares.insert(floor);
+    QRect dirty = BuildingFloor::layoutBounds(object);
+    layoutLater(floor, dirty);
 
     // Stairs affect the floor tiles on the floor above.
     // Roofs sometimes affect the floor tiles on the floor above.
     if (BuildingFloor *floorAbove = floor->floorAbove()) {
         if (object->affectsFloorAbove())
-            pendingLayoutToSquares.insert(floorAbove);
+            layoutLater(floorAbove, dirty);
     }
 
     schedulePending();
 
+    mDragBounds.remove(object);
     mShadowBuilding->objectAboutToBeRemoved(object);
 }
 
@@ -746,14 +795,15 @@ void BuildingMap::objectRemoved(BuildingObject *object)
 
 void BuildingMap::objectMoved(BuildingObject *object)
 {
+    // Where the object was isn't known here, so lay out the whole floor.
     BuildingFloor *floor = object->floor();
-    pendingLayoutToSquares.insert(floor);
+    layoutLater(floor);
 
     // Stairs affect the floor tiles on the floor above.
     // Roofs sometimes affect the floor tiles on the floor above.
     if (BuildingFloor *floorAbove = floor->floorAbove()) {
         if (object->affectsFloorAbove())
-            pendingLayoutToSquares.insert(floorAbove);
+            layoutLater(floorAbove);
     }
 
     schedulePending();
@@ -764,13 +814,14 @@ void BuildingMap::objectMoved(BuildingObject *object)
 void BuildingMap::objectTileChanged(BuildingObject *object)
 {
     BuildingFloor *floor = object->floor();
-    pendingLayoutToSquares.insert(floor);
+    QRect dirty = BuildingFloor::layoutBounds(object);
+    layoutLater(floor, dirty);
 
     // Stairs affect the floor tiles on the floor above.
     // Roofs sometimes affect the floor tiles on the floor above.
     if (BuildingFloor *floorAbove = floor->floorAbove()) {
         if (object->affectsFloorAbove())
-            pendingLayoutToSquares.insert(floorAbove);
+            layoutLater(floorAbove, dirty);
     }
 
     schedulePending();
@@ -830,6 +881,7 @@ void BuildingMap::tilesetAboutToBeRemoved(Tileset *tileset)
     foreach (CompositeLayerGroup *lg, mBlendMapComposite->layerGroups())
         foreach (TileLayer *tl, lg->layers())
             tl->erase();
+    mPickIndex->invalidate();
 
     foreach (BuildingFloor *floor, mBuilding->floors()) {
         pendingSquaresToTileLayers[floor] = floor->bounds(1, 1);
@@ -845,7 +897,19 @@ void BuildingMap::tilesetRemoved(Tileset *tileset)
     Q_UNUSED(tileset)
 }
 
-// FIXME: tilesetChanged?
+// Tile images may have been loaded or changed size.
+void BuildingMap::tilesetChanged()
+{
+    if (mPickIndex)
+        mPickIndex->invalidate();
+}
+
+// Schedules LayoutToSquares for the squares in 'dirty', or for the whole floor
+// when 'dirty' is empty.
+void BuildingMap::layoutLater(BuildingFloor *floor, const QRect &dirty)
+{
+    pendingLayoutToSquares[floor] |= dirty.isEmpty() ? floor->bounds(1, 1) : dirty;
+}
 
 void BuildingMap::handlePending()
 {
@@ -859,7 +923,9 @@ void BuildingMap::handlePending()
     }
 
     if (pendingRecreateAll || pendingBuildingResized) {
-        pendingLayoutToSquares = mBuilding->floors().toSet();
+        pendingLayoutToSquares.clear();
+        foreach (BuildingFloor *floor, mBuilding->floors())
+            pendingLayoutToSquares[floor] = floor->bounds(1, 1);
         pendingUserTilesToLayer.clear();
         foreach (BuildingFloor *floor, mBuilding->floors()) {
             foreach (QString layerName, floor->grimeLayers()) {
@@ -890,24 +956,29 @@ void BuildingMap::handlePending()
 
         foreach (CompositeLayerGroup *lg, mMapComposite->layerGroups())
             lg->setNeedsSynch(true);
+        mPickIndex->invalidate();
 
         delete mShadowBuilding;
         mShadowBuilding = new ShadowBuilding(mBuilding);
     }
 
     if (!pendingLayoutToSquares.isEmpty()) {
-        foreach (BuildingFloor *floor, pendingLayoutToSquares) {
-            floor->LayoutToSquares(); // not sure this belongs in this class
-            pendingSquaresToTileLayers[floor] = floor->bounds(1, 1);
-
-            mShadowBuilding->floor(floor->level())->LayoutToSquares();
+        // Lowest floor first, the floor above reads the stairs and roofs of
+        // the floor below.
+        foreach (BuildingFloor *floor, mBuilding->floors()) {
+            if (!pendingLayoutToSquares.contains(floor))
+                continue;
+            QRect dirty = pendingLayoutToSquares[floor].boundingRect();
+            QRect area = floor->LayoutToSquares(dirty); // not sure this belongs in this class
+            area |= mShadowBuilding->floor(floor->level())->LayoutToSquares(dirty);
+            pendingSquaresToTileLayers[floor] |= area;
         }
     }
 
     if (!pendingSquaresToTileLayers.isEmpty()) {
         foreach (BuildingFloor *floor, pendingSquaresToTileLayers.keys()) {
             CompositeLayerGroup *layerGroup = mBlendMapComposite->layerGroupForLevel(floor->level());
-            QRect area = pendingSquaresToTileLayers[floor].boundingRect(); // TODO: only affected region
+            QRect area = pendingSquaresToTileLayers[floor].boundingRect();
             BuildingSquaresToTileLayers(floor, area, layerGroup);
             if (layerGroup->needsSynch()) {
                 mMapComposite->layerGroupForLevel(floor->level())->setNeedsSynch(true);
@@ -924,6 +995,7 @@ void BuildingMap::handlePending()
             CompositeLayerGroup *layerGroup = mMapComposite->layerGroupForLevel(floor->level());
             foreach (TileLayer *tl, layerGroup->layers())
                 tl->erase();
+            mPickIndex->invalidate(floor->level());
             foreach (QString layerName, floor->grimeLayers())
                 pendingUserTilesToLayer[floor][layerName] = floor->bounds(1, 1);
             updatedLevels[floor->level()] |= floor->bounds();
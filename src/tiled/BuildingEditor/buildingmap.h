@@ -40,6 +40,7 @@ namespace BuildingEditor {
 class Building;
 class BuildingFloor;
 class BuildingObject;
+class BuildingPickIndex;
 class FloorTileGrid;
 class Room;
 
@@ -153,9 +154,10 @@ public:
     Tiled::Map *mergedMap() const;
 
     static void loadNeededTilesets(Building *building);
+    static void loadNeededTilesets(const QStringList &tilesetNames);
 
     void addRoomDefObjects(Tiled::Map *map);
-    void addRoomDefObjects(Tiled::Map *map, BuildingFloor *floor);
+    static void addRoomDefObjects(Tiled::Map *map, BuildingFloor *floor);
 
     static int defaultOrientation();
 
@@ -196,6 +198,7 @@ signals:
 
 private slots:
     void handlePending();
+    void tilesetChanged();
 
 private:
     void BuildingToMap();
@@ -205,6 +208,8 @@ private:
     void userTilesToLayer(BuildingFloor *floor, const QString &layerName,
                           const QRect &bounds);
 
+    void layoutLater(BuildingFloor *floor, const QRect &dirty = QRect());
+
     inline void schedulePending()
     {
         if (!pending) {
@@ -220,16 +225,19 @@ private:
     MapComposite *mBlendMapComposite;
     Tiled::Map *mBlendMap; // tile layers contain only building-generated tiles
     Tiled::MapRenderer *mMapRenderer;
+    BuildingPickIndex *mPickIndex;
     QMap<QString,int> mLayerToSection;
 
     BuildingFloor *mCursorObjectFloor;
+    QRect mCursorObjectBounds;
+    QMap<BuildingObject*,QRect> mDragBounds;
     ShadowBuilding *mShadowBuilding;
     QMap<BuildingFloor*,QRegion> mSuppressTiles;
 
     bool pending;
     bool pendingRecreateAll;
     bool pendingBuildingResized;
-    QSet<BuildingFloor*> pendingLayoutToSquares; // LayoutToSquares
+    QMap<BuildingFloor*,QRegion> pendingLayoutToSquares; // LayoutToSquares
     QMap<BuildingFloor*,QRegion> pendingSquaresToTileLayers; // BuildingSquaresToTileLayers
     QSet<BuildingFloor*> pendingEraseUserTiles; // TileLayer::erase on all user-tile layers
     QMap<BuildingFloor*,QMap<QString,QRegion> > pendingUserTilesToLayer; // floorTilesToLayer
@@ -0,0 +1,244 @@
+/*
+ * Copyright 2026, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "buildingmapconverter.h"
+
+#include "building.h"
+#include "buildingfloor.h"
+#include "buildingmap.h"
+#include "buildingtiles.h"
+#include "buildingtmx.h"
+#include "furnituregroups.h"
+#include "tilenameatoms.h"
+
+#include "tilemetainfomgr.h"
+#include "tilesetmanager.h"
+
+#include "map.h"
+#include "tile.h"
+#include "tilelayer.h"
+#include "tileset.h"
+
+#include <QMap>
+#include <QSet>
+
+using namespace BuildingEditor;
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+BuildingTilesetSnapshot *BuildingTilesetSnapshot::create(int revision)
+{
+    BuildingTilesMgr::instance();
+    FurnitureGroups::instance();
+    getTileDefWatcher()->check();
+
+    return new BuildingTilesetSnapshot(revision,
+                                       TilesetManager::instance()->missingTile(),
+                                       TileMetaInfoMgr::instance()->tilesets(),
+                                       BuildingTMX::instance()->tileLayerNames());
+}
+
+BuildingTilesetSnapshot::BuildingTilesetSnapshot(int revision, Tile *missingTile,
+                                                 const QList<Tileset*> &tilesets,
+                                                 const QStringList &tileLayerNames) :
+    mRevision(revision),
+    mMissingTile(missingTile),
+    mTileLayerNames(tileLayerNames)
+{
+    mTilesets += missingTile->tileset();
+    mTilesets += tilesets;
+
+    foreach (Tileset *ts, mTilesets) {
+        TilesetTiles &tiles = mTilesByName[ts->name()];
+        tiles.tileset = ts;
+        tiles.tiles.resize(ts->tileCount());
+        for (int i = 0; i < ts->tileCount(); i++)
+            tiles.tiles[i] = ts->tileAt(i);
+        tiles.missing = ts->isMissing();
+    }
+}
+
+QStringList BuildingTilesetSnapshot::layerNames(int level) const
+{
+    return BuildingTMX::tileLayerNamesForLevel(mTileLayerNames, level);
+}
+
+bool BuildingTilesetSnapshot::isUpToDate(const Tileset *tileset) const
+{
+    QHash<QString,TilesetTiles>::const_iterator it = mTilesByName.constFind(tileset->name());
+    if (it == mTilesByName.constEnd() || it->tileset != tileset)
+        return true;
+    return it->tiles.size() == tileset->tileCount()
+            && it->missing == tileset->isMissing();
+}
+
+Tile *BuildingTilesetSnapshot::tileFor(int atom) const
+{
+    int index = TileNameAtoms::index(atom);
+    if (index >= 0) {
+        QHash<QString,TilesetTiles>::const_iterator it =
+                mTilesByName.find(TileNameAtoms::tilesetName(atom));
+        if (it != mTilesByName.end()) {
+            if (index < it->tiles.size())
+                return it->tiles[index];
+            if (it->missing)
+                return it->tiles.isEmpty() ? 0 : it->tiles[0];
+        }
+    }
+    return mMissingTile;
+}
+
+Tile *BuildingTilesetSnapshot::userTileFor(int atom) const
+{
+    int index = TileNameAtoms::index(atom);
+    if (index >= 0) {
+        QHash<QString,TilesetTiles>::const_iterator it =
+                mTilesByName.find(TileNameAtoms::tilesetName(atom));
+        if (it != mTilesByName.end())
+            return (index < it->tiles.size()) ? it->tiles[index] : 0;
+    }
+    return mMissingTile;
+}
+
+/////
+
+BuildingMapConverter::BuildingMapConverter(const BuildingTilesetSnapshot *tilesets) :
+    mTilesets(tilesets)
+{
+    mUserTileByAtom[0] = 0;
+}
+
+Map *BuildingMapConverter::convert(Building *building)
+{
+    mMissingTilesets.clear();
+    foreach (QString tilesetName, building->tilesetNames()) {
+        if (!mTilesets->contains(tilesetName))
+            mMissingTilesets += tilesetName;
+    }
+
+    Map::Orientation orient = static_cast<Map::Orientation>(BuildingMap::defaultOrientation());
+
+    int maxLevel =  building->floorCount() - 1;
+    int extraForWalls = 1;
+    int extra = (orient == Map::LevelIsometric)
+            ? extraForWalls : maxLevel * 3 + extraForWalls;
+    QSize mapSize(building->width() + extra,
+                  building->height() + extra);
+
+    Map *map = new Map(orient,
+                       mapSize.width(), mapSize.height(),
+                       64, 32);
+
+    foreach (Tileset *ts, mTilesets->tilesets())
+        map->addTileset(ts);
+
+    QMap<QString,int> layerToSection;
+    QStringList sectionNames = BuildingMap::requiredLayerNames();
+    for (int i = 0; i < sectionNames.size(); i++)
+        layerToSection.insert(sectionNames[i], i);
+
+    foreach (BuildingFloor *floor, building->floors()) {
+        floor->LayoutToSquares();
+
+        int offset = (orient == Map::LevelIsometric)
+                ? 0 : (maxLevel - floor->level()) * 3;
+
+        // The building's tiles go in every layer of the same name, the
+        // user-drawn tiles only in the first.  User-drawn tiles in layers
+        // that aren't in TMXConfig.txt are dropped.
+        QSet<QString> userLayersDone;
+        foreach (QString name, mTilesets->layerNames(floor->level())) {
+            QString layerName = QString(QLatin1String("%1_%2"))
+                    .arg(floor->level()).arg(name);
+            TileLayer *tl = new TileLayer(layerName,
+                                          0, 0, mapSize.width(), mapSize.height());
+            map->addLayer(tl);
+            int section = layerToSection.value(name, -1);
+            if (section != -1)
+                buildingTilesToLayer(floor, section, tl, offset);
+            if (!userLayersDone.contains(name)) {
+                userTilesToLayer(floor, name, tl);
+                userLayersDone.insert(name);
+            }
+        }
+    }
+
+    foreach (BuildingFloor *floor, building->floors())
+        BuildingMap::addRoomDefObjects(map, floor);
+
+    return map;
+}
+
+// Like BuildingMap::BuildingSquaresToTileLayers() for the whole floor.
+void BuildingMapConverter::buildingTilesToLayer(BuildingFloor *floor, int section,
+                                                TileLayer *tl, int offset)
+{
+    QRect area = floor->bounds(1, 1);
+    for (int x = area.x(); x <= area.right(); x++) {
+        for (int y = area.y(); y <= area.bottom(); y++) {
+            const BuildingFloor::Square &square = floor->squares[x][y];
+            if (BuildingTile *btile = square.mTiles[section]) {
+                if (!btile->isNone()) {
+                    if (Tile *tile = tileFor(btile->atom()))
+                        tl->setCell(x + offset, y + offset, Cell(tile));
+                }
+                continue;
+            }
+            if (BuildingTileEntry *entry = square.mEntries[section]) {
+                int tileOffset = square.mEntryEnum[section];
+                if (entry->isNone() || entry->tile(tileOffset)->isNone())
+                    continue;
+                if (Tile *tile = tileFor(entry->tile(tileOffset)->atom()))
+                    tl->setCell(x + offset, y + offset, Cell(tile));
+            }
+        }
+    }
+}
+
+// Like BuildingMap::userTilesToLayer() followed by the merge in
+// BuildingMap::mergedMap(): a user-drawn tile replaces the building's tile.
+void BuildingMapConverter::userTilesToLayer(BuildingFloor *floor,
+                                            const QString &layerName,
+                                            TileLayer *tl)
+{
+    if (!floor->grime().contains(layerName))
+        return;
+
+    QRect bounds = floor->bounds(1, 1);
+    for (int x = bounds.left(); x <= bounds.right(); x++) {
+        for (int y = bounds.top(); y <= bounds.bottom(); y++) {
+            if (Tile *tile = userTileFor(floor->grimeAtomAt(layerName, x, y)))
+                tl->setCell(x, y, Cell(tile));
+        }
+    }
+}
+
+Tile *BuildingMapConverter::tileFor(int atom)
+{
+    QHash<int,Tile*>::const_iterator it = mTileByAtom.find(atom);
+    if (it == mTileByAtom.end())
+        it = mTileByAtom.insert(atom, mTilesets->tileFor(atom));
+    return *it;
+}
+
+Tile *BuildingMapConverter::userTileFor(int atom)
+{
+    QHash<int,Tile*>::const_iterator it = mUserTileByAtom.find(atom);
+    if (it == mUserTileByAtom.end())
+        it = mUserTileByAtom.insert(atom, mTilesets->userTileFor(atom));
+    return *it;
+}
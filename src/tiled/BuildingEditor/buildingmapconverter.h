@@ -0,0 +1,153 @@
+/*
+ * Copyright 2026, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BUILDINGMAPCONVERTER_H
+#define BUILDINGMAPCONVERTER_H
+
+#include <QHash>
+#include <QList>
+#include <QStringList>
+#include <QVector>
+
+namespace Tiled {
+class Map;
+class Tile;
+class TileLayer;
+class Tileset;
+}
+
+namespace BuildingEditor {
+
+class Building;
+class BuildingFloor;
+
+/**
+  * The tilesets and TMXConfig.txt layers a building is converted with.
+  *
+  * TileMetaInfoMgr and BuildingTMX belong to the GUI thread, so the map
+  * reader threads get a copy of what they need from them.  A snapshot never
+  * changes after it is created and may be shared by any number of threads.
+  * The tilesets themselves are not copied; TileMetaInfoMgr never deletes a
+  * tileset, and a tileset's Tile objects live as long as the tileset does.
+  */
+class BuildingTilesetSnapshot
+{
+public:
+    /**
+      * Takes a snapshot of the tilesets in Tilesets.txt and the tile layers
+      * in TMXConfig.txt.  Call this on the GUI thread.  It also creates the
+      * managers that BuildingMapConverter uses so the reader threads don't
+      * race to do so.
+      */
+    static BuildingTilesetSnapshot *create(int revision);
+
+    /**
+      * \a missingTile stands in for tiles that can't be found.  Its tileset
+      * is added in front of \a tilesets.  \a tileLayerNames are the names
+      * returned by BuildingTMX::tileLayerNames().
+      */
+    BuildingTilesetSnapshot(int revision, Tiled::Tile *missingTile,
+                            const QList<Tiled::Tileset*> &tilesets,
+                            const QStringList &tileLayerNames);
+
+    int revision() const
+    { return mRevision; }
+
+    /**
+      * The tilesets every converted map gets, the missing tileset first.
+      */
+    const QList<Tiled::Tileset*> &tilesets() const
+    { return mTilesets; }
+
+    bool contains(const QString &tilesetName) const
+    { return mTilesByName.contains(tilesetName); }
+
+    QStringList layerNames(int level) const;
+
+    /**
+      * Returns false if \a tileset is one of the snapshot's tilesets and its
+      * tile count or missing state changed since the snapshot was taken.
+      */
+    bool isUpToDate(const Tiled::Tileset *tileset) const;
+
+    /**
+      * The same as BuildingTilesMgr::tileFor(int) would return, for tiles
+      * placed by the building's objects and rooms.
+      */
+    Tiled::Tile *tileFor(int atom) const;
+
+    /**
+      * The tile a user-drawn tile name resolves to, or 0 if the index is
+      * past the end of the tileset.
+      */
+    Tiled::Tile *userTileFor(int atom) const;
+
+private:
+    struct TilesetTiles
+    {
+        const Tiled::Tileset *tileset;
+        QVector<Tiled::Tile*> tiles;
+        bool missing;
+    };
+
+    int mRevision;
+    Tiled::Tile *mMissingTile;
+    QList<Tiled::Tileset*> mTilesets;
+    QHash<QString,TilesetTiles> mTilesByName;
+    QStringList mTileLayerNames;
+};
+
+/**
+  * Turns a building into the map that BuildingMap::mergedMap() would give
+  * for it, with the room definitions added.  Unlike BuildingMap, this
+  * touches no GUI-thread state, so the map reader threads can convert
+  * buildings while the GUI thread does something else.
+  *
+  * The building's floors are laid out, so nothing else may use the building
+  * during convert().  The returned map doesn't own its tilesets.
+  */
+class BuildingMapConverter
+{
+public:
+    BuildingMapConverter(const BuildingTilesetSnapshot *tilesets);
+
+    Tiled::Map *convert(Building *building);
+
+    /**
+      * The tilesets the last converted building uses that aren't in the
+      * snapshot.  Tiles from these are shown as missing.
+      */
+    QStringList missingTilesets() const
+    { return mMissingTilesets; }
+
+private:
+    void buildingTilesToLayer(BuildingFloor *floor, int section,
+                              Tiled::TileLayer *tl, int offset);
+    void userTilesToLayer(BuildingFloor *floor, const QString &layerName,
+                          Tiled::TileLayer *tl);
+    Tiled::Tile *tileFor(int atom);
+    Tiled::Tile *userTileFor(int atom);
+
+    const BuildingTilesetSnapshot *mTilesets;
+    QHash<int,Tiled::Tile*> mTileByAtom;
+    QHash<int,Tiled::Tile*> mUserTileByAtom;
+    QStringList mMissingTilesets;
+};
+
+} // namespace BuildingEditor
+
+#endif // BUILDINGMAPCONVERTER_H
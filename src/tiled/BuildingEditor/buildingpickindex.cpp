@@ -0,0 +1,272 @@
+/*
+ * Copyright 2026, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "buildingpickindex.h"
+
+#include "tilesetmanager.h"
+
+#include "maprenderer.h"
+#include "tile.h"
+#include "tilelayer.h"
+
+#include <QImage>
+
+using namespace BuildingEditor;
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+// Buckets are 128x128 scene pixels.
+#define BUCKET_SHIFT 7
+
+static quint32 key(int x, int y)
+{
+    return (quint32(quint16(y)) << 16) | quint16(x);
+}
+
+static quint32 bucketKey(int x, int y)
+{
+    return key(x >> BUCKET_SHIFT, y >> BUCKET_SHIFT);
+}
+
+BuildingPickIndex::BuildingPickIndex(MapRenderer *renderer) :
+    mRenderer(renderer)
+{
+}
+
+BuildingPickIndex::~BuildingPickIndex()
+{
+    qDeleteAll(mLevels);
+}
+
+void BuildingPickIndex::setLayers(int level, const QVector<TileLayer *> &userLayers,
+                                  const QVector<TileLayer *> &blendLayers)
+{
+    Q_ASSERT(userLayers.size() == blendLayers.size());
+    Level *l = mLevels.value(level);
+    if (!l) {
+        l = new Level;
+        l->level = level;
+        mLevels[level] = l;
+    }
+    l->userLayers = userLayers;
+    l->blendLayers = blendLayers;
+    l->dirtyAll = true;
+}
+
+void BuildingPickIndex::invalidate()
+{
+    foreach (Level *level, mLevels)
+        level->dirtyAll = true;
+    mMasks.clear();
+}
+
+void BuildingPickIndex::invalidate(int level)
+{
+    if (Level *l = mLevels.value(level))
+        l->dirtyAll = true;
+}
+
+void BuildingPickIndex::invalidate(int level, const QRect &cells)
+{
+    if (Level *l = mLevels.value(level)) {
+        if (!l->dirtyAll)
+            l->dirty |= cells;
+    }
+}
+
+Tile *BuildingPickIndex::tileAt(int level, const QPoint &pos,
+                                const QVector<bool> &layerVisible)
+{
+    Level *l = mLevels.value(level);
+    if (!l)
+        return 0;
+    update(l);
+
+    QHash<quint32,QVector<Quad> >::const_iterator it = l->buckets.find(bucketKey(pos.x(), pos.y()));
+    if (it == l->buckets.end())
+        return 0;
+
+    QPoint tilePos = mRenderer->pixelToTileCoordsInt(pos, level);
+    QRect cells(tilePos - QPoint(4, 4), QSize(8, 8));
+
+    const Quad *best = 0;
+    foreach (const Quad &quad, *it) {
+        if (!quad.bounds.contains(pos) || !cells.contains(quad.x, quad.y))
+            continue;
+        if (quad.layer < layerVisible.size() && !layerVisible[quad.layer])
+            continue;
+        // The old brute-force search visited rows, then columns, then layers
+        // in increasing order and kept the last hit.
+        if (best) {
+            if (quad.y != best->y) {
+                if (quad.y < best->y) continue;
+            } else if (quad.x != best->x) {
+                if (quad.x < best->x) continue;
+            } else if (quad.layer < best->layer)
+                continue;
+        }
+        if (hit(quad, pos))
+            best = &quad;
+    }
+
+    return best ? best->tile : 0;
+}
+
+void BuildingPickIndex::update(Level *level)
+{
+    if (level->userLayers.isEmpty())
+        return;
+    const QRect bounds = level->userLayers.first()->bounds();
+
+    if (level->dirtyAll) {
+        level->buckets.clear();
+        level->cellBounds.clear();
+        for (int y = bounds.top(); y <= bounds.bottom(); y++)
+            for (int x = bounds.left(); x <= bounds.right(); x++)
+                addCell(level, x, y);
+        level->dirtyAll = false;
+        level->dirty = QRegion();
+        return;
+    }
+
+    if (level->dirty.isEmpty())
+        return;
+    foreach (QRect r, level->dirty.rects()) {
+        r &= bounds;
+        for (int y = r.top(); y <= r.bottom(); y++) {
+            for (int x = r.left(); x <= r.right(); x++) {
+                removeCell(level, x, y);
+                addCell(level, x, y);
+            }
+        }
+    }
+    level->dirty = QRegion();
+}
+
+void BuildingPickIndex::addCell(Level *level, int x, int y)
+{
+    const QRectF tileBox = mRenderer->boundingRect(QRect(x, y, 1, 1), level->level);
+    QRect cellBounds;
+
+    for (int i = 0; i < level->userLayers.size(); i++) {
+        TileLayer *tl = level->userLayers.at(i);
+        if (!tl->contains(x, y))
+            continue;
+        Tile *tile = tl->cellAt(x, y).tile; // user tile
+        if (!tile)
+            tile = level->blendLayers.at(i)->cellAt(x, y).tile; // building tile
+        if (!tile)
+            continue;
+
+        Quad quad;
+        quad.x = x;
+        quad.y = y;
+        quad.layer = i;
+        quad.tile = tile;
+        quad.test = tile->image().isNull() ? TilesetManager::instance()->missingTile() : tile;
+
+        // Double-size tiles are tested at half the scene resolution.
+        Tile *test = quad.test;
+        quad.scale = (qRound(tileBox.width()) == test->width() * 2) ? 2 : 1;
+        quad.origin = tileBox.bottomLeft().toPoint()
+                - QPoint(0, test->height() * quad.scale);
+
+        const QRect imageBox(test->offset(), test->image().size());
+        if (imageBox.isEmpty())
+            continue;
+        // Positions up to scale-1 pixels left of or above the origin round
+        // towards zero onto the tile's first row or column.
+        const int slop = quad.scale - 1;
+        quad.bounds = QRect(quad.origin + imageBox.topLeft() * quad.scale - QPoint(slop, slop),
+                            imageBox.size() * quad.scale + QSize(slop, slop));
+
+        const QRect b = quad.bounds;
+        for (int by = b.top() >> BUCKET_SHIFT; by <= (b.bottom() >> BUCKET_SHIFT); by++)
+            for (int bx = b.left() >> BUCKET_SHIFT; bx <= (b.right() >> BUCKET_SHIFT); bx++)
+                level->buckets[key(bx, by)] += quad;
+        cellBounds |= b;
+    }
+
+    if (!cellBounds.isEmpty())
+        level->cellBounds[key(x, y)] = cellBounds;
+}
+
+void BuildingPickIndex::removeCell(Level *level, int x, int y)
+{
+    QHash<quint32,QRect>::iterator it = level->cellBounds.find(key(x, y));
+    if (it == level->cellBounds.end())
+        return;
+
+    const QRect b = *it;
+    for (int by = b.top() >> BUCKET_SHIFT; by <= (b.bottom() >> BUCKET_SHIFT); by++) {
+        for (int bx = b.left() >> BUCKET_SHIFT; bx <= (b.right() >> BUCKET_SHIFT); bx++) {
+            QHash<quint32,QVector<Quad> >::iterator bit = level->buckets.find(key(bx, by));
+            if (bit == level->buckets.end())
+                continue;
+            QVector<Quad> &quads = *bit;
+            for (int i = quads.size() - 1; i >= 0; i--) {
+                if (quads[i].x == x && quads[i].y == y)
+                    quads.remove(i);
+            }
+            if (quads.isEmpty())
+                level->buckets.erase(bit);
+        }
+    }
+    level->cellBounds.erase(it);
+}
+
+bool BuildingPickIndex::hit(const Quad &quad, const QPoint &pos)
+{
+    QPoint p = pos - quad.origin;
+    if (quad.scale == 2) {
+        p.rx() /= 2;
+        p.ry() /= 2;
+    }
+    const QRect imageBox(quad.test->offset(), quad.test->image().size());
+    if (!imageBox.contains(p))
+        return false;
+    p -= imageBox.topLeft();
+    return mask(quad.test).test(p.x(), p.y());
+}
+
+const BuildingPickIndex::Mask &BuildingPickIndex::mask(Tile *tile)
+{
+    const QImage &image = tile->image();
+    QHash<Tile*,Mask>::iterator it = mMasks.find(tile);
+    if (it != mMasks.end() && it->cacheKey == image.cacheKey())
+        return *it;
+
+    Mask mask;
+    mask.cacheKey = image.cacheKey();
+    mask.stride = (image.width() + 31) / 32;
+    mask.bits.fill(0, mask.stride * image.height());
+
+    QImage argb = image;
+    if (argb.format() != QImage::Format_ARGB32
+            && argb.format() != QImage::Format_ARGB32_Premultiplied)
+        argb = argb.convertToFormat(QImage::Format_ARGB32);
+    for (int y = 0; y < argb.height(); y++) {
+        const QRgb *line = reinterpret_cast<const QRgb*>(argb.constScanLine(y));
+        quint32 *bits = mask.bits.data() + y * mask.stride;
+        for (int x = 0; x < argb.width(); x++) {
+            if (qAlpha(line[x]) > 0)
+                bits[x >> 5] |= 1u << (x & 31);
+        }
+    }
+
+    return *mMasks.insert(tile, mask);
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2026, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BUILDINGPICKINDEX_H
+#define BUILDINGPICKINDEX_H
+
+#include <QHash>
+#include <QMap>
+#include <QPoint>
+#include <QRect>
+#include <QRegion>
+#include <QVector>
+
+namespace Tiled {
+class MapRenderer;
+class Tile;
+class TileLayer;
+}
+
+namespace BuildingEditor {
+
+/**
+  * Finds the tile drawn at a scene position for BuildingMap::buildingTileAt().
+  *
+  * For each level, every non-empty cell of the level's tile layers is kept as
+  * a quad in scene coordinates, filed in a coarse grid of buckets.  Each tile
+  * image gets a 1-bit mask of its opaque pixels.  A pick only looks at the
+  * quads in one bucket and tests one bit for each quad under the position.
+  *
+  * The index reads the layers lazily.  Whoever changes a layer must say which
+  * cells changed with invalidate().
+  */
+class BuildingPickIndex
+{
+public:
+    BuildingPickIndex(Tiled::MapRenderer *renderer);
+    ~BuildingPickIndex();
+
+    /**
+      * Sets the tile layers of \a level.  userLayers[i] and blendLayers[i]
+      * are drawn as one layer: a user-drawn tile hides the building tile in
+      * the same cell.
+      */
+    void setLayers(int level, const QVector<Tiled::TileLayer*> &userLayers,
+                   const QVector<Tiled::TileLayer*> &blendLayers);
+
+    void invalidate();
+    void invalidate(int level);
+    void invalidate(int level, const QRect &cells);
+
+    /**
+      * Returns the tile on \a level that has an opaque pixel at scene
+      * position \a pos, or 0 if there is none.  Layers whose entry in
+      * \a layerVisible is false are skipped.
+      *
+      * Only tiles in the 8x8 cells around the cell under \a pos are
+      * considered.  When several tiles are hit, the one in the greatest row,
+      * then column, then layer wins.
+      */
+    Tiled::Tile *tileAt(int level, const QPoint &pos,
+                        const QVector<bool> &layerVisible);
+
+private:
+    struct Quad
+    {
+        QRect bounds; // scene pixels the tile's image may cover
+        QPoint origin; // scene position of the tile's top-left corner
+        int scale;
+        int x, y, layer;
+        Tiled::Tile *tile; // the tile that is drawn
+        Tiled::Tile *test; // the tile whose image is tested
+    };
+
+    struct Mask
+    {
+        Mask() : cacheKey(0), stride(0) {}
+
+        bool test(int x, int y) const
+        { return bits[y * stride + (x >> 5)] & (1u << (x & 31)); }
+
+        qint64 cacheKey;
+        int stride;
+        QVector<quint32> bits;
+    };
+
+    struct Level
+    {
+        Level() : level(0), dirtyAll(true) {}
+
+        int level;
+        QVector<Tiled::TileLayer*> userLayers;
+        QVector<Tiled::TileLayer*> blendLayers;
+        QHash<quint32,QVector<Quad> > buckets;
+        QHash<quint32,QRect> cellBounds; // union of each cell's quad bounds
+        QRegion dirty;
+        bool dirtyAll;
+    };
+
+    void update(Level *level);
+    void addCell(Level *level, int x, int y);
+    void removeCell(Level *level, int x, int y);
+    bool hit(const Quad &quad, const QPoint &pos);
+    const Mask &mask(Tiled::Tile *tile);
+
+    Tiled::MapRenderer *mRenderer;
+    QMap<int,Level*> mLevels;
+    QHash<Tiled::Tile*,Mask> mMasks;
+};
+
+} // namespace BuildingEditor
+
+#endif // BUILDINGPICKINDEX_H
@@ -136,15 +136,13 @@ public:
         */
     }
 
-    BuildingTile *add(const QString &tileName)
+    BuildingTile *add(int atom)
     {
-        QString tilesetName;
-        int tileIndex;
-        parseTileName(tileName, tilesetName, tileIndex);
-        BuildingTile *btile = new BuildingTile(tilesetName, tileIndex);
-        Q_ASSERT(!mTileByName.contains(btile->name()));
-        mTileByName[btile->name()] = btile;
-        mTiles = mTileByName.values(); // sorted by increasing tileset name and tile index!
+        BuildingTile *btile = new BuildingTile(TileNameAtoms::tilesetName(atom),
+                                               TileNameAtoms::index(atom));
+        btile->mAtom = atom; // differs if the name couldn't be parsed
+        Q_ASSERT(!mTileByAtom.contains(atom));
+        mTileByAtom[atom] = btile;
         return btile;
     }
 
@@ -153,11 +151,12 @@ public:
         if (tileName.isEmpty())
             return noneTile();
 
-        QString adjustedName = adjustTileNameIndex(tileName, offset); // also normalized
-
-        if (!mTileByName.contains(adjustedName))
-            add(adjustedName);
-        return mTileByName[adjustedName];
+        // The atom table is thread-safe and does the normalizing.
+        int atom = TileNameAtoms::atom(offset ? adjustTileNameIndex(tileName, offset)
+                                              : tileName);
+        if (BuildingTile *btile = mTileByAtom.value(atom))
+            return btile;
+        return add(atom);
     }
 
     BuildingTileCategory *category(const QString &name) const
@@ -232,8 +231,7 @@ public:
     QList<BuildingTileCategory*> mCategories;
     QMap<QString,BuildingTileCategory*> mCategoryByName;
 
-    QList<BuildingTile*> mTiles;
-    QMap<QString,BuildingTile*> mTileByName;
+    QHash<int,BuildingTile*> mTileByAtom;
 
     BuildingTile *mNoneBuildingTile;
 
@@ -285,6 +283,72 @@ DECLARE_FAKE_GETTILE(RoofTops)
 
 } // namespace BuildingEditor
 
+namespace {
+
+/**
+  * Reads the comma-separated numbers in <rooms> and <tiles> straight out of
+  * the text the XML reader returned, without copying each number into a
+  * string of its own.  Whitespace around the numbers is ignored.
+  */
+class CSVScanner
+{
+public:
+    CSVScanner(const QStringRef &text) :
+        mPos(text.unicode()),
+        mEnd(text.unicode() + text.size()),
+        mAtEnd(false)
+    {
+    }
+
+    /**
+      * Reads the next number and the comma after it.  Returns false if there
+      * is no number or it is followed by something other than a comma.
+      */
+    bool next(uint &value)
+    {
+        skipSpace();
+        const QChar *start = mPos;
+        quint64 n = 0;
+        while (mPos < mEnd && mPos->unicode() >= '0' && mPos->unicode() <= '9') {
+            n = n * 10 + (mPos->unicode() - '0');
+            if (n > 0xFFFFFFFFu)
+                return false;
+            ++mPos;
+        }
+        if (mPos == start)
+            return false;
+        value = uint(n);
+        skipSpace();
+        if (mPos == mEnd) {
+            mAtEnd = true;
+            return true;
+        }
+        if (mPos->unicode() != ',')
+            return false;
+        ++mPos;
+        return true;
+    }
+
+    /**
+      * Returns true once the last number has been read.
+      */
+    bool atEnd() const
+    { return mAtEnd; }
+
+private:
+    void skipSpace()
+    {
+        while (mPos < mEnd && mPos->isSpace())
+            ++mPos;
+    }
+
+    const QChar *mPos;
+    const QChar *mEnd;
+    bool mAtEnd;
+};
+
+} // namespace
+
 class BuildingEditor::BuildingReaderPrivate
 {
     Q_DECLARE_TR_FUNCTIONS(BuildingReaderPrivate)
@@ -320,11 +384,11 @@ private:
     Room *readRoom();
 
     BuildingFloor *readFloor();
-    void decodeCSVFloorData(BuildingFloor *floor, const QString &text);
+    void decodeCSVFloorData(BuildingFloor *floor, const QStringRef &text);
     Room *getRoom(BuildingFloor *floor, int x, int y, int index);
 
-    void decodeCSVTileData(BuildingFloor *floor, const QString &layerName, const QString &text);
-    QString getUserTile(BuildingFloor *floor, int x, int y, int index);
+    void decodeCSVTileData(BuildingFloor *floor, const QString &layerName, const QStringRef &text);
+    int getUserTile(BuildingFloor *floor, int x, int y, int index);
 
     BuildingObject *readObject(BuildingFloor *floor);
 
@@ -345,7 +409,7 @@ private:
     QList<FurnitureTiles*> mFurnitureTiles;
     QList<BuildingTileEntry*> mEntries;
     QMap<QString,BuildingTileEntry*> mEntryMap;
-    QStringList mUserTiles;
+    QVector<int> mUserTiles; // tile-name atoms
     int mVersion;
 
     FakeBuildingTilesMgr mFakeBuildingTilesMgr;
@@ -662,7 +726,7 @@ void BuildingReaderPrivate::readUserTiles()
                                .arg(tileName));
                 return;
             }
-            mUserTiles += tileName;
+            mUserTiles += TileNameAtoms::atom(tileName);
             xml.skipCurrentElement();
         } else
             readUnknownElement();
@@ -764,7 +828,7 @@ BuildingFloor *BuildingReaderPrivate::readFloor()
                 if (xml.isEndElement())
                     break;
                 if (xml.isCharacters() && !xml.isWhitespace()) {
-                    decodeCSVFloorData(floor, xml.text().toString());
+                    decodeCSVFloorData(floor, xml.text());
                 }
             }
         } else if (xml.name() == QLatin1String("tiles")) {
@@ -780,7 +844,7 @@ BuildingFloor *BuildingReaderPrivate::readFloor()
                 if (xml.isEndElement())
                     break;
                 if (xml.isCharacters() && !xml.isWhitespace()) {
-                    decodeCSVTileData(floor, layerName, xml.text().toString());
+                    decodeCSVTileData(floor, layerName, xml.text());
                 }
             }
         } else
@@ -1017,33 +1081,25 @@ FurnitureTiles *BuildingReaderPrivate::getFurniture(const QString &s)
 }
 
 void BuildingReaderPrivate::decodeCSVFloorData(BuildingFloor *floor,
-                                               const QString &text)
+                                               const QStringRef &text)
 {
-    int start = 0;
-    int end = text.length();
-    while (start < end && text.at(start).isSpace())
-        start++;
+    CSVScanner csv(text);
+    const int width = floor->width(), height = floor->height();
     int x = 0, y = 0;
-    const QChar sep(QLatin1Char(','));
-    const QChar nullChar(QLatin1Char('0'));
-    while ((end = text.indexOf(sep, start, Qt::CaseSensitive)) != -1) {
-        if (end - start == 1 && text.at(start) == nullChar) {
-            floor->SetRoomAt(x, y, 0);
-        } else {
-            bool conversionOk;
-            uint index = text.mid(start, end - start).toUInt(&conversionOk);
-            if (!conversionOk) {
-                xml.raiseError(
-                        tr("Unable to parse room at (%1,%2) on floor %3")
-                               .arg(x + 1).arg(y + 1).arg(floor->level()));
-                return;
-            }
-            floor->SetRoomAt(x, y, getRoom(floor, x, y, index));
+    while (true) {
+        uint index;
+        if (!csv.next(index)) {
+            xml.raiseError(
+                    tr("Unable to parse room at (%1,%2) on floor %3")
+                           .arg(x + 1).arg(y + 1).arg(floor->level()));
+            return;
         }
-        start = end + 1;
-        if (++x == floor->width()) {
+        floor->SetRoomAt(x, y, getRoom(floor, x, y, index));
+        if (csv.atEnd())
+            break;
+        if (++x == width) {
             ++y;
-            if (y >= floor->height()) {
+            if (y >= height) {
                 xml.raiseError(tr("Corrupt <rooms> for floor %1")
                                .arg(floor->level()));
                 return;
@@ -1051,22 +1107,6 @@ void BuildingReaderPrivate::decodeCSVFloorData(BuildingFloor *floor,
             x = 0;
         }
     }
-    end = text.size();
-    while (start < end && text.at(end-1).isSpace())
-        end--;
-    if (end - start == 1 && text.at(start) == nullChar) {
-        floor->SetRoomAt(x, y, 0);
-    } else {
-        bool conversionOk;
-        uint index = text.mid(start, end - start).toUInt(&conversionOk);
-        if (!conversionOk) {
-            xml.raiseError(
-                    tr("Unable to parse room at (%1,%2) on floor %3")
-                           .arg(x + 1).arg(y + 1).arg(floor->level()));
-            return;
-        }
-        floor->SetRoomAt(x, y, getRoom(floor, x, y, index));
-    }
 }
 
 Room *BuildingReaderPrivate::getRoom(BuildingFloor *floor, int x, int y, int index)
@@ -1082,33 +1122,35 @@ Room *BuildingReaderPrivate::getRoom(BuildingFloor *floor, int x, int y, int ind
 
 void BuildingReaderPrivate::decodeCSVTileData(BuildingFloor *floor,
                                               const QString &layerName,
-                                              const QString &text)
+                                              const QStringRef &text)
 {
-    int start = 0;
-    int end = text.length();
-    while (start < end && text.at(start).isSpace())
-        start++;
+    CSVScanner csv(text);
+    const int width = floor->width() + 1, height = floor->height() + 1;
+    FloorTileGrid *grid = floor->grime().value(layerName);
     int x = 0, y = 0;
-    const QChar sep(QLatin1Char(','));
-    const QChar nullChar(QLatin1Char('0'));
-    while ((end = text.indexOf(sep, start, Qt::CaseSensitive)) != -1) {
-        if (end - start == 1 && text.at(start) == nullChar) {
-            ; //floor->setGrime(layerName, x, y, QString());
-        } else {
-            bool conversionOk;
-            uint index = text.mid(start, end - start).toUInt(&conversionOk);
-            if (!conversionOk) {
-                xml.raiseError(
-                        tr("Unable to parse user-tile at (%1,%2) on floor %3")
-                               .arg(x + 1).arg(y + 1).arg(floor->level()));
-                return;
+    while (true) {
+        uint index;
+        if (!csv.next(index)) {
+            xml.raiseError(
+                    tr("Unable to parse user-tile at (%1,%2) on floor %3")
+                           .arg(x + 1).arg(y + 1).arg(floor->level()));
+            return;
+        }
+        if (index) {
+            int atom = getUserTile(floor, x, y, index);
+            if (grid)
+                grid->replaceAtom(x, y, atom);
+            else {
+                // The floor creates the layer's grid on the first tile.
+                floor->setGrimeAtom(layerName, x, y, atom);
+                grid = floor->grime().value(layerName);
             }
-            floor->setGrime(layerName, x, y, getUserTile(floor, x, y, index));
         }
-        start = end + 1;
-        if (++x == floor->width() + 1) {
+        if (csv.atEnd())
+            break;
+        if (++x == width) {
             ++y;
-            if (y >= floor->height() + 1) {
+            if (y >= height) {
                 xml.raiseError(tr("Corrupt <tiles> for floor %1")
                                .arg(floor->level()));
                 return;
@@ -1116,33 +1158,17 @@ void BuildingReaderPrivate::decodeCSVTileData(BuildingFloor *floor,
             x = 0;
         }
     }
-    end = text.size();
-    while (start < end && text.at(end-1).isSpace())
-        end--;
-    if (end - start == 1 && text.at(start) == nullChar) {
-        ; //floor->setGrime(layerName, x, y, QString());
-    } else {
-        bool conversionOk;
-        uint index = text.mid(start, end - start).toUInt(&conversionOk);
-        if (!conversionOk) {
-            xml.raiseError(
-                    tr("Unable to parse user-tile at (%1,%2) on floor %3")
-                           .arg(x + 1).arg(y + 1).arg(floor->level()));
-            return;
-        }
-        floor->setGrime(layerName, x, y, getUserTile(floor, x, y, index));
-    }
 }
 
-QString BuildingReaderPrivate::getUserTile(BuildingFloor *floor, int x, int y, int index)
+int BuildingReaderPrivate::getUserTile(BuildingFloor *floor, int x, int y, int index)
 {
     if (!index)
-        return QString();
+        return 0;
     if (index > 0 && index - 1 < mUserTiles.size())
         return mUserTiles.at(index - 1);
     xml.raiseError(tr("Invalid tile index at (%1,%2) on floor %3")
                    .arg(x).arg(y).arg(floor->level()));
-    return QString();
+    return 0;
 }
 
 void BuildingReaderPrivate::readUnknownElement()
@@ -1250,7 +1276,7 @@ FurnitureTiles *BuildingReaderPrivate::fixFurniture(FurnitureTiles *ftiles)
                     if (BuildingTile *btile = ftile->tile(x, y)) {
                         if (btile != BuildingTilesMgr::instance()->noneTile())
                             deadTiles.insert(btile);
-                        ftile->setTile(x, y, BuildingTilesMgr::instance()->get(btile->name()));
+                        ftile->setTile(x, y, BuildingTilesMgr::instance()->get(btile->atom()));
                     }
                 }
             }
@@ -1281,7 +1307,7 @@ BuildingTileEntry *BuildingReaderPrivate::fixEntry(BuildingTileEntry *entry)
             if (BuildingTile *btile = entry->tile(i)) {
                 if (btile != BuildingTilesMgr::instance()->noneTile())
                     deadTiles.insert(btile);
-                entry->setTile(i, BuildingTilesMgr::instance()->get(btile->name()));
+                entry->setTile(i, BuildingTilesMgr::instance()->get(btile->atom()));
             }
         }
         if (BuildingTileEntry *match = category->findMatch(entry)) {
@@ -130,6 +130,13 @@ BuildingTilesMgr::BuildingTilesMgr() :
             SIGNAL(tilesetAboutToBeRemoved(Tiled::Tileset*)));
     connect(TileMetaInfoMgr::instance(), SIGNAL(tilesetRemoved(Tiled::Tileset*)),
              SIGNAL(tilesetRemoved(Tiled::Tileset*)));
+
+    connect(TileMetaInfoMgr::instance(), SIGNAL(tilesetAdded(Tiled::Tileset*)),
+            SLOT(tilesetsChanged()));
+    connect(TileMetaInfoMgr::instance(), SIGNAL(tilesetRemoved(Tiled::Tileset*)),
+            SLOT(tilesetsChanged()));
+    connect(TilesetManager::instance(), SIGNAL(tilesetChanged(Tileset*)),
+            SLOT(tilesetsChanged()));
 }
 
 BuildingTilesMgr::~BuildingTilesMgr()
@@ -140,15 +147,17 @@ BuildingTilesMgr::~BuildingTilesMgr()
     delete mNoneBuildingTile;
 }
 
+// The caller must hold mTileMutex.
 BuildingTile *BuildingTilesMgr::add(const QString &tileName)
 {
-    QString tilesetName;
-    int tileIndex;
-    parseTileName(tileName, tilesetName, tileIndex);
-    BuildingTile *btile = new BuildingTile(tilesetName, tileIndex);
-    Q_ASSERT(!mTileByName.contains(btile->name()));
-    mTileByName[btile->name()] = btile;
-    mTiles = mTileByName.values(); // sorted by increasing tileset name and tile index!
+    int atom = TileNameAtoms::atom(tileName);
+    BuildingTile *btile = new BuildingTile(TileNameAtoms::tilesetName(atom),
+                                           TileNameAtoms::index(atom));
+    btile->mAtom = atom; // differs if the name couldn't be parsed
+    if (mTileByAtom.size() <= atom)
+        mTileByAtom.resize(TileNameAtoms::count());
+    Q_ASSERT(mTileByAtom[atom] == 0);
+    mTileByAtom[atom] = btile;
     return btile;
 }
 
@@ -157,11 +166,21 @@ BuildingTile *BuildingTilesMgr::get(const QString &tileName, int offset)
     if (tileName.isEmpty())
         return noneTile();
 
-    QString adjustedName = adjustTileNameIndex(tileName, offset); // also normalized
+    // The atom table does the normalizing.
+    if (offset == 0)
+        return get(TileNameAtoms::atom(tileName));
 
-    if (!mTileByName.contains(adjustedName))
-        add(adjustedName);
-    return mTileByName[adjustedName];
+    return get(TileNameAtoms::atom(adjustTileNameIndex(tileName, offset)));
+}
+
+BuildingTile *BuildingTilesMgr::get(int atom)
+{
+    if (atom == 0)
+        return noneTile();
+    QMutexLocker locker(&mTileMutex);
+    if (atom < mTileByAtom.size() && mTileByAtom[atom])
+        return mTileByAtom[atom];
+    return add(TileNameAtoms::name(atom));
 }
 
 QString BuildingTilesMgr::nameForTile(const QString &tilesetName, int index)
@@ -627,27 +646,45 @@ bool BuildingTilesMgr::mergeTxt()
 
 Tiled::Tile *BuildingTilesMgr::tileFor(const QString &tileName)
 {
-    QString tilesetName;
-    int index;
-    parseTileName(tileName, tilesetName, index);
-    Tileset *tileset = TileMetaInfoMgr::instance()->tileset(tilesetName);
-    if (!tileset)
-        return mMissingTile;
-    if (index >= tileset->tileCount())
-        return mMissingTile;
-    return tileset->tileAt(index);
+    return tileFor(TileNameAtoms::atom(tileName));
 }
 
 Tile *BuildingTilesMgr::tileFor(BuildingTile *tile, int offset)
 {
     if (tile->isNone())
         return mNoneTiledTile;
-    Tileset *tileset = TileMetaInfoMgr::instance()->tileset(tile->mTilesetName);
-    if (!tileset)
-        return mMissingTile;
-    if (tile->mIndex + offset >= tileset->tileCount())
-        return tileset->isMissing() ? tileset->tileAt(0) : mMissingTile;
-    return tileset->tileAt(tile->mIndex + offset);
+    if (offset == 0)
+        return tileFor(tile->atom());
+    return tileFor(TileNameAtoms::atom(tile->mTilesetName, tile->mIndex + offset));
+}
+
+Tile *BuildingTilesMgr::tileFor(int atom)
+{
+    if (atom < mTiledTileByAtom.size()) {
+        if (Tile *tile = mTiledTileByAtom[atom])
+            return tile;
+    } else {
+        mTiledTileByAtom.resize(TileNameAtoms::count());
+    }
+
+    Tile *tile = mMissingTile;
+    int index = TileNameAtoms::index(atom);
+    if (index >= 0) {
+        if (Tileset *tileset = TileMetaInfoMgr::instance()->tileset(TileNameAtoms::tilesetName(atom))) {
+            if (index < tileset->tileCount())
+                tile = tileset->tileAt(index);
+            else if (tileset->isMissing())
+                tile = tileset->tileAt(0);
+        }
+    }
+    mTiledTileByAtom[atom] = tile;
+    return tile;
+}
+
+void BuildingTilesMgr::tilesetsChanged()
+{
+    // Tiles may have been added to or removed from a tileset.
+    mTiledTileByAtom.clear();
 }
 
 BuildingTile *BuildingTilesMgr::fromTiledTile(Tile *tile)
@@ -726,7 +763,7 @@ BuildingTileEntry *BuildingTilesMgr::defaultRoofTopTiles() const
 
 QString BuildingTile::name() const
 {
-    return BuildingTilesMgr::nameForTile(mTilesetName, mIndex);
+    return TileNameAtoms::name(mAtom);
 }
 
 /////
@@ -18,8 +18,11 @@
 #ifndef BUILDINGTILES_H
 #define BUILDINGTILES_H
 
+#include "tilenameatoms.h"
+
 #include <QImage>
 #include <QMap>
+#include <QMutex>
 #include <QRect>
 #include <QString>
 #include <QStringList>
@@ -39,7 +42,8 @@ class BuildingTile
 public:
     BuildingTile(const QString &tilesetName, int index) :
         mTilesetName(tilesetName),
-        mIndex(index)
+        mIndex(index),
+        mAtom(TileNameAtoms::atom(tilesetName, index))
     {}
     virtual ~BuildingTile() {}
 
@@ -48,8 +52,12 @@ public:
 
     virtual QString name() const;
 
+    int atom() const
+    { return mAtom; }
+
     QString mTilesetName;
     int mIndex;
+    int mAtom;
 };
 
 class NoneBuildingTile : public BuildingTile
@@ -687,9 +695,12 @@ public:
     BuildingTilesMgr();
     ~BuildingTilesMgr();
 
-    BuildingTile *add(const QString &tileName);
-
+    /**
+      * These may be called from the map reader threads as well as the GUI
+      * thread.
+      */
     BuildingTile *get(const QString &tileName, int offset = 0);
+    BuildingTile *get(int atom);
 
     const QList<BuildingTileCategory*> &categories() const
     { return mCategories; }
@@ -732,6 +743,13 @@ public:
     Tiled::Tile *tileFor(const QString &tileName);
     Tiled::Tile *tileFor(BuildingTile *tile, int offset = 0);
 
+    /**
+      * Returns the tile for the tile name \a atom, or the missing tile.
+      * The result is cached until a tileset is added, removed or changed.
+      * Only call this from the main thread.
+      */
+    Tiled::Tile *tileFor(int atom);
+
     BuildingTile *fromTiledTile(Tiled::Tile *tile);
 
     BuildingTile *noneTile() const
@@ -788,9 +806,14 @@ public:
     { return mError; }
 
 private:
+    BuildingTile *add(const QString &tileName);
+
     bool upgradeTxt();
     bool mergeTxt();
 
+private slots:
+    void tilesetsChanged();
+
 signals:
     void tilesetAdded(Tiled::Tileset *tileset);
     void tilesetAboutToBeRemoved(Tiled::Tileset *tileset);
@@ -804,8 +827,9 @@ private:
     QList<BuildingTileCategory*> mCategories;
     QMap<QString,BuildingTileCategory*> mCategoryByName;
 
-    QList<BuildingTile*> mTiles;
-    QMap<QString,BuildingTile*> mTileByName;
+    QVector<BuildingTile*> mTileByAtom;
+    QMutex mTileMutex; // guards mTileByAtom
+    QVector<Tiled::Tile*> mTiledTileByAtom;
 
     Tiled::Tile *mMissingTile;
     Tiled::Tile *mNoneTiledTile;
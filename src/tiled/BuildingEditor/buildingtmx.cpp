@@ -67,12 +67,37 @@ BuildingTMX::BuildingTMX()
 }
 
 QStringList BuildingTMX::tileLayerNamesForLevel(int level)
+{
+    return tileLayerNamesForLevel(tileLayerNames(), level);
+}
+
+QStringList BuildingTMX::tileLayerNames() const
 {
     QStringList ret;
     foreach (LayerInfo layerInfo, mLayers) {
-        if (layerInfo.mType != LayerInfo::Tile)
-            continue;
-        QString layerName = layerInfo.mName;
+        if (layerInfo.mType == LayerInfo::Tile)
+            ret += layerInfo.mName;
+    }
+    return ret;
+}
+
+void BuildingTMX::setTileLayerNames(const QStringList &layerNames)
+{
+    QList<LayerInfo> layers;
+    foreach (QString layerName, layerNames)
+        layers += LayerInfo(layerName, LayerInfo::Tile);
+    foreach (LayerInfo layerInfo, mLayers) {
+        if (layerInfo.mType == LayerInfo::Object)
+            layers += layerInfo;
+    }
+    mLayers = layers;
+}
+
+QStringList BuildingTMX::tileLayerNamesForLevel(const QStringList &layerNames,
+                                                int level)
+{
+    QStringList ret;
+    foreach (QString layerName, layerNames) {
         int level2;
         if (MapComposite::levelForLayer(layerName, &level2)) {
             if (level2 != level)
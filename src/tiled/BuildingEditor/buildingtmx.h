@@ -43,6 +43,25 @@ public:
 //    { return mLayers; }
 
     QStringList tileLayerNamesForLevel(int level);
+
+    /**
+      * Returns the names of all the tile layers in TMXConfig.txt, with their
+      * level prefixes if they have any.
+      */
+    QStringList tileLayerNames() const;
+
+    /**
+      * Replaces the tile layers with \a layerNames without reading
+      * TMXConfig.txt.  The object layers are kept after them.
+      */
+    void setTileLayerNames(const QStringList &layerNames);
+
+    /**
+      * Picks the names of the layers for \a level out of \a layerNames,
+      * which came from tileLayerNames(), and strips their level prefixes.
+      */
+    static QStringList tileLayerNamesForLevel(const QStringList &layerNames,
+                                              int level);
     bool exportTMX(Building *building, const QString &fileName);
 
     QString txtName();
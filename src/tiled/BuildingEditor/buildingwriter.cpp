@@ -23,11 +23,14 @@
 #include "buildingtemplates.h"
 #include "buildingtiles.h"
 #include "furnituregroups.h"
+#include "tilenameatoms.h"
 
 #include <QCoreApplication>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QHash>
+#include <QSet>
 #include <QTemporaryFile>
 #include <QXmlStreamWriter>
 
@@ -71,7 +74,10 @@ public:
         mMapDir = QDir(absDirPath);
         mBuilding = building;
 
-        QXmlStreamWriter writer(device);
+        // The whole file is built in memory and handed to the device in one
+        // write, rather than as many small writes as there are XML tokens.
+        QByteArray buffer;
+        QXmlStreamWriter writer(&buffer);
         writer.setAutoFormatting(true);
         writer.setAutoFormattingIndent(1);
 
@@ -80,6 +86,8 @@ public:
         writeBuilding(writer, building);
 
         writer.writeEndDocument();
+
+        device->write(buffer);
     }
 
     void writeBuilding(QXmlStreamWriter &w, Building *building)
@@ -88,6 +96,9 @@ public:
 
         initBuildingTileEntries();
 
+        for (int i = 0; i < building->roomCount(); i++)
+            mRoomIndex[building->room(i)] = i + 1;
+
         w.writeAttribute(QLatin1String("version"), QString::number(VERSION_LATEST));
         w.writeAttribute(QLatin1String("width"), QString::number(building->width()));
         w.writeAttribute(QLatin1String("height"), QString::number(building->height()));
@@ -220,6 +231,8 @@ public:
 
         foreach (BuildingTileEntry *entry, mBuilding->usedTiles())
             addEntry(entry);
+
+        sortBuildingTileEntries();
     }
 
     void writeBuildingTileEntries(QXmlStreamWriter &w)
@@ -250,24 +263,28 @@ public:
 
     void writeUserTiles(QXmlStreamWriter &w)
     {
+        QSet<int> atoms;
         foreach (BuildingFloor *floor, mBuilding->floors()) {
-            foreach (QString layerName, floor->grimeLayers()) {
-                for (int x = 0; x <= floor->width(); x++) {
-                    for (int y = 0; y <= floor->height(); y++) {
-                        QString tileName = floor->grimeAt(layerName, x, y);
-                        if (!tileName.isEmpty() && !mUserTilesMap.contains(tileName))
-                            mUserTilesMap[tileName] = tileName;
-                    }
+            foreach (FloorTileGrid *grid, floor->grime()) {
+                for (int i = 0; i < grid->size(); i++) {
+                    if (int atom = grid->atomAt(i))
+                        atoms.insert(atom);
                 }
             }
         }
 
+        QMap<QString,int> sorted;
+        foreach (int atom, atoms)
+            sorted[TileNameAtoms::name(atom)] = atom;
+
         w.writeStartElement(QLatin1String("user_tiles"));
-        foreach (QString tileName, mUserTilesMap.values()) { // sorted
+        int index = 1;
+        QMap<QString,int>::const_iterator it = sorted.constBegin();
+        for (; it != sorted.constEnd(); ++it) {
+            mUserTileIndex[it.value()] = index++;
             w.writeStartElement(QLatin1String("tile"));
-            w.writeAttribute(QLatin1String("tile"), tileName);
+            w.writeAttribute(QLatin1String("tile"), it.key());
             w.writeEndElement(); // </tile>
-
         }
         w.writeEndElement(); // </user_tiles>
     }
@@ -282,15 +299,13 @@ public:
 
         // Write room indices.
         QString text;
-        const QLatin1Char zero('0'), comma(','), newline('\n');
-        text += newline;
+        const QLatin1Char comma(','), newline('\n');
         int count = 0, max = floor->height() * floor->width();
+        text.reserve(max * 3 + floor->height() + 1);
+        text += newline;
         for (int y = 0; y < floor->height(); y++) {
             for (int x = 0; x < floor->width(); x++) {
-                if (Room *room = floor->GetRoomAt(x, y))
-                    text += QString::number(mBuilding->rooms().indexOf(room) + 1);
-                else
-                    text += zero;
+                appendNumber(text, mRoomIndex.value(floor->GetRoomAt(x, y)));
                 if (++count < max)
                     text += comma;
             }
@@ -302,18 +317,15 @@ public:
 
         // Write user tile indices.
         foreach (QString layerName, floor->grimeLayers()) {
-            if (floor->grime()[layerName]->isEmpty())
+            FloorTileGrid *grid = floor->grime()[layerName];
+            if (grid->isEmpty())
                 continue;
             text.clear();
             text += newline;
             count = 0, max = (floor->height() + 1) * (floor->width() + 1);
             for (int y = 0; y <= floor->height(); y++) {
                 for (int x = 0; x <= floor->width(); x++) {
-                    QString tileName = floor->grimeAt(layerName, x, y);
-                    if (tileName.isEmpty())
-                        text += zero;
-                    else
-                        text += QString::number(mUserTilesMap.values().indexOf(tileName) + 1);
+                    appendNumber(text, mUserTileIndex.value(grid->atomAt(x, y)));
                     if (++count < max)
                         text += comma;
                 }
@@ -399,6 +411,18 @@ public:
         w.writeAttribute(name, value);
     }
 
+    // Like QString::number() without the temporary string.
+    static void appendNumber(QString &text, uint n)
+    {
+        QChar digits[10];
+        int i = 10;
+        do {
+            digits[--i] = QLatin1Char('0' + n % 10);
+            n /= 10;
+        } while (n);
+        text.append(digits + i, 10 - i);
+    }
+
     QString nameForEntry(BuildingTileEntry *entry)
     {
         QString name = entry->category()->name();
@@ -416,17 +440,22 @@ public:
 
     void addEntry(BuildingTileEntry *entry)
     {
-        if (entry && !entry->isNone() && !mTileEntries.contains(entry)) {
+        if (entry && !entry->isNone() && !mEntryIndex.contains(entry)) {
             mEntriesByCategoryName[nameForEntry(entry)] = entry;
-            mTileEntries = mEntriesByCategoryName.values(); // sorted
+            mEntryIndex[entry] = 0;
         }
     }
 
+    void sortBuildingTileEntries()
+    {
+        mTileEntries = mEntriesByCategoryName.values(); // sorted
+        for (int i = 0; i < mTileEntries.size(); i++)
+            mEntryIndex[mTileEntries[i]] = i + 1;
+    }
+
     QString entryIndex(BuildingTileEntry *entry)
     {
-        if (entry && !entry->isNone())
-            return QString::number(mTileEntries.indexOf(entry) + 1);
-        return QString::number(0);
+        return QString::number(mEntryIndex.value(entry));
     }
 
     QString furnitureIndex(FurnitureTiles *ftiles)
@@ -442,7 +471,9 @@ public:
     QList<FurnitureTiles*> mFurnitureTiles;
     QList<BuildingTileEntry*> mTileEntries;
     QMap<QString,BuildingTileEntry*> mEntriesByCategoryName;
-    QMap<QString,QString> mUserTilesMap;
+    QHash<BuildingTileEntry*,int> mEntryIndex;
+    QHash<Room*,int> mRoomIndex;
+    QHash<int,int> mUserTileIndex; // tile-name atom -> index in <user_tiles>
 };
 
 /////
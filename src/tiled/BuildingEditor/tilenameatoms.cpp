@@ -0,0 +1,198 @@
+/*
+ * Copyright 2026, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilenameatoms.h"
+
+#include "buildingtiles.h"
+
+#include <QHash>
+#include <QReadLocker>
+#include <QReadWriteLock>
+#include <QVector>
+#include <QWriteLocker>
+
+using namespace BuildingEditor;
+
+// Entries are allocated in fixed-size chunks that never move, so a reference
+// to an entry stays valid while other threads add more.
+#define CHUNK_BITS 12
+#define CHUNK_SIZE (1 << CHUNK_BITS)
+#define MAX_CHUNKS 1024
+
+// Tile indices below this are found by tileset name and index without
+// formatting the tile name.
+#define MAX_INDEXED_TILE 8192
+
+namespace {
+
+struct AtomEntry
+{
+    AtomEntry() : index(-1) {}
+
+    QString name;
+    QString tilesetName;
+    int index;
+};
+
+class AtomTable
+{
+public:
+    AtomTable() :
+        mCount(0)
+    {
+        for (int i = 0; i < MAX_CHUNKS; i++)
+            mChunks[i] = 0;
+        add(QString(), QString(), -1);
+    }
+
+    ~AtomTable()
+    {
+        for (int i = 0; i < MAX_CHUNKS; i++)
+            delete[] mChunks[i];
+    }
+
+    const AtomEntry &entry(int atom) const
+    {
+        Q_ASSERT(atom >= 0 && atom < MAX_CHUNKS * CHUNK_SIZE);
+        return mChunks[atom >> CHUNK_BITS][atom & (CHUNK_SIZE - 1)];
+    }
+
+    // The caller must hold mLock for reading.
+    int find(const QString &tilesetName, int index) const
+    {
+        if (index >= 0 && index < MAX_INDEXED_TILE) {
+            QHash<QString,QVector<int> >::const_iterator it = mAtomByIndex.constFind(tilesetName);
+            if (it != mAtomByIndex.constEnd() && index < it->size())
+                return it->at(index);
+            return 0;
+        }
+        return mAtomByName.value(BuildingTilesMgr::nameForTile(tilesetName, index));
+    }
+
+    // The caller must hold mLock for writing.
+    int add(const QString &name, const QString &tilesetName, int index)
+    {
+        int chunk = mCount >> CHUNK_BITS;
+        if (chunk == MAX_CHUNKS)
+            qFatal("TileNameAtoms: too many tile names");
+        if (!mChunks[chunk])
+            mChunks[chunk] = new AtomEntry[CHUNK_SIZE];
+        AtomEntry &e = mChunks[chunk][mCount & (CHUNK_SIZE - 1)];
+        e.name = name;
+        e.tilesetName = tilesetName;
+        e.index = index;
+        if (!name.isEmpty())
+            mAtomByName[name] = mCount;
+        if (!tilesetName.isEmpty() && index >= 0 && index < MAX_INDEXED_TILE) {
+            QVector<int> &atoms = mAtomByIndex[tilesetName];
+            if (atoms.size() <= index)
+                atoms.resize(index + 1);
+            atoms[index] = mCount;
+        }
+        return mCount++;
+    }
+
+    // Many threads look names up at once and new names are rare, so lookups
+    // only take the lock for reading.
+    QReadWriteLock mLock;
+    QHash<QString,int> mAtomByName; // every spelling seen so far
+    QHash<QString,QVector<int> > mAtomByIndex; // tileset name -> index -> atom
+    AtomEntry *mChunks[MAX_CHUNKS];
+    int mCount;
+};
+
+static AtomTable *table()
+{
+    static AtomTable table;
+    return &table;
+}
+
+} // namespace
+
+int TileNameAtoms::atom(const QString &tileName)
+{
+    if (tileName.isEmpty())
+        return 0;
+
+    AtomTable *t = table();
+    {
+        QReadLocker locker(&t->mLock);
+        QHash<QString,int>::const_iterator it = t->mAtomByName.constFind(tileName);
+        if (it != t->mAtomByName.constEnd())
+            return *it;
+    }
+
+    QWriteLocker locker(&t->mLock);
+
+    // Another thread may have added it since.
+    QHash<QString,int>::const_iterator it = t->mAtomByName.constFind(tileName);
+    if (it != t->mAtomByName.constEnd())
+        return *it;
+
+    QString tilesetName;
+    int index;
+    if (!BuildingTilesMgr::parseTileName(tileName, tilesetName, index))
+        return t->add(tileName, QString(), -1);
+
+    int atom = t->find(tilesetName, index);
+    if (!atom)
+        atom = t->add(BuildingTilesMgr::nameForTile(tilesetName, index),
+                      tilesetName, index);
+    t->mAtomByName[tileName] = atom;
+    return atom;
+}
+
+int TileNameAtoms::atom(const QString &tilesetName, int index)
+{
+    if (tilesetName.isEmpty())
+        return 0;
+
+    AtomTable *t = table();
+    {
+        QReadLocker locker(&t->mLock);
+        if (int atom = t->find(tilesetName, index))
+            return atom;
+    }
+
+    QWriteLocker locker(&t->mLock);
+    if (int atom = t->find(tilesetName, index))
+        return atom;
+    return t->add(BuildingTilesMgr::nameForTile(tilesetName, index),
+                  tilesetName, index);
+}
+
+const QString &TileNameAtoms::name(int atom)
+{
+    return table()->entry(atom).name;
+}
+
+const QString &TileNameAtoms::tilesetName(int atom)
+{
+    return table()->entry(atom).tilesetName;
+}
+
+int TileNameAtoms::index(int atom)
+{
+    return table()->entry(atom).index;
+}
+
+int TileNameAtoms::count()
+{
+    AtomTable *t = table();
+    QReadLocker locker(&t->mLock);
+    return t->mCount;
+}
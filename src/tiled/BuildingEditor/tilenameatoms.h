@@ -0,0 +1,56 @@
+/*
+ * Copyright 2026, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILENAMEATOMS_H
+#define TILENAMEATOMS_H
+
+#include <QString>
+
+namespace BuildingEditor {
+
+/**
+  * A process-wide table of interned tile names.
+  *
+  * Every distinct tile name gets a small integer, its atom, the first time it
+  * is seen.  Atom 0 is the empty name.  Names are stored in the padded form
+  * BuildingTilesMgr::nameForTile() returns, so "walls_01_5" and "walls_01_005"
+  * get the same atom.  A name that can't be parsed is kept as it is.
+  *
+  * Atoms are never freed.  The strings returned by name() and tilesetName()
+  * stay valid for the life of the program and may be read from any thread
+  * without locking.  Looking up a name that already has an atom only takes
+  * a shared read lock; interning a new name takes the write lock.
+  */
+class TileNameAtoms
+{
+public:
+    static int atom(const QString &tileName);
+    static int atom(const QString &tilesetName, int index);
+
+    static const QString &name(int atom);
+    static const QString &tilesetName(int atom);
+    static int index(int atom);
+
+    /**
+      * Returns the number of atoms handed out so far, including atom 0.
+      */
+    static int count();
+};
+
+} // namespace BuildingEditor
+
+#endif // TILENAMEATOMS_H
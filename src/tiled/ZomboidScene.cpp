@@ -19,6 +19,7 @@
 
 #include "bmpblender.h"
 #include "bmptool.h"
+#include "layergrouprendercache.h"
 #include "map.h"
 #include "mapbuildings.h"
 #include "mapcomposite.h"
@@ -33,6 +34,7 @@
 #include "preferences.h"
 #include "tilelayer.h"
 #include "tilelayeritem.h"
+#include "tilesetmanager.h"
 #include "toolmanager.h"
 #include "zlevelsmodel.h"
 #include "zlotmanager.h"
@@ -52,12 +54,19 @@ CompositeLayerGroupItem::CompositeLayerGroupItem(CompositeLayerGroup *layerGroup
     : QGraphicsItem(parent)
     , mLayerGroup(layerGroup)
     , mRenderer(renderer)
+    , mRenderCache(nullptr)
 {
     setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
 
     mBoundingRect = layerGroup->boundingRect(mRenderer);
 }
 
+CompositeLayerGroupItem::~CompositeLayerGroupItem()
+{
+    if (mRenderCache)
+        mRenderCache->removeItem(this);
+}
+
 QRectF CompositeLayerGroupItem::boundingRect() const
 {
     return mBoundingRect;
@@ -72,12 +81,22 @@ void CompositeLayerGroupItem::paint(QPainter *p, const QStyleOptionGraphicsItem
     if (mLayerGroup->needsSynch() /*mBoundingRect != mLayerGroup->boundingRect(mRenderer)*/)
         return;
 
-    mRenderer->drawTileLayerGroup(p, mLayerGroup, option->exposedRect);
+    if (!mRenderCache || !mRenderCache->paint(this, p, option->exposedRect))
+        mRenderer->drawTileLayerGroup(p, mLayerGroup, option->exposedRect);
 #ifdef _DEBUG
     p->drawRect(mBoundingRect);
 #endif
 }
 
+void CompositeLayerGroupItem::setRenderCache(LayerGroupRenderCache *cache)
+{
+    if (mRenderCache)
+        mRenderCache->removeItem(this);
+    mRenderCache = cache;
+    if (mRenderCache)
+        mRenderCache->addItem(this);
+}
+
 void CompositeLayerGroupItem::synchWithTileLayers()
 {
 //    if (layerGroup()->needsSynch())
@@ -105,7 +124,16 @@ ZomboidScene::ZomboidScene(QObject *parent)
     , mMapBordersItem2(new QGraphicsPolygonItem)
     , mMapBuildings(new MapBuildings)
     , mMapBuildingsInvalid(true)
+    , mRenderCache(new LayerGroupRenderCache(this))
 {
+    Preferences *prefs = Preferences::instance();
+    mRenderCache->setMaxSize(prefs->renderCacheSize());
+    mRenderCache->setEnabled(prefs->useRenderCache());
+    connect(prefs, SIGNAL(useRenderCacheChanged(bool)), SLOT(useRenderCacheChanged(bool)));
+    connect(prefs, SIGNAL(renderCacheSizeChanged(int)), SLOT(renderCacheSizeChanged(int)));
+    connect(TilesetManager::instance(), SIGNAL(tilesetChanged(Tileset*)),
+            SLOT(tilesetImageChanged(Tileset*)));
+
     connect(&mLotManager, SIGNAL(lotAdded(MapComposite*,Tiled::MapObject*)),
         this, SLOT(onLotAdded(MapComposite*,Tiled::MapObject*)));
     connect(&mLotManager, SIGNAL(lotRemoved(MapComposite*,Tiled::MapObject*)),
@@ -148,6 +176,8 @@ void ZomboidScene::setMapDocument(MapDocument *mapDoc)
     mLotManager.setMapDocument(mapDocument());
 
     if (mapDocument()) {
+        mMapDocument->mapComposite()->setCellCacheEnabled(true);
+
         connect(mMapDocument, SIGNAL(regionAltered(QRegion,Layer*)),
                 SLOT(regionAltered(QRegion,Layer*)));
         connect(mMapDocument, SIGNAL(layerGroupAdded(int)), SLOT(layerGroupAdded(int)));
@@ -189,7 +219,7 @@ void ZomboidScene::regionAltered(const QRegion &region, Layer *layer)
         // The drawMargins will only change the first time painting occurs
         // in an empty layer.
         if (tl->group() && mTileLayerGroupItems.contains(tl->level())) {
-            if (mTileLayerGroupItems[tl->level()]->layerGroup()->regionAltered(tl))
+            if (mTileLayerGroupItems[tl->level()]->layerGroup()->regionAltered(tl, region))
                 updateLayerGroupLater(tl->level(), Synch | Bounds); // recalculate CompositeLayerGroup::mDrawMargins
         } else {
             // TileLayer not part of a layer group.
@@ -236,6 +266,8 @@ void ZomboidScene::refreshScene()
         removeItem(mMapBordersItem2);
     }
 
+    mRenderCache->invalidate();
+
     MapScene::refreshScene();
 
     addItem(mMapBordersItem);
@@ -248,6 +280,7 @@ void ZomboidScene::mapChanged()
 {
     MapScene::mapChanged();
 
+    mMapDocument->mapComposite()->invalidateCellCache();
     updateLayerGroupsLater(Bounds);
 }
 
@@ -276,13 +309,22 @@ public:
     }
 };
 
+CompositeLayerGroupItem *ZomboidScene::createLayerGroupItem(CompositeLayerGroup *layerGroup)
+{
+    CompositeLayerGroupItem *item = new CompositeLayerGroupItem(layerGroup,
+                                                                mMapDocument->renderer());
+    item->setRenderCache(mRenderCache);
+    // A new level may change the renderer's maxLevel, moving everything.
+    mRenderCache->invalidate();
+    return item;
+}
+
 QGraphicsItem *ZomboidScene::createLayerItem(Layer *layer)
 {
     if (TileLayer *tl = layer->asTileLayer()) {
         if (tl->group()) {
             if (!mTileLayerGroupItems[tl->level()]) {
-                mTileLayerGroupItems[tl->level()] = new CompositeLayerGroupItem((CompositeLayerGroup*)tl->group(),
-                                                                                mMapDocument->renderer());
+                mTileLayerGroupItems[tl->level()] = createLayerGroupItem((CompositeLayerGroup*)tl->group());
                 addItem(mTileLayerGroupItems[tl->level()]);
                 mMapDocument->renderer()->setMaxLevel(mMapDocument->mapComposite()->maxLevel());
                 updateLayerGroupLater(tl->level(), Bounds);
@@ -444,8 +486,7 @@ void ZomboidScene::layerGroupAdded(int level)
 {
     if (!mTileLayerGroupItems.contains(level)) {
         CompositeLayerGroup *layerGroup = mMapDocument->mapComposite()->tileLayersForLevel(level);
-        mTileLayerGroupItems[level] = new CompositeLayerGroupItem((CompositeLayerGroup*)layerGroup,
-                                                                  mMapDocument->renderer());
+        mTileLayerGroupItems[level] = createLayerGroupItem(layerGroup);
         addItem(mTileLayerGroupItems[level]);
         mMapDocument->renderer()->setMaxLevel(mMapDocument->mapComposite()->maxLevel());
         updateLayerGroupLater(level, Synch | Bounds | ZOrder);
@@ -699,6 +740,12 @@ void ZomboidScene::bmpPainted(int bmpIndex, const QRegion &region)
     const MapRenderer *renderer = mMapDocument->renderer();
     const QMargins margins = mMapDocument->map()->drawMargins();
 
+    // Blends depend on the neighbouring pixels too.
+    QRegion cacheRgn;
+    foreach (const QRect &r, region.rects())
+        cacheRgn += r.adjusted(-1, -1, 1, 1);
+    mMapDocument->mapComposite()->invalidateCellCache(cacheRgn);
+
     foreach (const QRect &r, region.rects()) {
         update(renderer->boundingRect(r, 0).adjusted(-margins.left(),
                                                      -margins.top(),
@@ -748,6 +795,23 @@ void ZomboidScene::showLotFloorsOnlyChanged(bool show)
     update();
 }
 
+void ZomboidScene::useRenderCacheChanged(bool useCache)
+{
+    mRenderCache->setEnabled(useCache);
+    update();
+}
+
+void ZomboidScene::renderCacheSizeChanged(int megabytes)
+{
+    mRenderCache->setMaxSize(megabytes);
+}
+
+void ZomboidScene::tilesetImageChanged(Tileset *tileset)
+{
+    if (mMapDocument && mMapDocument->mapComposite()->isTilesetUsed(tileset))
+        mRenderCache->invalidate();
+}
+
 void ZomboidScene::handlePendingUpdates()
 {
     MapComposite *mapComposite = mMapDocument->mapComposite();
@@ -755,9 +819,7 @@ void ZomboidScene::handlePendingUpdates()
         foreach (CompositeLayerGroup *layerGroup, mapComposite->layerGroups()) {
             int level = layerGroup->level();
             if (!mTileLayerGroupItems.contains(level)) {
-                mTileLayerGroupItems[level]
-                        = new CompositeLayerGroupItem(layerGroup,
-                                                      mMapDocument->renderer());
+                mTileLayerGroupItems[level] = createLayerGroupItem(layerGroup);
                 addItem(mTileLayerGroupItems[level]);
                 mPendingFlags |= ZOrder;
             }
@@ -776,6 +838,7 @@ void ZomboidScene::handlePendingUpdates()
             item->updateBounds();
         QRectF sceneRect = mMapDocument->mapComposite()->boundingRect(mMapDocument->renderer());
         if (sceneRect != this->sceneRect()) {
+            mRenderCache->invalidate();
             MapScene::mapChanged(); // must reposition items
 //            setSceneRect(sceneRect);
 //            mDarkRectangle->setRect(sceneRect);
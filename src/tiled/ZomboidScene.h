@@ -31,12 +31,16 @@ class MapBuildings;
 namespace Tiled {
 class MapNoBlend;
 class MapRenderer;
+namespace Internal {
+class LayerGroupRenderCache;
+}
 }
 
 class CompositeLayerGroupItem : public QGraphicsItem
 {
 public:
     CompositeLayerGroupItem(CompositeLayerGroup *layerGroup, Tiled::MapRenderer *renderer, QGraphicsItem *parent = 0);
+    ~CompositeLayerGroupItem();
 
     QRectF boundingRect() const;
     void paint(QPainter *p, const QStyleOptionGraphicsItem *option, QWidget *);
@@ -45,11 +49,15 @@ public:
     void updateBounds();
 
     CompositeLayerGroup *layerGroup() const { return mLayerGroup; }
+    Tiled::MapRenderer *renderer() const { return mRenderer; }
+
+    void setRenderCache(Tiled::Internal::LayerGroupRenderCache *cache);
 
 private:
     CompositeLayerGroup *mLayerGroup;
     Tiled::MapRenderer *mRenderer;
     QRectF mBoundingRect;
+    Tiled::Internal::LayerGroupRenderCache *mRenderCache;
 };
 
 namespace Tiled {
@@ -116,6 +124,9 @@ private slots:
 
     void highlightRoomUnderPointerChanged(bool highlight);
     void showLotFloorsOnlyChanged(bool show);
+    void useRenderCacheChanged(bool useCache);
+    void renderCacheSizeChanged(int megabytes);
+    void tilesetImageChanged(Tileset *tileset);
 
     void handlePendingUpdates();
 
@@ -161,6 +172,8 @@ private:
     QList<CompositeLayerGroupItem*> mPendingGroupItems;
 
     QMap<int,CompositeLayerGroupItem*> mTileLayerGroupItems;
+    CompositeLayerGroupItem *createLayerGroupItem(CompositeLayerGroup *layerGroup);
+    LayerGroupRenderCache *mRenderCache;
     ZLotManager mLotManager;
     DnDItem *mDnDItem;
     bool mWasHighlightCurrentLayer;
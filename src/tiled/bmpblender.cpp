@@ -47,6 +47,7 @@ BmpBlender::BmpBlender(QObject *parent) :
     mMap(nullptr),
     mFakeTileGrid(nullptr),
     mInitTilesLater(true),
+    mFloorLayerID(-1),
     mHack(false),
     mBlendEdgesEverywhere(false)
 {
@@ -57,6 +58,7 @@ BmpBlender::BmpBlender(Map *map, QObject *parent) :
     mMap(map),
     mFakeTileGrid(nullptr),
     mInitTilesLater(true),
+    mFloorLayerID(-1),
     mHack(false),
     mBlendEdgesEverywhere(false)
 {
@@ -82,11 +84,9 @@ void BmpBlender::setMap(Map *map)
 
 void BmpBlender::recreate()
 {
-    if (mFakeTileGrid) {
-        qDeleteAll(mTileGrids);
-        mTileGrids.clear();
-        delete mFakeTileGrid;
-        mFakeTileGrid = nullptr;
+    // fromMap() already dropped the grids, but not the layers.
+    if (mFakeTileGrid || !mTileLayers.isEmpty()) {
+        deleteTileGrids();
 
         qDeleteAll(mTileLayers);
         mTileLayers.clear();
@@ -220,13 +220,13 @@ void BmpBlender::tilesToPixels(int x1, int y1, int x2, int y2)
 // and blends.
 bool BmpBlender::expectTile(const QString &layerName, int x, int y, Tile *tile)
 {
-    if (mBlendGrids.contains(layerName)) {
-        int index = x + y * mMap->width();
-        if (mBlendGrids[layerName].contains(index)) {
-            BlendWrapper *blendW = mBlendGrids[layerName][index];
-            return blendW->mBlendTiles.contains(tile);
-        }
-    }
+    int layerID = mLayerIDs.value(layerName, -1);
+    if (layerID == -1 || layerID >= mBlendGrids.size() || mBlendGrids[layerID].isEmpty())
+        return false;
+    if (x < 0 || y < 0 || x >= mMap->width() || y >= mMap->height())
+        return false;
+    if (BlendWrapper *blendW = mBlendGrids[layerID][x + y * mMap->width()])
+        return blendW->mBlendSet.testBit(tileID(tile));
     return false;
 }
 
@@ -311,6 +311,9 @@ void BmpBlender::fromMap()
 {
     QSet<QString> tileNames;
 
+    // The layer IDs are about to change, the grids are recreated on demand.
+    deleteTileGrids();
+
     // We have to take care that any alias references exist, because when
     // loading or clearing Rules.txt the aliases are changed before the rules.
     // Also, if the aliases change, Blends.txt may reference undefined aliases!
@@ -329,14 +332,23 @@ void BmpBlender::fromMap()
 
     qDeleteAll(mRules);
     mRules.clear();
-    mRuleByColor.clear();
+    mRulesByColor.clear();
     mRuleLayers.clear();
     mFloor0Rules.clear();
+    mLayerNames.clear();
+    mLayerIDs.clear();
     foreach (BmpRule *rule, mMap->bmpSettings()->rules()) {
         RuleWrapper *ruleW = new RuleWrapper(rule);
-        mRuleByColor[rule->color] += ruleW;
+        ColorRules &colorRules = mRulesByColor[rule->color];
+        if (rule->bitmapIndex == 0 || rule->bitmapIndex == 1)
+            colorRules.mRules[rule->bitmapIndex] += ruleW;
         if (!mRuleLayers.contains(rule->targetLayer))
             mRuleLayers += rule->targetLayer;
+        if (!mLayerIDs.contains(rule->targetLayer)) {
+            mLayerIDs[rule->targetLayer] = mLayerNames.size();
+            mLayerNames += rule->targetLayer;
+        }
+        ruleW->mLayerID = mLayerIDs[rule->targetLayer];
         foreach (QString tileName, rule->tileChoices) {
             if (BuildingEditor::BuildingTilesMgr::legalTileName(tileName)) {
                 if (!mAliasByName.contains(tileName))
@@ -362,12 +374,21 @@ void BmpBlender::fromMap()
 
     qDeleteAll(mBlendList);
     mBlendList.clear();
-    mBlendsByLayer.clear();
+    mBlendsByLayerID.clear();
     mBlendLayers.clear();
+    mBlendLayerIDs.clear();
+    mExclude2LayerNames.clear();
     QSet<QString> layers;
     foreach (BmpBlend *blend, mMap->bmpSettings()->blends()) {
         BlendWrapper *blendW = new BlendWrapper(blend);
-        mBlendsByLayer[blend->targetLayer] += blendW;
+        if (!mLayerIDs.contains(blend->targetLayer)) {
+            mLayerIDs[blend->targetLayer] = mLayerNames.size();
+            mLayerNames += blend->targetLayer;
+        }
+        int layerID = mLayerIDs[blend->targetLayer];
+        if (mBlendsByLayerID.size() <= layerID)
+            mBlendsByLayerID.resize(layerID + 1);
+        mBlendsByLayerID[layerID] += blendW;
         layers.insert(blend->targetLayer);
         QStringList excludes;
         foreach (QString tileName, blend->ExclusionList) {
@@ -384,6 +405,10 @@ void BmpBlender::fromMap()
             if (BuildingEditor::BuildingTilesMgr::legalTileName(tileName)) {
                 tileNames += tileName;
             }
+            const QString &layerName = blend->exclude2[i + 1];
+            if (!mExclude2LayerNames.contains(layerName))
+                mExclude2LayerNames += layerName;
+            blendW->mExclude2LayerIDs += mExclude2LayerNames.indexOf(layerName);
         }
         if (BuildingEditor::BuildingTilesMgr::legalTileName(blend->mainTile)) {
             if (!mAliasByName.contains(blend->mainTile))
@@ -396,6 +421,10 @@ void BmpBlender::fromMap()
         mBlendList += blendW;
     }
     mBlendLayers = layers.values();
+    foreach (QString layerName, mBlendLayers)
+        mBlendLayerIDs += mLayerIDs[layerName];
+    mBlendsByLayerID.resize(mLayerNames.size());
+    mFloorLayerID = mLayerIDs.value(STR_0Floor, -1);
 
     mTileNames = normalizeTileNames(tileNames.values());
 
@@ -462,7 +491,7 @@ void BmpBlender::initTiles()
             mFloorTileToRule[tile] = ruleW;
     }
 
-    mBlendExclude2Layers.clear();
+    mTileIDs.clear();
     foreach (BlendWrapper *blendW, mBlendList) {
         blendW->mMainTiles = tileNameToTiles(blendW->mBlend->mainTile).toVector();
         blendW->mBlendTiles = tileNameToTiles(blendW->mBlend->blendTile).toVector();
@@ -470,10 +499,28 @@ void BmpBlender::initTiles()
         blendW->mExclude2Tiles.clear();
         for (int i = 0; i < blendW->mBlend->exclude2.size(); i += 2) {
             blendW->mExclude2Tiles += tileNameToTiles(blendW->mBlend->exclude2[i]).toVector();
-            mBlendExclude2Layers += blendW->mBlend->exclude2[i + 1];
+        }
+        QList<QVector<Tile*> > tileLists = blendW->mExclude2Tiles;
+        tileLists << blendW->mMainTiles << blendW->mBlendTiles << blendW->mExcludeTiles;
+        foreach (const QVector<Tile*> &tiles, tileLists) {
+            foreach (Tile *tile, tiles) {
+                if (!mTileIDs.contains(tile))
+                    mTileIDs.insert(tile, mTileIDs.size() + 1);
+            }
         }
     }
 
+    // All the sets must be the same size, so build them once every tile
+    // has its ID.
+    foreach (BlendWrapper *blendW, mBlendList) {
+        blendW->mMainSet = tileIDSet(blendW->mMainTiles);
+        blendW->mBlendSet = tileIDSet(blendW->mBlendTiles);
+        blendW->mExcludeSet = tileIDSet(blendW->mExcludeTiles);
+        blendW->mExclude2Sets.clear();
+        foreach (const QVector<Tile*> &tiles, blendW->mExclude2Tiles)
+            blendW->mExclude2Sets += tileIDSet(tiles);
+    }
+
     updateWarnings();
 
     // This list is for the benefit of PaintBMP().
@@ -502,12 +549,13 @@ static bool adjacentToNonBlack(const QImage &image1, const QImage &image2, int x
 
 void BmpBlender::imagesToTileGrids(int x1, int y1, int x2, int y2)
 {
-    if (mTileGrids.isEmpty()) {
-        foreach (QString layerName, mRuleLayers + mBlendLayers) {
-            if (!mTileGrids.contains(layerName))
-                mTileGrids[layerName] = new SparseTileGrid(mMap->width(), mMap->height());
-        }
+    if (mFakeTileGrid == nullptr) {
+        foreach (QString layerName, mLayerNames)
+            mTileGrids += new SparseTileGrid(mMap->width(), mMap->height());
         mFakeTileGrid = new SparseTileGrid(mMap->width(), mMap->height());
+        mBlendGrids.resize(mLayerNames.size());
+        foreach (int layerID, mBlendLayerIDs)
+            mBlendGrids[layerID].fill(nullptr, mMap->width() * mMap->height());
     }
 
     const QRgb black = qRgb(0, 0, 0);
@@ -524,27 +572,34 @@ void BmpBlender::imagesToTileGrids(int x1, int y1, int x2, int y2)
 
     Cell emptyCell;
 
+    // Runs of the same color are common, so remember the last lookup.
+    QRgb lastCol = black, lastCol2 = black;
+    const ColorRules *rules = nullptr, *rules2 = nullptr;
+    bool haveRules = false, haveRules2 = false;
+
     for (int y = y1; y <= y2; y++) {
         for (int x = x1; x <= x2; x++) {
-            foreach (QString layerName, mTileGrids.keys())
-                mTileGrids[layerName]->replace(x, y, emptyCell);
+            for (SparseTileGrid *grid : mTileGrids)
+                grid->replace(x, y, emptyCell);
             mFakeTileGrid->replace(x, y, emptyCell);
-            foreach (QString layerName, mBlendGrids.keys())
-                mBlendGrids[layerName].remove(x + y * mMap->width());
+            for (int layerID : mBlendLayerIDs)
+                mBlendGrids[layerID][x + y * mMap->width()] = nullptr;
 
             QRgb col = mMap->rbmpMain().pixel(x, y);
             QRgb col2 = mMap->rbmpVeg().pixel(x, y);
 
-            if (mRuleByColor.contains(col)) {
-                foreach (RuleWrapper *ruleW, mRuleByColor[col]) {
-                    if (ruleW->mRule->bitmapIndex != 0)
-                        continue;
-                    if (!mTileGrids.contains(ruleW->mRule->targetLayer))
-                        continue;
+            if (!haveRules || col != lastCol) {
+                QHash<QRgb,ColorRules>::const_iterator it = mRulesByColor.constFind(col);
+                rules = (it == mRulesByColor.constEnd()) ? nullptr : &it.value();
+                lastCol = col;
+                haveRules = true;
+            }
+            if (rules) {
+                for (RuleWrapper *ruleW : rules->mRules[0]) {
                     if (!ruleW->mTiles.size())
                         continue;
                     Tile *tile = ruleW->mTiles[mMap->bmp(0).rand(x, y) % ruleW->mTiles.size()];
-                    mTileGrids[ruleW->mRule->targetLayer]->replace(x, y, Cell(tile));
+                    mTileGrids[ruleW->mLayerID]->replace(x, y, Cell(tile));
                 }
             }
 
@@ -552,8 +607,7 @@ void BmpBlender::imagesToTileGrids(int x1, int y1, int x2, int y2)
             // one of the Rules.txt tiles, pretend that that pixel exists in the image.
             if (floorLayer && col == black) {
                 if (Tile *tile = floorLayer->cellAt(x, y).tile) {
-                    if (mFloorTileToRule.contains(tile)) {
-                        RuleWrapper *ruleW = mFloorTileToRule[tile];
+                    if (RuleWrapper *ruleW = mFloorTileToRule.value(tile)) {
                         if (ruleW->mTiles.size()) {
                             Tile *tile = ruleW->mTiles[mMap->bmp(0).rand(x, y) % ruleW->mTiles.count()];
                             mFakeTileGrid->replace(x, y, Cell(tile));
@@ -563,18 +617,22 @@ void BmpBlender::imagesToTileGrids(int x1, int y1, int x2, int y2)
                 }
             }
 
-            if (col2 != black && mRuleByColor.contains(col2)) {
-                foreach (RuleWrapper *ruleW, mRuleByColor[col2]) {
-                    if (ruleW->mRule->bitmapIndex != 1)
-                        continue;
+            if (col2 == black)
+                continue;
+            if (!haveRules2 || col2 != lastCol2) {
+                QHash<QRgb,ColorRules>::const_iterator it = mRulesByColor.constFind(col2);
+                rules2 = (it == mRulesByColor.constEnd()) ? nullptr : &it.value();
+                lastCol2 = col2;
+                haveRules2 = true;
+            }
+            if (rules2) {
+                for (RuleWrapper *ruleW : rules2->mRules[1]) {
                     if (ruleW->mRule->condition != col && ruleW->mRule->condition != black)
                         continue;
-                    if (!mTileGrids.contains(ruleW->mRule->targetLayer))
-                        continue;
                     if (!ruleW->mTiles.size())
                         continue;
                     Tile *tile = ruleW->mTiles[mMap->bmp(1).rand(x, y) % ruleW->mTiles.size()];
-                    mTileGrids[ruleW->mRule->targetLayer]->replace(x, y, Cell(tile));
+                    mTileGrids[ruleW->mLayerID]->replace(x, y, Cell(tile));
                 }
             }
         }
@@ -588,18 +646,18 @@ void BmpBlender::addEdgeTiles(int x1, int y1, int x2, int y2)
     y1 = qBound(0, y1, mMap->height() - 1);
     y2 = qBound(0, y2, mMap->height() - 1);
 
-    if (mTileGrids.contains(STR_0Floor) == false)
+    if (mFloorLayerID == -1)
         return;
-    SparseTileGrid *grid = mTileGrids[STR_0Floor];
+    SparseTileGrid *grid = mTileGrids[mFloorLayerID];
 
-    QMap<QString,TileLayer*> mapLayers;
-    foreach (QString layerName, mBlendExclude2Layers) {
-        int n = mMap->indexOfLayer(layerName, Layer::TileLayerType);
+    QVector<TileLayer*> exclude2Layers(mExclude2LayerNames.size(), nullptr);
+    for (int i = 0; i < mExclude2LayerNames.size(); i++) {
+        int n = mMap->indexOfLayer(mExclude2LayerNames[i], Layer::TileLayerType);
         if (n != -1)
-            mapLayers[layerName] = mMap->layerAt(n)->asTileLayer();
+            exclude2Layers[i] = mMap->layerAt(n)->asTileLayer();
     }
 
-    QVector<Tile*> neighbors(9);
+    int neighbors[9];
 
     const Cell emptyCell;
 
@@ -610,19 +668,22 @@ void BmpBlender::addEdgeTiles(int x1, int y1, int x2, int y2)
                                       adjacentToNonBlack(mMap->rbmpMain().rimage(), mMap->rbmpVeg().rimage(), x, y))) {
                 tile = mFakeTileGrid->at(x, y).tile;
             }
+            bool canBlend = (mBlendEdgesEverywhere == true) || (tile != nullptr);
+            int id = tileID(tile);
 
             for (int dy = -1; dy <= +1; dy++)
                 for (int dx = -1; dx <= +1; dx++)
-                    neighbors[(dx + 1) + (dy + 1) * 3] = getNeighbouringTile(x + dx, y + dy);
+                    neighbors[(dx + 1) + (dy + 1) * 3] = tileID(getNeighbouringTile(x + dx, y + dy));
+
+            int index = x + y * mMap->width();
 
-            foreach (QString layerName, mBlendLayers) {
-                BlendWrapper *blendW = getBlendRule(x, y, tile, layerName, neighbors);
+            for (int layerID : mBlendLayerIDs) {
+                BlendWrapper *blendW = canBlend ? getBlendRule(layerID, id, neighbors) : nullptr;
                 if (blendW != nullptr) {
-                    for (int i = 0; i < blendW->mBlend->exclude2.size(); i += 2) {
-                        if (mapLayers.contains(blendW->mBlend->exclude2[i + 1])) {
-                            TileLayer *mapLayer = mapLayers[blendW->mBlend->exclude2[i + 1]];
+                    for (int i = 0; i < blendW->mExclude2Sets.size(); i++) {
+                        if (TileLayer *mapLayer = exclude2Layers[blendW->mExclude2LayerIDs[i]]) {
                             if (Tile *tile = mapLayer->cellAt(x, y).tile) {
-                                if (blendW->mExclude2Tiles[i/2].contains(tile)) {
+                                if (blendW->mExclude2Sets[i].testBit(tileID(tile))) {
                                     blendW = nullptr;
                                     break;
                                 }
@@ -631,21 +692,19 @@ void BmpBlender::addEdgeTiles(int x1, int y1, int x2, int y2)
                     }
                 }
                 if (blendW == nullptr) {
-                    mTileGrids[layerName]->replace(x, y, emptyCell);
+                    mTileGrids[layerID]->replace(x, y, emptyCell);
                     if (true/*mHack*/) {
-                        int index = x + y * mMap->width();
-                        mBlendGrids[layerName].remove(index);
+                        mBlendGrids[layerID][index] = nullptr;
                     }
                     continue;
                 }
-                const QVector<Tile*> tiles = blendW->mBlendTiles;
+                const QVector<Tile*> &tiles = blendW->mBlendTiles;
                 if (tiles.size()) {
                     Tile *tile = tiles[mMap->bmp(0).rand(x, y) % tiles.size()];
-                    mTileGrids[layerName]->replace(x, y, Cell(tile));
+                    mTileGrids[layerID]->replace(x, y, Cell(tile));
                 }
                 if (true/*mHack*/) {
-                    int index = x + y * mMap->width();
-                    mBlendGrids[layerName][index] = blendW;
+                    mBlendGrids[layerID][index] = blendW;
                 }
             }
         }
@@ -673,9 +732,12 @@ void BmpBlender::tileGridsToLayers(int x1, int y1, int x2, int y2)
     const Cell emptyCell;
 
     foreach (QString layerName, mTileLayers.keys()) {
-        SparseTileGrid *grid = mTileGrids[layerName];
+        int layerID = mLayerIDs.value(layerName, -1);
+        if (layerID == -1 || layerID >= mTileGrids.size())
+            continue;
+        SparseTileGrid *grid = mTileGrids[layerID];
         TileLayer *tl = mTileLayers[layerName];
-        BlendGrid &blendGrid = mBlendGrids[layerName];
+        const BlendGrid &blendGrid = mBlendGrids[layerID];
         int n = mMap->indexOfLayer(layerName, Layer::TileLayerType);
         TileLayer *mapLayer = (n == -1) ? nullptr : mMap->layerAt(n)->asTileLayer();
         for (int y = y1; y <= y2; y++) {
@@ -688,12 +750,10 @@ void BmpBlender::tileGridsToLayers(int x1, int y1, int x2, int y2)
                 // If the blend tile that is in the map is the expected one,
                 // don't override it.  This prevents a map tile which should
                 // be there from being overriden by this automatic one.
-                if (mapLayer != nullptr) {
-                    int index = x + y * mMap->width();
-                    if (blendGrid.contains(index)) {
-                        BlendWrapper *blendW = blendGrid[index];
+                if (mapLayer != nullptr && !blendGrid.isEmpty()) {
+                    if (BlendWrapper *blendW = blendGrid[x + y * mMap->width()]) {
                         Tile *tile = mapLayer->cellAt(x, y).tile;
-                        if (blendW->mBlendTiles.contains(tile)) {
+                        if (blendW->mBlendSet.testBit(tileID(tile))) {
                             tl->setCell(x, y, emptyCell);
                             continue;
                         }
@@ -793,12 +853,12 @@ void BmpBlender::updateWarnings()
     for (int y = 0; y < mMap->rbmpMain().height(); y++) {
         for (int x = 0; x < mMap->rbmpMain().width(); x++) {
             QRgb color = mMap->rbmpMain().pixel(x, y);
-            if (color != qRgb(0,0,0) && !mRuleByColor.contains(color)) {
+            if (color != qRgb(0,0,0) && !mRulesByColor.contains(color)) {
                 warnings += tr("Map BMP image #%1 contains unknown color %2,%3,%4 at %5,%6")
                         .arg(0).arg(qRed(color)).arg(qGreen(color)).arg(qBlue(color)).arg(x).arg(y);
             }
             color = mMap->rbmpVeg().pixel(x, y);
-            if (color != qRgb(0,0,0) && !mRuleByColor.contains(color)) {
+            if (color != qRgb(0,0,0) && !mRulesByColor.contains(color)) {
                 warnings += tr("Map BMP image #%1 contains unknown color %2,%3,%4 at %5,%6")
                         .arg(1).arg(qRed(color)).arg(qGreen(color)).arg(qBlue(color)).arg(x).arg(y);
             }
@@ -815,76 +875,80 @@ Tile *BmpBlender::getNeighbouringTile(int x, int y)
 {
     if (x < 0 || y < 0 || x >= mMap->width() || y >= mMap->height())
         return nullptr;
-    SparseTileGrid *grid = mTileGrids[STR_0Floor];
+    SparseTileGrid *grid = mTileGrids[mFloorLayerID];
     Tile *tile = grid->at(x, y).tile;
     if (!tile)
         tile = mFakeTileGrid->at(x, y).tile;
     return tile;
 }
 
-BmpBlender::BlendWrapper *BmpBlender::getBlendRule(int x, int y, Tile *tile,
-                                   const QString &layer,
-                                   const QVector<Tile*> &neighbors)
+BmpBlender::BlendWrapper *BmpBlender::getBlendRule(int layerID, int tileID,
+                                                   const int *neighbors)
 {
-    if ((mBlendEdgesEverywhere == false) && (tile == nullptr))
-        return nullptr;
-
-    BlendWrapper *lastBlend = nullptr;
-
-#define NEIGHBOR(X,Y) neighbors[((X) - x + 1) + ((Y) - y + 1) * 3]
-
-    foreach (BlendWrapper *blendW, mBlendsByLayer[layer]) {
-        QVector<Tile*> &mainTiles = blendW->mMainTiles;
-        if (mainTiles.contains(tile))
+#define NEIGHBOR(DX,DY) mainTiles.testBit(neighbors[((DX) + 1) + ((DY) + 1) * 3])
+
+    // The last blend that matches wins.
+    const QVector<BlendWrapper*> &blends = mBlendsByLayerID[layerID];
+    for (int i = blends.size() - 1; i >= 0; --i) {
+        BlendWrapper *blendW = blends[i];
+        const QBitArray &mainTiles = blendW->mMainSet;
+        if (mainTiles.testBit(tileID))
             continue;
-        if (blendW->mExcludeTiles.contains(tile))
+        if (blendW->mExcludeSet.testBit(tileID))
             continue;
         bool bPass = false;
         switch (blendW->mBlend->dir) {
         case BmpBlend::N:
-            bPass = mainTiles.contains(NEIGHBOR(x, y - 1)) &&
-                    !mainTiles.contains(NEIGHBOR(x - 1, y)) &&
-                    !mainTiles.contains(NEIGHBOR(x + 1, y));
+            bPass = NEIGHBOR(0, -1) && !NEIGHBOR(-1, 0) && !NEIGHBOR(1, 0);
             break;
         case BmpBlend::S:
-            bPass = mainTiles.contains(NEIGHBOR(x, y + 1)) &&
-                    !mainTiles.contains(NEIGHBOR(x - 1, y)) &&
-                    !mainTiles.contains(NEIGHBOR(x + 1, y));
+            bPass = NEIGHBOR(0, 1) && !NEIGHBOR(-1, 0) && !NEIGHBOR(1, 0);
             break;
         case BmpBlend::E:
-            bPass = mainTiles.contains(NEIGHBOR(x + 1, y)) &&
-                    !mainTiles.contains(NEIGHBOR(x, y - 1)) &&
-                    !mainTiles.contains(NEIGHBOR(x, y + 1));
+            bPass = NEIGHBOR(1, 0) && !NEIGHBOR(0, -1) && !NEIGHBOR(0, 1);
             break;
         case BmpBlend::W:
-            bPass = mainTiles.contains(NEIGHBOR(x - 1, y)) &&
-                    !mainTiles.contains(NEIGHBOR(x, y - 1)) &&
-                    !mainTiles.contains(NEIGHBOR(x, y + 1));
+            bPass = NEIGHBOR(-1, 0) && !NEIGHBOR(0, -1) && !NEIGHBOR(0, 1);
             break;
         case BmpBlend::NE:
-            bPass = mainTiles.contains(NEIGHBOR(x, y - 1)) &&
-                    mainTiles.contains(NEIGHBOR(x + 1, y));
+            bPass = NEIGHBOR(0, -1) && NEIGHBOR(1, 0);
             break;
         case BmpBlend::SE:
-            bPass = mainTiles.contains(NEIGHBOR(x, y + 1)) &&
-                    mainTiles.contains(NEIGHBOR(x + 1, y));
+            bPass = NEIGHBOR(0, 1) && NEIGHBOR(1, 0);
             break;
         case BmpBlend::NW:
-            bPass = mainTiles.contains(NEIGHBOR(x, y - 1)) &&
-                    mainTiles.contains(NEIGHBOR(x - 1, y));
+            bPass = NEIGHBOR(0, -1) && NEIGHBOR(-1, 0);
             break;
         case BmpBlend::SW:
-            bPass = mainTiles.contains(NEIGHBOR(x, y + 1)) &&
-                    mainTiles.contains(NEIGHBOR(x - 1, y));
+            bPass = NEIGHBOR(0, 1) && NEIGHBOR(-1, 0);
             break;
         default:
             break;
         }
         if (bPass)
-            lastBlend = blendW;
+            return blendW;
     }
 
-    return lastBlend;
+#undef NEIGHBOR
+
+    return nullptr;
+}
+
+QBitArray BmpBlender::tileIDSet(const QVector<Tile *> &tiles) const
+{
+    QBitArray set(mTileIDs.size() + 1);
+    foreach (Tile *tile, tiles)
+        set.setBit(tileID(tile));
+    return set;
+}
+
+void BmpBlender::deleteTileGrids()
+{
+    qDeleteAll(mTileGrids);
+    mTileGrids.clear();
+    delete mFakeTileGrid;
+    mFakeTileGrid = nullptr;
+    mBlendGrids.clear();
 }
 
 /////
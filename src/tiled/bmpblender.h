@@ -18,7 +18,9 @@
 #ifndef BMPBLENDER_H
 #define BMPBLENDER_H
 
+#include <QBitArray>
 #include <QCoreApplication>
+#include <QHash>
 #include <QMap>
 #include <QRegion>
 #include <QRgb>
@@ -171,9 +173,10 @@ private:
     void addEdgeTiles(int x1, int y1, int x2, int y2);
     void tileGridsToLayers(int x1, int y1, int x2, int y2);
     QString resolveAlias(const QString &tileName, int randForPos) const;
+    void deleteTileGrids();
 
     Map *mMap;
-    QMap<QString,SparseTileGrid*> mTileGrids;
+    QVector<SparseTileGrid*> mTileGrids; // indexed by layer ID
     SparseTileGrid *mFakeTileGrid;
     QMap<QString,TileLayer*> mTileLayers;
 
@@ -184,8 +187,14 @@ private:
 
     Tile *getNeighbouringTile(int x, int y);
     class BlendWrapper;
-    BlendWrapper *getBlendRule(int x, int y, Tile *tile, const QString &layer,
-                               const QVector<Tile *> &neighbors);
+    BlendWrapper *getBlendRule(int layerID, int tileID, const int *neighbors);
+
+    // Every tile that is a main, blend or exclude tile of some blend gets a
+    // small integer ID so the blends can test membership with a bit lookup.
+    // ID 0 is any other tile.
+    int tileID(Tile *tile) const
+    { return mTileIDs.value(tile, 0); }
+    QBitArray tileIDSet(const QVector<Tile*> &tiles) const;
 
     class AliasWrapper
     {
@@ -204,19 +213,33 @@ private:
     {
     public:
         RuleWrapper(BmpRule *rule) :
-            mRule(rule)
+            mRule(rule),
+            mLayerID(-1)
         {
         }
         BmpRule *mRule;
+        int mLayerID;
         QStringList mTileNames;
         QVector<Tile*> mTiles;
     };
 
+    // The rules for one color, in Rules.txt order, by bitmap index.
+    class ColorRules
+    {
+    public:
+        QVector<RuleWrapper*> mRules[2];
+    };
+
     QList<RuleWrapper*> mRules;
-    QMap<QRgb,QList<RuleWrapper*> > mRuleByColor;
+    QHash<QRgb,ColorRules> mRulesByColor;
     QStringList mRuleLayers;
     QList<RuleWrapper*> mFloor0Rules;
-    QMap<Tile*,RuleWrapper*> mFloorTileToRule;
+    QHash<Tile*,RuleWrapper*> mFloorTileToRule;
+
+    // Every layer targeted by a rule or blend, the index is the layer ID.
+    QStringList mLayerNames;
+    QHash<QString,int> mLayerIDs;
+    int mFloorLayerID;
 
     class BlendWrapper
     {
@@ -229,18 +252,27 @@ private:
         QVector<Tile*> mBlendTiles;
         QVector<Tile*> mExcludeTiles;
         QList<QVector<Tile*> > mExclude2Tiles;
+
+        // Sets of tile IDs, see tileID().
+        QBitArray mMainSet;
+        QBitArray mBlendSet;
+        QBitArray mExcludeSet;
+        QVector<QBitArray> mExclude2Sets;
+        QVector<int> mExclude2LayerIDs; // index into mExclude2LayerNames
     };
 
     QList<BlendWrapper*> mBlendList;
     QStringList mBlendLayers;
-    QMap<QString,QList<BlendWrapper*> > mBlendsByLayer;
-    QSet<QString> mBlendExclude2Layers;
+    QVector<int> mBlendLayerIDs;
+    QVector<QVector<BlendWrapper*> > mBlendsByLayerID;
+    QStringList mExclude2LayerNames;
+    QHash<Tile*,int> mTileIDs;
 
     QSet<Tile*> mKnownBlendTiles;
     bool mHack;
     bool mBlendEdgesEverywhere;
-    typedef QHash<int,BlendWrapper*> BlendGrid;
-    QMap<QString,BlendGrid> mBlendGrids; // blend at each x,y
+    typedef QVector<BlendWrapper*> BlendGrid;
+    QVector<BlendGrid> mBlendGrids; // blend at each x,y, by layer ID
 
     QRegion mDirtyRegion;
 
@@ -0,0 +1,267 @@
+/*
+ * layergrouprendercache.cpp
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "layergrouprendercache.h"
+
+#include "mapcomposite.h"
+#include "maprenderer.h"
+#include "ZomboidScene.h"
+
+#include <QElapsedTimer>
+
+#include <cmath>
+
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+namespace Tiled {
+namespace Internal {
+
+uint qHash(const LayerGroupRenderCache::Key &key)
+{
+    uint h = uint(key.level);
+    h = h * 31 + uint(key.scale);
+    h = h * 31 + uint(key.opacity);
+    h = h * 31 + uint(key.x);
+    return h * 31 + uint(key.y);
+}
+
+} // namespace Internal
+} // namespace Tiled
+
+LayerGroupRenderCache::LayerGroupRenderCache(QObject *parent)
+    : QObject(parent)
+    , mEnabled(false)
+{
+    setMaxSize(256);
+
+    mRenderTimer.setSingleShot(true);
+    mRenderTimer.setInterval(0);
+    connect(&mRenderTimer, SIGNAL(timeout()), SLOT(renderPending()));
+}
+
+void LayerGroupRenderCache::setEnabled(bool enabled)
+{
+    if (enabled == mEnabled)
+        return;
+    mEnabled = enabled;
+    invalidate();
+}
+
+void LayerGroupRenderCache::setMaxSize(int megabytes)
+{
+    // The cost of a tile is its size in kilobytes.
+    mTiles.setMaxCost(qMax(megabytes, 1) * 1024);
+}
+
+int LayerGroupRenderCache::maxSize() const
+{
+    return mTiles.maxCost() / 1024;
+}
+
+void LayerGroupRenderCache::addItem(CompositeLayerGroupItem *item)
+{
+    mItems[item->layerGroup()->level()] = item;
+    invalidate(item->layerGroup()->level());
+}
+
+void LayerGroupRenderCache::removeItem(CompositeLayerGroupItem *item)
+{
+    int level = item->layerGroup()->level();
+    if (mItems.value(level) == item) {
+        mItems.remove(level);
+        invalidate(level);
+    }
+}
+
+bool LayerGroupRenderCache::paint(CompositeLayerGroupItem *item, QPainter *painter,
+                                  const QRectF &exposed)
+{
+    if (!mEnabled)
+        return false;
+
+    CompositeLayerGroup *layerGroup = item->layerGroup();
+    if (!layerGroup->owner()->isCellCacheEnabled())
+        return false;
+
+    // Only a uniform scale plus translation maps tiles onto whole pixels.
+    const QTransform xform = painter->worldTransform();
+    if (xform.type() > QTransform::TxScale || xform.m11() != xform.m22() || xform.m11() <= 0)
+        return false;
+
+    takeChanges(item);
+
+    const qreal scale = xform.m11();
+    const QRectF rect = exposed.isNull() ? item->boundingRect()
+                                         : (exposed & item->boundingRect());
+    if (rect.isEmpty())
+        return true;
+
+    Key key;
+    key.level = layerGroup->level();
+    key.scale = qRound(scale * ScaleBuckets);
+    key.opacity = qRound(painter->opacity() * 255);
+
+    const int x1 = int(std::floor(rect.left() * scale / TileSize));
+    const int y1 = int(std::floor(rect.top() * scale / TileSize));
+    const int x2 = int(std::floor(rect.right() * scale / TileSize));
+    const int y2 = int(std::floor(rect.bottom() * scale / TileSize));
+
+    for (int y = y1; y <= y2; y++) {
+        for (int x = x1; x <= x2; x++) {
+            key.x = x;
+            key.y = y;
+            const QRectF tileRect = tileSceneRect(x, y, scale);
+            if (QImage *image = mTiles.object(key)) {
+                painter->save();
+                painter->setOpacity(1.0);
+                painter->drawImage(tileRect, *image);
+                painter->restore();
+                continue;
+            }
+
+            // Draw this part directly until the tile is ready.  Clip it, so
+            // cells overlapping a cached neighbour aren't drawn twice.
+            const QRectF drawRect = tileRect & rect;
+            painter->save();
+            painter->setClipRect(drawRect, Qt::IntersectClip);
+            item->renderer()->drawTileLayerGroup(painter, layerGroup, drawRect);
+            painter->restore();
+
+            Job job;
+            job.key = key;
+            job.scale = scale;
+            job.hints = painter->renderHints();
+            queue(job);
+        }
+    }
+
+    return true;
+}
+
+void LayerGroupRenderCache::invalidate()
+{
+    mTiles.clear();
+    mPending.clear();
+    mPendingKeys.clear();
+}
+
+void LayerGroupRenderCache::invalidate(int level)
+{
+    foreach (const Key &key, mTiles.keys()) {
+        if (key.level == level)
+            mTiles.remove(key);
+    }
+}
+
+void LayerGroupRenderCache::invalidate(int level, const QRectF &sceneRect)
+{
+    foreach (const Key &key, mTiles.keys()) {
+        if (key.level != level)
+            continue;
+        qreal scale = qreal(key.scale) / ScaleBuckets;
+        if (tileSceneRect(key.x, key.y, scale).intersects(sceneRect))
+            mTiles.remove(key);
+    }
+}
+
+void LayerGroupRenderCache::renderPending()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Keep the UI responsive; whatever is left is done next time around.
+    while (!mPending.isEmpty() && timer.elapsed() < 25) {
+        Job job = mPending.takeFirst();
+        mPendingKeys.remove(job.key);
+
+        CompositeLayerGroupItem *item = mItems.value(job.key.level);
+        if (!item || !item->isVisible() || mTiles.contains(job.key))
+            continue;
+        CompositeLayerGroup *layerGroup = item->layerGroup();
+        if (layerGroup->needsSynch())
+            continue;
+
+        // Anything that changed since the tile was queued must not leave
+        // stale tiles behind.
+        takeChanges(item);
+
+        const QRectF tileRect = tileSceneRect(job.key.x, job.key.y, job.scale);
+
+        QImage *image = new QImage(TileSize, TileSize, QImage::Format_ARGB32_Premultiplied);
+        image->fill(Qt::transparent);
+        QPainter painter(image);
+        painter.setRenderHints(job.hints);
+        painter.setOpacity(job.key.opacity / 255.0);
+        painter.scale(job.scale, job.scale);
+        painter.translate(-tileRect.topLeft());
+        item->renderer()->drawTileLayerGroup(&painter, layerGroup, tileRect);
+        painter.end();
+
+        // Drawing may have flushed the BMP blender, which alters the
+        // neighbouring tiles too.
+        takeChanges(item);
+
+        mTiles.insert(job.key, image, image->byteCount() / 1024);
+        item->update(tileRect);
+    }
+
+    if (!mPending.isEmpty())
+        mRenderTimer.start();
+}
+
+QRectF LayerGroupRenderCache::tileSceneRect(int x, int y, qreal scale)
+{
+    const qreal size = TileSize / scale;
+    return QRectF(x * size, y * size, size, size);
+}
+
+void LayerGroupRenderCache::takeChanges(CompositeLayerGroupItem *item)
+{
+    CompositeLayerGroup *layerGroup = item->layerGroup();
+    QRegion region;
+    if (layerGroup->takeChangedRegion(region)) {
+        invalidate(layerGroup->level());
+        return;
+    }
+    if (region.isEmpty())
+        return;
+
+    // Tiles are taller than a cell, see MapScene::regionChanged().
+    const QMargins margins = layerGroup->drawMargins();
+    foreach (const QRect &r, region.rects()) {
+        QRectF bounds = item->renderer()->boundingRect(r, layerGroup->level());
+        invalidate(layerGroup->level(), bounds.adjusted(-margins.left(),
+                                                        -margins.top(),
+                                                        margins.right(),
+                                                        margins.bottom()));
+    }
+}
+
+void LayerGroupRenderCache::queue(const Job &job)
+{
+    if (mPendingKeys.contains(job.key))
+        return;
+
+    // The most recently exposed tiles are rendered first.
+    mPending.prepend(job);
+    mPendingKeys.insert(job.key);
+    while (mPending.size() > MaxPendingJobs)
+        mPendingKeys.remove(mPending.takeLast().key);
+
+    mRenderTimer.start();
+}
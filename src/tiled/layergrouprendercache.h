@@ -0,0 +1,124 @@
+/*
+ * layergrouprendercache.h
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LAYERGROUPRENDERCACHE_H
+#define LAYERGROUPRENDERCACHE_H
+
+#include <QCache>
+#include <QImage>
+#include <QMap>
+#include <QObject>
+#include <QPainter>
+#include <QSet>
+#include <QTimer>
+
+class CompositeLayerGroupItem;
+
+namespace Tiled {
+namespace Internal {
+
+/**
+  * Keeps pre-composited images of each level of a map as fixed-size screen
+  * tiles, so a CompositeLayerGroupItem can be repainted by blitting them
+  * instead of drawing every cell again.
+  *
+  * Tiles are keyed by level, view scale and opacity.  A tile that isn't
+  * cached yet is drawn directly and queued; queued tiles are rendered a few
+  * at a time when the event loop is idle, then the area is repainted.  The
+  * least-recently used tiles are dropped once maxSize() is reached.
+  *
+  * Changes are picked up from CompositeLayerGroup::takeChangedRegion(), so
+  * this requires MapComposite::setCellCacheEnabled().
+  */
+class LayerGroupRenderCache : public QObject
+{
+    Q_OBJECT
+public:
+    enum { TileSize = 512 };
+
+    LayerGroupRenderCache(QObject *parent = nullptr);
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const
+    { return mEnabled; }
+
+    /**
+      * The memory cap in megabytes.
+      */
+    void setMaxSize(int megabytes);
+    int maxSize() const;
+
+    void addItem(CompositeLayerGroupItem *item);
+    void removeItem(CompositeLayerGroupItem *item);
+
+    /**
+      * Draws the exposed area of the item's layer group.  Returns false if
+      * the cache can't be used with this painter, in which case the caller
+      * should draw the layer group itself.
+      */
+    bool paint(CompositeLayerGroupItem *item, QPainter *painter,
+               const QRectF &exposed);
+
+    void invalidate();
+    void invalidate(int level);
+    void invalidate(int level, const QRectF &sceneRect);
+
+private slots:
+    void renderPending();
+
+private:
+    struct Key
+    {
+        int level;
+        int scale; // scale * ScaleBuckets
+        int opacity; // 0-255
+        int x;
+        int y;
+
+        bool operator==(const Key &other) const
+        {
+            return level == other.level && scale == other.scale &&
+                    opacity == other.opacity && x == other.x && y == other.y;
+        }
+    };
+    friend uint qHash(const Key &key);
+
+    struct Job
+    {
+        Key key;
+        qreal scale;
+        QPainter::RenderHints hints;
+    };
+
+    enum { ScaleBuckets = 1024, MaxPendingJobs = 256 };
+
+    static QRectF tileSceneRect(int x, int y, qreal scale);
+    void takeChanges(CompositeLayerGroupItem *item);
+    void queue(const Job &job);
+
+    bool mEnabled;
+    QMap<int,CompositeLayerGroupItem*> mItems;
+    QCache<Key,QImage> mTiles;
+    QList<Job> mPending;
+    QSet<Key> mPendingKeys;
+    QTimer mRenderTimer;
+};
+
+} // namespace Internal
+} // namespace Tiled
+
+#endif // LAYERGROUPRENDERCACHE_H
@@ -0,0 +1,118 @@
+/*
+ * lotexportbatch.cpp
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lotexportbatch.h"
+
+#include "mapcomposite.h"
+#include "mapmanager.h"
+#include "newmapbinaryfile.h"
+
+#include <QCoreApplication>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+
+namespace {
+
+class ExportTask : public QRunnable
+{
+public:
+    ExportTask(MapComposite *mapComposite, const QString &lotFilePath,
+               QString *error) :
+        mMapComposite(mapComposite),
+        mLotFilePath(lotFilePath),
+        mError(error)
+    {
+    }
+
+    void run()
+    {
+        NewMapBinaryFile file;
+        if (!file.write(mMapComposite, mLotFilePath))
+            *mError = file.errorString();
+    }
+
+private:
+    MapComposite *mMapComposite;
+    QString mLotFilePath;
+    QString *mError;
+};
+
+} // namespace
+
+LotExportBatch::LotExportBatch(QObject *parent) :
+    QObject(parent)
+{
+}
+
+void LotExportBatch::addJob(const QString &mapFilePath, const QString &lotFilePath)
+{
+    mJobs += Job(mapFilePath, lotFilePath);
+}
+
+bool LotExportBatch::run()
+{
+    mErrors.clear();
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+
+    // Enough maps per batch that every thread has a couple to export,
+    // without every map being loaded at once.
+    const int batchSize = pool.maxThreadCount() * 2;
+
+    for (int first = 0; first < mJobs.size(); first += batchSize) {
+        const int count = qMin(batchSize, mJobs.size() - first);
+        QVector<MapComposite*> loaded(count, 0);
+        QVector<QString> errors(count);
+
+        // Load the maps and their lots.  MapManager isn't thread-safe, so
+        // this happens here and not in the pool.  Events are only processed
+        // while nothing is being exported.
+        for (int i = 0; i < count; i++) {
+            const Job &job = mJobs[first + i];
+            MapInfo *mapInfo = MapManager::instance()->loadMap(job.mapFilePath);
+            if (!mapInfo) {
+                errors[i] = MapManager::instance()->errorString();
+                continue;
+            }
+            loaded[i] = new MapComposite(mapInfo);
+            while (loaded[i]->waitingForMapsToLoad())
+                qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
+        }
+
+        // Nothing else touches the maps until the pool is done with them.
+        for (int i = 0; i < count; i++) {
+            if (loaded[i])
+                pool.start(new ExportTask(loaded[i], mJobs[first + i].lotFilePath,
+                                          &errors[i]));
+        }
+        pool.waitForDone();
+
+        // Report in job order, whatever order the threads finished in.
+        for (int i = 0; i < count; i++) {
+            const Job &job = mJobs[first + i];
+            if (!errors[i].isEmpty())
+                mErrors += tr("%1: %2").arg(job.mapFilePath).arg(errors[i]);
+            delete loaded[i];
+            emit progress(first + i + 1, mJobs.size(), job.mapFilePath);
+        }
+    }
+
+    return mErrors.isEmpty();
+}
@@ -0,0 +1,71 @@
+/*
+ * lotexportbatch.h
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOTEXPORTBATCH_H
+#define LOTEXPORTBATCH_H
+
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+/**
+  * Exports many maps to lot files at once.
+  *
+  * Maps are loaded through the MapManager on the calling thread, so MapInfos
+  * and tilesets shared between cells are only loaded once.  Cells are
+  * loaded in batches.  The cells of a batch are handed to a pool of
+  * QThread::idealThreadCount() threads, each exported by its own
+  * NewMapBinaryFile, and the next batch is loaded once they are all done.
+  * Errors and progress are reported in the order the jobs were added.
+  */
+class LotExportBatch : public QObject
+{
+    Q_OBJECT
+public:
+    LotExportBatch(QObject *parent = 0);
+
+    void addJob(const QString &mapFilePath, const QString &lotFilePath);
+
+    /**
+      * Exports every job, blocking until they are all done.  Returns false if
+      * any of them failed, see errors().
+      */
+    bool run();
+
+    const QStringList &errors() const
+    { return mErrors; }
+
+signals:
+    void progress(int done, int total, const QString &mapFilePath);
+
+private:
+    struct Job
+    {
+        Job(const QString &mapFilePath, const QString &lotFilePath) :
+            mapFilePath(mapFilePath),
+            lotFilePath(lotFilePath)
+        {}
+        QString mapFilePath;
+        QString lotFilePath;
+    };
+
+    QList<Job> mJobs;
+    QStringList mErrors;
+};
+
+#endif // LOTEXPORTBATCH_H
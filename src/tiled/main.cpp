@@ -26,6 +26,7 @@
 #include "preferences.h"
 #include "tiledapplication.h"
 #ifdef ZOMBOID
+#include "lotexportbatch.h"
 #include "worlded/worldedmgr.h"
 #include "zprogress.h"
 #include <QFileInfo>
@@ -59,11 +60,17 @@ public:
     bool quit;
     bool showedVersion;
     bool disableOpenGL;
+#ifdef ZOMBOID
+    bool exportLots;
+#endif
 
 private:
     void showVersion();
     void justQuit();
     void setDisableOpenGL();
+#ifdef ZOMBOID
+    void setExportLots();
+#endif
 
     // Convenience wrapper around registerOption
     template <void (CommandLineHandler::*memberFunction)()>
@@ -85,6 +92,9 @@ CommandLineHandler::CommandLineHandler()
     : quit(false)
     , showedVersion(false)
     , disableOpenGL(false)
+#ifdef ZOMBOID
+    , exportLots(false)
+#endif
 {
     option<&CommandLineHandler::showVersion>(
                 QLatin1Char('v'),
@@ -101,6 +111,14 @@ CommandLineHandler::CommandLineHandler()
                 QChar(),
                 QLatin1String("--disable-opengl"),
                 QLatin1String("Disable hardware accelerated rendering"));
+
+#ifdef ZOMBOID
+    option<&CommandLineHandler::setExportLots>(
+                QChar(),
+                QLatin1String("--export-lots"),
+                QLatin1String("Export the given maps to .pzby lot files next "
+                              "to them without opening a window, then quit"));
+#endif
 }
 
 void CommandLineHandler::showVersion()
@@ -123,6 +141,36 @@ void CommandLineHandler::setDisableOpenGL()
     disableOpenGL = true;
 }
 
+#ifdef ZOMBOID
+void CommandLineHandler::setExportLots()
+{
+    exportLots = true;
+}
+
+static int exportLots(const QStringList &mapFilePaths)
+{
+    LotExportBatch batch;
+    foreach (const QString &mapFilePath, mapFilePaths) {
+        QFileInfo info(mapFilePath);
+        batch.addJob(info.absoluteFilePath(),
+                     info.absolutePath() + QLatin1Char('/')
+                     + info.completeBaseName() + QLatin1String(".pzby"));
+    }
+
+    QObject::connect(&batch, &LotExportBatch::progress,
+                     [](int done, int total, const QString &mapFilePath) {
+        qWarning("[%d/%d] %s", done, total, qPrintable(mapFilePath));
+    });
+
+    if (!batch.run()) {
+        foreach (const QString &error, batch.errors())
+            qWarning("%s", qPrintable(error));
+        return 1;
+    }
+    return 0;
+}
+#endif
+
 #if !defined(QT_NO_DEBUG) && defined(ZOMBOID) && defined(_MSC_VER)
 static void __cdecl invalid_parameter_handler(
    const wchar_t * expression,
@@ -182,7 +230,7 @@ int main(int argc, char *argv[])
         Preferences::instance()->setUseOpenGL(false);
 
 #ifdef ZOMBOID
-    if (a.isRunning()) {
+    if (a.isRunning() && !commandLine.exportLots) {
         if (!commandLine.filesToOpen().isEmpty()) {
             foreach (const QString &fileName, commandLine.filesToOpen())
                 a.sendMessage(fileName);
@@ -191,6 +239,19 @@ int main(int argc, char *argv[])
     }
 #endif
 
+#ifdef ZOMBOID
+    // No MainWindow when exporting lots, only the managers the export needs,
+    // which are created as the config files are read.
+    if (commandLine.exportLots) {
+        QString error;
+        if (!MainWindow::readConfigFiles(error)) {
+            qWarning("%s", qPrintable(error));
+            return 1;
+        }
+        return exportLots(commandLine.filesToOpen());
+    }
+#endif
+
     MainWindow w;
 #ifdef ZOMBOID
     ZProgressManager::instance()->setMainWindow(&w);
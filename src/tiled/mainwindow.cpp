@@ -973,14 +973,23 @@ bool MainWindow::InitConfigFiles()
     // Refresh the ui before blocking while loading tilesets etc
     qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
 
+    QString error;
+    if (!readConfigFiles(error)) {
+        QMessageBox::critical(this, tr("It's no good, Jim!"), error);
+        return false;
+    }
+    return true;
+}
+
+bool MainWindow::readConfigFiles(QString &error)
+{
     // Create ~/.TileZed if needed.
     QString configPath = Preferences::instance()->configPath();
     QDir dir(configPath);
     if (!dir.exists()) {
         if (!dir.mkpath(configPath)) {
-            QMessageBox::critical(this, tr("It's no good, Jim!"),
-                                  tr("Failed to create config directory:\n%1")
-                                  .arg(QDir::toNativeSeparators(configPath)));
+            error = tr("Failed to create config directory:\n%1")
+                    .arg(QDir::toNativeSeparators(configPath));
             return false;
         }
     }
@@ -1000,9 +1009,8 @@ bool MainWindow::InitConfigFiles()
             QString source = Preferences::instance()->appConfigPath(configFile);
             if (QFileInfo(source).exists()) {
                 if (!QFile::copy(source, fileName)) {
-                    QMessageBox::critical(this, tr("It's no good, Jim!"),
-                                          tr("Failed to copy file:\nFrom: %1\nTo: %2")
-                                          .arg(source).arg(fileName));
+                    error = tr("Failed to copy file:\nFrom: %1\nTo: %2")
+                            .arg(source).arg(fileName);
                     return false;
                 }
             }
@@ -1012,48 +1020,43 @@ bool MainWindow::InitConfigFiles()
     // Read Tilesets.txt before TMXConfig.txt in case we are upgrading
     // TMXConfig.txt from VERSION0 to VERSION1.
     if (!TileMetaInfoMgr::instance()->readTxt()) {
-        QMessageBox::critical(this, tr("It's no good, Jim!"),
-                              tr("%1\n(while reading %2)")
-                              .arg(TileMetaInfoMgr::instance()->errorString())
-                              .arg(TileMetaInfoMgr::instance()->txtName()));
+        error = tr("%1\n(while reading %2)")
+                .arg(TileMetaInfoMgr::instance()->errorString())
+                .arg(TileMetaInfoMgr::instance()->txtName());
         return false;
     }
 
     if (!TileMetaInfoMgr::instance()->addNewTilesets()) {
-        QMessageBox::critical(this, tr("It's no good, Jim!"),
-                              tr("%1\n(while adding new tilesets)"));
+        error = tr("%1\n(while adding new tilesets)")
+                .arg(TileMetaInfoMgr::instance()->errorString());
         return false;
     }
 
     if (!BuildingTMX::instance()->readTxt()) {
-        QMessageBox::critical(this, tr("It's no good, Jim!"),
-                              tr("Error while reading %1\n%2")
-                              .arg(BuildingTMX::instance()->txtName())
-                              .arg(BuildingTMX::instance()->errorString()));
+        error = tr("Error while reading %1\n%2")
+                .arg(BuildingTMX::instance()->txtName())
+                .arg(BuildingTMX::instance()->errorString());
         return false;
     }
 
     if (!BuildingTilesMgr::instance()->readTxt()) {
-        QMessageBox::critical(this, tr("It's no good, Jim!"),
-                              tr("Error while reading %1\n%2")
-                              .arg(BuildingTilesMgr::instance()->txtName())
-                              .arg(BuildingTilesMgr::instance()->errorString()));
+        error = tr("Error while reading %1\n%2")
+                .arg(BuildingTilesMgr::instance()->txtName())
+                .arg(BuildingTilesMgr::instance()->errorString());
         return false;
     }
 
     if (!FurnitureGroups::instance()->readTxt()) {
-        QMessageBox::critical(this, tr("It's no good, Jim!"),
-                              tr("Error while reading %1\n%2")
-                              .arg(FurnitureGroups::instance()->txtName())
-                              .arg(FurnitureGroups::instance()->errorString()));
+        error = tr("Error while reading %1\n%2")
+                .arg(FurnitureGroups::instance()->txtName())
+                .arg(FurnitureGroups::instance()->errorString());
         return false;
     }
 
     if (!BuildingTemplates::instance()->readTxt()) {
-        QMessageBox::critical(this, tr("It's no good, Jim!"),
-                              tr("Error while reading %1\n%2")
-                              .arg(BuildingTemplates::instance()->txtName())
-                              .arg(BuildingTemplates::instance()->errorString()));
+        error = tr("Error while reading %1\n%2")
+                .arg(BuildingTemplates::instance()->txtName())
+                .arg(BuildingTemplates::instance()->errorString());
         return false;
     }
 
@@ -127,6 +127,12 @@ public:
 #ifdef ZOMBOID
     bool InitConfigFiles();
 
+    /**
+     * Reads Tilesets.txt, TMXConfig.txt and the other config files without
+     * showing any ui, copying them to the config directory first if needed.
+     */
+    static bool readConfigFiles(QString &error);
+
     void ApplyScriptChanges(MapDocument *doc, const QString &undoText, Lua::LuaMap *map);
     void LuaScript(const QString &filePath);
     bool LuaScript(MapDocument *doc, const QString &filePath);
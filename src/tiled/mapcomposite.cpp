@@ -89,11 +89,16 @@ CompositeLayerGroup::SubMapLayers::SubMapLayers(MapComposite *subMap,
 
 ///// ///// ///// ///// /////
 
+static QLatin1String sFloor("0_Floor"); // FIXME: thread safe?
+static QLatin1String sAboveLot("_AboveLot");
+static QLatin1String sNoRender("NoRender");
+
 CompositeLayerGroup::CompositeLayerGroup(MapComposite *owner, int level)
     : ZTileLayerGroup(owner->map(), level)
     , mOwner(owner)
     , mAnyVisibleLayers(false)
     , mNeedsSynch(true)
+    , mAllCellsChanged(true)
     , mNoBlendCell(Tiled::Internal::TilesetManager::instance()->noBlendTile())
 #if 1 // ROAD_CRUD
     , mRoadLayer0(0)
@@ -103,6 +108,11 @@ CompositeLayerGroup::CompositeLayerGroup(MapComposite *owner, int level)
 
 }
 
+CompositeLayerGroup::~CompositeLayerGroup()
+{
+    qDeleteAll(mCellCache);
+}
+
 void CompositeLayerGroup::addTileLayer(TileLayer *layer, int index)
 {
 #ifndef WORLDED
@@ -124,14 +134,6 @@ void CompositeLayerGroup::addTileLayer(TileLayer *layer, int index)
     mLayerOpacity.insert(index, mOwner->mapInfo()->isBeingEdited()
                          ? layer->opacity() : 1.0f);
 
-    // To optimize drawing of submaps, remember which layers are totally empty.
-    // But don't do this for the top-level map (the one being edited).
-    // TileLayer::isEmpty() is SLOW, it's why I'm caching it.
-    bool empty = mOwner->mapInfo()->isBeingEdited()
-            ? false
-            : layer->isEmpty() || layer->name().contains(QLatin1String("NoRender"));
-    mEmptyLayers.insert(index, empty);
-
     mBmpBlendLayers.insert(index, nullptr);
     mNoBlends.insert(index, nullptr);
 #ifdef BUILDINGED
@@ -140,6 +142,19 @@ void CompositeLayerGroup::addTileLayer(TileLayer *layer, int index)
     mToolNoBlends.insert(index, ToolNoBlend());
     mForceNonEmpty.insert(index, false);
 #endif // BUILDINGED
+
+    mLayerRoles.insert(index, 0);
+    updateLayerRoles(index);
+
+    // To optimize drawing of submaps, remember which layers are totally empty.
+    // But don't do this for the top-level map (the one being edited).
+    // TileLayer::isEmpty() is SLOW, it's why I'm caching it.
+    bool empty = mOwner->mapInfo()->isBeingEdited()
+            ? false
+            : layerHasRole(index, NoRenderRole) || layer->isEmpty();
+    mEmptyLayers.insert(index, empty);
+
+    mOwner->invalidateCellCache();
 }
 
 void CompositeLayerGroup::removeTileLayer(TileLayer *layer)
@@ -150,6 +165,7 @@ void CompositeLayerGroup::removeTileLayer(TileLayer *layer)
     mEmptyLayers.remove(index);
     mBmpBlendLayers.remove(index);
     mNoBlends.remove(index);
+    mLayerRoles.remove(index);
 #ifdef BUILDINGED
     mBlendOverLayers.remove(index);
     mToolLayers.remove(index);
@@ -169,6 +185,38 @@ void CompositeLayerGroup::removeTileLayer(TileLayer *layer)
     const QString name = MapComposite::layerNameWithoutPrefix(layer);
     index = mLayersByName[name].indexOf(layer);
     mLayersByName[name].remove(index);
+
+    mOwner->invalidateCellCache();
+}
+
+void CompositeLayerGroup::updateLayerRoles()
+{
+    for (int index = 0; index < mLayers.size(); index++)
+        updateLayerRoles(index);
+}
+
+int CompositeLayerGroup::layerRolesForName(const QString &name, int level)
+{
+    int roles = 0;
+    if (level == 0 && name.startsWith(sFloor)) {
+        roles |= AnyFloorRole;
+        if (name == sFloor)
+            roles |= FloorRole;
+    }
+    if (name.contains(sAboveLot))
+        roles |= AboveLotRole;
+    if (name.contains(sNoRender))
+        roles |= NoRenderRole;
+    return roles;
+}
+
+void CompositeLayerGroup::updateLayerRoles(int index)
+{
+    const QString &name = mLayers[index]->name();
+    int roles = layerRolesForName(name, mLevel);
+    if (name == mOwner->noBlendLayer())
+        roles |= NoBlendTargetRole;
+    mLayerRoles[index] = roles;
 }
 
 void CompositeLayerGroup::prepareDrawing(const MapRenderer *renderer, const QRect &rect)
@@ -190,12 +238,143 @@ void CompositeLayerGroup::prepareDrawing(const MapRenderer *renderer, const QRec
         mOwner->bmpBlender()->flush(renderer, rect, mOwner->originRecursive());
 }
 
-static QLatin1String sFloor("0_Floor"); // FIXME: thread safe?
-static QLatin1String sAboveLot("_AboveLot");
+static int floorDiv(int a, int b)
+{
+    return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
 
 bool CompositeLayerGroup::orderedCellsAt(const QPoint &pos,
                                          QVector<const Cell *> &cells,
                                          QVector<qreal> &opacities) const
+{
+    if (!isCellCacheEnabled())
+        return resolveCellsAt(pos, cells, opacities, false);
+
+    const int N = CellCacheChunkSize;
+    const int chunkX = floorDiv(pos.x(), N);
+    const int chunkY = floorDiv(pos.y(), N);
+    const CellStackChunk *chunk = cellStackChunk(chunkX, chunkY);
+    const int index = (pos.x() - chunkX * N) + (pos.y() - chunkY * N) * N;
+
+    cells.resize(0);
+    opacities.resize(0);
+    for (int i = chunk->mOffsets[index]; i < chunk->mOffsets[index + 1]; i++) {
+        cells.append(&chunk->mCells.at(i));
+        opacities.append(chunk->mOpacities.at(i));
+    }
+    return !cells.isEmpty();
+}
+
+const CompositeLayerGroup::CellStackChunk *CompositeLayerGroup::cellStackChunk(int chunkX, int chunkY) const
+{
+    const quint64 key = (quint64(quint32(chunkX)) << 32) | quint32(chunkY);
+    if (CellStackChunk *chunk = mCellCache.value(key))
+        return chunk;
+
+    if (mCellCache.size() >= MaxCachedChunks) {
+        qDeleteAll(mCellCache);
+        mCellCache.clear();
+    }
+
+    const int N = CellCacheChunkSize;
+    const QRect tileRect(chunkX * N, chunkY * N, N, N);
+
+    // prepareDrawing() only flushed the blenders inside the exposed area.
+    flushBmpBlenders(tileRect);
+
+    CellStackChunk *chunk = new CellStackChunk;
+    chunk->mOffsets.reserve(N * N + 1);
+    QVector<const Cell*> cells;
+    QVector<qreal> opacities;
+    for (int y = tileRect.top(); y <= tileRect.bottom(); y++) {
+        for (int x = tileRect.left(); x <= tileRect.right(); x++) {
+            chunk->mOffsets.append(chunk->mCells.size());
+            cells.resize(0);
+            opacities.resize(0);
+            if (!resolveCellsAt(QPoint(x, y), cells, opacities, true))
+                continue;
+            for (int i = 0; i < cells.size(); i++) {
+                chunk->mCells.append(*cells[i]);
+                chunk->mOpacities.append(opacities[i]);
+            }
+        }
+    }
+    chunk->mOffsets.append(chunk->mCells.size());
+
+    mCellCache.insert(key, chunk);
+    return chunk;
+}
+
+void CompositeLayerGroup::flushBmpBlenders(const QRect &tileRect) const
+{
+    for (const SubMapLayers &subMapLayer : mVisibleSubMapLayers) {
+        if (subMapLayer.mSubMap->isHiddenDuringDrag())
+            continue;
+        if (!subMapLayer.mBounds.intersects(tileRect))
+            continue;
+        subMapLayer.mLayerGroup->flushBmpBlenders(tileRect.translated(-subMapLayer.mSubMap->origin()));
+    }
+    if (level() == 0 && mOwner->bmpBlender())
+        mOwner->bmpBlender()->flush(tileRect);
+}
+
+bool CompositeLayerGroup::isCellCacheEnabled() const
+{
+    return !mOwner->parent() && mOwner->isCellCacheEnabled();
+}
+
+QRegion CompositeLayerGroup::layerToCacheRegion(const TileLayer *tl, const QRegion &region) const
+{
+    return region.translated(mOwner->orientAdjustTiles() * mLevel + tl->position());
+}
+
+void CompositeLayerGroup::invalidateCellCache()
+{
+    qDeleteAll(mCellCache);
+    mCellCache.clear();
+    mAllCellsChanged = true;
+    mChangedCells = QRegion();
+}
+
+void CompositeLayerGroup::invalidateCellCache(const QRegion &region)
+{
+    if (!mAllCellsChanged && isCellCacheEnabled()) {
+        mChangedCells |= region;
+        // Nobody may be taking these, so don't let the region grow forever.
+        if (mChangedCells.rectCount() > 256) {
+            mAllCellsChanged = true;
+            mChangedCells = QRegion();
+        }
+    }
+    if (mCellCache.isEmpty())
+        return;
+    const int N = CellCacheChunkSize;
+    for (const QRect &r : region.rects()) {
+        for (int chunkY = floorDiv(r.top(), N); chunkY <= floorDiv(r.bottom(), N); chunkY++) {
+            for (int chunkX = floorDiv(r.left(), N); chunkX <= floorDiv(r.right(), N); chunkX++) {
+                const quint64 key = (quint64(quint32(chunkX)) << 32) | quint32(chunkY);
+                delete mCellCache.take(key);
+            }
+        }
+    }
+}
+
+bool CompositeLayerGroup::takeChangedRegion(QRegion &region)
+{
+    bool all = mAllCellsChanged;
+    region = mChangedCells;
+    mAllCellsChanged = false;
+    mChangedCells = QRegion();
+    return all;
+}
+
+// With allSubMaps, every visible sub-map is consulted instead of only those
+// passed by prepareDrawing(), so the result doesn't depend on the area being
+// drawn.  That is what the cell cache stores.
+bool CompositeLayerGroup::resolveCellsAt(const QPoint &pos,
+                                         QVector<const Cell *> &cells,
+                                         QVector<qreal> &opacities,
+                                         bool allSubMaps) const
 {
     MapComposite *root = mOwner->rootOrAdjacent();
     if (root == mOwner)
@@ -218,6 +397,8 @@ bool CompositeLayerGroup::orderedCellsAt(const QPoint &pos,
         const QPoint subPos = pos - mOwner->orientAdjustTiles() * mLevel - tl->position();
         if (!tl->contains(subPos))
             continue;
+        const int roles = mLayerRoles[index];
+        const bool isFloor = !index && (roles & FloorRole);
         const TileLayer *tlBmpBlend = mBmpBlendLayers[index];
         const MapNoBlend *noBlend = mNoBlends[index];
 #ifdef BUILDINGED
@@ -234,8 +415,7 @@ bool CompositeLayerGroup::orderedCellsAt(const QPoint &pos,
         if (!mOwner->parent() && !mOwner->showMapTiles())
             cell = &emptyCell;
         if (mOwner->parent() != nullptr && mOwner->parent()->showLotFloorsOnly()) {
-            bool isFloor = !mLevel && !index && (tl->name() == sFloor);
-            if (!isFloor && !tl->name().contains(sAboveLot)) {
+            if (!isFloor && !(roles & AboveLotRole)) {
                 cell = &emptyCell;
             }
         }
@@ -254,14 +434,13 @@ bool CompositeLayerGroup::orderedCellsAt(const QPoint &pos,
 #endif // BUILDINGED
         if (index && suppressRgn.contains(rootPos))
             cell = &emptyCell;
-        if (!cell->isEmpty() && (root == mOwner) && tl->name().contains(sAboveLot)) {
+        if (!cell->isEmpty() && (root == mOwner) && (roles & AboveLotRole)) {
             aboveLotCells += cell;
             aboveLotOpacities += mLayerOpacity[index];
             cell = &emptyCell;
         }
         if (!cell->isEmpty()) {
             if (!cleared) {
-                bool isFloor = !mLevel && !index && (tl->name() == sFloor);
                 if (isFloor) root->mKeepFloorLayerCount = 0;
                 cells.resize(root->mKeepFloorLayerCount);
                 opacities.resize(root->mKeepFloorLayerCount);
@@ -281,9 +460,8 @@ bool CompositeLayerGroup::orderedCellsAt(const QPoint &pos,
         }
 
         // Draw the no-blend tile.
-        if (noBlend && tl->name() == mOwner->mNoBlendLayer && noBlend->get(subPos - nbPos)) {
+        if (noBlend && (roles & NoBlendTargetRole) && noBlend->get(subPos - nbPos)) {
             if (!cleared) {
-                bool isFloor = !mLevel && !index && (tl->name() == sFloor);
                 if (isFloor) root->mKeepFloorLayerCount = 0;
                 cells.resize(root->mKeepFloorLayerCount);
                 opacities.resize(root->mKeepFloorLayerCount);
@@ -300,13 +478,17 @@ bool CompositeLayerGroup::orderedCellsAt(const QPoint &pos,
     // Chop off sub-map cells that aren't in the root- or adjacent-map's bounds.
     QRect rootBounds(root->originRecursive(), root->mapInfo()->size());
     bool inRoot = (rootBounds.size() != QSize(300, 300)) || rootBounds.contains(rootPos);
-    for (const SubMapLayers& subMapLayer : mPreparedSubMapLayers) {
+    const QVector<SubMapLayers> &subMapLayers = allSubMaps ? mVisibleSubMapLayers
+                                                           : mPreparedSubMapLayers;
+    for (const SubMapLayers& subMapLayer : subMapLayers) {
+        if (allSubMaps && subMapLayer.mSubMap->isHiddenDuringDrag())
+            continue;
         if (!inRoot && !subMapLayer.mSubMap->isAdjacentMap())
             continue;
         if (!subMapLayer.mBounds.contains(pos))
             continue;
-        subMapLayer.mLayerGroup->orderedCellsAt(pos - subMapLayer.mSubMap->origin(),
-                                                cells, opacities);
+        subMapLayer.mLayerGroup->resolveCellsAt(pos - subMapLayer.mSubMap->origin(),
+                                                cells, opacities, allSubMaps);
     }
 
     cells += aboveLotCells;
@@ -344,6 +526,8 @@ bool CompositeLayerGroup::orderedCellsAt2(const QPoint &pos, QVector<const Cell
     int index = -1;
     foreach (TileLayer *tl, mLayers) {
         ++index;
+        const int roles = mLayerRoles[index];
+        const bool isFloor = !index && (roles & FloorRole);
         TileLayer *tlBmpBlend = mBmpBlendLayers[index];
         MapNoBlend *noBlend = mNoBlends[index];
 #ifdef BUILDINGED
@@ -358,7 +542,6 @@ bool CompositeLayerGroup::orderedCellsAt2(const QPoint &pos, QVector<const Cell
                         : &mOwner->roadLayer1()->cellAt(subPos);
                 if (!cell->isEmpty()) {
                     if (!cleared) {
-                        bool isFloor = !mLevel && !index && (tl->name() == sFloor);
                         if (isFloor) root->mKeepFloorLayerCount = 0;
                         cells.resize(root->mKeepFloorLayerCount);
                         cleared = true;
@@ -381,13 +564,12 @@ bool CompositeLayerGroup::orderedCellsAt2(const QPoint &pos, QVector<const Cell
                 cell = &tlBlendOver->cellAt(subPos);
             }
 #endif // BUILDINGED
-            if (!cell->isEmpty() && (root == mOwner) && tl->name().contains(sAboveLot)) {
+            if (!cell->isEmpty() && (root == mOwner) && (roles & AboveLotRole)) {
                 aboveLotCells += cell;
                 continue;
             }
             if (!cell->isEmpty()) {
                 if (!cleared) {
-                    bool isFloor = !mLevel && !index && (tl->name() == sFloor);
                     if (isFloor) root->mKeepFloorLayerCount = 0;
                     cells.resize(root->mKeepFloorLayerCount);
                     cleared = true;
@@ -444,6 +626,8 @@ bool CompositeLayerGroup::isLayerEmpty(int index) const
 
 void CompositeLayerGroup::synch()
 {
+    mOwner->invalidateCellCache();
+
     mMaxFloorLayer = -1;
     if (!mVisible) {
         mAnyVisibleLayers = false;
@@ -543,7 +727,7 @@ void CompositeLayerGroup::synch()
         }
         if (!mLevel && (!mOwner->parent() || mOwner->isAdjacentMap()) &&
                 (index == mMaxFloorLayer + 1) &&
-                tl->name().startsWith(QLatin1String("0_Floor")))
+                (mLayerRoles[index] & AnyFloorRole))
             mMaxFloorLayer = index;
         ++index;
     }
@@ -588,6 +772,7 @@ void CompositeLayerGroup::saveVisibility()
 void CompositeLayerGroup::restoreVisibility()
 {
     mVisibleLayers = mSavedVisibleLayers;
+    mOwner->invalidateCellCache();
 }
 
 void CompositeLayerGroup::saveOpacity()
@@ -598,6 +783,7 @@ void CompositeLayerGroup::saveOpacity()
 void CompositeLayerGroup::restoreOpacity()
 {
     mLayerOpacity = mSavedOpacity;
+    mOwner->invalidateCellCache();
 }
 
 bool CompositeLayerGroup::setBmpBlendLayers(const QList<TileLayer *> &layers)
@@ -615,7 +801,10 @@ bool CompositeLayerGroup::setBmpBlendLayers(const QList<TileLayer *> &layers)
         }
     }
 
-    return old != mBmpBlendLayers;
+    if (old == mBmpBlendLayers)
+        return false;
+    mOwner->invalidateCellCache();
+    return true;
 }
 
 #ifdef BUILDINGED
@@ -635,10 +824,52 @@ bool CompositeLayerGroup::setLayerNonEmpty(TileLayer *tl, bool force)
     Q_ASSERT(index != -1);
     if (force != mForceNonEmpty[index]) {
         mForceNonEmpty[index] = force;
-        mNeedsSynch = true;
+        setNeedsSynch(true);
     }
     return mNeedsSynch;
 }
+
+void CompositeLayerGroup::setToolTiles(const TileLayer *stamp,
+                                       const QPoint &pos, const QRegion &rgn,
+                                       TileLayer *layer)
+{
+    int index = mLayers.indexOf(layer);
+    if (isCellCacheEnabled())
+        invalidateCellCache(layerToCacheRegion(layer, mToolLayers[index].mRegion | rgn));
+    mToolLayers[index].mLayer = stamp;
+    mToolLayers[index].mPos = pos;
+    mToolLayers[index].mRegion = rgn;
+}
+
+void CompositeLayerGroup::clearToolTiles()
+{
+    if (isCellCacheEnabled()) {
+        for (int i = 0; i < mLayers.size(); i++)
+            invalidateCellCache(layerToCacheRegion(mLayers[i], mToolLayers[i].mRegion));
+    }
+    mToolLayers.fill(ToolLayer());
+}
+
+void CompositeLayerGroup::setToolNoBlend(const MapNoBlend &noBlend,
+                                         const QPoint &pos, const QRegion &rgn,
+                                         TileLayer *layer)
+{
+    int index = mLayers.indexOf(layer);
+    if (isCellCacheEnabled())
+        invalidateCellCache(layerToCacheRegion(layer, mToolNoBlends[index].mRegion | rgn));
+    mToolNoBlends[index].mNoBlend = noBlend;
+    mToolNoBlends[index].mPos = pos;
+    mToolNoBlends[index].mRegion = rgn;
+}
+
+void CompositeLayerGroup::clearToolNoBlends()
+{
+    if (isCellCacheEnabled()) {
+        for (int i = 0; i < mLayers.size(); i++)
+            invalidateCellCache(layerToCacheRegion(mLayers[i], mToolNoBlends[i].mRegion));
+    }
+    mToolNoBlends.fill(ToolNoBlend());
+}
 #endif // BUILDINGED
 
 QRect CompositeLayerGroup::bounds() const
@@ -669,7 +900,8 @@ bool CompositeLayerGroup::setLayerVisibility(TileLayer *tl, bool visible)
     Q_ASSERT(index != -1);
     if (visible != mVisibleLayers[index]) {
         mVisibleLayers[index] = visible;
-        mNeedsSynch = true;
+        setNeedsSynch(true);
+        mOwner->invalidateCellCache();
     }
     return mNeedsSynch;
 }
@@ -696,6 +928,10 @@ void CompositeLayerGroup::layerRenamed(TileLayer *layer)
 
     const QString name = MapComposite::layerNameWithoutPrefix(layer);
     mLayersByName[name].append(layer);
+
+    updateLayerRoles(mLayers.indexOf(layer));
+
+    mOwner->invalidateCellCache();
 }
 
 bool CompositeLayerGroup::setLayerOpacity(const QString &layerName, qreal opacity)
@@ -717,6 +953,7 @@ bool CompositeLayerGroup::setLayerOpacity(TileLayer *tl, qreal opacity)
     Q_ASSERT(index != -1);
     if (mLayerOpacity[index] != opacity) {
         mLayerOpacity[index] = opacity;
+        mOwner->invalidateCellCache();
         return true;
     }
     return false;
@@ -734,8 +971,10 @@ void CompositeLayerGroup::synchSubMapLayerOpacity(const QString &layerName, qrea
     }
 }
 
-bool CompositeLayerGroup::regionAltered(Tiled::TileLayer *tl)
+bool CompositeLayerGroup::regionAltered(Tiled::TileLayer *tl, const QRegion &region)
 {
+    invalidateCellCache(layerToCacheRegion(tl, region));
+
     QMargins m;
     maxMargins(mDrawMargins, tl->drawMargins(), m);
     if (m != mDrawMargins) {
@@ -813,6 +1052,7 @@ MapComposite::MapComposite(MapInfo *mapInfo, Map::Orientation orientRender,
     , mShowBMPTiles(true)
     , mShowMapTiles(true)
     , mIsAdjacentMap(false)
+    , mCellCacheEnabled(false)
     , mBmpBlender(new Tiled::Internal::BmpBlender(mMap, this))
     , mSuppressLevel(0)
 {
@@ -841,7 +1081,7 @@ MapComposite::MapComposite(MapInfo *mapInfo, Map::Orientation orientRender,
                     mLayerGroups[level] = new CompositeLayerGroup(this, level);
                 mLayerGroups[level]->addTileLayer(tl, index);
                 if (!mapInfo->isBeingEdited())
-                    mLayerGroups[level]->setLayerVisibility(tl, !layer->name().contains(QLatin1String("NoRender")));
+                    mLayerGroups[level]->setLayerVisibility(tl, !mLayerGroups[level]->layerHasRole(tl, CompositeLayerGroup::NoRenderRole));
             }
         }
         ++index;
@@ -1149,6 +1389,7 @@ QList<MapComposite *> MapComposite::maps()
 void MapComposite::setOrigin(const QPoint &origin)
 {
     mPos = origin;
+    invalidateCellCache();
 }
 
 QPoint MapComposite::originRecursive() const
@@ -1496,7 +1737,7 @@ void MapComposite::recreate()
                     mLayerGroups[level] = new CompositeLayerGroup(this, level);
                 mLayerGroups[level]->addTileLayer(tl, index);
                 if (!mMapInfo->isBeingEdited())
-                    mLayerGroups[level]->setLayerVisibility(tl, !layer->name().contains(QLatin1String("NoRender")));
+                    mLayerGroups[level]->setLayerVisibility(tl, !mLayerGroups[level]->layerHasRole(tl, CompositeLayerGroup::NoRenderRole));
             }
         }
         ++index;
@@ -1653,9 +1894,51 @@ void MapComposite::mapFailedToLoad(MapInfo *mapInfo)
     }
 }
 
+void MapComposite::setNoBlendLayer(const QString &layerName)
+{
+    if (layerName == mNoBlendLayer)
+        return;
+    mNoBlendLayer = layerName;
+    foreach (CompositeLayerGroup *layerGroup, mLayerGroups)
+        layerGroup->updateLayerRoles();
+    invalidateCellCache();
+}
+
 void MapComposite::setSuppressRegion(const QRegion &rgn, int level)
 {
+    if (rgn != mSuppressRgn || level != mSuppressLevel)
+        invalidateCellCache();
     mSuppressRgn = rgn;
     mSuppressLevel = level;
 }
 
+void MapComposite::setCellCacheEnabled(bool enabled)
+{
+    if (enabled == mCellCacheEnabled)
+        return;
+    mCellCacheEnabled = enabled;
+    if (!enabled) {
+        foreach (CompositeLayerGroup *layerGroup, mLayerGroups)
+            layerGroup->invalidateCellCache();
+    }
+}
+
+void MapComposite::invalidateCellCache()
+{
+    MapComposite *root = this->root();
+    if (!root->mCellCacheEnabled)
+        return;
+    foreach (CompositeLayerGroup *layerGroup, root->mLayerGroups)
+        layerGroup->invalidateCellCache();
+}
+
+void MapComposite::invalidateCellCache(const QRegion &region)
+{
+    MapComposite *root = this->root();
+    if (!root->mCellCacheEnabled)
+        return;
+    const QRegion rootRgn = region.translated(originRecursive() - root->originRecursive());
+    foreach (CompositeLayerGroup *layerGroup, root->mLayerGroups)
+        layerGroup->invalidateCellCache(rootRgn.translated(root->orientAdjustTiles() * layerGroup->level()));
+}
+
@@ -25,6 +25,7 @@
 #endif
 #include "ztilelayergroup.h"
 
+#include <QHash>
 #include <QObject>
 #include <QMap>
 #include <QString>
@@ -46,6 +47,7 @@ class CompositeLayerGroup : public Tiled::ZTileLayerGroup
 {
 public:
     CompositeLayerGroup(MapComposite *owner, int level);
+    ~CompositeLayerGroup();
 
     void addTileLayer(Tiled::TileLayer *layer, int index);
     void removeTileLayer(Tiled::TileLayer *layer);
@@ -73,11 +75,45 @@ public:
 
     MapComposite *owner() const { return mOwner; }
 
-    bool regionAltered(Tiled::TileLayer *tl);
+    bool regionAltered(Tiled::TileLayer *tl, const QRegion &region);
 
-    void setNeedsSynch(bool synch) { mNeedsSynch = synch; }
+    void setNeedsSynch(bool synch)
+    {
+        mNeedsSynch = synch;
+        if (synch)
+            invalidateCellCache();
+    }
     bool needsSynch() const { return mNeedsSynch; }
     bool isLayerEmpty(int index) const;
+
+    /**
+      * Roles of a layer that would otherwise be found by matching its name
+      * against "0_Floor", "_AboveLot", "NoRender" and the no-blend layer.
+      * They are updated when a layer is added or renamed, so per-cell code
+      * can test bits instead of strings.
+      */
+    enum LayerRole
+    {
+        FloorRole = 0x01,           // 0_Floor
+        AboveLotRole = 0x02,        // *_AboveLot
+        NoRenderRole = 0x04,        // *NoRender*
+        NoBlendTargetRole = 0x08,   // MapComposite::noBlendLayer()
+        AnyFloorRole = 0x10         // 0_Floor*
+    };
+
+    /**
+      * The roles that follow from a layer's name alone, for a layer in the
+      * given level.  Pass a level of -1 for layers that aren't in a group.
+      */
+    static int layerRolesForName(const QString &name, int level);
+
+    int layerRoles(int index) const
+    { return mLayerRoles[index]; }
+    bool layerHasRole(int index, LayerRole role) const
+    { return (mLayerRoles[index] & role) != 0; }
+    bool layerHasRole(Tiled::TileLayer *tl, LayerRole role) const
+    { return layerHasRole(mLayers.indexOf(tl), role); }
+    void updateLayerRoles();
     void synch();
 
     void saveVisibility();
@@ -89,41 +125,62 @@ public:
     const QVector<Tiled::TileLayer*> &bmpBlendLayers() const
     { return mBmpBlendLayers; }
 
+    /**
+      * When MapComposite::setCellCacheEnabled() is on, the root map keeps
+      * the result of orderedCellsAt() for each cell in chunks.  The region
+      * is in the same coordinates as the point passed to orderedCellsAt().
+      */
+    void invalidateCellCache();
+    void invalidateCellCache(const QRegion &region);
+
+    /**
+      * Returns the cells whose stack changed since the last call, in the
+      * same coordinates as invalidateCellCache().  Returns true if
+      * everything may have changed.  Only tracked while the cell cache is
+      * enabled; used by caches of rendered output.
+      */
+    bool takeChangedRegion(QRegion &region);
+
 #ifdef BUILDINGED
     void setToolTiles(const Tiled::TileLayer *stamp,
                       const QPoint &pos, const QRegion &rgn,
-                      Tiled::TileLayer *layer)
-    {
-        int index = mLayers.indexOf(layer);
-        mToolLayers[index].mLayer = stamp;
-        mToolLayers[index].mPos = pos;
-        mToolLayers[index].mRegion = rgn;
-    }
-
-    void clearToolTiles()
-    { mToolLayers.fill(ToolLayer()); }
+                      Tiled::TileLayer *layer);
+    void clearToolTiles();
 
     void setToolNoBlend(const Tiled::MapNoBlend &noBlend,
                         const QPoint &pos, const QRegion &rgn,
-                        Tiled::TileLayer *layer)
-    {
-        int index = mLayers.indexOf(layer);
-        mToolNoBlends[index].mNoBlend = noBlend;
-        mToolNoBlends[index].mPos = pos;
-        mToolNoBlends[index].mRegion = rgn;
-    }
-
-    void clearToolNoBlends()
-    { mToolNoBlends.fill(ToolNoBlend()); }
+                        Tiled::TileLayer *layer);
+    void clearToolNoBlends();
 
     bool setLayerNonEmpty(const QString &layerName, bool force);
     bool setLayerNonEmpty(Tiled::TileLayer *tl, bool force);
 
     void setHighlightLayer(const QString &layerName)
-    { mHighlightLayer = layerName; }
+    { mHighlightLayer = layerName; invalidateCellCache(); }
 #endif
 
 private:
+    bool resolveCellsAt(const QPoint &pos, QVector<const Tiled::Cell*>& cells,
+                        QVector<qreal> &opacities, bool allSubMaps) const;
+    void flushBmpBlenders(const QRect &tileRect) const;
+    bool isCellCacheEnabled() const;
+    QRegion layerToCacheRegion(const Tiled::TileLayer *tl, const QRegion &region) const;
+    void updateLayerRoles(int index);
+
+    // The flattened cell stacks for CellCacheChunkSize^2 cells.  The stack
+    // of cell N is mCells[mOffsets[N]] up to mCells[mOffsets[N+1]].
+    enum { CellCacheChunkSize = 16, MaxCachedChunks = 4096 };
+    struct CellStackChunk
+    {
+        QVector<int> mOffsets;
+        QVector<Tiled::Cell> mCells;
+        QVector<qreal> mOpacities;
+    };
+    const CellStackChunk *cellStackChunk(int chunkX, int chunkY) const;
+    mutable QHash<quint64,CellStackChunk*> mCellCache;
+    bool mAllCellsChanged;
+    QRegion mChangedCells;
+
     MapComposite *mOwner;
     bool mAnyVisibleLayers;
     bool mNeedsSynch;
@@ -133,6 +190,7 @@ private:
     QVector<bool> mVisibleLayers;
     QVector<bool> mEmptyLayers;
     QVector<qreal> mLayerOpacity;
+    QVector<int> mLayerRoles;
     int mMaxFloorLayer;
     QMap<QString,QVector<Tiled::Layer*> > mLayersByName;
     QVector<bool> mSavedVisibleLayers;
@@ -232,10 +290,10 @@ public:
     void setLevel(int level) { mLevelOffset = level; }
     int levelOffset() const { return mLevelOffset; }
 
-    void setVisible(bool visible) { mVisible = visible; }
+    void setVisible(bool visible) { mVisible = visible; invalidateCellCache(); }
     bool isVisible() const { return mVisible; }
 
-    void setGroupVisible(bool visible) { mGroupVisible = visible; }
+    void setGroupVisible(bool visible) { mGroupVisible = visible; invalidateCellCache(); }
     bool isGroupVisible() const { return mGroupVisible; }
 
     int maxLevel() const { return mMaxLevel; }
@@ -249,7 +307,7 @@ public:
       * want to affect the scene bounds, so instead of calling setVisible(false)
       * I call this.
       */
-    void setHiddenDuringDrag(bool hidden) { mHiddenDuringDrag = hidden; }
+    void setHiddenDuringDrag(bool hidden) { mHiddenDuringDrag = hidden; invalidateCellCache(); }
     bool isHiddenDuringDrag() const { return mHiddenDuringDrag; }
 
     QRectF boundingRect(Tiled::MapRenderer *renderer, bool forceMapBounds = true) const;
@@ -267,12 +325,15 @@ public:
     struct ZOrderItem
     {
         ZOrderItem(CompositeLayerGroup *group)
-            : layer(nullptr), layerIndex(-1), group(group) {}
+            : layer(nullptr), layerIndex(-1), group(group), roles(0) {}
         ZOrderItem(Tiled::Layer *layer, int layerIndex)
-            : layer(layer), layerIndex(layerIndex), group(nullptr) {}
+            : layer(layer), layerIndex(layerIndex), group(nullptr),
+              roles(CompositeLayerGroup::layerRolesForName(layer->name(), -1)) {}
         Tiled::Layer *layer;
         int layerIndex;
         CompositeLayerGroup *group;
+        int roles; // CompositeLayerGroup::LayerRole flags of a layer
+                   // that isn't in a group
     };
     typedef QList<ZOrderItem> ZOrderList;
     ZOrderList zOrder();
@@ -291,22 +352,21 @@ public:
     { return mBmpBlender; }
 
     void setShowBMPTiles(bool show)
-    { mShowBMPTiles = show; }
+    { mShowBMPTiles = show; invalidateCellCache(); }
     bool showBMPTiles() const
     { return mShowBMPTiles; }
 
     void setShowLotFloorsOnly(bool show)
-    { mShowLotFloorsOnly = show; }
+    { mShowLotFloorsOnly = show; invalidateCellCache(); }
     bool showLotFloorsOnly() const
     { return mShowLotFloorsOnly; }
 
     void setShowMapTiles(bool show)
-    { mShowMapTiles = show; }
+    { mShowMapTiles = show; invalidateCellCache(); }
     bool showMapTiles() const
     { return mShowMapTiles; }
 
-    void setNoBlendLayer(const QString &layerName)
-    { mNoBlendLayer = layerName; }
+    void setNoBlendLayer(const QString &layerName);
     QString noBlendLayer() const
     { return mNoBlendLayer; }
 
@@ -325,6 +385,21 @@ public:
 
     bool waitingForMapsToLoad() const;
 
+    /**
+      * Turns on caching of the resolved cell stacks of each level of this
+      * (root) map.  Only do this for a map whose changes all go through
+      * CompositeLayerGroup::regionAltered(), synch() and the setters here,
+      * as in the map editor's scene.
+      */
+    void setCellCacheEnabled(bool enabled);
+    bool isCellCacheEnabled() const
+    { return mCellCacheEnabled; }
+
+    // These invalidate the cache of the root map.  The region is in the
+    // tile coordinates of this map's layers.
+    void invalidateCellCache();
+    void invalidateCellCache(const QRegion &region);
+
     void setSuppressRegion(const QRegion &rgn, int level);
     QRegion suppressRegion() const
     { return mSuppressRgn; }
@@ -379,6 +454,7 @@ private:
     bool mSavedShowBMPTiles;
     bool mSavedShowMapTiles;
     bool mIsAdjacentMap;
+    bool mCellCacheEnabled;
 
     Tiled::Internal::BmpBlender *mBmpBlender;
 
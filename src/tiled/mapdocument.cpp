@@ -969,7 +969,7 @@ void MapDocument::bmpBlenderRegionAltered(const QRegion &region)
         if (index == -1)
             continue;
         TileLayer *tl = map()->layerAt(index)->asTileLayer();
-        mapComposite()->tileLayersForLevel(0)->regionAltered(tl);
+        mapComposite()->tileLayersForLevel(0)->regionAltered(tl, region);
         emit regionAltered(region, tl); // infinite loop with emitRegionAltered()
         break; // this should redraw the whole layergroup anyway
     }
@@ -1128,6 +1128,9 @@ void MapDocument::setTilesetFileName(Tileset *tileset,
                                      const QString &fileName)
 {
     tileset->setFileName(fileName);
+#ifdef ZOMBOID
+    TilesetManager::instance()->tilesetFileNameChanged(tileset);
+#endif
     emit tilesetFileNameChanged(tileset);
 }
 
@@ -56,37 +56,43 @@ MapImageManager *MapImageManager::mInstance = NULL;
 
 MapImageManager::MapImageManager() :
     QObject(),
-    mExpectMapImage(0),
-    mRenderMapComposite(0),
     mDeferralDepth(0),
     mDeferralQueued(false)
 {
-    mImageReaderThreads.resize(4);
+    mImageReaderThreads.resize(qMax(2, QThread::idealThreadCount()));
     mImageReaderWorkers.resize(mImageReaderThreads.size());
-    mNextThreadForJob = 0;
     for (int i = 0; i < mImageReaderWorkers.size(); i++) {
         mImageReaderThreads[i] = new InterruptibleThread;
-        mImageReaderWorkers[i] = new MapImageReaderWorker(mImageReaderThreads[i]);
+        mImageReaderWorkers[i] = new MapImageReaderWorker(mImageReaderThreads[i],
+                                                          &mImageReaderJobs);
         mImageReaderWorkers[i]->moveToThread(mImageReaderThreads[i]);
         connect(mImageReaderWorkers[i], SIGNAL(imageLoaded(QImage*,MapImage*)),
                 SLOT(imageLoadedByThread(QImage*,MapImage*)));
         mImageReaderThreads[i]->start();
     }
 
-    mImageRenderThread = new InterruptibleThread;
-    mImageRenderWorker = new MapImageRenderWorker(mImageRenderThread);
-    mImageRenderWorker->moveToThread(mImageRenderThread);
-    connect(mImageRenderWorker, SIGNAL(mapNeeded(MapImage*)),
-            SLOT(renderThreadNeedsMap(MapImage*)));
     qRegisterMetaType<MapImageData>("MapImageData");
     qRegisterMetaType<MapImage*>("MapImage*");
     qRegisterMetaType<MapComposite*>("MapComposite*");
-    connect(mImageRenderWorker,
-            SIGNAL(imageRendered(MapImageData,MapImage*)),
-            SLOT(imageRenderedByThread(MapImageData,MapImage*)));
-    connect(mImageRenderWorker, SIGNAL(jobDone(MapComposite*)),
-            SLOT(renderJobDone(MapComposite*)));
-    mImageRenderThread->start();
+
+    // Each render thread paints a different map, so as many maps as there
+    // are cores can be rendered at once.
+    mRenderThreads.resize(qMax(1, QThread::idealThreadCount()));
+    mNextRenderThreadForJob = 0;
+    for (int i = 0; i < mRenderThreads.size(); i++) {
+        RenderThread &rt = mRenderThreads[i];
+        rt.thread = new InterruptibleThread;
+        rt.worker = new MapImageRenderWorker(rt.thread);
+        rt.worker->moveToThread(rt.thread);
+        connect(rt.worker, SIGNAL(mapNeeded(MapImage*)),
+                SLOT(renderThreadNeedsMap(MapImage*)));
+        connect(rt.worker,
+                SIGNAL(imageRendered(MapImageData,MapImage*)),
+                SLOT(imageRenderedByThread(MapImageData,MapImage*)));
+        connect(rt.worker, SIGNAL(jobDone(MapComposite*)),
+                SLOT(renderJobDone(MapComposite*)));
+        rt.thread->start();
+    }
 
     connect(MapManager::instance(), SIGNAL(mapAboutToChange(MapInfo*)),
             SLOT(mapAboutToChange(MapInfo*)));
@@ -110,11 +116,13 @@ MapImageManager::~MapImageManager()
         delete mImageReaderThreads[i];
     }
 
-    mImageRenderThread->interrupt();
-    mImageRenderThread->quit();
-    mImageRenderThread->wait();
-    delete mImageRenderWorker;
-    delete mImageRenderThread;
+    for (int i = 0; i < mRenderThreads.size(); i++) {
+        mRenderThreads[i].thread->interrupt();
+        mRenderThreads[i].thread->quit();
+        mRenderThreads[i].thread->wait();
+        delete mRenderThreads[i].worker;
+        delete mRenderThreads[i].thread;
+    }
 }
 
 MapImageManager *MapImageManager::instance()
@@ -183,17 +191,11 @@ MapImage *MapImageManager::getMapImage(const QString &mapName, const QString &re
     if (data.threadLoad || data.threadRender) {
         if (data.threadLoad) {
             QString imageFileName = imageFileInfo(mapFilePath).canonicalFilePath();
-            QMetaObject::invokeMethod(mImageReaderWorkers[mNextThreadForJob],
-                                      "addJob", Qt::QueuedConnection,
-                                      Q_ARG(QString,imageFileName),
-                                      Q_ARG(MapImage*,mapImage));
-            mNextThreadForJob = (mNextThreadForJob + 1) % mImageReaderWorkers.size();
-        }
-        if (data.threadRender) {
-            QMetaObject::invokeMethod(mImageRenderWorker,
-                                      "addJob", Qt::QueuedConnection,
-                                      Q_ARG(MapImage*,mapImage));
+            mImageReaderJobs.add(MapImageReaderWorker::Job(imageFileName, mapImage));
+            wakeWorkers(mImageReaderWorkers);
         }
+        if (data.threadRender)
+            addRenderJob(mapImage);
     }
 
     // Set up file modification tracking on each TMX that makes
@@ -480,34 +482,38 @@ void MapImageManager::writeImageData(const QFileInfo &imageDataFileInfo, const M
 
 void MapImageManager::mapAboutToChange(MapInfo *mapInfo)
 {
-    if (!mRenderMapComposite)
-        return;
-    // Caution: mRenderMapComposite is being used right now by the render thread.
-    foreach (MapComposite *mc, mRenderMapComposite->maps()) {
-        if (mc->mapInfo() == mapInfo) {
-            mImageRenderThread->interrupt(true);
-            MapImage *mapImage = mMapImages[mRenderMapComposite->mapInfo()->path()];
-            Q_ASSERT(mapImage);
-            mapImage->mLoaded = false;
-            break;
+    for (RenderThread &rt : mRenderThreads) {
+        if (!rt.mapComposite)
+            continue;
+        // Caution: rt.mapComposite is being used right now by the render thread.
+        foreach (MapComposite *mc, rt.mapComposite->maps()) {
+            if (mc->mapInfo() == mapInfo) {
+                rt.thread->interrupt(true);
+                MapImage *mapImage = mMapImages[rt.mapComposite->mapInfo()->path()];
+                Q_ASSERT(mapImage);
+                mapImage->mLoaded = false;
+                break;
+            }
         }
     }
 }
 
 void MapImageManager::mapChanged(MapInfo *mapInfo)
 {
-    if (!mRenderMapComposite)
-        return;
-    // Caution: mRenderMapComposite is being used right now by the render thread.
-    foreach (MapComposite *mc, mRenderMapComposite->maps()) {
-        if (mc->mapInfo() == mapInfo) {
-            MapImage *mapImage = mMapImages[mRenderMapComposite->mapInfo()->path()];
-            Q_ASSERT(mapImage);
-            mImageRenderThread->resume();
-            QMetaObject::invokeMethod(mImageRenderWorker,
-                                      "resume", Qt::QueuedConnection,
-                                      Q_ARG(MapImage*,mapImage));
-            break;
+    for (RenderThread &rt : mRenderThreads) {
+        if (!rt.mapComposite)
+            continue;
+        // Caution: rt.mapComposite is being used right now by the render thread.
+        foreach (MapComposite *mc, rt.mapComposite->maps()) {
+            if (mc->mapInfo() == mapInfo) {
+                MapImage *mapImage = mMapImages[rt.mapComposite->mapInfo()->path()];
+                Q_ASSERT(mapImage);
+                rt.thread->resume();
+                QMetaObject::invokeMethod(rt.worker,
+                                          "resume", Qt::QueuedConnection,
+                                          Q_ARG(MapImage*,mapImage));
+                break;
+            }
         }
     }
 }
@@ -533,9 +539,7 @@ void MapImageManager::mapFileChanged(MapInfo *mapInfo)
                 mapImage->mSources.clear();
                 mapImage->mSources += mapImage->mapInfo();
                 mapImage->mLoaded = false;
-                QMetaObject::invokeMethod(mImageRenderWorker,
-                                          "addJob", Qt::QueuedConnection,
-                                          Q_ARG(MapImage*,mapImage));
+                addRenderJob(mapImage);
                 emit mapImageChanged(mapImage);
             }
         }
@@ -556,26 +560,31 @@ void MapImageManager::imageLoadedByThread(QImage *image, MapImage *mapImage)
 
 void MapImageManager::renderThreadNeedsMap(MapImage *mapImage)
 {
+    RenderThread *rt = renderThreadFor(sender());
+    Q_ASSERT(rt);
+    if (!rt)
+        return;
+
     bool asynch = true;
-    Q_ASSERT(mExpectMapImage == 0);
+    Q_ASSERT(rt->expectMapImage == 0);
     MapInfo *mapInfo = MapManager::instance()->loadMap(mapImage->mapInfo()->path(),
                                                        QString(), asynch,
                                                        MapManager::PriorityLow);
     if (!mapInfo) {
         // The map file went away since MapImage's MapInfo was created.
-        QMetaObject::invokeMethod(mImageRenderWorker,
+        QMetaObject::invokeMethod(rt->worker,
                                   "mapFailedToLoad", Qt::QueuedConnection);
         emit mapImageFailedToLoad(mapImage);
         return;
     }
-    mExpectMapImage = mapImage;
-    mExpectSubMaps.clear();
+    rt->expectMapImage = mapImage;
+    rt->expectSubMaps.clear();
 #ifdef WORLDED
-    mReferencedMaps.clear();
+    rt->referencedMaps.clear();
 #endif
     Q_ASSERT(mapInfo == mapImage->mapInfo());
     if (!mapInfo->isLoading())
-        mapLoaded(mapInfo);
+        mapLoaded(*rt, mapInfo);
 }
 
 void MapImageManager::imageRenderedByThread(MapImageData imgData, MapImage *mapImage)
@@ -614,11 +623,30 @@ void MapImageManager::imageRenderedByThread(MapImageData imgData, MapImage *mapI
 
 void MapImageManager::renderJobDone(MapComposite *mapComposite)
 {
-    Q_ASSERT(mapComposite == mRenderMapComposite);
-    mRenderMapComposite = 0;
+    RenderThread *rt = renderThreadFor(sender());
+    Q_ASSERT(rt && mapComposite == rt->mapComposite);
+    if (rt)
+        rt->mapComposite = 0;
     delete mapComposite;
 }
 
+void MapImageManager::addRenderJob(MapImage *mapImage)
+{
+    QMetaObject::invokeMethod(mRenderThreads[mNextRenderThreadForJob].worker,
+                              "addJob", Qt::QueuedConnection,
+                              Q_ARG(MapImage*,mapImage));
+    mNextRenderThreadForJob = (mNextRenderThreadForJob + 1) % mRenderThreads.size();
+}
+
+MapImageManager::RenderThread *MapImageManager::renderThreadFor(QObject *worker)
+{
+    for (RenderThread &rt : mRenderThreads) {
+        if (rt.worker == worker)
+            return &rt;
+    }
+    return 0;
+}
+
 #include "mapobject.h"
 QStringList getSubMapFileNames(const MapInfo *mapInfo)
 {
@@ -638,72 +666,78 @@ QStringList getSubMapFileNames(const MapInfo *mapInfo)
 
 void MapImageManager::mapLoaded(MapInfo *mapInfo)
 {
-    if (!mExpectMapImage)
+    for (RenderThread &rt : mRenderThreads)
+        mapLoaded(rt, mapInfo);
+}
+
+void MapImageManager::mapLoaded(RenderThread &rt, MapInfo *mapInfo)
+{
+    if (!rt.expectMapImage)
         return;
 
-    if (mExpectMapImage->mapInfo() == mapInfo) {
+    if (rt.expectMapImage->mapInfo() == mapInfo) {
 #ifdef WORLDED
-        MapManager::instance()->addReferenceToMap(mapInfo), mReferencedMaps += mapInfo;
+        MapManager::instance()->addReferenceToMap(mapInfo), rt.referencedMaps += mapInfo;
 #endif
         foreach (const QString &path, getSubMapFileNames(mapInfo)) {
             bool async = true;
             if (MapInfo *subMapInfo = MapManager::instance()->loadMap(path, QString(), async,
                                                                       MapManager::PriorityLow)) {
-                if (!mExpectSubMaps.contains(subMapInfo)) {
+                if (!rt.expectSubMaps.contains(subMapInfo)) {
                     if (subMapInfo->isLoading())
-                        mExpectSubMaps += subMapInfo;
+                        rt.expectSubMaps += subMapInfo;
 #ifdef WORLDED
                     else
-                        MapManager::instance()->addReferenceToMap(subMapInfo), mReferencedMaps += subMapInfo;
+                        MapManager::instance()->addReferenceToMap(subMapInfo), rt.referencedMaps += subMapInfo;
 #endif
                 }
             }
         }
-    } else if (mExpectSubMaps.contains(mapInfo)) {
+    } else if (rt.expectSubMaps.contains(mapInfo)) {
 #ifdef WORLDED
-        MapManager::instance()->addReferenceToMap(mapInfo), mReferencedMaps += mapInfo;
+        MapManager::instance()->addReferenceToMap(mapInfo), rt.referencedMaps += mapInfo;
 #endif
-        mExpectSubMaps.removeAll(mapInfo);
+        rt.expectSubMaps.removeAll(mapInfo);
         foreach (const QString &path, getSubMapFileNames(mapInfo)) {
             bool async = true;
             if (MapInfo *subMapInfo = MapManager::instance()->loadMap(
                         path, QString(), async, MapManager::PriorityLow)) {
-                if (!mExpectSubMaps.contains(subMapInfo)) {
+                if (!rt.expectSubMaps.contains(subMapInfo)) {
                     if (subMapInfo->isLoading())
-                        mExpectSubMaps += subMapInfo;
+                        rt.expectSubMaps += subMapInfo;
 #ifdef WORLDED
                     else
-                        MapManager::instance()->addReferenceToMap(subMapInfo), mReferencedMaps += subMapInfo;
+                        MapManager::instance()->addReferenceToMap(subMapInfo), rt.referencedMaps += subMapInfo;
 #endif
                 }
             }
         }
-        mapInfo = mExpectMapImage->mapInfo();
+        mapInfo = rt.expectMapImage->mapInfo();
     } else {
         return;
     }
 
-    if (mExpectSubMaps.size())
+    if (rt.expectSubMaps.size())
         return;
 
-    mExpectMapImage = 0;
+    rt.expectMapImage = 0;
 
-    mRenderMapComposite = new MapComposite(mapInfo);
-    Q_ASSERT(mRenderMapComposite->waitingForMapsToLoad() == false);
+    rt.mapComposite = new MapComposite(mapInfo);
+    Q_ASSERT(rt.mapComposite->waitingForMapsToLoad() == false);
 #ifdef WORLDED
     // Now that mapComposite is referencing the maps...
-    foreach (MapInfo *mapInfo, mReferencedMaps)
+    foreach (MapInfo *mapInfo, rt.referencedMaps)
         MapManager::instance()->removeReferenceToMap(mapInfo);
 #endif
     // Wait for TilesetManager's threads to finish loading the tilesets.
     // FIXME: this shouldn't block the gui.
 #if 1
-    QList<Tileset*> usedTilesets = mRenderMapComposite->usedTilesets();
+    QList<Tileset*> usedTilesets = rt.mapComposite->usedTilesets();
     usedTilesets.removeAll(TilesetManager::instance()->missingTileset());
     TilesetManager::instance()->waitForTilesets(usedTilesets);
 #else
     QSet<Tileset*> usedTilesets;
-    foreach (MapComposite *mc, mRenderMapComposite->maps())
+    foreach (MapComposite *mc, rt.mapComposite->maps())
         usedTilesets += mc->map()->usedTilesets();
     usedTilesets.remove(TilesetManager::instance()->missingTileset());
     TilesetManager::instance()->waitForTilesets(usedTilesets.toList());
@@ -711,36 +745,38 @@ void MapImageManager::mapLoaded(MapInfo *mapInfo)
 
     // BmpBlender sends a signal to the MapComposite when it has finished
     // blending.  That needs to happen in the render thread.
-    Q_ASSERT(mRenderMapComposite->bmpBlender()->parent() == mRenderMapComposite);
-    mRenderMapComposite->moveToThread(mImageRenderThread);
+    Q_ASSERT(rt.mapComposite->bmpBlender()->parent() == rt.mapComposite);
+    rt.mapComposite->moveToThread(rt.thread);
 
-    QMetaObject::invokeMethod(mImageRenderWorker,
+    QMetaObject::invokeMethod(rt.worker,
                               "mapLoaded", Qt::QueuedConnection,
-                              Q_ARG(MapComposite*,mRenderMapComposite));
+                              Q_ARG(MapComposite*,rt.mapComposite));
 }
 
 void MapImageManager::mapFailedToLoad(MapInfo *mapInfo)
 {
-    // Failing to load a submap of the one we want to paint doesn't stop us
-    // creating the map image.
-    if (mExpectSubMaps.contains(mapInfo))
-        mExpectSubMaps.removeAll(mapInfo);
-
-    // The render thread was waiting for a map to load, but that failed.
-    // Tell the render thread to continue on with the next job.
-    if (mExpectMapImage && (mapInfo == mExpectMapImage->mapInfo())) {
+    for (RenderThread &rt : mRenderThreads) {
+        // Failing to load a submap of the one we want to paint doesn't stop us
+        // creating the map image.
+        if (rt.expectSubMaps.contains(mapInfo))
+            rt.expectSubMaps.removeAll(mapInfo);
+
+        // The render thread was waiting for a map to load, but that failed.
+        // Tell the render thread to continue on with the next job.
+        if (rt.expectMapImage && (mapInfo == rt.expectMapImage->mapInfo())) {
 #ifdef WORLDED
-        foreach (MapInfo *mapInfo, mReferencedMaps)
-            MapManager::instance()->removeReferenceToMap(mapInfo);
-        mReferencedMaps.clear();
+            foreach (MapInfo *mapInfo, rt.referencedMaps)
+                MapManager::instance()->removeReferenceToMap(mapInfo);
+            rt.referencedMaps.clear();
 #endif
-        MapImage *mapImage = mExpectMapImage;
-        mapImage->mImage.fill(Qt::transparent);
-        mapImage->mLoaded = true; // FIXME: delete bogus MapImage???
-        mExpectMapImage = 0;
-        QMetaObject::invokeMethod(mImageRenderWorker,
-                                  "mapFailedToLoad", Qt::QueuedConnection);
-        emit mapImageFailedToLoad(mapImage);
+            MapImage *mapImage = rt.expectMapImage;
+            mapImage->mImage.fill(Qt::transparent);
+            mapImage->mLoaded = true; // FIXME: delete bogus MapImage???
+            rt.expectMapImage = 0;
+            QMetaObject::invokeMethod(rt.worker,
+                                      "mapFailedToLoad", Qt::QueuedConnection);
+            emit mapImageFailedToLoad(mapImage);
+        }
     }
 }
 
@@ -888,8 +924,10 @@ void MapImage::chopIntoPieces()
 
 /////
 
-MapImageReaderWorker::MapImageReaderWorker(InterruptibleThread *thread) :
-    BaseWorker(thread)
+MapImageReaderWorker::MapImageReaderWorker(InterruptibleThread *thread,
+                                           SharedJobQueue<Job> *jobs) :
+    BaseWorker(thread),
+    mJobs(jobs)
 {
 }
 
@@ -901,15 +939,8 @@ void MapImageReaderWorker::work()
 {
     IN_WORKER_THREAD
 
-    while (mJobs.size()) {
-
-        if (aborted()) {
-            mJobs.clear();
-            return;
-        }
-
-        Job job = mJobs.takeAt(0);
-
+    Job job;
+    while (!aborted() && mJobs->take(job)) {
         QImage *image = new QImage(job.imageFileName);
 #ifdef WORLDED
         if (!image->isNull())
@@ -920,17 +951,10 @@ void MapImageReaderWorker::work()
         Sleep::msleep(250);
 #endif
         emit imageLoaded(image, job.mapImage);
+        mJobs->finish(job);
     }
 }
 
-void MapImageReaderWorker::addJob(const QString &imageFileName, MapImage *mapImage)
-{
-    IN_WORKER_THREAD
-
-    mJobs += Job(imageFileName, mapImage);
-    scheduleWork();
-}
-
 /////
 
 MapImageRenderWorker::MapImageRenderWorker(InterruptibleThread *thread) :
@@ -986,10 +1010,9 @@ void MapImageRenderWorker::mapLoaded(MapComposite *mapComposite)
     IN_WORKER_THREAD
 
     foreach (CompositeLayerGroup *layerGroup, mapComposite->sortedLayerGroups()) {
-        foreach (TileLayer *tl, layerGroup->layers()) {
-            bool isVisible = true;
-            if (tl->name().contains(QLatin1String("NoRender")))
-                isVisible = false;
+        for (int index = 0; index < layerGroup->layerCount(); index++) {
+            TileLayer *tl = layerGroup->layers().at(index);
+            bool isVisible = !layerGroup->layerHasRole(index, CompositeLayerGroup::NoRenderRole);
             layerGroup->setLayerVisibility(tl, isVisible);
             layerGroup->setLayerOpacity(tl, 1.0f);
         }
@@ -1077,7 +1100,7 @@ MapImageData MapImageRenderWorker::generateMapImage(MapComposite *mapComposite)
         if (zo.group) {
             renderer->drawTileLayerGroup(&painter, zo.group);
         } else if (TileLayer *tl = zo.layer->asTileLayer()) {
-            if (tl->name().contains(QLatin1String("NoRender")))
+            if (zo.roles & CompositeLayerGroup::NoRenderRole)
                 continue;
             renderer->drawTileLayer(&painter, tl);
         }
@@ -1090,13 +1113,14 @@ MapImageData MapImageRenderWorker::generateMapImage(MapComposite *mapComposite)
 
     painter.end();
 
+    // Make every painted pixel opaque.  No branches, so the compiler can
+    // vectorize this.
+    const int width = image.width();
     for (int y = 0; y < image.height(); y++) {
-        QRgb *pixels = reinterpret_cast<QRgb*>(image.scanLine(y));
-        for (int x = 0; x < image.width(); x++) {
-            QRgb pixel = pixels[x];
-            if (qAlpha(pixel) > 0.01f) {
-                pixels[x] = qRgba(qRed(pixel), qGreen(pixel), qBlue(pixel), 255);
-            }
+        quint32 *pixels = reinterpret_cast<quint32*>(image.scanLine(y));
+        for (int x = 0; x < width; x++) {
+            const quint32 pixel = pixels[x];
+            pixels[x] = pixel | ((0u - quint32((pixel >> 24) != 0)) & 0xFF000000u);
         }
     }
 
@@ -37,30 +37,38 @@ class MapImageReaderWorker : public BaseWorker
 {
     Q_OBJECT
 public:
-    MapImageReaderWorker(InterruptibleThread *thread);
-
-    ~MapImageReaderWorker();
-
-signals:
-    void imageLoaded(QImage *image, MapImage *mapImage);
-
-public slots:
-    void work();
-    void addJob(const QString &imageFileName, MapImage *mapImage);
-
-private:
     class Job {
     public:
+        Job() :
+            mapImage(0)
+        {
+        }
+
         Job(const QString &imageFileName, MapImage *mapImage) :
             imageFileName(imageFileName),
             mapImage(mapImage)
         {
         }
 
+        bool operator==(const Job &other) const
+        { return mapImage == other.mapImage; }
+
         QString imageFileName;
         MapImage *mapImage;
     };
-    QList<Job> mJobs;
+
+    MapImageReaderWorker(InterruptibleThread *thread, SharedJobQueue<Job> *jobs);
+
+    ~MapImageReaderWorker();
+
+signals:
+    void imageLoaded(QImage *image, MapImage *mapImage);
+
+public slots:
+    void work();
+
+private:
+    SharedJobQueue<Job> *mJobs;
 };
 
 class MapImageData
@@ -290,16 +298,31 @@ private:
 
     QVector<InterruptibleThread*> mImageReaderThreads;
     QVector<MapImageReaderWorker*> mImageReaderWorkers;
-    int mNextThreadForJob;
+    SharedJobQueue<MapImageReaderWorker::Job> mImageReaderJobs;
 
-    InterruptibleThread *mImageRenderThread;
-    MapImageRenderWorker *mImageRenderWorker;
-    MapImage *mExpectMapImage;
-    QList<MapInfo*> mExpectSubMaps;
+    struct RenderThread
+    {
+        RenderThread() :
+            thread(0),
+            worker(0),
+            expectMapImage(0),
+            mapComposite(0)
+        {}
+        InterruptibleThread *thread;
+        MapImageRenderWorker *worker;
+        MapImage *expectMapImage;
+        QList<MapInfo*> expectSubMaps;
 #ifdef WORLDED
-    QList<MapInfo*> mReferencedMaps;
+        QList<MapInfo*> referencedMaps;
 #endif
-    MapComposite *mRenderMapComposite;
+        MapComposite *mapComposite;
+    };
+    void addRenderJob(MapImage *mapImage);
+    RenderThread *renderThreadFor(QObject *worker);
+    void mapLoaded(RenderThread &rt, MapInfo *mapInfo);
+
+    QVector<RenderThread> mRenderThreads;
+    int mNextRenderThreadForJob;
 
     friend class MapImageManagerDeferral;
     void deferThreadResults(bool defer);
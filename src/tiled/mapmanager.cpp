@@ -23,6 +23,7 @@
 #include "tilesetmanager.h"
 #include "zprogress.h"
 
+#include "imagelayer.h"
 #include "map.h"
 #include "mapreader.h"
 #include "mapobject.h"
@@ -37,6 +38,7 @@ using namespace SharedTools;
 #include "BuildingEditor/building.h"
 #include "BuildingEditor/buildingreader.h"
 #include "BuildingEditor/buildingmap.h"
+#include "BuildingEditor/buildingmapconverter.h"
 #include "BuildingEditor/buildingobjects.h"
 #include "BuildingEditor/buildingtiles.h"
 #include "BuildingEditor/furnituregroups.h"
@@ -45,6 +47,7 @@ using namespace SharedTools;
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QSettings>
 
 #ifdef QT_NO_DEBUG
 inline QNoDebug noise() { return QNoDebug(); }
@@ -76,9 +79,17 @@ MapManager::MapManager() :
     mDeferralDepth(0),
     mDeferralQueued(false),
     mWaitingForMapInfo(0),
-    mNextThreadForJob(0)
+    mBuildingTilesetsRevision(0),
+    mBuildingTilesetsChanged(false)
 #ifdef WORLDED
     , mReferenceEpoch(0)
+    , mMemoryBudget(qint64(512) * 1024 * 1024)
+    , mMemoryUsage(0)
+    , mLruFirst(0)
+    , mLruLast(0)
+    , mCacheHits(0)
+    , mCacheMisses(0)
+    , mCacheEvictions(0)
 #endif
 {
     connect(mFileSystemWatcher, SIGNAL(fileChanged(QString)),
@@ -89,20 +100,30 @@ MapManager::MapManager() :
     connect(&mChangedFilesTimer, SIGNAL(timeout()),
             SLOT(fileChangedTimeout()));
 
+    mMapsLoadedSinceReport = 0;
+    mTilesetLookupsAtReport = 0;
+    mLoadReportTimer.setInterval(1000);
+    mLoadReportTimer.setSingleShot(true);
+    connect(&mLoadReportTimer, SIGNAL(timeout()), SLOT(reportLoading()));
+
     qRegisterMetaType<MapInfo*>("MapInfo*");
 
-    mMapReaderThread.resize(4);
+    // The workers share one queue, so whichever thread is free reads the
+    // most important map next.
+    mMapReaderThread.resize(qMax(2, QThread::idealThreadCount()));
     mMapReaderWorker.resize(mMapReaderThread.size());
     for (int i = 0; i < mMapReaderThread.size(); i++) {
         mMapReaderThread[i] = new InterruptibleThread;
-        mMapReaderWorker[i] = new MapReaderWorker(mMapReaderThread[i], i);
+        mMapReaderWorker[i] = new MapReaderWorker(mMapReaderThread[i], i, &mMapReaderJobs);
         mMapReaderWorker[i]->moveToThread(mMapReaderThread[i]);
         connect(mMapReaderWorker[i], SIGNAL(loaded(Map*,MapInfo*)),
                 SLOT(mapLoadedByThread(Map*,MapInfo*)));
-        connect(mMapReaderWorker[i], SIGNAL(loaded(Building*,MapInfo*)),
-                SLOT(buildingLoadedByThread(Building*,MapInfo*)));
+        connect(mMapReaderWorker[i], SIGNAL(buildingLoaded(Map*,MapInfo*,int,QStringList)),
+                SLOT(buildingLoadedByThread(Map*,MapInfo*,int,QStringList)));
         connect(mMapReaderWorker[i], SIGNAL(failedToLoad(QString,MapInfo*)),
                 SLOT(failedToLoadByThread(QString,MapInfo*)));
+        connect(mMapReaderWorker[i], SIGNAL(cancelled(MapInfo*)),
+                SLOT(loadCancelledByThread(MapInfo*)));
         mMapReaderThread[i]->start();
     }
 
@@ -110,6 +131,14 @@ MapManager::MapManager() :
             SLOT(metaTilesetAdded(Tiled::Tileset*)));
     connect(TileMetaInfoMgr::instance(), SIGNAL(tilesetRemoved(Tiled::Tileset*)),
             SLOT(metaTilesetRemoved(Tiled::Tileset*)));
+    connect(TilesetManager::instance(), SIGNAL(tilesetChanged(Tileset*)),
+            SLOT(tilesetChanged(Tileset*)));
+
+#ifdef WORLDED
+    QSettings settings;
+    int megabytes = settings.value(QLatin1String("MapManager/MemoryBudget"), 512).toInt();
+    mMemoryBudget = qint64(qMax(megabytes, 1)) * 1024 * 1024;
+#endif
 }
 
 MapManager::~MapManager()
@@ -122,6 +151,10 @@ MapManager::~MapManager()
         delete mMapReaderWorker[i];
     }
 
+#ifdef WORLDED
+    logCacheStatus();
+#endif
+
     TilesetManager *tilesetManager = TilesetManager::instance();
 
     const QMap<QString,MapInfo*>::const_iterator end = mMapInfo.constEnd();
@@ -191,6 +224,9 @@ MapInfo *MapManager::loadMap(const QString &mapName, const QString &relativeTo,
     }
 
     if (mMapInfo.contains(mapFilePath) && mMapInfo[mapFilePath]->map()) {
+#ifdef WORLDED
+        ++mCacheHits;
+#endif
         return mMapInfo[mapFilePath];
     }
 
@@ -200,10 +236,17 @@ MapInfo *MapManager::loadMap(const QString &mapName, const QString &relativeTo,
     if (!mapInfo)
         return 0;
     if (mapInfo->mLoading) {
-        foreach (MapReaderWorker *w, mMapReaderWorker)
-            QMetaObject::invokeMethod(w, "possiblyRaisePriority",
-                                      Qt::QueuedConnection, Q_ARG(MapInfo*,mapInfo),
-                                      Q_ARG(int,priority));
+        if (mCancelledMaps.remove(mapInfo)) {
+            // Keep the result of the cancelled read, or read the map again
+            // if the reader already threw it away.
+            if (!mMapReaderJobs.raisePriority(mapInfo, priority)) {
+                updateBuildingTilesets(mapInfo);
+                mMapReaderJobs.add(mapInfo, priority);
+            }
+        } else {
+            mMapReaderJobs.raisePriority(mapInfo, priority);
+        }
+        wakeWorkers(mMapReaderWorker);
         if (!asynch) {
             noise() << "WAITING FOR MAP" << mapName << "with priority" << priority;
             Q_ASSERT(mWaitingForMapInfo == 0);
@@ -222,17 +265,23 @@ MapInfo *MapManager::loadMap(const QString &mapName, const QString &relativeTo,
             mWaitingForMapInfo = 0;
             if (!mapInfo->map())
                 return 0;
+        } else {
+            ++mapInfo->mLoadRequests;
         }
         return mapInfo;
     }
     mapInfo->mLoading = true;
-    QMetaObject::invokeMethod(mMapReaderWorker[mNextThreadForJob], "addJob",
-                              Qt::QueuedConnection, Q_ARG(MapInfo*,mapInfo),
-                              Q_ARG(int,priority));
-    mNextThreadForJob = (mNextThreadForJob + 1) % mMapReaderThread.size();
+#ifdef WORLDED
+    ++mCacheMisses;
+#endif
+    updateBuildingTilesets(mapInfo);
+    mMapReaderJobs.add(mapInfo, priority);
+    wakeWorkers(mMapReaderWorker);
 
-    if (asynch)
+    if (asynch) {
+        ++mapInfo->mLoadRequests;
         return mapInfo;
+    }
 
     // Wow.  Had a map *finish loading* after the PROGRESS call below displayed
     // the dialog and started processing events but before the qApp->processEvents()
@@ -242,10 +291,6 @@ MapInfo *MapManager::loadMap(const QString &mapName, const QString &relativeTo,
     mWaitingForMapInfo = mapInfo;
 
     PROGRESS progress(tr("Reading %1").arg(fileInfoMap.completeBaseName()));
-    foreach (MapReaderWorker *w, mMapReaderWorker)
-        QMetaObject::invokeMethod(w, "possiblyRaisePriority",
-                                  Qt::QueuedConnection, Q_ARG(MapInfo*,mapInfo),
-                                  Q_ARG(int,priority));
     noise() << "WAITING FOR MAP" << mapName << "with priority" << priority;
     for (int i = 0; i < mDeferredMaps.size(); i++) {
         MapDeferral md = mDeferredMaps[i];
@@ -264,6 +309,29 @@ MapInfo *MapManager::loadMap(const QString &mapName, const QString &relativeTo,
     return 0;
 }
 
+void MapManager::cancelLoading(MapInfo *mapInfo)
+{
+    if (!mapInfo->mLoading || mapInfo == mWaitingForMapInfo)
+        return;
+    // A load nobody asked for, such as a reload after the file changed,
+    // isn't anybody's to cancel.
+    if (mapInfo->mLoadRequests <= 0 || --mapInfo->mLoadRequests > 0)
+        return;
+    switch (mMapReaderJobs.cancel(mapInfo)) {
+    case SharedJobQueue<MapInfo*>::Removed:
+        noise() << "MapManager cancelled" << mapInfo->path();
+        mapInfo->mLoading = false;
+        break;
+    case SharedJobQueue<MapInfo*>::Cancelled:
+        // loadCancelledByThread() will be called.
+        mCancelledMaps.insert(mapInfo);
+        break;
+    case SharedJobQueue<MapInfo*>::NotFound:
+        // Already read, the result is on its way.
+        break;
+    }
+}
+
 MapInfo *MapManager::newFromMap(Map *map, const QString &mapFilePath)
 {
     MapInfo *info = new MapInfo(map->orientation(),
@@ -480,6 +548,7 @@ MapInfo *MapManager::getEmptyMap()
     mapInfo->setFilePath(mapFilePath);
     mMapInfo[mapFilePath] = mapInfo;
 #ifdef WORLDED
+    updateMemoryUsage(mapInfo);
     addReferenceToMap(mapInfo);
 #endif
     return mapInfo;
@@ -507,6 +576,10 @@ MapInfo *MapManager::getPlaceholderMap(const QString &mapName, int width, int he
     mapInfo->setFilePath(mapFilePath);
     mapInfo->mPlaceholder = true;
     mMapInfo[mapFilePath] = mapInfo;
+#ifdef WORLDED
+    updateMemoryUsage(mapInfo);
+    lruAppend(mapInfo);
+#endif
 
     return mapInfo;
 }
@@ -528,8 +601,10 @@ void MapManager::addReferenceToMap(MapInfo *mapInfo)
     if (mapInfo->mMap) {
         mapInfo->mMapRefCount++;
         mapInfo->mReferenceEpoch = mReferenceEpoch;
-        if (mapInfo->mMapRefCount == 1)
+        if (mapInfo->mMapRefCount == 1) {
             ++mReferenceEpoch;
+            lruRemove(mapInfo);
+        }
         noise() << "MapManager refCount++ =" << mapInfo->mMapRefCount << mapInfo->mFilePath;
     }
 }
@@ -541,28 +616,118 @@ void MapManager::removeReferenceToMap(MapInfo *mapInfo)
         Q_ASSERT(mapInfo->mMapRefCount > 0);
         mapInfo->mMapRefCount--;
         noise() << "MapManager refCount-- =" << mapInfo->mMapRefCount << mapInfo->mFilePath;
+        if (mapInfo->mMapRefCount == 0)
+            lruAppend(mapInfo);
         purgeUnreferencedMaps();
     }
 }
 
 void MapManager::purgeUnreferencedMaps()
 {
-    int unpurged = 0;
-    foreach (MapInfo *mapInfo, mMapInfo) {
-        bool bigMap = mapInfo->size() == QSize(300, 300);
-        if ((mapInfo->mMap && mapInfo->mMapRefCount <= 0) &&
-                ((bigMap && (mapInfo->mReferenceEpoch <= mReferenceEpoch - 10)) ||
-                (mapInfo->mReferenceEpoch <= mReferenceEpoch - 50))) {
+    int purged = 0;
+    MapInfo *mapInfo = mLruFirst;
+    while (mapInfo && mMemoryUsage > mMemoryBudget) {
+        MapInfo *next = mapInfo->mLruNext;
+        // A map that was loaded or referenced recently is kept for a while,
+        // so a map that was just loaded isn't dropped before whoever asked
+        // for it references it.  Big (cell-sized) maps are kept for fewer
+        // epochs.
+        const int keepEpochs = (mapInfo->size() == QSize(300, 300)) ? 10 : 50;
+        if (mapInfo->mReferenceEpoch <= mReferenceEpoch - keepEpochs) {
+            Q_ASSERT(mapInfo->mMap && mapInfo->mMapRefCount <= 0);
             noise() << "MapManager purging" << mapInfo->mFilePath;
+            lruRemove(mapInfo);
             TilesetManager *tilesetMgr = TilesetManager::instance();
             tilesetMgr->removeReferences(mapInfo->mMap->tilesets());
             delete mapInfo->mMap;
             mapInfo->mMap = 0;
+            updateMemoryUsage(mapInfo);
+            ++mCacheEvictions;
+            ++purged;
+        }
+        mapInfo = next;
+    }
+    if (purged) {
+        noise() << "MapManager purged" << purged << "maps";
+        logCacheStatus();
+    }
+}
+
+void MapManager::setMemoryBudget(qint64 bytes)
+{
+    mMemoryBudget = bytes;
+    QSettings settings;
+    settings.setValue(QLatin1String("MapManager/MemoryBudget"),
+                      int(bytes / (1024 * 1024)));
+    purgeUnreferencedMaps();
+}
+
+void MapManager::logCacheStatus() const
+{
+    noise() << "MapManager cache: using" << memoryUsage() / (1024 * 1024)
+            << "of" << memoryBudget() / (1024 * 1024) << "MB, hits =" << cacheHits()
+            << "misses =" << cacheMisses() << "evictions =" << cacheEvictions();
+}
+
+qint64 MapManager::memoryUsage(Map *map)
+{
+    if (!map)
+        return 0;
+    qint64 bytes = sizeof(Map);
+    foreach (Layer *layer, map->layers()) {
+        if (TileLayer *tl = layer->asTileLayer()) {
+            bytes += tl->memoryUsage();
+        } else if (ObjectGroup *og = layer->asObjectGroup()) {
+            bytes += sizeof(ObjectGroup);
+            foreach (MapObject *object, og->objects()) {
+                bytes += sizeof(MapObject) + (object->name().size()
+                                              + object->type().size()) * sizeof(QChar);
+            }
+        } else if (ImageLayer *il = layer->asImageLayer()) {
+            bytes += sizeof(ImageLayer) + il->image().width() * il->image().height() * 4;
         }
-        else if (mapInfo->mMap && mapInfo->mMapRefCount <= 0)
-            unpurged++;
     }
-    if (unpurged) noise() << "MapManager unpurged =" << unpurged;
+    for (int i = 0; i < 2; i++) {
+        const MapBmp &bmp = map->rbmp(i);
+        // The image plus the random numbers used for blending.
+        bytes += qint64(bmp.width()) * bmp.height() * (4 + sizeof(int));
+    }
+    foreach (MapNoBlend *noBlend, map->noBlends())
+        bytes += sizeof(MapNoBlend) + noBlend->width() * noBlend->height() / 8;
+    return bytes;
+}
+
+void MapManager::updateMemoryUsage(MapInfo *mapInfo)
+{
+    mMemoryUsage -= mapInfo->mMemoryUsage;
+    mapInfo->mMemoryUsage = memoryUsage(mapInfo->mMap);
+    mMemoryUsage += mapInfo->mMemoryUsage;
+}
+
+void MapManager::lruAppend(MapInfo *mapInfo)
+{
+    lruRemove(mapInfo);
+    mapInfo->mLruPrev = mLruLast;
+    if (mLruLast)
+        mLruLast->mLruNext = mapInfo;
+    else
+        mLruFirst = mapInfo;
+    mLruLast = mapInfo;
+}
+
+void MapManager::lruRemove(MapInfo *mapInfo)
+{
+    if (mapInfo->mLruPrev)
+        mapInfo->mLruPrev->mLruNext = mapInfo->mLruNext;
+    else if (mLruFirst == mapInfo)
+        mLruFirst = mapInfo->mLruNext;
+    else
+        return; // not in the list
+    if (mapInfo->mLruNext)
+        mapInfo->mLruNext->mLruPrev = mapInfo->mLruPrev;
+    else
+        mLruLast = mapInfo->mLruPrev;
+    mapInfo->mLruPrev = mapInfo->mLruNext = 0;
 }
 
 void MapManager::newMapFileCreated(const QString &path)
@@ -643,10 +808,12 @@ void MapManager::fileChangedTimeout()
                     Q_ASSERT(!mapInfo->isBeingEdited());
                     if (!mapInfo->isLoading()) {
                         mapInfo->mLoading = true; // FIXME: seems weird to change this for a loaded map
-                        QMetaObject::invokeMethod(mMapReaderWorker[mNextThreadForJob], "addJob",
-                                                  Qt::QueuedConnection, Q_ARG(MapInfo*,mapInfo),
-                                                  Q_ARG(int,PriorityLow));
-                        mNextThreadForJob = (mNextThreadForJob + 1) % mMapReaderThread.size();
+                        // The reload is MapManager's own request.  Callers
+                        // that join it can't cancel it.
+                        ++mapInfo->mLoadRequests;
+                        updateBuildingTilesets(mapInfo);
+                        mMapReaderJobs.add(mapInfo, PriorityLow);
+                        wakeWorkers(mMapReaderWorker);
                     }
                 }
                 emit mapFileChanged(mapInfo);
@@ -660,6 +827,7 @@ void MapManager::fileChangedTimeout()
 void MapManager::metaTilesetAdded(Tileset *tileset)
 {
     Q_UNUSED(tileset)
+    ++mBuildingTilesetsRevision;
     foreach (MapInfo *mapInfo, mMapInfo) {
         if (mapInfo->map() && mapInfo->path().endsWith(QLatin1String(".tbx"))
                 && mapInfo->map()->hasUsedMissingTilesets())
@@ -670,6 +838,7 @@ void MapManager::metaTilesetAdded(Tileset *tileset)
 void MapManager::metaTilesetRemoved(Tileset *tileset)
 {
     Q_UNUSED(tileset)
+    ++mBuildingTilesetsRevision;
     foreach (MapInfo *mapInfo, mMapInfo) {
         if (mapInfo->map() && mapInfo->path().endsWith(QLatin1String(".tbx"))
                 && mapInfo->map()->usedTilesets().contains(tileset))
@@ -677,6 +846,37 @@ void MapManager::metaTilesetRemoved(Tileset *tileset)
     }
 }
 
+void MapManager::tilesetChanged(Tileset *tileset)
+{
+    // This is emitted whenever a tileset's image finishes loading, which
+    // usually doesn't change the tiles the snapshot holds.  If tiles were
+    // added, the snapshot is taken again the next time a building is queued.
+    if (mBuildingTilesets && !mBuildingTilesets->isUpToDate(tileset))
+        mBuildingTilesetsChanged = true;
+}
+
+// Called before a map is queued for the reader threads.  A building is
+// converted with the tilesets in the snapshot taken here.
+void MapManager::updateBuildingTilesets(MapInfo *mapInfo)
+{
+    if (!mapInfo->path().endsWith(QLatin1String(".tbx")))
+        return;
+    if (mBuildingTilesets && !mBuildingTilesetsChanged &&
+            mBuildingTilesets->revision() == mBuildingTilesetsRevision)
+        return;
+    QSharedPointer<const BuildingTilesetSnapshot> snapshot(
+                BuildingTilesetSnapshot::create(mBuildingTilesetsRevision));
+    mBuildingTilesetsChanged = false;
+    QMutexLocker locker(&mBuildingTilesetsMutex);
+    mBuildingTilesets = snapshot;
+}
+
+QSharedPointer<const BuildingTilesetSnapshot> MapManager::buildingTilesets()
+{
+    QMutexLocker locker(&mBuildingTilesetsMutex);
+    return mBuildingTilesets;
+}
+
 void MapManager::mapLoadedByThread(MapManager::Map *map, MapInfo *mapInfo)
 {
     if (mapInfo != mWaitingForMapInfo && mDeferralDepth > 0) {
@@ -722,6 +922,7 @@ void MapManager::mapLoadedByThread(MapManager::Map *map, MapInfo *mapInfo)
     mapInfo->mTileHeight = map->tileHeight();
     mapInfo->mPlaceholder = false;
     mapInfo->mLoading = false;
+    mapInfo->mLoadRequests = 0;
 
     if (replace)
         emit mapChanged(mapInfo);
@@ -730,45 +931,78 @@ void MapManager::mapLoadedByThread(MapManager::Map *map, MapInfo *mapInfo)
     // The reference count is zero, but prevent it being immediately purged.
     // FIXME: add a reference and let the caller deal with it.
     mapInfo->mReferenceEpoch = mReferenceEpoch;
+    updateMemoryUsage(mapInfo);
+    if (mapInfo->mMapRefCount <= 0)
+        lruAppend(mapInfo);
 #endif
 
     emit mapLoaded(mapInfo);
+
+    ++mMapsLoadedSinceReport;
+#ifndef QT_NO_DEBUG
+    mLoadReportTimer.start();
+#endif
+
+#ifdef WORLDED
+    purgeUnreferencedMaps();
+#endif
 }
 
-void MapManager::buildingLoadedByThread(Building *building, MapInfo *mapInfo)
+void MapManager::buildingLoadedByThread(Map *map, MapInfo *mapInfo,
+                                        int tilesetsRevision,
+                                        const QStringList &missingTilesets)
 {
     MapManagerDeferral deferral;
 
-    BuildingReader reader;
-    reader.fix(building);
-
-    BuildingMap::loadNeededTilesets(building);
-
-    BuildingMap bmap(building);
-    Map *map = bmap.mergedMap();
-    bmap.addRoomDefObjects(map);
-
-    delete building;
+    // The building may use tilesets that aren't in Tilesets.txt yet.  Adding
+    // them bumps mBuildingTilesetsRevision.
+    BuildingMap::loadNeededTilesets(missingTilesets);
+
+    if (tilesetsRevision != mBuildingTilesetsRevision) {
+        // Tilesets.txt changed while the building was being converted, so
+        // convert it again.  The map doesn't own its tilesets.
+        noise() << "MapManager reconverting" << mapInfo->path();
+        delete map;
+        updateBuildingTilesets(mapInfo);
+        mMapReaderJobs.add(mapInfo, PriorityHigh);
+        wakeWorkers(mMapReaderWorker);
+        return;
+    }
 
     QSet<Tileset*> usedTilesets = map->usedTilesets();
     usedTilesets.remove(TilesetManager::instance()->missingTileset());
 
     TileMetaInfoMgr::instance()->loadTilesets(usedTilesets.toList());
 
-    // The map references TileMetaInfoMgr's tilesets, but we add a reference
-    // to them ourself below.
-    TilesetManager::instance()->removeReferences(map->tilesets());
-
     mapLoadedByThread(map, mapInfo);
 }
 
 void MapManager::failedToLoadByThread(const QString error, MapInfo *mapInfo)
 {
     mapInfo->mLoading = false;
+    mapInfo->mLoadRequests = 0;
     mError = error;
     emit mapFailedToLoad(mapInfo);
 }
 
+void MapManager::loadCancelledByThread(MapInfo *mapInfo)
+{
+    // loadMap() may have asked for the map again since it was cancelled.
+    if (!mCancelledMaps.remove(mapInfo))
+        return;
+    noise() << "MapManager cancelled" << mapInfo->path();
+    mapInfo->mLoading = false;
+}
+
+void MapManager::reportLoading()
+{
+    int lookups = TilesetManager::instance()->lookupCount();
+    noise() << "MapManager loaded" << mMapsLoadedSinceReport << "maps with"
+            << lookups - mTilesetLookupsAtReport << "tileset lookups";
+    mMapsLoadedSinceReport = 0;
+    mTilesetLookupsAtReport = lookups;
+}
+
 void MapManager::deferThreadResults(bool defer)
 {
     if (defer) {
@@ -802,8 +1036,10 @@ void MapManager::processDeferrals()
 
 /////
 
-MapReaderWorker::MapReaderWorker(InterruptibleThread *thread, int id) :
+MapReaderWorker::MapReaderWorker(InterruptibleThread *thread, int id,
+                                 SharedJobQueue<MapInfo*> *jobs) :
     BaseWorker(thread),
+    mJobs(jobs),
     mID(id)
 {
 }
@@ -816,64 +1052,46 @@ void MapReaderWorker::work()
 {
     IN_WORKER_THREAD
 
-    if (mJobs.size()) {
-        if (aborted()) {
-            mJobs.clear();
-            return;
-        }
+    if (aborted())
+        return;
 
-        Job job = mJobs.takeFirst();
+    MapInfo *mapInfo;
+    if (mJobs->take(mapInfo)) {
         debugJobs("take job");
 
-        if (job.mapInfo->path().endsWith(QLatin1String(".tbx"))) {
-            Building *building = loadBuilding(job.mapInfo);
-            if (building)
-                emit loaded(building, job.mapInfo);
+        if (mapInfo->path().endsWith(QLatin1String(".tbx"))) {
+            int tilesetsRevision;
+            QStringList missingTilesets;
+            Map *map = loadBuilding(mapInfo, tilesetsRevision, missingTilesets);
+            if (!mJobs->finish(mapInfo)) {
+                // The tilesets belong to TileMetaInfoMgr.
+                delete map;
+                emit cancelled(mapInfo);
+            } else if (map)
+                emit buildingLoaded(map, mapInfo, tilesetsRevision, missingTilesets);
             else
-                emit failedToLoad(mError, job.mapInfo);
+                emit failedToLoad(mError, mapInfo);
         } else {
-//            noise() << "READING STARTED" << job.mapInfo->path();
-            Map *map = loadMap(job.mapInfo);
-//            noise() << "READING FINISHED" << job.mapInfo->path();
-            if (map)
-                emit loaded(map, job.mapInfo);
+//            noise() << "READING STARTED" << mapInfo->path();
+            Map *map = loadMap(mapInfo);
+//            noise() << "READING FINISHED" << mapInfo->path();
+            if (!mJobs->finish(mapInfo)) {
+                if (map) {
+                    // Nothing references the reader's tilesets yet.
+                    qDeleteAll(map->tilesets());
+                    delete map;
+                }
+                emit cancelled(mapInfo);
+            } else if (map)
+                emit loaded(map, mapInfo);
             else
-                emit failedToLoad(mError, job.mapInfo);
+                emit failedToLoad(mError, mapInfo);
         }
-
-//        QCoreApplication::processEvents(); // handle changing job priority
     }
 
-    if (mJobs.size()) scheduleWork();
-}
-
-void MapReaderWorker::addJob(MapInfo *mapInfo, int priority)
-{
-    IN_WORKER_THREAD
-
-    int index = 0;
-    while ((index < mJobs.size()) && (mJobs[index].priority >= priority))
-        ++index;
-
-    mJobs.insert(index, Job(mapInfo, priority));
-    debugJobs("add job");
-    scheduleWork();
-}
-
-void MapReaderWorker::possiblyRaisePriority(MapInfo *mapInfo, int priority)
-{
-    IN_WORKER_THREAD
-
-    for (int i = 0; i < mJobs.size(); i++) {
-        if (mJobs[i].mapInfo == mapInfo && mJobs[i].priority < priority) {
-            int j;
-            for (j = i - 1; j >= 0 && mJobs[j].priority < priority; j--) {}
-            mJobs[i].priority = priority;
-            mJobs.move(i, j + 1);
-            debugJobs("raise priority");
-            break;
-        }
-    }
+    // One job at a time, so an interrupt is noticed between jobs.
+    if (!mJobs->isEmpty())
+        scheduleWork();
 }
 
 class MapReaderWorker_MapReader : public MapReader
@@ -903,20 +1121,34 @@ Map *MapReaderWorker::loadMap(MapInfo *mapInfo)
     return map;
 }
 
-MapReaderWorker::Building *MapReaderWorker::loadBuilding(MapInfo *mapInfo)
+Map *MapReaderWorker::loadBuilding(MapInfo *mapInfo, int &tilesetsRevision,
+                                   QStringList &missingTilesets)
 {
+    QSharedPointer<const BuildingTilesetSnapshot> tilesets =
+            MapManager::instance()->buildingTilesets();
+    Q_ASSERT(tilesets);
+
     BuildingReader reader;
     Building *building = reader.read(mapInfo->path());
-    if (!building)
+    if (!building) {
         mError = reader.errorString();
-    return building;
+        return 0;
+    }
+    reader.fix(building);
+
+    BuildingMapConverter converter(tilesets.data());
+    Map *map = converter.convert(building);
+    delete building;
+
+    tilesetsRevision = tilesets->revision();
+    missingTilesets = converter.missingTilesets();
+    return map;
 }
 
 void MapReaderWorker::debugJobs(const char *msg)
 {
     QStringList out;
-    foreach (Job job, mJobs) {
-        out += QString::fromLatin1("    %1 priority=%2\n").arg(QFileInfo(job.mapInfo->path()).fileName()).arg(job.priority);
-    }
+    foreach (MapInfo *mapInfo, mJobs->queued())
+        out += QString::fromLatin1("    %1\n").arg(QFileInfo(mapInfo->path()).fileName());
     noise() << "MRW #" << mID << ": " << msg << "\n" << out;
 }
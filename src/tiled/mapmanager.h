@@ -24,50 +24,43 @@
 
 #include <QDateTime>
 #include <QMap>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QStringList>
 #include <QTimer>
 
 class MapInfo;
 
 namespace BuildingEditor {
-class Building;
+class BuildingTilesetSnapshot;
 }
 
 class MapReaderWorker : public BaseWorker
 {
     Q_OBJECT
 public:
-    MapReaderWorker(InterruptibleThread *thread, int id);
+    MapReaderWorker(InterruptibleThread *thread, int id,
+                    SharedJobQueue<MapInfo*> *jobs);
     ~MapReaderWorker();
 
     typedef Tiled::Map Map;
-    typedef BuildingEditor::Building Building;
 
 signals:
     void loaded(Map *map, MapInfo *mapInfo);
-    void loaded(Building *building, MapInfo *mapInfo);
+    void buildingLoaded(Map *map, MapInfo *mapInfo, int tilesetsRevision,
+                        const QStringList &missingTilesets);
     void failedToLoad(const QString error, MapInfo *mapInfo);
+    void cancelled(MapInfo *mapInfo);
 
 public slots:
     void work();
-    void addJob(MapInfo *mapInfo, int priority);
-    void possiblyRaisePriority(MapInfo *mapInfo, int priority);
 
 private:
     Map *loadMap(MapInfo *mapInfo);
-    Building *loadBuilding(MapInfo *mapInfo);
+    Map *loadBuilding(MapInfo *mapInfo, int &tilesetsRevision,
+                      QStringList &missingTilesets);
 
-    class Job {
-    public:
-        Job(MapInfo *mapInfo, int priority) :
-            mapInfo(mapInfo),
-            priority(priority)
-        {
-        }
-
-        MapInfo *mapInfo;
-        int priority;
-    };
-    QList<Job> mJobs;
+    SharedJobQueue<MapInfo*> *mJobs;
 
     int mID;
     void debugJobs(const char *msg);
@@ -92,8 +85,12 @@ public:
 #ifdef WORLDED
         , mMapRefCount(0)
         , mReferenceEpoch(0)
+        , mMemoryUsage(0)
+        , mLruPrev(0)
+        , mLruNext(0)
 #endif
         , mLoading(false)
+        , mLoadRequests(0)
     {
 
     }
@@ -131,8 +128,12 @@ private:
 #ifdef WORLDED
     int mMapRefCount;
     int mReferenceEpoch;
+    qint64 mMemoryUsage;
+    MapInfo *mLruPrev;
+    MapInfo *mLruNext;
 #endif
     bool mLoading;
+    int mLoadRequests; // asynchronous loadMap() calls not yet cancelled, plus reloads
 
     friend class MapManager;
 };
@@ -161,6 +162,16 @@ public:
                      const QString &relativeTo = QString(),
                      bool asynch = false, LoadPriority priority = PriorityHigh);
 
+    /**
+      * Stops an asynchronous load started by loadMap().  Each asynchronous
+      * loadMap() call that returned a loading map needs its own
+      * cancelLoading() call; the load only stops once nobody wants the map
+      * any more.  If a reader thread is already reading the map, the result
+      * is thrown away.  Calling loadMap() again before then keeps the result
+      * instead.
+      */
+    void cancelLoading(MapInfo *mapInfo);
+
     MapInfo *newFromMap(Tiled::Map *map, const QString &mapFilePath = QString());
 
     MapInfo *mapInfo(const QString &mapFilePath);
@@ -189,18 +200,53 @@ public:
       * Call this when the map's size or tile size changes.
       */
     void mapParametersChanged(MapInfo *mapInfo);
+
+    /**
+      * The tilesets the reader threads convert .tbx files to maps with.
+      * This may be called from any thread.
+      */
+    QSharedPointer<const BuildingEditor::BuildingTilesetSnapshot> buildingTilesets();
 #ifdef WORLDED
     void addReferenceToMap(MapInfo *mapInfo);
     void removeReferenceToMap(MapInfo *mapInfo);
     void purgeUnreferencedMaps();
 
+    /**
+      * Loaded maps that nothing references are kept in memory until all the
+      * loaded maps together use more than \a bytes.  Then the least-recently
+      * used ones are deleted.  The budget is kept in the MapManager/MemoryBudget
+      * setting, in megabytes, and defaults to 512.
+      */
+    void setMemoryBudget(qint64 bytes);
+    qint64 memoryBudget() const
+    { return mMemoryBudget; }
+
+    /**
+      * Returns roughly how many bytes all the loaded maps use.
+      */
+    qint64 memoryUsage() const
+    { return mMemoryUsage; }
+
+    int cacheHits() const
+    { return mCacheHits; }
+    int cacheMisses() const
+    { return mCacheMisses; }
+    int cacheEvictions() const
+    { return mCacheEvictions; }
+
+    /**
+      * Logs the memory use and the counts above.  This happens whenever maps
+      * are evicted and when the MapManager is deleted.
+      */
+    void logCacheStatus() const;
+
     void newMapFileCreated(const QString &path);
 #endif
     QString errorString() const
     { return mError; }
 
     typedef Tiled::Map Map;
-    typedef BuildingEditor::Building Building;
+    typedef Tiled::Tileset Tileset;
 
 signals:
     void mapAboutToChange(MapInfo *mapInfo);
@@ -218,12 +264,16 @@ private slots:
 
     void metaTilesetAdded(Tiled::Tileset *tileset);
     void metaTilesetRemoved(Tiled::Tileset *tileset);
+    void tilesetChanged(Tileset *tileset);
 
     void mapLoadedByThread(Map *map, MapInfo *mapInfo);
-    void buildingLoadedByThread(Building *building, MapInfo *mapInfo);
+    void buildingLoadedByThread(Map *map, MapInfo *mapInfo, int tilesetsRevision,
+                                const QStringList &missingTilesets);
     void failedToLoadByThread(const QString error, MapInfo *mapInfo);
+    void loadCancelledByThread(MapInfo *mapInfo);
 
     void processDeferrals();
+    void reportLoading();
 
 private:
     Q_DISABLE_COPY(MapManager)
@@ -237,6 +287,12 @@ private:
     QSet<QString> mChangedFiles;
     QTimer mChangedFilesTimer;
 
+    // Once maps stop arriving, as when a world or a map with many lots has
+    // finished loading, the number of tileset lookups is logged.
+    QTimer mLoadReportTimer;
+    int mMapsLoadedSinceReport;
+    int mTilesetLookupsAtReport;
+
     friend class MapManagerDeferral;
     void deferThreadResults(bool defer);
     int mDeferralDepth;
@@ -256,9 +312,28 @@ private:
 
     QVector<InterruptibleThread*> mMapReaderThread;
     QVector<MapReaderWorker*> mMapReaderWorker;
-    int mNextThreadForJob;
+    SharedJobQueue<MapInfo*> mMapReaderJobs;
+    QSet<MapInfo*> mCancelledMaps; // cancelled while a thread was reading them
+
+    void updateBuildingTilesets(MapInfo *mapInfo);
+    QSharedPointer<const BuildingEditor::BuildingTilesetSnapshot> mBuildingTilesets;
+    QMutex mBuildingTilesetsMutex; // guards mBuildingTilesets
+    int mBuildingTilesetsRevision; // changes when Tilesets.txt does
+    bool mBuildingTilesetsChanged; // a tileset's tiles changed
 #ifdef WORLDED
+    static qint64 memoryUsage(Map *map);
+    void updateMemoryUsage(MapInfo *mapInfo);
+    void lruAppend(MapInfo *mapInfo);
+    void lruRemove(MapInfo *mapInfo);
+
     int mReferenceEpoch;
+    qint64 mMemoryBudget;
+    qint64 mMemoryUsage;
+    MapInfo *mLruFirst; // least-recently used
+    MapInfo *mLruLast;
+    int mCacheHits;
+    int mCacheMisses;
+    int mCacheEvictions;
 #endif
     QString mError;
 };
@@ -62,10 +62,9 @@ ShadowMap::ShadowMap(MapInfo *mapInfo)
     mMapComposite = new MapComposite(mapInfo);
 
     foreach (CompositeLayerGroup *layerGroup, mMapComposite->sortedLayerGroups()) {
-        foreach (TileLayer *tl, layerGroup->layers()) {
-            bool isVisible = true;
-            if (tl->name().contains(QLatin1String("NoRender")))
-                isVisible = false;
+        for (int index = 0; index < layerGroup->layerCount(); index++) {
+            TileLayer *tl = layerGroup->layers().at(index);
+            bool isVisible = !layerGroup->layerHasRole(index, CompositeLayerGroup::NoRenderRole);
             layerGroup->setLayerVisibility(tl, isVisible);
             layerGroup->setLayerOpacity(tl, 1.0f);
         }
@@ -90,9 +89,7 @@ void ShadowMap::layerAdded(int index, Layer *layer)
 
     if (TileLayer *tl = layer->asTileLayer()) {
         if (CompositeLayerGroup *layerGroup = mMapComposite->layerGroupForLayer(tl)) {
-            bool isVisible = true;
-            if (tl->name().contains(QLatin1String("NoRender")))
-                isVisible = false;
+            bool isVisible = !layerGroup->layerHasRole(tl, CompositeLayerGroup::NoRenderRole);
             layerGroup->setLayerVisibility(tl, isVisible);
             layerGroup->setLayerOpacity(tl, 1.0f);
 
@@ -320,7 +317,7 @@ void MiniMapRenderWorker::work()
         if (zo.group)
             mRenderer->drawTileLayerGroup(&painter, zo.group, paintRect);
         else if (TileLayer *tl = zo.layer->asTileLayer()) {
-            if (tl->name().contains(QLatin1String("NoRender")))
+            if (zo.roles & CompositeLayerGroup::NoRenderRole)
                 continue;
             mRenderer->drawTileLayer(&painter, tl, paintRect);
         }
@@ -395,7 +392,7 @@ void MiniMapRenderWorker::processChanges(const QList<MapChange *> &changes)
                             tl->setCell(ce.x, ce.y, ce.cell);
                     }
                     if (CompositeLayerGroup *layerGroup = sm.mMapComposite->layerGroupForLayer(tl))
-                        layerGroup->regionAltered(tl); // possibly set mNeedsSynch
+                        layerGroup->regionAltered(tl, c.mRegion); // possibly set mNeedsSynch
                 }
                 if (sm.mMapComposite->bmpBlender()->tileLayerNames().contains(layer->name())) {
                     sm.mMapComposite->bmpBlender()->markDirty(c.mRegion);
@@ -12,10 +12,81 @@
 #include "tileset.h"
 
 #include <qmath.h>
+#include <QtConcurrentMap>
 
 using namespace Tiled;
 using namespace Tiled::Internal;
 
+void LotFile::SquareGrid::reset(int width, int height, int levels)
+{
+    mWidth = width;
+    mHeight = height;
+    mLevels.resize(levels);
+    for (Level &level : mLevels) {
+        level.offsets.resize(width * height + 1);
+        level.gids.resize(0);
+        level.roomIDs.fill(-1, width * height);
+        level.next = 0;
+    }
+}
+
+void LotFile::SquareGrid::append(int x, int y, int z, uint gid)
+{
+    Level &level = mLevels[z];
+    const int index = y * mWidth + x;
+    Q_ASSERT(index >= level.next - 1);
+    fillOffsets(level, index + 1);
+    level.gids.append(gid);
+}
+
+void LotFile::SquareGrid::finish()
+{
+    for (Level &level : mLevels)
+        fillOffsets(level, mWidth * mHeight + 1);
+}
+
+void LotFile::SquareGrid::fillOffsets(Level &level, int end)
+{
+    const qint32 offset = level.gids.size();
+    qint32 *offsets = level.offsets.data();
+    for (; level.next < end; ++level.next)
+        offsets[level.next] = offset;
+}
+
+namespace {
+
+/**
+ * Encodes one 10x10 chunk of the lot.  Chunks are encoded concurrently, so
+ * this only reads from the NewMapBinaryFile.
+ */
+class ChunkEncoder
+{
+public:
+    typedef QByteArray result_type;
+
+    ChunkEncoder(NewMapBinaryFile *file, MapComposite *mapComposite) :
+        mFile(file),
+        mMapComposite(mapComposite)
+    {
+    }
+
+    QByteArray operator()(const QPoint &chunkPos) const
+    {
+        QByteArray bytes;
+        QDataStream out(&bytes, QIODevice::WriteOnly);
+        out.setByteOrder(QDataStream::LittleEndian);
+        if (!mFile->generateChunk(out, mMapComposite, chunkPos.x(), chunkPos.y()))
+            return QByteArray();
+        return bytes;
+    }
+
+private:
+    NewMapBinaryFile *mFile;
+    MapComposite *mMapComposite;
+};
+
+} // anonymous namespace
+
 NewMapBinaryFile::NewMapBinaryFile()
 {
 
@@ -62,13 +133,7 @@ bool NewMapBinaryFile::write(MapComposite *mapComposite, const QString &filePath
     int NUM_CHUNKS_Y = (mapInfo->height() + CHUNK_HEIGHT - 1) / CHUNK_HEIGHT;
 
     // Resize the grid and cleanup data from the previous cell.
-    mGridData.resize(NUM_CHUNKS_X * CHUNK_WIDTH);
-    for (int x = 0; x < NUM_CHUNKS_X * CHUNK_WIDTH; x++) {
-        mGridData[x].resize(NUM_CHUNKS_Y * CHUNK_HEIGHT);
-        for (int y = 0; y < NUM_CHUNKS_Y * CHUNK_HEIGHT; y++) {
-            mGridData[x][y].fill(LotFile::Square(), MaxLevel);
-        }
-    }
+    mGridData.reset(NUM_CHUNKS_X * CHUNK_WIDTH, NUM_CHUNKS_Y * CHUNK_HEIGHT, MaxLevel);
 
     Tile *missingTile = Tiled::Internal::TilesetManager::instance()->missingTile();
     QVector<const Tiled::Cell *> cells(40);
@@ -89,13 +154,14 @@ bool NewMapBinaryFile::write(MapComposite *mapComposite, const QString &filePath
                     }
                     if (lx >= mapWidth) continue;
                     if (ly >= mapHeight) continue;
-                    LotFile::Entry *e = new LotFile::Entry(cellToGid(cell));
-                    mGridData[lx][ly][lg->level()].Entries.append(e);
-                    mTileMap[e->gid]->used = true;
+                    uint gid = cellToGid(cell);
+                    mGridData.append(lx, ly, lg->level(), gid);
+                    mTileMap[gid]->used = true;
                 }
             }
         }
     }
+    mGridData.finish();
 
     QFile file(filePath);
     if (!file.open(QIODevice::WriteOnly /*| QIODevice::Text*/)) {
@@ -111,35 +177,30 @@ bool NewMapBinaryFile::write(MapComposite *mapComposite, const QString &filePath
     if (!generateHeaderAux(out, mapComposite))
         return false;
 
-    qint64 chunkTablePosition = file.pos();
-
-//    out << qint32(NUM_CHUNKS_X * NUM_CHUNKS_Y);
-    for (int m = 0; m < NUM_CHUNKS_X * NUM_CHUNKS_Y; m++) {
-        out << qint64(m);
-    }
-
-    QList<qint64> PositionMap;
-
+    // Encode the chunks in parallel, then write them out in order after the
+    // table of chunk positions.
+    QList<QPoint> chunkPositions;
     for (int y = 0; y < NUM_CHUNKS_Y; y++) {
         for (int x = 0; x < NUM_CHUNKS_X; x++) {
-            PositionMap += file.pos();
-            if (!generateChunk(out, mapComposite, x, y))
-                return false;
+            chunkPositions += QPoint(x, y);
         }
     }
+    QList<QByteArray> chunks = QtConcurrent::blockingMapped<QList<QByteArray> >(
+                chunkPositions, ChunkEncoder(this, mapComposite));
 
-    file.close();
-    if (!file.open(QIODevice::ReadWrite | QIODevice::Append)) {
-        mError = tr("Could not open file for writing.");
-        return false;
+    for (const QByteArray &chunk : chunks) {
+        if (chunk.isNull())
+            return false;
     }
-    file.seek(chunkTablePosition);
 
-    QDataStream out2(&file);
-    out2.setByteOrder(QDataStream::LittleEndian);
+    qint64 position = file.pos() + NUM_CHUNKS_X * NUM_CHUNKS_Y * qint64(sizeof(qint64));
+    for (const QByteArray &chunk : chunks) {
+        out << qint64(position);
+        position += chunk.size();
+    }
 
-    for (int m = 0; m < NUM_CHUNKS_X * NUM_CHUNKS_Y; m++) {
-        out2 << qint64(PositionMap[m]);
+    for (const QByteArray &chunk : chunks) {
+        out.writeRawData(chunk.constData(), chunk.size());
     }
 
     file.close();
@@ -181,7 +242,8 @@ bool NewMapBinaryFile::generateHeader(MapComposite *mapComposite)
     mTileMap.clear();
     mTileMap[0] = new LotFile::Tile;
 
-    mTilesetToFirstGid.clear();
+    mGidMapper.clear();
+    mFirstGidByTilesetName.clear();
     uint firstGid = 1;
     for (Tileset *tileset : tilesets) {
         if (!handleTileset(tileset, firstGid)) {
@@ -372,22 +434,24 @@ bool NewMapBinaryFile::generateChunk(QDataStream &out, MapComposite *mapComposit
             for (int y = 0; y < CHUNK_HEIGHT; y++) {
                 int gx = cx * CHUNK_WIDTH + x;
                 int gy = cy * CHUNK_HEIGHT + y;
-                const QList<LotFile::Entry*> &entries = mGridData[gx][gy][z].Entries;
-                if (entries.count() == 0) {
+                const int count = mGridData.count(gx, gy, z);
+                if (count == 0) {
                     notdonecount++;
-                } else {
-                    if (notdonecount > 0) {
-                        out << qint32(-1);
-                        out << qint32(notdonecount);
-                    }
-                    notdonecount = 0;
-                    out << qint32(entries.count() + 1);
-                    out << qint32(getRoomID(gx, gy, z));
+                    continue;
+                }
+                if (notdonecount > 0) {
+                    out << qint32(-1);
+                    out << qint32(notdonecount);
                 }
-                for (LotFile::Entry *entry : entries) {
-                    Q_ASSERT(mTileMap[entry->gid]);
-                    Q_ASSERT(mTileMap[entry->gid]->id != -1);
-                    out << qint32(mTileMap[entry->gid]->id);
+                notdonecount = 0;
+                out << qint32(count + 1);
+                out << qint32(getRoomID(gx, gy, z));
+                const uint *gids = mGridData.gids(gx, gy, z);
+                for (int i = 0; i < count; i++) {
+                    const LotFile::Tile *tile = mTileMap.value(gids[i]);
+                    Q_ASSERT(tile);
+                    Q_ASSERT(tile->id != -1);
+                    out << qint32(tile->id);
                 }
             }
         }
@@ -416,12 +480,13 @@ void NewMapBinaryFile::generateBuildingObjects(int mapWidth, int mapHeight,
         for (int y = rr->y; y < rr->y + rr->h; y++) {
 
             // Remember the room at each position in the map.
-            mGridData[x][y][room->floor].roomID = room->ID;
+            mGridData.setRoomID(x, y, room->floor, room->ID);
 
             /* Examine every tile inside the room.  If the tile's metaEnum >= 0
                then create a new RoomObject for it. */
-            for (LotFile::Entry *entry : mGridData[x][y][room->floor].Entries) {
-                int metaEnum = mTileMap[entry->gid]->metaEnum;
+            const uint *gids = mGridData.gids(x, y, room->floor);
+            for (int i = 0, n = mGridData.count(x, y, room->floor); i < n; i++) {
+                int metaEnum = mTileMap[gids[i]]->metaEnum;
                 if (metaEnum >= 0) {
                     LotFile::RoomObject object;
                     object.x = x;
@@ -438,8 +503,9 @@ void NewMapBinaryFile::generateBuildingObjects(int mapWidth, int mapHeight,
     int y = rr->y + rr->h;
     if (y < mapHeight) {
         for (int x = rr->x; x < rr->x + rr->w; x++) {
-            for (LotFile::Entry *entry : mGridData[x][y][room->floor].Entries) {
-                int metaEnum = mTileMap[entry->gid]->metaEnum;
+            const uint *gids = mGridData.gids(x, y, room->floor);
+            for (int i = 0, n = mGridData.count(x, y, room->floor); i < n; i++) {
+                int metaEnum = mTileMap[gids[i]]->metaEnum;
                 if (metaEnum >= 0 && TileMetaInfoMgr::instance()->isEnumNorth(metaEnum)) {
                     LotFile::RoomObject object;
                     object.x = x;
@@ -456,8 +522,9 @@ void NewMapBinaryFile::generateBuildingObjects(int mapWidth, int mapHeight,
     int x = rr->x + rr->w;
     if (x < mapWidth) {
         for (int y = rr->y; y < rr->y + rr->h; y++) {
-            for (LotFile::Entry *entry : mGridData[x][y][room->floor].Entries) {
-                int metaEnum = mTileMap[entry->gid]->metaEnum;
+            const uint *gids = mGridData.gids(x, y, room->floor);
+            for (int i = 0, n = mGridData.count(x, y, room->floor); i < n; i++) {
+                int metaEnum = mTileMap[gids[i]]->metaEnum;
                 if (metaEnum >= 0 && TileMetaInfoMgr::instance()->isEnumWest(metaEnum)) {
                     LotFile::RoomObject object;
                     object.x = x - 1;
@@ -481,7 +548,7 @@ QString NewMapBinaryFile::nameOfTileset(const Tileset *tileset)
     return name;
 }
 
-bool NewMapBinaryFile::handleTileset(const Tiled::Tileset *tileset, uint &firstGid)
+bool NewMapBinaryFile::handleTileset(Tiled::Tileset *tileset, uint &firstGid)
 {
     if (!tileset->fileName().isEmpty()) {
         mError = tr("Only tileset image files supported, not external tilesets");
@@ -492,15 +559,12 @@ bool NewMapBinaryFile::handleTileset(const Tiled::Tileset *tileset, uint &firstG
 
     // TODO: Verify that two tilesets sharing the same name are identical
     // between maps.
-    QMap<const Tileset*,uint>::const_iterator i = mTilesetToFirstGid.begin();
-    QMap<const Tileset*,uint>::const_iterator i_end = mTilesetToFirstGid.end();
-    while (i != i_end) {
-        QString name2 = nameOfTileset(i.key());
-        if (name == name2) {
-            mTilesetToFirstGid.insert(tileset, i.value());
-            return true;
-        }
-        ++i;
+    // The first tileset with a given name, which has the lowest first gid,
+    // supplies the tiles for every other tileset of that name.
+    QMap<QString,uint>::const_iterator it = mFirstGidByTilesetName.constFind(name);
+    if (it != mFirstGidByTilesetName.constEnd()) {
+        mGidMapper.insertAlias(it.value(), tileset);
+        return true;
     }
 
     for (int i = 0; i < tileset->tileCount(); ++i) {
@@ -511,7 +575,8 @@ bool NewMapBinaryFile::handleTileset(const Tiled::Tileset *tileset, uint &firstG
         mTileMap[ID] = tile;
     }
 
-    mTilesetToFirstGid.insert(tileset, firstGid);
+    mGidMapper.insert(firstGid, tileset);
+    mFirstGidByTilesetName.insert(name, firstGid);
     firstGid += uint(tileset->tileCount());
 
     return true;
@@ -519,22 +584,16 @@ bool NewMapBinaryFile::handleTileset(const Tiled::Tileset *tileset, uint &firstG
 
 int NewMapBinaryFile::getRoomID(int x, int y, int z)
 {
-    return mGridData[x][y][z].roomID;
+    return mGridData.roomID(x, y, z);
 }
 
 uint NewMapBinaryFile::cellToGid(const Cell *cell)
 {
-    Tileset *tileset = cell->tile->tileset();
-
-    QMap<const Tileset*,uint>::const_iterator i = mTilesetToFirstGid.begin();
-    QMap<const Tileset*,uint>::const_iterator i_end = mTilesetToFirstGid.end();
-    while (i != i_end && i.key() != tileset) {
-        ++i;
-    }
-    if (i == i_end) {// tileset not found
+    // Flip flags aren't stored in .lotpack files.
+    const uint firstGid = mGidMapper.firstGid(cell->tile->tileset());
+    if (firstGid == 0) // tileset not found
         return 0;
-    }
-    return i.value() + uint(cell->tile->id());
+    return firstGid + uint(cell->tile->id());
 }
 
 bool NewMapBinaryFile::processObjectGroups(MapComposite *mapComposite)
@@ -1,6 +1,8 @@
 #ifndef TMXBINARY_H
 #define TMXBINARY_H
 
+#include "gidmapper.h"
+
 #include <QMap>
 #include <QObject>
 #include <QRect>
@@ -55,39 +57,69 @@ public:
     int h;
 };
 
-class Entry
+/**
+ * The tiles and room IDs of every square in a map.  Each level keeps the gids
+ * of all its squares in one contiguous array, with a per-square offset into
+ * it (compressed sparse row form), so no per-square or per-tile allocations
+ * are needed.
+ */
+class SquareGrid
 {
 public:
-    Entry(uint gid) :
-        gid(gid)
+    SquareGrid() :
+        mWidth(0),
+        mHeight(0)
     {
     }
 
-    uint gid;
-};
+    /**
+     * Empties the grid, keeping previously allocated memory where possible.
+     */
+    void reset(int width, int height, int levels);
 
-class Square
-{
-public:
-    Square() :
-        roomID(-1)
-    {
+    /**
+     * Appends a tile to a square.  Within each level, tiles must be appended
+     * in increasing y, then x order.  finish() must be called once all the
+     * tiles have been appended.
+     */
+    void append(int x, int y, int z, uint gid);
+    void finish();
 
-    }
-    ~Square()
+    int count(int x, int y, int z) const
     {
-        qDeleteAll(Entries);
+        const Level &level = mLevels[z];
+        const int index = y * mWidth + x;
+        return level.offsets[index + 1] - level.offsets[index];
     }
-    Square &operator=(const Square &other)
+
+    const uint *gids(int x, int y, int z) const
     {
-        qDeleteAll(Entries);
-        Entries = other.Entries;
-        roomID = other.roomID;
-        return *this;
+        const Level &level = mLevels[z];
+        return level.gids.constData() + level.offsets[y * mWidth + x];
     }
 
-    QList<Entry*> Entries;
-    int roomID;
+    int roomID(int x, int y, int z) const
+    { return mLevels[z].roomIDs[y * mWidth + x]; }
+
+    void setRoomID(int x, int y, int z, int roomID)
+    { mLevels[z].roomIDs[y * mWidth + x] = roomID; }
+
+private:
+    struct Level
+    {
+        Level() : next(0) {}
+
+        QVector<qint32> offsets;
+        QVector<uint> gids;
+        QVector<qint32> roomIDs;
+        int next; // first square whose offset isn't set yet
+    };
+
+    void fillOffsets(Level &level, int end);
+
+    int mWidth;
+    int mHeight;
+    QVector<Level> mLevels;
 };
 
 class Zone
@@ -259,7 +291,7 @@ public:
     void generateBuildingObjects(int mapWidth, int mapHeight,
                                  LotFile::Room *room, LotFile::RoomRect *rr);
     QString nameOfTileset(const Tiled::Tileset *tileset);
-    bool handleTileset(const Tiled::Tileset *tileset, uint &firstGid);
+    bool handleTileset(Tiled::Tileset *tileset, uint &firstGid);
 
     int getRoomID(int x, int y, int z);
 
@@ -276,10 +308,11 @@ private:
 
 private:
     QList<LotFile::Zone*> ZoneList;
-    QMap<const Tiled::Tileset*,uint> mTilesetToFirstGid;
+    Tiled::GidMapper mGidMapper;
+    QMap<QString,uint> mFirstGidByTilesetName;
     Tiled::Tileset *mJumboTreeTileset;
     QMap<uint,LotFile::Tile*> mTileMap;
-    QVector<QVector<QVector<LotFile::Square> > > mGridData;
+    LotFile::SquareGrid mGridData;
     int MaxLevel;
     int Version;
     QList<LotFile::RoomRect*> mRoomRects;
@@ -45,8 +45,20 @@ void PackExtractDialog::accept()
     if (!outputDir.exists())
         return;
 
+    // Only decode the pages that have something to extract.
+    QList<int> pageIndices;
+    for (int i = 0; i < mPackFile.pages().size(); i++) {
+        foreach (const PackSubTexInfo &tex, mPackFile.pages().at(i).mInfo) {
+            if (prefix.isEmpty() || tex.name.startsWith(prefix, Qt::CaseInsensitive)) {
+                pageIndices += i;
+                break;
+            }
+        }
+    }
+    mPackFile.decodeImages(pageIndices);
+
     if (ui->radioMultiple->isChecked()) {
-        foreach (PackPage page, mPackFile.pages()) {
+        foreach (const PackPage &page, mPackFile.pages()) {
             foreach (PackSubTexInfo tex, page.mInfo) {
                 if (prefix.isEmpty() || tex.name.startsWith(prefix, Qt::CaseInsensitive)) {
                     QImage image(tex.fx, tex.fy, QImage::Format_ARGB32);
@@ -67,7 +79,7 @@ void PackExtractDialog::accept()
         };
         QRect bounds(0, 0, 0, 0);
         QList<TileInfo> tiles;
-        foreach (PackPage page, mPackFile.pages()) {
+        foreach (const PackPage &page, mPackFile.pages()) {
             foreach (PackSubTexInfo tex, page.mInfo) {
                 if (tex.name.startsWith(prefix, Qt::CaseInsensitive)) {
                     QString tileName;
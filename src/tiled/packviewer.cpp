@@ -97,8 +97,10 @@ void PackViewer::openPack()
 
     PROGRESS *progress = new PROGRESS(tr("Loading %1").arg(QFileInfo(fileName).completeBaseName()), this);
 
-    if (!mPackFile.read(fileName))
+    if (!mPackFile.read(fileName)) {
+        delete progress;
         return;
+    }
 
     ui->listWidget->clear();
     int numImages = 0;
@@ -122,7 +124,7 @@ void PackViewer::itemSelectionChanged()
     QList<QListWidgetItem*> items = ui->listWidget->selectedItems();
     if (items.size() == 1) {
         int row = ui->listWidget->row(items.first());
-        QPixmap pixmap = QPixmap::fromImage(mPackFile.pages().at(row).image);
+        QPixmap pixmap = QPixmap::fromImage(mPackFile.pageImage(row));
         mRectItem->setRect(QRectF(QPoint(-1, -1), pixmap.size() + QSize(1, 1)));
         mRectItem->show();
         mPixmapItem->setPackPage(mPackFile.pages().at(row));
@@ -93,6 +93,10 @@ Preferences::Preferences()
     mShowAdjacentMaps = mSettings->value(QLatin1String("ShowAdjacentMaps"), true).toBool();
     mHighlightRoomUnderPointer = mSettings->value(QLatin1String("HighlightRoomUnderPointer"), false).toBool();
     mTilesetBackgroundColor = QColor(mSettings->value(QLatin1String("TilesetBackgroundColor"), QColor(Qt::white).name()).toString());
+    mUseRenderCache = mSettings->value(QLatin1String("UseRenderCache"), false).toBool();
+    mRenderCacheSize = mSettings->value(QLatin1String("RenderCacheSize"), 256).toInt();
+    mTileMipmaps = mSettings->value(QLatin1String("TileMipmaps"), true).toBool();
+    mTilesetDiskCache = mSettings->value(QLatin1String("TilesetDiskCache"), false).toBool();
 #endif
     mSettings->endGroup();
 #ifdef ZOMBOID
@@ -622,4 +626,38 @@ void Preferences::setTilesetBackgroundColor(const QColor &color)
     emit tilesetBackgroundColorChanged(mTilesetBackgroundColor);
 }
 
+void Preferences::setUseRenderCache(bool useCache)
+{
+    if (mUseRenderCache == useCache)
+        return;
+    mUseRenderCache = useCache;
+    mSettings->setValue(QLatin1String("Interface/UseRenderCache"), mUseRenderCache);
+    emit useRenderCacheChanged(mUseRenderCache);
+}
+
+void Preferences::setRenderCacheSize(int megabytes)
+{
+    if (mRenderCacheSize == megabytes)
+        return;
+    mRenderCacheSize = megabytes;
+    mSettings->setValue(QLatin1String("Interface/RenderCacheSize"), mRenderCacheSize);
+    emit renderCacheSizeChanged(mRenderCacheSize);
+}
+
+void Preferences::setTileMipmaps(bool enabled)
+{
+    if (mTileMipmaps == enabled)
+        return;
+    mTileMipmaps = enabled;
+    mSettings->setValue(QLatin1String("Interface/TileMipmaps"), mTileMipmaps);
+}
+
+void Preferences::setTilesetDiskCache(bool enabled)
+{
+    if (mTilesetDiskCache == enabled)
+        return;
+    mTilesetDiskCache = enabled;
+    mSettings->setValue(QLatin1String("Interface/TilesetDiskCache"), mTilesetDiskCache);
+}
+
 #endif // ZOMBOID
@@ -136,6 +136,29 @@ public:
 
     QColor tilesetBackgroundColor() const
     { return mTilesetBackgroundColor; }
+
+    bool useRenderCache() const
+    { return mUseRenderCache; }
+
+    /**
+     * The memory cap of the map view's render cache in megabytes.
+     */
+    int renderCacheSize() const
+    { return mRenderCacheSize; }
+
+    /**
+     * Whether tileset images get smaller copies for drawing zoomed out.
+     * Read by TilesetManager at startup.
+     */
+    bool tileMipmaps() const
+    { return mTileMipmaps; }
+
+    /**
+     * Whether decoded tileset images are kept in the "tilesetcache"
+     * directory under configPath().  Read by TilesetManager at startup.
+     */
+    bool tilesetDiskCache() const
+    { return mTilesetDiskCache; }
 #endif // ZOMBOID
 
     /**
@@ -163,6 +186,10 @@ public slots:
     void setHighlightRoomUnderPointer(bool highlight);
     void setEraserBrushSize(int newSize);
     void setTilesetBackgroundColor(const QColor& color);
+    void setUseRenderCache(bool useCache);
+    void setRenderCacheSize(int megabytes);
+    void setTileMipmaps(bool enabled);
+    void setTilesetDiskCache(bool enabled);
 #endif
 
 signals:
@@ -192,6 +219,8 @@ signals:
     void highlightRoomUnderPointerChanged(bool highlight);
     void eraserBrushSizeChanged(int newSize);
     void tilesetBackgroundColorChanged(const QColor &color);
+    void useRenderCacheChanged(bool useCache);
+    void renderCacheSizeChanged(int megabytes);
 #endif
 
 private:
@@ -232,6 +261,10 @@ private:
     bool mHighlightRoomUnderPointer;
     int mEraserBrushSize;
     QColor mTilesetBackgroundColor;
+    bool mUseRenderCache;
+    int mRenderCacheSize;
+    bool mTileMipmaps;
+    bool mTilesetDiskCache;
 #endif
 
     static Preferences *mInstance;
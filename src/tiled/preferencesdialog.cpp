@@ -147,6 +147,14 @@ PreferencesDialog::PreferencesDialog(QWidget *parent) :
 #ifdef ZOMBOID
     connect(mUi->gridColorReset, SIGNAL(clicked()),
             SLOT(defaultGridColor()));
+    connect(mUi->renderCache, SIGNAL(toggled(bool)),
+            Preferences::instance(), SLOT(setUseRenderCache(bool)));
+    connect(mUi->renderCacheSize, SIGNAL(valueChanged(int)),
+            Preferences::instance(), SLOT(setRenderCacheSize(int)));
+    connect(mUi->tileMipmaps, SIGNAL(toggled(bool)),
+            Preferences::instance(), SLOT(setTileMipmaps(bool)));
+    connect(mUi->tilesetDiskCache, SIGNAL(toggled(bool)),
+            Preferences::instance(), SLOT(setTilesetDiskCache(bool)));
     connect(mUi->bgColor, SIGNAL(colorChanged(QColor)),
             Preferences::instance(), SLOT(setBackgroundColor(QColor)));
     connect(mUi->bgColorReset, SIGNAL(clicked()),
@@ -371,6 +379,12 @@ void PreferencesDialog::fromPreferences()
     mUi->enableDtd->setChecked(prefs->dtdEnabled());
     if (mUi->openGL->isEnabled())
         mUi->openGL->setChecked(prefs->useOpenGL());
+#ifdef ZOMBOID
+    mUi->renderCache->setChecked(prefs->useRenderCache());
+    mUi->renderCacheSize->setValue(prefs->renderCacheSize());
+    mUi->tileMipmaps->setChecked(prefs->tileMipmaps());
+    mUi->tilesetDiskCache->setChecked(prefs->tilesetDiskCache());
+#endif
 
     int formatIndex = 0;
     switch (prefs->layerDataFormat()) {
@@ -22,6 +22,8 @@
 #include "tiledeffile.h"
 #include "zprogress.h"
 
+#include "tile.h"
+
 #include <QDebug>
 #include <QDir>
 #include <QFile>
@@ -825,142 +827,28 @@ bool TexturePacker::isSolidFloor(const QList<TileDefTileset *> &tilesets, int ti
     return false;
 }
 
-TexturePacker::Translation TexturePacker::WorkOutTranslation(QImage image)
+TexturePacker::Translation TexturePacker::WorkOutTranslation(const QImage &image)
 {
-    int y1 = 0;
-    int x1 = 0;
-    int width = image.width();
-    int height = image.height();
-
-    bool flag1 = false;
-    for (int y2 = 0; y2 < image.height() && !flag1; ++y2) {
-        for (int x2 = 0; x2 < image.width(); ++x2) {
-            if (qAlpha(image.pixel(x2, y2)) > 0) {
-                y1 = y2;
-                flag1 = true;
-                break;
-            }
-        }
-    }
-
-    bool flag2 = false;
-    for (int y2 = image.height() - 1; y2 >= 0 && !flag2; --y2) {
-        for (int x2 = 0; x2 < image.width(); ++x2) {
-            if (qAlpha(image.pixel(x2, y2)) > 0) {
-                height = y2 - (y1 - 1);
-                flag2 = true;
-                break;
-            }
-        }
-    }
-
-    bool flag3 = false;
-    for (int x2 = 0; x2 < image.width() && !flag3; ++x2) {
-        for (int y2 = 0; y2 < image.height(); ++y2) {
-            if (qAlpha(image.pixel(x2, y2)) > 0) {
-                x1 = x2;
-                flag3 = true;
-                break;
-            }
-        }
-    }
-
-    bool flag4 = false;
-    for (int x2 = image.width() - 1; x2 >= 0 && !flag4; --x2) {
-        for (int y2 = 0; y2 < image.height(); ++y2) {
-            if (qAlpha(image.pixel(x2, y2)) > 0) {
-                width = x2 - (x1 - 1);
-                flag4 = true;
-                break;
-            }
-        }
-    }
+    QRect bounds = Tile::opaqueBounds(image);
+    if (bounds.isNull())
+        bounds = image.rect();
 
     Translation tln;
-    tln.topLeft = QPoint(x1, y1);
-    tln.size = QSize(width, height);
+    tln.topLeft = bounds.topLeft();
+    tln.size = bounds.size();
     tln.originalSize = image.size();
     return tln;
 }
 
-TexturePacker::Translation TexturePacker::WorkOutTranslation(QImage image, int sx, int sy, int cutWidth, int cutHeight)
+TexturePacker::Translation TexturePacker::WorkOutTranslation(const QImage &image, int sx, int sy, int cutWidth, int cutHeight)
 {
-    int endY = sy + cutHeight;
-    int endX = sx + cutWidth;
-    int y1 = sy;
-    int x1 = sx;
-    int width1 = cutWidth;
-    int height = cutHeight;
-
-    bool flag1 = false;
-    for (int y2 = sy; y2 < endY && !flag1; ++y2)
-    {
-        for (int x2 = sx; x2 < endX; ++x2)
-        {
-            if (qAlpha(image.pixel(x2, y2)) > 0)
-            {
-                y1 = y2;
-                flag1 = true;
-                break;
-            }
-        }
-    }
-    if (!flag1)
-        return Translation();
-
-    bool flag2 = false;
-    for (int y2 = endY - 1; y2 >= sy && !flag2; --y2)
-    {
-        for (int x2 = sx; x2 < endX; ++x2)
-        {
-            if (qAlpha(image.pixel(x2, y2)) > 0)
-            {
-                height = y2 - (y1 - 1);
-                flag2 = true;
-                break;
-            }
-        }
-    }
-    if (!flag2)
-        return Translation();
-
-    bool flag3 = false;
-    for (int x2 = sx; x2 < endX && !flag3; ++x2)
-    {
-        for (int y2 = sy; y2 < endY; ++y2)
-        {
-            if (qAlpha(image.pixel(x2, y2)) > 0)
-            {
-                x1 = x2;
-                flag3 = true;
-                break;
-            }
-        }
-    }
-    if (!flag3)
-        return Translation();
-
-    bool flag4 = false;
-    for (int x2 = endX - 1; x2 >= sx && !flag4; --x2)
-    {
-        for (int y2 = sy; y2 < endY; ++y2)
-        {
-            if (qAlpha(image.pixel(x2, y2)) > 0)
-            {
-                width1 = x2 - (x1 - 1);
-                flag4 = true;
-                break;
-            }
-        }
-    }
-    if (!flag4)
+    QRect bounds = Tile::opaqueBounds(image, QRect(sx, sy, cutWidth, cutHeight));
+    if (bounds.isNull())
         return Translation();
 
     Translation tln;
-    tln.topLeft = QPoint(x1, y1);
-    tln.size = QSize(width1, height);
-//    int width2 = image.width();
-//    int num3 = tln.topLeft.x + tln.size.width();
+    tln.topLeft = bounds.topLeft();
+    tln.size = bounds.size();
     tln.originalSize = QSize(cutWidth, cutHeight);
     tln.sheetOffset = QPoint(sx, sy);
     return tln;
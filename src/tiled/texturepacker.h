@@ -134,8 +134,8 @@ private:
         QPoint sheetOffset;
         QPoint topLeft;
     };
-    TexturePacker::Translation WorkOutTranslation(QImage image);
-    TexturePacker::Translation WorkOutTranslation(QImage image, int sx, int sy, int cutWidth, int cutHeight);
+    TexturePacker::Translation WorkOutTranslation(const QImage &image);
+    TexturePacker::Translation WorkOutTranslation(const QImage &image, int sx, int sy, int cutWidth, int cutHeight);
 
     class Comparator
     {
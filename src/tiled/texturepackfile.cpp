@@ -18,134 +18,207 @@
 #include "texturepackfile.h"
 
 #include <QBuffer>
-#include <QDebug>
 #include <QDataStream>
-#include <QFile>
+#include <QtConcurrentMap>
+#include <QtEndian>
 
-PackFile::PackFile()
+#include <string.h>
+
+PackFile::PackFile() :
+    mData(nullptr)
 {
 
 }
 
 PackFile::~PackFile()
 {
-
+    close();
 }
 
-static int readInt(QDataStream &in)
+static void SaveString(QDataStream &out, QString &str)
 {
-    qint32 ret;
-    in >> ret;
-    return ret;
+    out << (qint32) str.length();
+    for (int i = 0; i < str.length(); i++)
+        out << (quint8) str.at(i).toLatin1();
 }
 
-static int chl1 = 0;
-static int chl2 = 0;
-static int chl3 = 0;
-static int chl4 = 0;
-static int readIntByte(QDataStream &in)
-{
-    int ch1 = chl2;
-    int ch2 = chl3;
-    int ch3 = chl4;
-    quint8 ch;
-    in >> ch;
-    int ch4 = ch;
-    chl1 = ch1;
-    chl2 = ch2;
-    chl3 = ch3;
-    chl4 = ch4;
-//    if ((ch1 | ch2 | ch3 | ch4) < 0)
-//        throw new EOFException();
-
-    return ((ch1 << 0) + (ch2 << 8) + (ch3 << 16) + (ch4 << 24));
-}
+namespace {
 
-static QString ReadString(QDataStream &in)
+// Parses the .pack format straight out of the mapped file.
+class PackReader
 {
-    QString str;
-    int len = readInt(in);
-    for (int n = 0; n < len; n++) {
-        quint8 c;
-        in >> c;
-        str += QLatin1Char(c);
+public:
+    PackReader(const uchar *data, qint64 size) :
+        mPos(data),
+        mEnd(data + size),
+        mOK(true)
+    {
     }
-    return str;
-}
 
-static void SaveString(QDataStream &out, QString &str)
+    bool ok() const { return mOK; }
+
+    int readInt()
+    {
+        if (mEnd - mPos < 4) {
+            mOK = false;
+            return 0;
+        }
+        qint32 value = qFromLittleEndian<qint32>(mPos);
+        mPos += 4;
+        return value;
+    }
+
+    QString readString()
+    {
+        int length = readInt();
+        if (length < 0 || mEnd - mPos < length) {
+            mOK = false;
+            return QString();
+        }
+        QString str = QString::fromLatin1(reinterpret_cast<const char*>(mPos), length);
+        mPos += length;
+        return str;
+    }
+
+    // The PNG data of each page has no length prefix, it is followed by
+    // 0xDEADBEEF instead.  Returns the data before that marker without
+    // copying it and moves past the marker.
+    QByteArray readPNG()
+    {
+        static const uchar Marker[4] = { 0xEF, 0xBE, 0xAD, 0xDE };
+        const uchar *p = mPos;
+        while (mEnd - p >= 4) {
+            p = static_cast<const uchar*>(memchr(p, Marker[0], size_t(mEnd - p) - 3));
+            if (!p)
+                break;
+            if (memcmp(p, Marker, 4) == 0) {
+                QByteArray png = QByteArray::fromRawData(reinterpret_cast<const char*>(mPos),
+                                                         int(p - mPos));
+                mPos = p + 4;
+                return png;
+            }
+            ++p;
+        }
+        mOK = false;
+        return QByteArray();
+    }
+
+private:
+    const uchar *mPos;
+    const uchar *mEnd;
+    bool mOK;
+};
+
+class PngDecoder
 {
-    out << (qint32) str.length();
-    for (int i = 0; i < str.length(); i++)
-        out << (quint8) str.at(i).toLatin1();
-}
+public:
+    typedef QImage result_type;
+
+    QImage operator()(const QByteArray &png) const
+    {
+        QImage image;
+        image.loadFromData(png, "PNG");
+        return image;
+    }
+};
+
+} // namespace
 
 bool PackFile::read(const QString &fileName)
 {
-    mPages.clear();
+    close();
 
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly)) {
+    mFile.setFileName(fileName);
+    if (!mFile.open(QIODevice::ReadOnly)) {
         mError = tr("Error opening file for reading.\n%1").arg(fileName);
         return false;
     }
 
-//    QDir dir = QFileInfo(fileName).absoluteDir();
+    qint64 size = mFile.size();
+    mData = (size > 0) ? mFile.map(0, size) : nullptr;
+    if (!mData) {
+        mError = tr("Error mapping file for reading.\n%1").arg(fileName);
+        mFile.close();
+        return false;
+    }
 
-    QDataStream in(&file);
-    in.setByteOrder(QDataStream::LittleEndian);
+    PackReader in(mData, size);
 
-    int numPages = readInt(in);
-    qDebug() << "PackFile: reading" << numPages << "pages";
-    for (int i = 0; i < numPages; i++) {
+    int numPages = in.readInt();
+    for (int i = 0; i < numPages && in.ok(); i++) {
         PackPage page;
-        page.name = ReadString(in);
-        int numEntries = readInt(in);
-        bool mask = readInt(in) != 0;
-        qDebug() << "PackFile: page=" << page.name << "numEntries=" << numEntries;
-
-        for (int n = 0; n < numEntries; n++) {
-            QString entryName = ReadString(in);
-            qDebug() << entryName;
-            int x = readInt(in);
-            int y = readInt(in);
-            int w = readInt(in);
-            int h = readInt(in);
-            int ox = readInt(in);
-            int oy = readInt(in);
-            int fx = readInt(in);
-            int fy = readInt(in);
-            page.mInfo += PackSubTexInfo(x, y, w, h, ox, oy, fx, fy, entryName);
-        }
+        page.name = in.readString();
+        int numEntries = in.readInt();
+        bool mask = in.readInt() != 0;
+        Q_UNUSED(mask);
 
-        QBuffer buf;
-        buf.buffer().reserve(250 * 1024);
-        buf.open(QBuffer::ReadWrite);
-        while (true) {
-            quint32 ii = readIntByte(in);
-            if (ii == 0xDEADBEEF)
-                break;
-            char ch = ((ii >> 24) & 0xFF);
-            int n = buf.write(&ch, 1);
-            if (n != 1)
-                break;
+        for (int n = 0; n < numEntries && in.ok(); n++) {
+            QString entryName = in.readString();
+            int x = in.readInt();
+            int y = in.readInt();
+            int w = in.readInt();
+            int h = in.readInt();
+            int ox = in.readInt();
+            int oy = in.readInt();
+            int fx = in.readInt();
+            int fy = in.readInt();
+            page.mInfo += PackSubTexInfo(x, y, w, h, ox, oy, fx, fy, entryName);
         }
 
-        qDebug() << "Creating PNG" << page.name << "size=" << buf.size();
-        page.image.loadFromData(buf.buffer(), "PNG");
-
-//        quint32 magic = readInt(in);
-//        if (magic != 0xDEADBEEF) {
-//            mError = tr("Expected 0xDEADBEEF after PNG data");
-//            return false;
-//        }
+        page.pngData = in.readPNG();
 
         mPages += page;
     }
 
+    if (!in.ok()) {
+        close();
+        mError = tr("The .pack file is truncated or corrupt.\n%1").arg(fileName);
+        return false;
+    }
+
     return true;
 }
 
+QImage PackFile::pageImage(int pageIndex)
+{
+    if (pageIndex < 0 || pageIndex >= mPages.size())
+        return QImage();
+    decodeImages(QList<int>() << pageIndex);
+    return mPages[pageIndex].image;
+}
+
+void PackFile::decodeImages(const QList<int> &pageIndices)
+{
+    QList<int> pending;
+    QList<QByteArray> pngData;
+    foreach (int pageIndex, pageIndices) {
+        if (pageIndex < 0 || pageIndex >= mPages.size())
+            continue;
+        const PackPage &page = mPages.at(pageIndex);
+        if (page.image.isNull() && !page.pngData.isEmpty() && !pending.contains(pageIndex)) {
+            pending += pageIndex;
+            pngData += page.pngData;
+        }
+    }
+    if (pending.isEmpty())
+        return;
+
+    QList<QImage> images = QtConcurrent::blockingMapped<QList<QImage> >(pngData, PngDecoder());
+    for (int i = 0; i < pending.size(); i++)
+        mPages[pending[i]].image = images[i];
+}
+
+void PackFile::close()
+{
+    // Pages may reference the mapping, drop them first.
+    mPages.clear();
+    if (mData) {
+        mFile.unmap(mData);
+        mData = nullptr;
+    }
+    mFile.close();
+}
+
 bool PackFile::write(const QString &fileName)
 {
     QFile file(fileName);
@@ -174,10 +247,15 @@ bool PackFile::write(const QString &fileName)
             out << (qint32) info.fx;
             out << (qint32) info.fy;
         }
-        QBuffer b;
-        b.buffer().reserve(250 * 1024);
-        page.image.save(&b, "PNG");
-        out.writeRawData(b.buffer().data(), b.buffer().length());
+        if (page.image.isNull() && !page.pngData.isEmpty()) {
+            // A page read from disk that was never decoded.
+            out.writeRawData(page.pngData.constData(), page.pngData.length());
+        } else {
+            QBuffer b;
+            b.buffer().reserve(250 * 1024);
+            page.image.save(&b, "PNG");
+            out.writeRawData(b.buffer().data(), b.buffer().length());
+        }
         out << (quint32) 0xDEADBEEF;
     }
 
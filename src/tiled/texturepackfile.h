@@ -19,6 +19,7 @@
 #define TEXTUREPACKFILE_H
 
 #include <QCoreApplication>
+#include <QFile>
 #include <QImage>
 
 class PackSubTexInfo
@@ -43,11 +44,15 @@ public:
 class PackPage
 {
 public:
-    const QList<PackSubTexInfo> &subTextures() { return mInfo; }
+    const QList<PackSubTexInfo> &subTextures() const { return mInfo; }
 
     QString name;
     QList<PackSubTexInfo> mInfo;
     QImage image;
+
+    // The encoded PNG of a page read from disk.  This points into the
+    // PackFile's mapping of the file and is only valid while it stays open.
+    QByteArray pngData;
 };
 
 class PackFile
@@ -65,9 +70,25 @@ public:
     void addPage(PackPage &page) { mPages += page; }
     const QList<PackPage> &pages() const { return mPages; }
 
+    /**
+     * Returns the image of the given page, decoding its PNG data the first
+     * time it is asked for.  read() only parses the sub-texture metadata.
+     */
+    QImage pageImage(int pageIndex);
+
+    /**
+     * Decodes the images of the given pages in parallel, skipping any that
+     * were decoded already.
+     */
+    void decodeImages(const QList<int> &pageIndices);
+
+    void close();
+
 private:
     QList<PackPage> mPages;
     QString mError;
+    QFile mFile;
+    uchar *mData;
 };
 
 #endif // TEXTUREPACKFILE_H
@@ -19,9 +19,11 @@
 #define THREADS_H
 
 #include <QCoreApplication>
+#include <QList>
 #include <QMutex>
 #include <QWaitCondition>
 #include <QThread>
+#include <QVector>
 
 #define IN_APP_THREAD Q_ASSERT(QThread::currentThread() == qApp->thread());
 #define IN_WORKER_THREAD Q_ASSERT(QThread::currentThread() != qApp->thread());
@@ -40,6 +42,13 @@ public:
 
     InterruptibleThread *workerThread() const { return mThread; }
 
+public slots:
+    /**
+      * Called when jobs were added to a SharedJobQueue the worker takes
+      * jobs from.
+      */
+    void jobsAvailable() { scheduleWork(); }
+
 protected:
     void scheduleWork();
     void allowWork();
@@ -93,6 +102,167 @@ private:
     friend class BaseWorker;
 };
 
+/**
+  * A priority-ordered queue of jobs shared by several workers.  Whichever
+  * worker is free takes the next job, so a slow job on one thread doesn't
+  * hold up the jobs queued behind it.  Jobs with the same priority are
+  * taken in the order they were added.
+  *
+  * Jobs are compared with ==, so T is usually a pointer to the object
+  * being loaded.  A worker calls take() to get a job and finish() when it
+  * is done.
+  */
+template <typename T>
+class SharedJobQueue
+{
+public:
+    enum CancelResult {
+        NotFound,
+        Removed,   // the job was still queued, it will never run
+        Cancelled  // a worker is running it, finish() will return false
+    };
+
+    void add(const T &job, int priority = 0)
+    {
+        QMutexLocker locker(&mMutex);
+        insert(Entry(job, priority));
+    }
+
+    /**
+      * Raises the priority of a queued job.  A running job that was
+      * cancelled is un-cancelled.  Returns false if the job is neither
+      * queued nor running.
+      */
+    bool raisePriority(const T &job, int priority)
+    {
+        QMutexLocker locker(&mMutex);
+        for (int i = 0; i < mRunning.size(); i++) {
+            if (mRunning[i].job == job) {
+                mRunning[i].cancelled = false;
+                return true;
+            }
+        }
+        for (int i = 0; i < mQueued.size(); i++) {
+            if (mQueued[i].job == job) {
+                if (mQueued[i].priority < priority) {
+                    Entry entry = mQueued.takeAt(i);
+                    entry.priority = priority;
+                    insert(entry);
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    CancelResult cancel(const T &job)
+    {
+        QMutexLocker locker(&mMutex);
+        for (int i = 0; i < mQueued.size(); i++) {
+            if (mQueued[i].job == job) {
+                mQueued.removeAt(i);
+                return Removed;
+            }
+        }
+        for (int i = 0; i < mRunning.size(); i++) {
+            if (mRunning[i].job == job) {
+                mRunning[i].cancelled = true;
+                return Cancelled;
+            }
+        }
+        return NotFound;
+    }
+
+    bool take(T &job)
+    {
+        QMutexLocker locker(&mMutex);
+        if (mQueued.isEmpty())
+            return false;
+        Entry entry = mQueued.takeFirst();
+        job = entry.job;
+        mRunning += entry;
+        return true;
+    }
+
+    /**
+      * Returns false if the job was cancelled while it ran, in which case
+      * the worker should throw away the result.
+      */
+    bool finish(const T &job)
+    {
+        QMutexLocker locker(&mMutex);
+        for (int i = 0; i < mRunning.size(); i++) {
+            if (mRunning[i].job == job) {
+                bool cancelled = mRunning[i].cancelled;
+                mRunning.removeAt(i);
+                return !cancelled;
+            }
+        }
+        return true;
+    }
+
+    bool isEmpty()
+    {
+        QMutexLocker locker(&mMutex);
+        return mQueued.isEmpty();
+    }
+
+    /**
+      * Returns true if no jobs are queued or running.
+      */
+    bool isIdle()
+    {
+        QMutexLocker locker(&mMutex);
+        return mQueued.isEmpty() && mRunning.isEmpty();
+    }
+
+    QList<T> queued()
+    {
+        QMutexLocker locker(&mMutex);
+        QList<T> jobs;
+        foreach (const Entry &entry, mQueued)
+            jobs += entry.job;
+        return jobs;
+    }
+
+private:
+    struct Entry
+    {
+        Entry(const T &job, int priority) :
+            job(job),
+            priority(priority),
+            cancelled(false)
+        {}
+
+        T job;
+        int priority;
+        bool cancelled;
+    };
+
+    void insert(const Entry &entry)
+    {
+        int index = 0;
+        while (index < mQueued.size() && mQueued[index].priority >= entry.priority)
+            ++index;
+        mQueued.insert(index, entry);
+    }
+
+    QList<Entry> mQueued;
+    QList<Entry> mRunning;
+    QMutex mMutex;
+};
+
+/**
+  * Tells each worker that jobs were added to the queue they share.  The
+  * idle ones will take them.
+  */
+template <typename W>
+void wakeWorkers(const QVector<W*> &workers)
+{
+    foreach (W *worker, workers)
+        QMetaObject::invokeMethod(worker, "jobsAvailable", Qt::QueuedConnection);
+}
+
 class Sleep : public QThread
 {
 public:
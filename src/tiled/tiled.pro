@@ -24,7 +24,7 @@ win32 {
 }
 
 greaterThan(QT_MAJOR_VERSION, 4) {
-    QT += widgets
+    QT += widgets concurrent
 }
 contains(QT_CONFIG, opengl): QT += opengl
 
@@ -92,6 +92,7 @@ SOURCES += aboutdialog.cpp \
     imagelayerpropertiesdialog.cpp \
     languagemanager.cpp \
     layerdock.cpp \
+    layergrouprendercache.cpp \
     layermodel.cpp \
     luatable.cpp \
     main.cpp \
@@ -107,6 +108,7 @@ SOURCES += aboutdialog.cpp \
     movemapobject.cpp \
     movemapobjecttogroup.cpp \
     movetileset.cpp \
+    lotexportbatch.cpp \
     newmapbinaryfile.cpp \
     newmapdialog.cpp \
     newtilesetdialog.cpp \
@@ -143,6 +145,7 @@ SOURCES += aboutdialog.cpp \
     tilepainter.cpp \
     tileselectionitem.cpp \
     tileselectiontool.cpp \
+    tilesetdiskcache.cpp \
     tilesetdock.cpp \
     tilesetmanager.cpp \
     tilesetmodel.cpp \
@@ -192,6 +195,7 @@ SOURCES += aboutdialog.cpp \
     BuildingEditor/buildingpreferences.cpp \
     BuildingEditor/buildingtmx.cpp \
     BuildingEditor/tilecategoryview.cpp \
+    BuildingEditor/tilenameatoms.cpp \
     BuildingEditor/listofstringsdialog.cpp \
     tilemetainfodialog.cpp \
     tilemetainfomgr.cpp \
@@ -199,6 +203,8 @@ SOURCES += aboutdialog.cpp \
     BuildingEditor/buildingfloorsdialog.cpp \
     BuildingEditor/buildingtiletools.cpp \
     BuildingEditor/buildingmap.cpp \
+    BuildingEditor/buildingmapconverter.cpp \
+    BuildingEditor/buildingpickindex.cpp \
     BuildingEditor/buildingfurnituredock.cpp \
     BuildingEditor/buildingtilesetdock.cpp \
     BuildingEditor/buildinglayersdock.cpp \
@@ -307,6 +313,7 @@ HEADERS += aboutdialog.h \
     imagelayerpropertiesdialog.h \
     languagemanager.h \
     layerdock.h \
+    layergrouprendercache.h \
     layermodel.h \
     luatable.h \
     macsupport.h \
@@ -324,6 +331,7 @@ HEADERS += aboutdialog.h \
     movemapobject.h \
     movemapobjecttogroup.h \
     movetileset.h \
+    lotexportbatch.h \
     newmapbinaryfile.h \
     newmapdialog.h \
     newtilesetdialog.h \
@@ -361,6 +369,7 @@ HEADERS += aboutdialog.h \
     tilepainter.h \
     tileselectionitem.h \
     tileselectiontool.h \
+    tilesetdiskcache.h \
     tilesetdock.h \
     tilesetmanager.h \
     tilesetmodel.h \
@@ -411,6 +420,7 @@ HEADERS += aboutdialog.h \
     BuildingEditor/buildingpreferences.h \
     BuildingEditor/buildingtmx.h \
     BuildingEditor/tilecategoryview.h \
+    BuildingEditor/tilenameatoms.h \
     BuildingEditor/listofstringsdialog.h \
     tilemetainfodialog.h \
     tilemetainfomgr.h \
@@ -418,6 +428,8 @@ HEADERS += aboutdialog.h \
     BuildingEditor/buildingfloorsdialog.h \
     BuildingEditor/buildingtiletools.h \
     BuildingEditor/buildingmap.h \
+    BuildingEditor/buildingmapconverter.h \
+    BuildingEditor/buildingpickindex.h \
     BuildingEditor/buildingfurnituredock.h \
     BuildingEditor/buildingtilesetdock.h \
     BuildingEditor/buildinglayersdock.h \
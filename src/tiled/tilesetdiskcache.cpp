@@ -0,0 +1,260 @@
+/*
+ * Copyright 2026, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilesetdiskcache.h"
+
+#include "tileset.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+#define TILESET_CACHE_MAGIC 0x7153C0DE
+#define TILESET_CACHE_VERSION 1
+
+// The pixels start at the first multiple of this after the header.
+#define PIXEL_ALIGNMENT 16
+
+static qint64 pixelOffset(qint64 headerEnd)
+{
+    return (headerEnd + PIXEL_ALIGNMENT - 1) & ~qint64(PIXEL_ALIGNMENT - 1);
+}
+
+// The size of one tile in the image, and how many tiles
+// Tileset::createAtlas() cuts an image of \a imageSize into.
+static QSize tileSize(const Tileset *tileset)
+{
+    QSize size(tileset->tileWidth(), tileset->tileHeight());
+    if (!tileset->imageSource2x().isEmpty())
+        size *= 2;
+    return size;
+}
+
+static int tileCount(const Tileset *tileset, const QSize &imageSize)
+{
+    const QSize size = tileSize(tileset);
+    const int margin = tileset->margin();
+    const int spacing = tileset->tileSpacing();
+    const int stopWidth = imageSize.width() - size.width();
+    const int stopHeight = imageSize.height() - size.height();
+    if (stopWidth < margin || stopHeight < margin)
+        return 0;
+    const int columns = (stopWidth - margin) / (size.width() + spacing) + 1;
+    const int rows = (stopHeight - margin) / (size.height() + spacing) + 1;
+    return columns * rows;
+}
+
+#if QT_VERSION >= 0x050000
+static void releaseMapping(void *file)
+{
+    // Closing the file unmaps it.
+    delete static_cast<QFile*>(file);
+}
+#endif
+
+TilesetDiskCache::TilesetDiskCache(const QString &directory) :
+    mDirectory(directory)
+{
+    QDir dir(mDirectory);
+    if (!dir.exists())
+        dir.mkpath(QLatin1String("."));
+}
+
+bool TilesetDiskCache::load(const Tileset *tileset, const QString &imageFile,
+                            TilesetAtlas &atlas) const
+{
+    QFileInfo imageInfo(imageFile);
+    if (!imageInfo.exists())
+        return false;
+
+    QFile *file = new QFile(cacheFileName(tileset, imageFile));
+    if (!file->open(QIODevice::ReadOnly)) {
+        delete file;
+        return false;
+    }
+
+    QDataStream in(file);
+    in.setVersion(QDataStream::Qt_4_0);
+
+    quint32 magic, version;
+    in >> magic >> version;
+    if (magic != TILESET_CACHE_MAGIC || version != TILESET_CACHE_VERSION) {
+        delete file;
+        return false;
+    }
+
+    QString source;
+    qint64 modified, size;
+    in >> source >> modified >> size;
+    if (source != QDir::cleanPath(imageInfo.absoluteFilePath())
+            || modified != imageInfo.lastModified().toMSecsSinceEpoch()
+            || size != imageInfo.size()) {
+        delete file;
+        return false;
+    }
+
+    qint32 imageWidth, imageHeight, atlasWidth, atlasHeight, count;
+    in >> imageWidth >> imageHeight >> atlasWidth >> atlasHeight >> count;
+    if (in.status() != QDataStream::Ok || atlasWidth <= 0 || atlasHeight <= 0
+            || imageWidth <= 0 || imageHeight <= 0
+            || count != tileCount(tileset, QSize(imageWidth, imageHeight))) {
+        delete file;
+        return false;
+    }
+
+    // A damaged file mustn't point the tiles outside the mapped pixels.
+    const QRect atlasBounds(0, 0, atlasWidth, atlasHeight);
+    const QRect tileBounds(QPoint(), tileSize(tileset));
+    atlas.rects.resize(count);
+    atlas.offsets.resize(count);
+    for (int i = 0; i < count; i++) {
+        qint32 x, y, w, h, dx, dy;
+        in >> x >> y >> w >> h >> dx >> dy;
+        if (w > 0 && h > 0) {
+            QRect r(x, y, w, h);
+            if (!atlasBounds.contains(r) || !tileBounds.contains(QRect(QPoint(dx, dy), r.size()))) {
+                delete file;
+                return false;
+            }
+            atlas.rects[i] = r;
+        } else {
+            atlas.rects[i] = QRect();
+        }
+        atlas.offsets[i] = QPoint(dx, dy);
+    }
+    if (in.status() != QDataStream::Ok) {
+        delete file;
+        return false;
+    }
+
+    const qint64 offset = pixelOffset(file->pos());
+    const qint64 bytes = qint64(atlasWidth) * 4 * atlasHeight;
+    if (file->size() < offset + bytes) {
+        delete file;
+        return false;
+    }
+
+    uchar *pixels = file->map(offset, bytes);
+    if (!pixels) {
+        delete file;
+        return false;
+    }
+
+#if QT_VERSION >= 0x050000
+    // The tiles' images refer to this image, which keeps the file mapped
+    // until the last of them goes away.
+    atlas.image = QImage(pixels, atlasWidth, atlasHeight, atlasWidth * 4,
+                         QImage::Format_ARGB32_Premultiplied,
+                         releaseMapping, file);
+#else
+    atlas.image = QImage(pixels, atlasWidth, atlasHeight, atlasWidth * 4,
+                         QImage::Format_ARGB32_Premultiplied).copy();
+    delete file;
+#endif
+    atlas.imageSize = QSize(imageWidth, imageHeight);
+
+    return true;
+}
+
+bool TilesetDiskCache::save(const Tileset *tileset, const QString &imageFile,
+                            const TilesetAtlas &atlas) const
+{
+    QFileInfo imageInfo(imageFile);
+    if (!imageInfo.exists() || atlas.image.isNull())
+        return false;
+    Q_ASSERT(atlas.image.format() == QImage::Format_ARGB32_Premultiplied);
+    Q_ASSERT(atlas.image.bytesPerLine() == atlas.image.width() * 4);
+
+    // Write to a temporary file and rename it, so a reader never sees half
+    // a file.
+    const QString fileName = cacheFileName(tileset, imageFile);
+    const QString tempName = fileName + QLatin1String(".tmp");
+    QFile file(tempName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_0);
+    out << quint32(TILESET_CACHE_MAGIC);
+    out << quint32(TILESET_CACHE_VERSION);
+    out << QDir::cleanPath(imageInfo.absoluteFilePath());
+    out << qint64(imageInfo.lastModified().toMSecsSinceEpoch());
+    out << qint64(imageInfo.size());
+    out << qint32(atlas.imageSize.width()) << qint32(atlas.imageSize.height());
+    out << qint32(atlas.image.width()) << qint32(atlas.image.height());
+    out << qint32(atlas.rects.size());
+    for (int i = 0; i < atlas.rects.size(); i++) {
+        const QRect &r = atlas.rects[i];
+        out << qint32(r.x()) << qint32(r.y()) << qint32(r.width()) << qint32(r.height());
+        out << qint32(atlas.offsets[i].x()) << qint32(atlas.offsets[i].y());
+    }
+
+    const qint64 headerEnd = file.pos();
+    const qint64 padding = pixelOffset(headerEnd) - headerEnd;
+    if (padding > 0)
+        file.write(QByteArray(int(padding), '\0'));
+
+    const qint64 bytes = qint64(atlas.image.bytesPerLine()) * atlas.image.height();
+    bool ok = out.status() == QDataStream::Ok
+            && file.write(reinterpret_cast<const char*>(atlas.image.constBits()), bytes) == bytes;
+    file.close();
+
+    if (ok) {
+        QFile::remove(fileName);
+        ok = QFile::rename(tempName, fileName);
+    }
+    if (!ok) {
+        qDebug() << "TilesetDiskCache: failed to write" << fileName;
+        QFile::remove(tempName);
+    }
+    return ok;
+}
+
+void TilesetDiskCache::remove(const QString &imageFile) const
+{
+    QDir dir(mDirectory);
+    QStringList filters(pathHash(imageFile) + QLatin1String("-*"));
+    foreach (QString fileName, dir.entryList(filters, QDir::Files))
+        dir.remove(fileName);
+}
+
+QString TilesetDiskCache::cacheFileName(const Tileset *tileset, const QString &imageFile) const
+{
+    QColor transparent = tileset->transparentColor();
+    return QString(QLatin1String("%1/%2-%3x%4-%5-%6-%7.tiles"))
+            .arg(mDirectory)
+            .arg(pathHash(imageFile))
+            .arg(tileset->tileWidth())
+            .arg(tileset->tileHeight())
+            .arg(tileset->tileSpacing())
+            .arg(tileset->margin())
+            .arg(transparent.isValid() ? transparent.rgba() : 0, 8, 16, QLatin1Char('0'));
+}
+
+QString TilesetDiskCache::pathHash(const QString &imageFile)
+{
+    QString path = QDir::cleanPath(QFileInfo(imageFile).absoluteFilePath());
+    return QString::fromLatin1(QCryptographicHash::hash(path.toUtf8(),
+                                                        QCryptographicHash::Sha1).toHex());
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2026, Tim Baker <treectrl@users.sf.net>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILESETDISKCACHE_H
+#define TILESETDISKCACHE_H
+
+#include <QString>
+
+namespace Tiled {
+class Tileset;
+struct TilesetAtlas;
+
+namespace Internal {
+
+/**
+  * Keeps decoded, trimmed tileset images on disk so they don't have to be
+  * decoded from PNG again on the next run.
+  *
+  * Each tileset image gets one file holding its TilesetAtlas: a header with
+  * the tile rectangles and offsets, followed by the premultiplied pixels.
+  * The pixels are memory-mapped when loaded.  A file is only used when the
+  * path, modification time and size of the tileset image it was made from
+  * still match.
+  *
+  * The methods only touch the file for the given tileset image, so the
+  * tileset image reader threads can share one instance.
+  */
+class TilesetDiskCache
+{
+public:
+    TilesetDiskCache(const QString &directory);
+
+    /**
+      * Fills \a atlas from the cache file for \a imageFile cut up the way
+      * \a tileset says.  Returns false if there is no up-to-date file.
+      */
+    bool load(const Tileset *tileset, const QString &imageFile,
+              TilesetAtlas &atlas) const;
+
+    /**
+      * Writes \a atlas to the cache file for \a imageFile and \a tileset.
+      */
+    bool save(const Tileset *tileset, const QString &imageFile,
+              const TilesetAtlas &atlas) const;
+
+    /**
+      * Deletes every cache file made from \a imageFile.
+      */
+    void remove(const QString &imageFile) const;
+
+    QString directory() const
+    { return mDirectory; }
+
+private:
+    QString cacheFileName(const Tileset *tileset, const QString &imageFile) const;
+    static QString pathHash(const QString &imageFile);
+
+    QString mDirectory;
+};
+
+} // namespace Internal
+} // namespace Tiled
+
+#endif // TILESETDISKCACHE_H
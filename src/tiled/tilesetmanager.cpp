@@ -28,10 +28,17 @@
 #ifdef ZOMBOID
 #include "preferences.h"
 #include "tile.h"
+#include "tilesetdiskcache.h"
 #include <QDebug>
 #include <QDir>
 #include <QImageReader>
 #include <QMetaType>
+
+#ifdef QT_NO_DEBUG
+inline QNoDebug noise() { return QNoDebug(); }
+#else
+inline QDebug noise() { return QDebug(QtDebugMsg); }
+#endif
 #endif
 
 using namespace Tiled;
@@ -42,6 +49,7 @@ TilesetManager *TilesetManager::mInstance = 0;
 TilesetManager::TilesetManager():
 #ifdef ZOMBOID
     mTilesetImageCache(new TilesetImageCache),
+    mLookups(0),
 #endif
     mWatcher(new FileSystemWatcher(this)),
     mReloadTilesetsOnChange(false)
@@ -77,12 +85,20 @@ TilesetManager::TilesetManager():
 
     qRegisterMetaType<Tileset*>("Tileset*");
 
-    mImageReaderThreads.resize(8);
+    mCreateMips = Preferences::instance()->tileMipmaps();
+    mMipBytes = 0;
+    mDiskCache = 0;
+    if (Preferences::instance()->tilesetDiskCache())
+        mDiskCache = new TilesetDiskCache(Preferences::instance()->configPath(QLatin1String("tilesetcache")));
+
+    mImageReaderThreads.resize(qMax(2, QThread::idealThreadCount()));
     mImageReaderWorkers.resize(mImageReaderThreads.size());
-    mNextThreadForJob = 0;
     for (int i = 0; i < mImageReaderWorkers.size(); i++) {
         mImageReaderThreads[i] = new InterruptibleThread;
-        mImageReaderWorkers[i] = new TilesetImageReaderWorker(i, mImageReaderThreads[i]);
+        mImageReaderWorkers[i] = new TilesetImageReaderWorker(i, mImageReaderThreads[i],
+                                                              &mImageReaderJobs,
+                                                              mCreateMips,
+                                                              mDiskCache);
         mImageReaderWorkers[i]->moveToThread(mImageReaderThreads[i]);
         connect(mImageReaderWorkers[i], SIGNAL(imageLoaded(Tiled::Tileset*,Tiled::Tileset*)),
                 SLOT(imageLoaded(Tiled::Tileset*,Tiled::Tileset*)));
@@ -100,6 +116,12 @@ TilesetManager::TilesetManager():
 
     connect(&mChangedFilesTimer, SIGNAL(timeout()),
             this, SLOT(fileChangedTimeout()));
+
+#ifdef ZOMBOID
+    mMipBytesTimer.setInterval(1000);
+    mMipBytesTimer.setSingleShot(true);
+    connect(&mMipBytesTimer, SIGNAL(timeout()), SLOT(reportMipBytes()));
+#endif
 }
 
 TilesetManager::~TilesetManager()
@@ -115,6 +137,7 @@ TilesetManager::~TilesetManager()
         delete mImageReaderThreads[i];
     }
 
+    delete mDiskCache;
     delete mTilesetImageCache;
 #endif
 
@@ -144,15 +167,55 @@ void TilesetManager::deleteInstance()
 
 Tileset *TilesetManager::findTileset(const QString &fileName) const
 {
+#ifdef ZOMBOID
+    ++mLookups;
+    Tileset *tileset = mTilesetsByFileName.value(fileName);
+    Q_ASSERT(!tileset || tileset->fileName() == fileName);
+    return tileset;
+#else
     foreach (Tileset *tileset, tilesets())
         if (tileset->fileName() == fileName)
             return tileset;
 
     return 0;
+#endif
 }
 
+#ifdef ZOMBOID
+void TilesetManager::tilesetFileNameChanged(Tileset *tileset)
+{
+    if (!mTilesets.contains(tileset))
+        return;
+
+    // Drop the entry for the old name, falling back to another tileset that
+    // still has that name.
+    QHash<QString, Tileset*>::iterator it = mTilesetsByFileName.begin();
+    while (it != mTilesetsByFileName.end()) {
+        if (it.value() == tileset) {
+            QString oldName = it.key();
+            it = mTilesetsByFileName.erase(it);
+            foreach (Tileset *other, mTilesets.keys()) {
+                if (other != tileset && other->fileName() == oldName) {
+                    mTilesetsByFileName.insert(oldName, other);
+                    break;
+                }
+            }
+            break;
+        }
+        ++it;
+    }
+
+    if (!tileset->fileName().isEmpty() && !mTilesetsByFileName.contains(tileset->fileName()))
+        mTilesetsByFileName.insert(tileset->fileName(), tileset);
+}
+#endif
+
 Tileset *TilesetManager::findTileset(const TilesetSpec &spec) const
 {
+#ifdef ZOMBOID
+    ++mLookups;
+    return mTilesetsBySpec.value(spec);
+#else
     foreach (Tileset *tileset, tilesets()) {
         if (tileset->imageSource() == spec.imageSource
             && tileset->tileWidth() == spec.tileWidth
@@ -165,8 +228,71 @@ Tileset *TilesetManager::findTileset(const TilesetSpec &spec) const
     }
 
     return 0;
+#endif
+}
+
+#ifdef ZOMBOID
+uint Tiled::Internal::qHash(const TilesetSpec &spec)
+{
+    uint h = ::qHash(spec.imageSource);
+    h = h * 31 + uint(spec.tileWidth);
+    h = h * 31 + uint(spec.tileHeight);
+    h = h * 31 + uint(spec.tileSpacing);
+    return h * 31 + uint(spec.margin);
+}
+
+TilesetSpec TilesetManager::specFor(const Tileset *tileset)
+{
+    TilesetSpec spec;
+    spec.imageSource = tileset->imageSource();
+    spec.tileWidth = tileset->tileWidth();
+    spec.tileHeight = tileset->tileHeight();
+    spec.tileSpacing = tileset->tileSpacing();
+    spec.margin = tileset->margin();
+    return spec;
+}
+
+// The first tileset added with a spec is the one findTileset() returns.
+void TilesetManager::addToSpecIndex(Tileset *tileset)
+{
+    TilesetSpec spec = specFor(tileset);
+    mSpecByTileset.insert(tileset, spec);
+    if (!mTilesetsBySpec.contains(spec))
+        mTilesetsBySpec.insert(spec, tileset);
 }
 
+// Removes the tileset under the spec it was indexed with, which isn't
+// specFor(tileset) if its image source changed since.  Falls back to another
+// tileset with the same spec, if there is one.
+void TilesetManager::removeFromSpecIndex(Tileset *tileset)
+{
+    if (!mSpecByTileset.contains(tileset))
+        return;
+    TilesetSpec spec = mSpecByTileset.take(tileset);
+    if (mTilesetsBySpec.value(spec) != tileset)
+        return;
+    mTilesetsBySpec.remove(spec);
+    QHash<Tileset*, TilesetSpec>::const_iterator it = mSpecByTileset.constBegin();
+    for (; it != mSpecByTileset.constEnd(); ++it) {
+        if (it.value() == spec) {
+            mTilesetsBySpec.insert(spec, it.key());
+            break;
+        }
+    }
+}
+
+// Loading a tileset's image may change its image source, for example to
+// the one the cached image was read from.  Call this afterwards.
+void TilesetManager::updateSpecIndex(Tileset *tileset)
+{
+    QHash<Tileset*, TilesetSpec>::const_iterator it = mSpecByTileset.constFind(tileset);
+    if (it == mSpecByTileset.constEnd() || *it == specFor(tileset))
+        return;
+    removeFromSpecIndex(tileset);
+    addToSpecIndex(tileset);
+}
+#endif
+
 void TilesetManager::addReference(Tileset *tileset)
 {
     if (mTilesets.contains(tileset)) {
@@ -174,6 +300,9 @@ void TilesetManager::addReference(Tileset *tileset)
     } else {
         mTilesets.insert(tileset, 1);
 #ifdef ZOMBOID
+        if (!tileset->fileName().isEmpty() && !mTilesetsByFileName.contains(tileset->fileName()))
+            mTilesetsByFileName.insert(tileset->fileName(), tileset);
+        addToSpecIndex(tileset);
 #else
         if (!tileset->imageSource().isEmpty())
             mWatcher->addPath(tileset->imageSource());
@@ -197,6 +326,16 @@ void TilesetManager::removeReference(Tileset *tileset)
     if (mTilesets.value(tileset) == 0) {
         mTilesets.remove(tileset);
 #ifdef ZOMBOID
+        removeFromSpecIndex(tileset);
+        if (mTilesetsByFileName.value(tileset->fileName()) == tileset) {
+            mTilesetsByFileName.remove(tileset->fileName());
+            foreach (Tileset *other, mTilesets.keys()) {
+                if (other->fileName() == tileset->fileName()) {
+                    mTilesetsByFileName.insert(other->fileName(), other);
+                    break;
+                }
+            }
+        }
 #else
         if (!tileset->imageSource().isEmpty())
             mWatcher->removePath(tileset->imageSource());
@@ -293,11 +432,21 @@ void TilesetManager::fileChangedTimeout()
 {
 #ifdef ZOMBOID
     qDebug() << "fileChangedTimeout " << mChangedFiles;
+    if (mDiskCache) {
+        foreach (QString fileName, mChangedFiles)
+            mDiskCache->remove(fileName);
+    }
     foreach (Tileset *tileset, mTilesetImageCache->mTilesets) {
         QString fileName = tileset->imageSource2x().isEmpty() ? tileset->imageSource() : tileset->imageSource2x();
         if (mChangedFiles.contains(fileName)) {
             if (QImageReader(fileName).size().isValid()) {
+                const qint64 oldMipBytes = mCreateMips ? tileset->mipBytes() : 0;
                 tileset->loadFromImage(QImage(fileName), tileset->imageSource());
+                updateSpecIndex(tileset);
+                if (mCreateMips) {
+                    tileset->createMips();
+                    addMipBytes(tileset, oldMipBytes);
+                }
                 tileset->setMissing(false);
             } else {
                 if (tileset->tileHeight() == mMissingTile->width() && tileset->tileWidth() == mMissingTile->height()) {
@@ -314,6 +463,7 @@ void TilesetManager::fileChangedTimeout()
         if (mChangedFiles.contains(fileName2)) {
             if (Tileset *cached = mTilesetImageCache->findMatch(tileset, fileName, fileName2)) {
                 if (tileset->loadFromCache(cached)) {
+                    updateSpecIndex(tileset);
                     tileset->setMissing(cached->isMissing());
                     syncTileLayerNames(tileset);
                     emit tilesetChanged(tileset);
@@ -347,7 +497,13 @@ void TilesetManager::imageLoaded(QImage *image, Tileset *tileset)
     Q_ASSERT(mTilesetImageCache->mTilesets.contains(tileset));
 
     // This updates a tileset in the cache.
+    const qint64 oldMipBytes = mCreateMips ? tileset->mipBytes() : 0;
     tileset->loadFromImage(*image, tileset->imageSource());
+    updateSpecIndex(tileset);
+    if (mCreateMips) {
+        tileset->createMips();
+        addMipBytes(tileset, oldMipBytes);
+    }
 
     // Watch the image file for changes.
     mWatcher->addPath(tileset->imageSource2x().isEmpty() ? tileset->imageSource() : tileset->imageSource2x());
@@ -363,6 +519,7 @@ void TilesetManager::imageLoaded(QImage *image, Tileset *tileset)
                 && candidate->margin() == tileset->margin()
                 && candidate->transparentColor() == tileset->transparentColor()) {
             candidate->loadFromCache(tileset);
+            updateSpecIndex(candidate);
             candidate->setMissing(false);
             emit tilesetChanged(candidate);
         }
@@ -376,8 +533,12 @@ void TilesetManager::imageLoaded(Tileset *fromThread, Tileset *tileset)
 
     // This updates a tileset in the cache.
     // HACK - 'fromThread' is not in the cache, 'tileset' is
+    const qint64 oldMipBytes = mCreateMips ? tileset->mipBytes() : 0;
     tileset->loadFromCache(fromThread);
     delete fromThread;
+    updateSpecIndex(tileset);
+    if (mCreateMips)
+        addMipBytes(tileset, oldMipBytes);
 
     // Watch the image file for changes.
     mWatcher->addPath(tileset->imageSource2x().isEmpty() ? tileset->imageSource() : tileset->imageSource2x());
@@ -393,6 +554,7 @@ void TilesetManager::imageLoaded(Tileset *fromThread, Tileset *tileset)
                 && candidate->margin() == tileset->margin()
                 && candidate->transparentColor() == tileset->transparentColor()) {
             candidate->loadFromCache(tileset);
+            updateSpecIndex(candidate);
             candidate->setMissing(false);
             emit tilesetChanged(candidate);
         }
@@ -416,6 +578,7 @@ void TilesetManager::loadTileset(Tileset *tileset, const QString &imageSource_)
             //        3) 2x images remain unloaded
             if (cached->isLoaded()) {
                 tileset->loadFromCache(cached);
+                updateSpecIndex(tileset);
                 tileset->setMissing(false);
                 emit tilesetChanged(tileset);
             } else {
@@ -428,10 +591,8 @@ void TilesetManager::loadTileset(Tileset *tileset, const QString &imageSource_)
             tileset->setImageSource2x(imageSource2x);
             cached = mTilesetImageCache->addTileset(tileset);
 #if 1 /* QT_POINTER_SIZE == 8 */
-            QMetaObject::invokeMethod(mImageReaderWorkers[mNextThreadForJob],
-                                      "addJob", Qt::QueuedConnection,
-                                      Q_ARG(Tileset*,cached));
-            mNextThreadForJob = (mNextThreadForJob + 1) % mImageReaderWorkers.size();
+            mImageReaderJobs.add(cached);
+            wakeWorkers(mImageReaderWorkers);
 #else
             QImage *image = new QImage(tileset->imageSource2x());
             imageLoaded(image, cached);
@@ -442,10 +603,8 @@ void TilesetManager::loadTileset(Tileset *tileset, const QString &imageSource_)
             tileset->setImageSource2x(QString());
             cached = mTilesetImageCache->addTileset(tileset);
 #if 1 /* QT_POINTER_SIZE == 8 */
-            QMetaObject::invokeMethod(mImageReaderWorkers[mNextThreadForJob],
-                                      "addJob", Qt::QueuedConnection,
-                                      Q_ARG(Tileset*,cached));
-            mNextThreadForJob = (mNextThreadForJob + 1) % mImageReaderWorkers.size();
+            mImageReaderJobs.add(cached);
+            wakeWorkers(mImageReaderWorkers);
             qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
 #else
             QImage *image = new QImage(tileset->imageSource());
@@ -462,18 +621,25 @@ void TilesetManager::loadTileset(Tileset *tileset, const QString &imageSource_)
     }
 }
 
+// Tilesets outside the cache share their images with one in the cache, so
+// only cached tilesets are counted.  In debug builds the total is logged
+// once loading has settled down, not for every tileset.
+void TilesetManager::addMipBytes(Tileset *cached, qint64 oldBytes)
+{
+    mMipBytes += cached->mipBytes() - oldBytes;
+#ifndef QT_NO_DEBUG
+    mMipBytesTimer.start();
+#endif
+}
+
+void TilesetManager::reportMipBytes()
+{
+    noise() << "TilesetManager: tile mips use" << mMipBytes / 1024 << "KB";
+}
+
 void TilesetManager::waitForTilesets(const QList<Tileset *> &tilesets)
 {
-    while (true) {
-        bool busy = false;
-        for (TilesetImageReaderWorker *worker : mImageReaderWorkers) {
-            if (worker->busy()) {
-                busy = true;
-                break;
-            }
-        }
-        if (!busy)
-            break;
+    while (!mImageReaderJobs.isIdle()) {
         Sleep::msleep(10);
         qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
     }
@@ -499,6 +665,7 @@ void TilesetManager::changeTilesetSource(Tileset *tileset, const QString &source
                                          bool missing)
 {
     tileset->setImageSource(source);
+    updateSpecIndex(tileset);
     tileset->setMissing(missing);
     if (!tileset->imageSource().isEmpty() && !tileset->isMissing()) {
         readTileLayerNames(tileset);
@@ -794,10 +961,15 @@ void TilesetManager::syncTileLayerNames(Tileset *ts)
 #ifdef ZOMBOID
 /////
 
-TilesetImageReaderWorker::TilesetImageReaderWorker(int id, InterruptibleThread *thread) :
+TilesetImageReaderWorker::TilesetImageReaderWorker(int id, InterruptibleThread *thread,
+                                                   SharedJobQueue<Tileset*> *jobs,
+                                                   bool createMips,
+                                                   TilesetDiskCache *diskCache) :
     BaseWorker(thread),
+    mJobs(jobs),
     mID(id),
-    mHasJobs(false)
+    mCreateMips(createMips),
+    mDiskCache(diskCache)
 {
 }
 
@@ -805,49 +977,34 @@ TilesetImageReaderWorker::~TilesetImageReaderWorker()
 {
 }
 
-bool TilesetImageReaderWorker::busy()
-{
-    QMutexLocker locker(&mJobsMutex);
-    return mHasJobs;
-}
-
 void TilesetImageReaderWorker::work()
 {
     IN_WORKER_THREAD
 
-    while (mJobs.size()) {
-        if (aborted()) {
-            mJobs.clear();
-            break;
-        }
-
-        Job job = mJobs.takeAt(0);
-
-        QImage *image = new QImage(job.tileset->imageSource2x().isEmpty() ? job.tileset->imageSource() : job.tileset->imageSource2x());
+    Tileset *tileset;
+    while (!aborted() && mJobs->take(tileset)) {
+        QString imageFile = tileset->imageSource2x().isEmpty() ? tileset->imageSource() : tileset->imageSource2x();
+        Tileset *fromThread = new Tileset(tileset->name(), 64, 128);
+        fromThread->setImageSource2x(tileset->imageSource2x());
+        TilesetAtlas atlas;
+        if (!mDiskCache || !mDiskCache->load(fromThread, imageFile, atlas)) {
+            QImage image(imageFile);
 #if 0
-        Sleep::msleep(500);
-        qDebug() << "TilesetImageReaderThread #" << mID << "loaded" << job.tileset->imageSource();
+            Sleep::msleep(500);
+            qDebug() << "TilesetImageReaderThread #" << mID << "loaded" << tileset->imageSource();
 #endif
-        Tileset *fromThread = new Tileset(job.tileset->name(), 64, 128);
-        fromThread->setImageSource2x(job.tileset->imageSource2x());
-        fromThread->loadFromImage(*image, job.tileset->imageSource());
-        delete image;
-        emit imageLoaded(fromThread, job.tileset);
+            if (!image.isNull()) {
+                fromThread->createAtlas(image, atlas);
+                if (mDiskCache)
+                    mDiskCache->save(fromThread, imageFile, atlas);
+            }
+        }
+        fromThread->loadFromAtlas(atlas, tileset->imageSource());
+        if (mCreateMips)
+            fromThread->createMips();
+        emit imageLoaded(fromThread, tileset);
+        // After emitting, so waitForTilesets() sees the result once idle.
+        mJobs->finish(tileset);
     }
-
-    QMutexLocker locker(&mJobsMutex);
-    mHasJobs = false;
-}
-
-void TilesetImageReaderWorker::addJob(Tileset *tileset)
-{
-    IN_WORKER_THREAD
-
-    QMutexLocker locker(&mJobsMutex);
-    mHasJobs = true;
-    locker.unlock();
-
-    mJobs += Job(tileset);
-    scheduleWork();
 }
 #endif // ZOMBOID
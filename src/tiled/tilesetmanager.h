@@ -34,44 +34,38 @@
 
 #ifdef ZOMBOID
 #include "threads.h"
+#include <QHash>
 #include <QVector>
 namespace Tiled {
 class Tileset;
+namespace Internal {
+class TilesetDiskCache;
+}
 }
 class QImage;
 class TilesetImageReaderWorker : public BaseWorker
 {
     Q_OBJECT
 public:
-    TilesetImageReaderWorker(int id, InterruptibleThread *thread);
+    TilesetImageReaderWorker(int id, InterruptibleThread *thread,
+                             SharedJobQueue<Tiled::Tileset*> *jobs,
+                             bool createMips,
+                             Tiled::Internal::TilesetDiskCache *diskCache);
 
     ~TilesetImageReaderWorker();
 
-    bool busy();
-
     typedef Tiled::Tileset Tileset;
 signals:
     void imageLoaded(Tiled::Tileset *tileset, Tiled::Tileset *fromThread);
 
 public slots:
     void work();
-    void addJob(Tileset *tileset);
 
 private:
-    class Job {
-    public:
-        Job(Tiled::Tileset *tileset) :
-            tileset(tileset)
-        {
-        }
-
-        Tiled::Tileset *tileset;
-    };
-    QList<Job> mJobs;
-
+    SharedJobQueue<Tiled::Tileset*> *mJobs;
     int mID;
-    QMutex mJobsMutex;
-    bool mHasJobs;
+    bool mCreateMips;
+    Tiled::Internal::TilesetDiskCache *mDiskCache;
 };
 #endif // ZOMBOID
 
@@ -102,8 +96,21 @@ struct TilesetSpec
     int tileHeight;
     int tileSpacing;
     int margin;
+
+#ifdef ZOMBOID
+    bool operator==(const TilesetSpec &other) const
+    {
+        return imageSource == other.imageSource && tileWidth == other.tileWidth &&
+                tileHeight == other.tileHeight && tileSpacing == other.tileSpacing &&
+                margin == other.margin;
+    }
+#endif
 };
 
+#ifdef ZOMBOID
+uint qHash(const TilesetSpec &spec);
+#endif
+
 /**
  * The tileset manager keeps track of all tilesets used by loaded maps. It also
  * watches the tileset images for changes and will attempt to reload them when
@@ -131,6 +138,14 @@ public:
      */
     Tileset *findTileset(const QString &fileName) const;
 
+#ifdef ZOMBOID
+    /**
+     * Updates the file name index after \a tileset was given a new file
+     * name, so findTileset() keeps finding it.
+     */
+    void tilesetFileNameChanged(Tileset *tileset);
+#endif
+
     /**
      * Searches for a tileset matching the given specification.
      * @return a tileset matching the given specification, or 0 if none exists
@@ -194,6 +209,19 @@ public:
 
     TilesetImageCache *imageCache() const { return mTilesetImageCache; }
 
+    /**
+     * Returns the number of tileset lookups done so far, including lookups
+     * in the tileset image cache.
+     */
+    int lookupCount() const
+    { return mLookups + mTilesetImageCache->lookupCount(); }
+
+    /**
+     * Returns the memory used by the zoomed-out mips of every tileset image.
+     */
+    qint64 mipBytes() const
+    { return mMipBytes; }
+
     void loadTileset(Tileset *tileset, const QString &imageSource);
     void waitForTilesets(const QList<Tileset *> &tilesets = QList<Tileset*>());
 #endif
@@ -215,6 +243,7 @@ private slots:
 #ifdef ZOMBOID
     void imageLoaded(QImage *image, Tiled::Tileset *tileset);
     void imageLoaded(Tiled::Tileset *fromThread, Tiled::Tileset *tileset);
+    void reportMipBytes();
 #endif
 
 private:
@@ -243,7 +272,13 @@ private:
 
     QVector<InterruptibleThread*> mImageReaderThreads;
     QVector<TilesetImageReaderWorker*> mImageReaderWorkers;
-    int mNextThreadForJob;
+    SharedJobQueue<Tileset*> mImageReaderJobs;
+    bool mCreateMips;
+    qint64 mMipBytes;
+    QTimer mMipBytesTimer;
+    TilesetDiskCache *mDiskCache;
+
+    void addMipBytes(Tileset *cached, qint64 oldBytes);
 #endif
 
 #ifdef ZOMBOID
@@ -261,6 +296,17 @@ private:
      * Stores the tilesets and maps them to the number of references.
      */
     QMap<Tileset*, int> mTilesets;
+#ifdef ZOMBOID
+    QHash<QString, Tileset*> mTilesetsByFileName;
+    QHash<TilesetSpec, Tileset*> mTilesetsBySpec;
+    QHash<Tileset*, TilesetSpec> mSpecByTileset;
+    mutable int mLookups;
+
+    static TilesetSpec specFor(const Tileset *tileset);
+    void addToSpecIndex(Tileset *tileset);
+    void removeFromSpecIndex(Tileset *tileset);
+    void updateSpecIndex(Tileset *tileset);
+#endif
     FileSystemWatcher *mWatcher;
     QSet<QString> mChangedFiles;
     QTimer mChangedFilesTimer;
@@ -50,6 +50,12 @@ ZLotManager::~ZLotManager()
 {
     if (mapDocument())
         mapDocument()->disconnect(this);
+
+    // Stop loading lots nobody else is waiting for.
+    foreach (const MapLoading &ml, mMapsLoading)
+        MapManager::instance()->cancelLoading(ml.info);
+    foreach (const MapLoading2 &ml, mMapsLoading2)
+        MapManager::instance()->cancelLoading(ml.info);
 }
 
 void ZLotManager::setMapDocument(MapDocument *mapDoc)
@@ -137,13 +143,17 @@ void ZLotManager::handleMapObject(MapObject *mapObject)
                                                       true, MapManager::PriorityMedium);
     }
 
-    if (newInfo && newInfo->isLoading()) {
-        int n = findLoading(mapObject);
-        if (n != -1)
-            mMapsLoading[n].info = newInfo;
-        else
-            mMapsLoading += MapLoading(newInfo, mapObject);
-    } else if (!newInfo || !newInfo->isLoading())
+    // Every asynchronous loadMap() above that returned a loading map is
+    // balanced by one cancelLoading(), either here or when the object goes
+    // away, so a map nobody is waiting for stops loading.
+    int n = findLoading(mapObject);
+    if (n != -1) {
+        MapManager::instance()->cancelLoading(mMapsLoading[n].info);
+        mMapsLoading.removeAt(n);
+    }
+    if (newInfo && newInfo->isLoading())
+        mMapsLoading += MapLoading(newInfo, mapObject);
+    else
         setMapInfo(mapObject, newInfo);
 #else
     const QString& name = mapObject->name();
@@ -364,8 +374,10 @@ void ZLotManager::onObjectsRemoved(const QList<MapObject*> &objects)
     foreach (MapObject *mapObject, objects) {
         mMapObjectToInfo.remove(mapObject);
         int n = findLoading(mapObject);
-        if (n != -1)
+        if (n != -1) {
+            MapManager::instance()->cancelLoading(mMapsLoading[n].info);
             mMapsLoading.removeAt(n);
+        }
         QMap<MapObject*,MapComposite*>::iterator it = mMapObjectToLot.find(mapObject);
         if (it != mMapObjectToLot.end()) {
             MapComposite *lot = it.value();
@@ -420,6 +432,8 @@ void ZLotManager::beforeWorldChanged()
 {
     foreach (WorldCellLot *lot, mWorldCellLotToMI.keys())
         setMapInfo(lot, 0);
+    foreach (const MapLoading2 &ml, mMapsLoading2)
+        MapManager::instance()->cancelLoading(ml.info);
     mMapsLoading2.clear();
     Q_ASSERT(mWorldCellLotToMI.isEmpty());
     Q_ASSERT(mWorldCellLotToMC.isEmpty());
@@ -57,8 +57,14 @@ void ZProgressManager::setMainWindow(QWidget *mainWindow)
     mDialog->setWindowFlags(Qt::CustomizeWindowHint | Qt::Dialog);
 }
 
+// Without a main window, as when exporting lots from the command line, there
+// is no dialog and progress isn't shown.
 void ZProgressManager::begin(const QString &text)
 {
+    if (!mDialog) {
+        ++mDepth;
+        return;
+    }
     mLabel->setText(text);
     if (mDepth++ == 0)
         mDialog->show();
@@ -68,6 +74,8 @@ void ZProgressManager::begin(const QString &text)
 void ZProgressManager::update(const QString &text)
 {
     Q_ASSERT(mDepth > 0);
+    if (!mDialog)
+        return;
     mLabel->setText(text);
     qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
 }
@@ -75,6 +83,10 @@ void ZProgressManager::update(const QString &text)
 void ZProgressManager::end()
 {
     Q_ASSERT(mDepth > 0);
+    if (!mDialog) {
+        --mDepth;
+        return;
+    }
 //    mDialog->setValue(mDialog->maximum()); // hides dialog!
     if (--mDepth == 0)
         mDialog->hide();
@@ -0,0 +1,7 @@
+# The building converter uses the tile managers of the editor.
+include(../editortest.pri)
+TARGET = test_buildingconvert
+include(../shared/testbuilding.pri)
+
+# Input
+SOURCES += test_buildingconvert.cpp
@@ -0,0 +1,265 @@
+#include "building.h"
+#include "buildingmap.h"
+#include "buildingmapconverter.h"
+#include "buildingreader.h"
+#include "buildingtiles.h"
+#include "buildingtmx.h"
+#include "buildingwriter.h"
+#include "furnituregroups.h"
+#include "tilenameatoms.h"
+
+#include "mapmanager.h"
+#include "tilemetainfomgr.h"
+#include "tilesetmanager.h"
+
+#include "map.h"
+#include "mapobject.h"
+#include "objectgroup.h"
+#include "tile.h"
+#include "tilelayer.h"
+#include "tileset.h"
+
+#include "testbuilding.h"
+
+#include <QFuture>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrentRun>
+#include <QtTest/QtTest>
+
+using namespace BuildingEditor;
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+class test_BuildingConvert : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void concurrentConversion();
+
+private:
+    Tileset *createTileset(const QString &name);
+    Building *createBuilding(int width, int height, int floors, int rooms, uint seed);
+
+    QDir mDir;
+    BuildingTilesetSnapshot *mSnapshot;
+};
+
+static const int FILES = 300;
+
+// The converter only looks at a tileset's name and tiles, so the images are
+// tiny.
+Tileset *test_BuildingConvert::createTileset(const QString &name)
+{
+    QImage image(8 * 8, 16 * 8, QImage::Format_ARGB32);
+    image.fill(0xffff0000);
+    Tileset *tileset = new Tileset(name, 8, 16);
+    if (!tileset->loadFromImage(image, name + QLatin1String(".png"))) {
+        delete tileset;
+        return 0;
+    }
+    return tileset;
+}
+
+void test_BuildingConvert::initTestCase()
+{
+    QString dirName = QString(QLatin1String("test_buildingconvert-%1"))
+            .arg(QCoreApplication::applicationPid());
+    QDir temp = QDir::temp();
+    QVERIFY(temp.mkpath(dirName));
+    mDir = QDir(temp.filePath(dirName));
+
+    // roofs_01 is left out so some tiles are missing.
+    const char *names[] = {
+        "walls_exterior_house_01",
+        "walls_interior_house_01",
+        "walls_interior_house_02",
+        "walls_interior_house_03",
+        "walls_interior_house_04",
+        "floors_interior_carpet_01",
+        "floors_exterior_street_01",
+        "fixtures_doors_01",
+        "fixtures_doors_frames_01",
+        "fixtures_windows_01",
+        "fixtures_stairs_01",
+        nullptr
+    };
+    // BuildingMap finds the tilesets through TileMetaInfoMgr, which takes
+    // ownership of them.
+    for (int i = 0; names[i]; i++) {
+        Tileset *tileset = createTileset(QLatin1String(names[i]));
+        QVERIFY(tileset);
+        TileMetaInfoMgr::instance()->addTileset(tileset);
+    }
+
+    // Instead of TMXConfig.txt.  FloorOverlay is listed twice.
+    QStringList layerNames = BuildingMap::requiredLayerNames();
+    layerNames << QLatin1String("FloorOverlay") << QLatin1String("1_Vegetation");
+    BuildingTMX::instance()->setTileLayerNames(layerNames);
+
+    mSnapshot = BuildingTilesetSnapshot::create(1);
+}
+
+void test_BuildingConvert::cleanupTestCase()
+{
+    foreach (QString fileName, mDir.entryList(QDir::Files))
+        mDir.remove(fileName);
+    QDir::temp().rmdir(mDir.dirName());
+    delete mSnapshot;
+    MapManager::deleteInstance();
+    TileMetaInfoMgr::deleteInstance();
+    BuildingTMX::deleteInstance();
+    BuildingTilesMgr::deleteInstance();
+    TilesetManager::deleteInstance();
+}
+
+// User tiles are scattered over two layers, a few of them from a tileset
+// that isn't loaded.
+Building *test_BuildingConvert::createBuilding(int width, int height, int floors,
+                                               int rooms, uint seed)
+{
+    QStringList layerNames;
+    layerNames << QLatin1String("Floor") << QLatin1String("FloorOverlay");
+    QVector<int> userTiles;
+    for (int i = 0; i < 70; i++)
+        userTiles += TileNameAtoms::atom(QLatin1String("floors_exterior_street_01"), i);
+    userTiles += TileNameAtoms::atom(QLatin1String("roofs_01"), 1);
+    return createTestBuilding(width, height, floors, rooms, seed, layerNames, userTiles);
+}
+
+struct ConvertResult
+{
+    QString error;
+    QString map;
+    QStringList missingTilesets;
+    int tileCount;
+};
+
+static QString describe(Map *map, int &tileCount)
+{
+    QString s;
+    tileCount = 0;
+    foreach (Layer *layer, map->layers()) {
+        s += layer->name() + QLatin1Char('\n');
+        if (TileLayer *tl = layer->asTileLayer()) {
+            for (int y = 0; y < tl->height(); y++) {
+                for (int x = 0; x < tl->width(); x++) {
+                    if (Tile *tile = tl->cellAt(x, y).tile) {
+                        s += QString(QLatin1String("%1,%2 %3 %4\n")).arg(x).arg(y)
+                                .arg(tile->tileset()->name()).arg(tile->id());
+                        ++tileCount;
+                    }
+                }
+            }
+        } else if (ObjectGroup *og = layer->asObjectGroup()) {
+            foreach (MapObject *object, og->objects()) {
+                s += QString(QLatin1String("%1 %2,%3 %4x%5\n")).arg(object->name())
+                        .arg(object->x()).arg(object->y())
+                        .arg(object->width()).arg(object->height());
+            }
+        }
+    }
+    return s;
+}
+
+// What a map reader thread does with a .tbx file.
+static ConvertResult convertFile(const BuildingTilesetSnapshot *tilesets,
+                                 const QString &path)
+{
+    ConvertResult result;
+    result.tileCount = 0;
+    BuildingReader reader;
+    Building *building = reader.read(path);
+    if (!building) {
+        result.error = reader.errorString();
+        return result;
+    }
+    reader.fix(building);
+
+    BuildingMapConverter converter(tilesets);
+    Map *map = converter.convert(building);
+    result.map = describe(map, result.tileCount);
+    result.missingTilesets = converter.missingTilesets();
+    delete map;
+    delete building;
+    return result;
+}
+
+// What the editor shows for a .tbx file.
+static QString mergedMap(const QString &path, QString &error)
+{
+    BuildingReader reader;
+    Building *building = reader.read(path);
+    if (!building) {
+        error = reader.errorString();
+        return QString();
+    }
+    reader.fix(building);
+
+    BuildingMap *buildingMap = new BuildingMap(building);
+    Map *map = buildingMap->mergedMap();
+    buildingMap->addRoomDefObjects(map);
+    int tileCount;
+    QString s = describe(map, tileCount);
+    TilesetManager::instance()->removeReferences(map->tilesets());
+    delete map;
+    delete buildingMap;
+    delete building;
+    return s;
+}
+
+// Every building is converted once on this thread, then all of them at once
+// on a pool of threads sharing one snapshot, as the map reader threads do.
+// Both must give the map BuildingMap gives the editor.
+void test_BuildingConvert::concurrentConversion()
+{
+    QStringList paths;
+    for (int i = 0; i < FILES; i++) {
+        uint seed = 1000 + i;
+        Building *building = createBuilding(8 + nextRandom(seed) % 24,
+                                            8 + nextRandom(seed) % 24,
+                                            1 + i % 3, 1 + i % 6, seed);
+        QString path = mDir.filePath(QString(QLatin1String("building%1.tbx")).arg(i));
+        BuildingWriter writer;
+        QVERIFY2(writer.write(building, path), qPrintable(writer.errorString()));
+        delete building;
+        paths += path;
+    }
+
+    QList<ConvertResult> expected;
+    foreach (QString path, paths) {
+        ConvertResult result = convertFile(mSnapshot, path);
+        QVERIFY2(result.error.isEmpty(), qPrintable(result.error));
+        QVERIFY(result.tileCount > 0);
+        QVERIFY(result.missingTilesets.contains(QLatin1String("roofs_01")));
+        QString error;
+        QString merged = mergedMap(path, error);
+        QVERIFY2(error.isEmpty(), qPrintable(error));
+        if (result.map != merged)
+            QFAIL(qPrintable(QString(QLatin1String("%1 differs from BuildingMap::mergedMap()"))
+                             .arg(path)));
+        expected += result;
+    }
+
+    QThreadPool::globalInstance()->setMaxThreadCount(qMax(4, QThread::idealThreadCount()));
+    for (int pass = 0; pass < 2; pass++) {
+        QList<QFuture<ConvertResult> > futures;
+        foreach (QString path, paths)
+            futures += QtConcurrent::run(convertFile, mSnapshot, path);
+        for (int i = 0; i < futures.size(); i++) {
+            ConvertResult result = futures[i].result();
+            QVERIFY2(result.error.isEmpty(), qPrintable(result.error));
+            if (result.map != expected[i].map)
+                QFAIL(qPrintable(QString(QLatin1String("pass %1: %2 differs"))
+                                 .arg(pass).arg(paths[i])));
+            QCOMPARE(result.missingTilesets, expected[i].missingTilesets);
+        }
+    }
+}
+
+QTEST_MAIN(test_BuildingConvert)
+#include "test_buildingconvert.moc"
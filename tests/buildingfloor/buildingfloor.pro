@@ -0,0 +1,6 @@
+# The building model needs the tile managers and preferences of the editor.
+include(../editortest.pri)
+TARGET = test_buildingfloor
+
+# Input
+SOURCES += test_buildingfloor.cpp
@@ -0,0 +1,301 @@
+#include "building.h"
+#include "buildingfloor.h"
+#include "buildingobjects.h"
+#include "buildingtemplates.h"
+#include "buildingtiles.h"
+#include "tilenameatoms.h"
+
+#include <QtTest/QtTest>
+
+using namespace BuildingEditor;
+
+class test_BuildingFloor : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void init();
+    void cleanup();
+
+    void incrementalLayout_data();
+    void incrementalLayout();
+
+    void tileNameAtoms();
+
+private:
+    BuildingTileEntry *entry(BuildingTileCategory *category, const char *tileName);
+    void fillRoom(BuildingFloor *floor, const QRect &r, Room *room);
+    bool sameSquares(const QVector<QVector<BuildingFloor::Square> > &a,
+                     const QVector<QVector<BuildingFloor::Square> > &b,
+                     QString &where);
+
+    Building *mBuilding;
+    Room *mKitchen;
+    Room *mBedroom;
+    BuildingTileEntry *mDoorTile;
+    BuildingTileEntry *mDoorFrameTile;
+    BuildingTileEntry *mWindowTile;
+    BuildingTileEntry *mWallTile;
+    BuildingTileEntry *mStairsTile;
+    BuildingTileEntry *mRoofCapTile;
+    BuildingTileEntry *mRoofSlopeTile;
+    BuildingTileEntry *mRoofTopTile;
+};
+
+enum Change {
+    PaintRoom,
+    EraseRoom,
+    AddDoor,
+    MoveWindow,
+    RemoveStairs,
+    AddWall,
+    AddRoof
+};
+Q_DECLARE_METATYPE(Change)
+
+BuildingTileEntry *test_BuildingFloor::entry(BuildingTileCategory *category,
+                                             const char *tileName)
+{
+    BuildingTileEntry *entry = category->createEntryFromSingleTile(QLatin1String(tileName));
+    Q_ASSERT(entry);
+    return entry;
+}
+
+void test_BuildingFloor::initTestCase()
+{
+    BuildingTilesMgr *mgr = BuildingTilesMgr::instance();
+    mDoorTile = entry(mgr->catDoors(), "fixtures_doors_01_0");
+    mDoorFrameTile = entry(mgr->catDoorFrames(), "fixtures_doors_frames_01_0");
+    mWindowTile = entry(mgr->catWindows(), "fixtures_windows_01_0");
+    mWallTile = entry(mgr->catIWalls(), "walls_interior_house_02_0");
+    mStairsTile = entry(mgr->catStairs(), "fixtures_stairs_01_0");
+    mRoofCapTile = entry(mgr->catRoofCaps(), "roofs_01_0");
+    mRoofSlopeTile = entry(mgr->catRoofSlopes(), "roofs_01_0");
+    mRoofTopTile = entry(mgr->catRoofTops(), "roofs_01_0");
+}
+
+void test_BuildingFloor::cleanupTestCase()
+{
+    BuildingTilesMgr::deleteInstance();
+}
+
+void test_BuildingFloor::init()
+{
+    BuildingTilesMgr *mgr = BuildingTilesMgr::instance();
+
+    mBuilding = new Building(30, 20);
+    mBuilding->setTile(Building::ExteriorWall,
+                       entry(mgr->catEWalls(), "walls_exterior_house_01_0"));
+    mBuilding->setTile(Building::ExteriorWallTrim,
+                       entry(mgr->catEWallTrim(), "walls_exterior_house_trim_01_0"));
+
+    mKitchen = new Room;
+    mKitchen->Name = QLatin1String("Kitchen");
+    mKitchen->internalName = QLatin1String("kitchen");
+    mKitchen->setTile(Room::InteriorWall, entry(mgr->catIWalls(), "walls_interior_house_01_0"));
+    mKitchen->setTile(Room::InteriorWallTrim, entry(mgr->catIWallTrim(), "walls_interior_house_trim_01_0"));
+    mKitchen->setTile(Room::Floor, entry(mgr->catFloors(), "floors_interior_tilesandwood_01_0"));
+    mBuilding->insertRoom(0, mKitchen);
+
+    mBedroom = new Room;
+    mBedroom->Name = QLatin1String("Bedroom");
+    mBedroom->internalName = QLatin1String("bedroom");
+    mBedroom->setTile(Room::InteriorWall, entry(mgr->catIWalls(), "walls_interior_house_03_0"));
+    mBedroom->setTile(Room::Floor, entry(mgr->catFloors(), "floors_interior_carpet_01_0"));
+    mBuilding->insertRoom(1, mBedroom);
+
+    BuildingFloor *ground = new BuildingFloor(mBuilding, 0);
+    mBuilding->insertFloor(0, ground);
+    fillRoom(ground, QRect(2, 2, 12, 10), mKitchen);
+    fillRoom(ground, QRect(14, 2, 10, 10), mBedroom);
+    fillRoom(ground, QRect(6, 12, 8, 6), mBedroom);
+
+    Door *door = new Door(ground, 8, 12, BuildingObject::N);
+    door->setTile(mDoorTile);
+    door->setTile(mDoorFrameTile, 1);
+    ground->insertObject(ground->objectCount(), door);
+
+    Window *window = new Window(ground, 2, 5, BuildingObject::W);
+    window->setTile(mWindowTile);
+    ground->insertObject(ground->objectCount(), window);
+
+    Stairs *stairs = new Stairs(ground, 16, 4, BuildingObject::W);
+    stairs->setTile(mStairsTile);
+    ground->insertObject(ground->objectCount(), stairs);
+
+    BuildingFloor *upstairs = new BuildingFloor(mBuilding, 1);
+    mBuilding->insertFloor(1, upstairs);
+    fillRoom(upstairs, QRect(14, 2, 10, 10), mBedroom);
+
+    foreach (BuildingFloor *floor, mBuilding->floors())
+        floor->LayoutToSquares();
+}
+
+void test_BuildingFloor::cleanup()
+{
+    delete mBuilding;
+    mBuilding = 0;
+}
+
+void test_BuildingFloor::fillRoom(BuildingFloor *floor, const QRect &r, Room *room)
+{
+    for (int y = r.top(); y <= r.bottom(); y++)
+        for (int x = r.left(); x <= r.right(); x++)
+            floor->SetRoomAt(x, y, room);
+}
+
+bool test_BuildingFloor::sameSquares(const QVector<QVector<BuildingFloor::Square> > &a,
+                                     const QVector<QVector<BuildingFloor::Square> > &b,
+                                     QString &where)
+{
+    if (a.size() != b.size())
+        return false;
+    for (int x = 0; x < a.size(); x++) {
+        for (int y = 0; y < a[x].size(); y++) {
+            const BuildingFloor::Square &s1 = a[x][y];
+            const BuildingFloor::Square &s2 = b[x][y];
+            where = QString(QLatin1String("square %1,%2")).arg(x).arg(y);
+            if (s1.mEntries != s2.mEntries || s1.mEntryEnum != s2.mEntryEnum
+                    || s1.mTiles != s2.mTiles
+                    || s1.mWallOrientation != s2.mWallOrientation
+                    || s1.mExterior != s2.mExterior
+                    || s1.mWallN.entry != s2.mWallN.entry
+                    || s1.mWallN.trim != s2.mWallN.trim
+                    || s1.mWallW.entry != s2.mWallW.entry
+                    || s1.mWallW.trim != s2.mWallW.trim)
+                return false;
+        }
+    }
+    return true;
+}
+
+void test_BuildingFloor::incrementalLayout_data()
+{
+    QTest::addColumn<Change>("change");
+
+    QTest::newRow("paint room") << PaintRoom;
+    QTest::newRow("erase room") << EraseRoom;
+    QTest::newRow("add door") << AddDoor;
+    QTest::newRow("move window") << MoveWindow;
+    QTest::newRow("remove stairs") << RemoveStairs;
+    QTest::newRow("add wall") << AddWall;
+    QTest::newRow("add roof") << AddRoof;
+}
+
+void test_BuildingFloor::incrementalLayout()
+{
+    QFETCH(Change, change);
+
+    BuildingFloor *ground = mBuilding->floor(0);
+    BuildingFloor *upstairs = mBuilding->floor(1);
+    QList<BuildingFloor*> floors;
+    floors << ground;
+    QRect dirty;
+
+    switch (change) {
+    case PaintRoom:
+        dirty = QRect(10, 6, 6, 3);
+        fillRoom(ground, dirty, mBedroom);
+        break;
+    case EraseRoom:
+        dirty = QRect(20, 9, 4, 3);
+        fillRoom(ground, dirty, 0);
+        break;
+    case AddDoor: {
+        Door *door = new Door(ground, 14, 8, BuildingObject::W);
+        door->setTile(mDoorTile);
+        door->setTile(mDoorFrameTile, 1);
+        ground->insertObject(ground->objectCount(), door);
+        dirty = BuildingFloor::layoutBounds(door);
+        break;
+    }
+    case MoveWindow: {
+        Window *window = ground->GetWindowAt(2, 5);
+        QVERIFY(window);
+        dirty = BuildingFloor::layoutBounds(window);
+        window->setPos(2, 9);
+        dirty |= BuildingFloor::layoutBounds(window);
+        break;
+    }
+    case RemoveStairs: {
+        Stairs *stairs = ground->GetStairsAt(16, 4);
+        QVERIFY(stairs);
+        dirty = BuildingFloor::layoutBounds(stairs);
+        delete ground->removeObject(stairs->index());
+        floors << upstairs;
+        break;
+    }
+    case AddWall: {
+        WallObject *wall = new WallObject(ground, 4, 4, BuildingObject::W, 6);
+        wall->setTile(mWallTile);
+        ground->insertObject(ground->objectCount(), wall);
+        dirty = BuildingFloor::layoutBounds(wall);
+        break;
+    }
+    case AddRoof: {
+        RoofObject *roof = new RoofObject(upstairs, 15, 3, 6, 4,
+                                          RoofObject::SlopeW, RoofObject::Two,
+                                          true, true, true, true);
+        roof->setCapTiles(mRoofCapTile);
+        roof->setSlopeTiles(mRoofSlopeTile);
+        roof->setTopTiles(mRoofTopTile);
+        upstairs->insertObject(upstairs->objectCount(), roof);
+        dirty = BuildingFloor::layoutBounds(roof);
+        floors.clear();
+        floors << upstairs;
+        break;
+    }
+    }
+
+    foreach (BuildingFloor *floor, floors) {
+        QRect area = floor->LayoutToSquares(dirty);
+        QVERIFY(area.contains(dirty & floor->bounds(1, 1)));
+        // Every change here is local, so none of them should have needed a
+        // full layout.
+        QVERIFY(floor->bounds(1, 1).contains(area));
+        QVERIFY(area != floor->bounds(1, 1));
+        QVector<QVector<BuildingFloor::Square> > incremental = floor->squares;
+
+        floor->LayoutToSquares();
+        QString where;
+        QVERIFY2(sameSquares(incremental, floor->squares, where), qPrintable(where));
+    }
+}
+
+void test_BuildingFloor::tileNameAtoms()
+{
+    QCOMPARE(TileNameAtoms::atom(QString()), 0);
+    QVERIFY(TileNameAtoms::name(0).isEmpty());
+
+    int atom = TileNameAtoms::atom(QLatin1String("walls_exterior_house_01_5"));
+    QVERIFY(atom > 0);
+    QCOMPARE(TileNameAtoms::atom(QLatin1String("walls_exterior_house_01_005")), atom);
+    QCOMPARE(TileNameAtoms::atom(QLatin1String("walls_exterior_house_01"), 5), atom);
+    QCOMPARE(TileNameAtoms::name(atom), QString(QLatin1String("walls_exterior_house_01_005")));
+    QCOMPARE(TileNameAtoms::tilesetName(atom), QString(QLatin1String("walls_exterior_house_01")));
+    QCOMPARE(TileNameAtoms::index(atom), 5);
+
+    int bad = TileNameAtoms::atom(QLatin1String("nounderscore"));
+    QVERIFY(bad > 0 && bad != atom);
+    QCOMPARE(TileNameAtoms::name(bad), QString(QLatin1String("nounderscore")));
+    QCOMPARE(TileNameAtoms::index(bad), -1);
+
+    BuildingTilesMgr *mgr = BuildingTilesMgr::instance();
+    BuildingTile *btile = mgr->get(QLatin1String("walls_exterior_house_01_5"));
+    QCOMPARE(btile->atom(), atom);
+    QCOMPARE(mgr->get(atom), btile);
+    QCOMPARE(mgr->tileFor(btile), mgr->tileFor(atom));
+
+    FloorTileGrid grid(10, 10);
+    grid.replace(2, 3, QLatin1String("walls_exterior_house_01_5"));
+    grid.replace(2, 3, QLatin1String("walls_exterior_house_01_6"));
+    QCOMPARE(grid.at(2, 3), QString(QLatin1String("walls_exterior_house_01_006")));
+    grid.replace(2, 3, QString());
+    QVERIFY(grid.isEmpty());
+}
+
+QTEST_MAIN(test_BuildingFloor)
+#include "test_buildingfloor.moc"
@@ -0,0 +1,6 @@
+# The pick index uses the tileset manager of the editor.
+include(../editortest.pri)
+TARGET = test_buildingpickindex
+
+# Input
+SOURCES += test_buildingpickindex.cpp
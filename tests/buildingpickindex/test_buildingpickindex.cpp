@@ -0,0 +1,276 @@
+#include "buildingpickindex.h"
+
+#include "tilesetmanager.h"
+
+#include "map.h"
+#include "tile.h"
+#include "tilelayer.h"
+#include "tileset.h"
+#include "zlevelrenderer.h"
+
+#include <QtTest/QtTest>
+
+using namespace BuildingEditor;
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+class test_BuildingPickIndex : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void init();
+    void cleanup();
+
+    void sameAsBruteForce_data();
+    void sameAsBruteForce();
+    void afterChanges_data();
+    void afterChanges();
+
+private:
+    Tileset *createTileset(const QString &name, int tileWidth, int tileHeight);
+    void fill(int level, const QRect &r, uint seed);
+    void addRenderModes();
+    Tile *bruteForceTileAt(int level, const QPoint &pos);
+    void compareAll(const QString &when);
+
+    Map *mMap;
+    ZLevelRenderer *mRenderer;
+    BuildingPickIndex *mIndex;
+    QList<Tileset*> mTilesets;
+    QVector<QVector<TileLayer*> > mUserLayers;
+    QVector<QVector<TileLayer*> > mBlendLayers;
+    QVector<QVector<bool> > mLayerVisible;
+};
+
+static const int LEVELS = 2;
+static const int LAYERS = 3;
+static const int SIZE = 12;
+
+static uint nextRandom(uint &seed)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) & 0x7fff;
+}
+
+// Tiles with an uneven alpha pattern and transparent margins, so hits depend
+// on the exact pixel and the tiles get trimmed when they are loaded.
+Tileset *test_BuildingPickIndex::createTileset(const QString &name,
+                                                int tileWidth, int tileHeight)
+{
+    const int columns = 4, rows = 2;
+    QImage image(tileWidth * columns, tileHeight * rows, QImage::Format_ARGB32);
+    image.fill(0);
+    for (int y = 0; y < image.height(); y++) {
+        for (int x = 0; x < image.width(); x++) {
+            int tx = x % tileWidth, ty = y % tileHeight;
+            int id = (y / tileHeight) * columns + x / tileWidth;
+            if (tx < 4 + id || ty < tileHeight / 3 || tx >= tileWidth - 3)
+                continue;
+            if ((tx / 3 + ty / 5 + id) % 3 == 0)
+                continue;
+            image.setPixel(x, y, qRgba(255, 0, 0, 128));
+        }
+    }
+    Tileset *tileset = new Tileset(name, tileWidth, tileHeight);
+    if (!tileset->loadFromImage(image, name + QLatin1String(".png"))) {
+        delete tileset;
+        return 0;
+    }
+    return tileset;
+}
+
+void test_BuildingPickIndex::initTestCase()
+{
+    // In 2x mode the renderer's tiles are 128 pixels wide, so pick_1x tiles
+    // are drawn double-size and pick_2x tiles at their own size.  In 1x mode
+    // every tile is drawn at its own size.
+    mTilesets << createTileset(QLatin1String("pick_1x"), 64, 128);
+    mTilesets << createTileset(QLatin1String("pick_2x"), 128, 256);
+    QVERIFY(mTilesets[0] && mTilesets[1]);
+}
+
+void test_BuildingPickIndex::cleanupTestCase()
+{
+    qDeleteAll(mTilesets);
+    TilesetManager::deleteInstance();
+}
+
+void test_BuildingPickIndex::init()
+{
+    QFETCH(bool, is2x);
+
+    mMap = new Map(Map::LevelIsometric, SIZE, SIZE, 64, 32);
+    mRenderer = new ZLevelRenderer(mMap);
+    mRenderer->set2x(is2x);
+    mRenderer->setMaxLevel(LEVELS - 1);
+    mIndex = new BuildingPickIndex(mRenderer);
+
+    mUserLayers.resize(LEVELS);
+    mBlendLayers.resize(LEVELS);
+    mLayerVisible.resize(LEVELS);
+    for (int level = 0; level < LEVELS; level++) {
+        for (int i = 0; i < LAYERS; i++) {
+            QString name = QString(QLatin1String("%1_Layer%2")).arg(level).arg(i);
+            mUserLayers[level] += new TileLayer(name, 0, 0, SIZE, SIZE);
+            mBlendLayers[level] += new TileLayer(name, 0, 0, SIZE, SIZE);
+        }
+        mLayerVisible[level] = QVector<bool>(LAYERS, true);
+        mIndex->setLayers(level, mUserLayers[level], mBlendLayers[level]);
+        fill(level, QRect(0, 0, SIZE, SIZE), 1234 + level);
+    }
+}
+
+void test_BuildingPickIndex::cleanup()
+{
+    delete mIndex;
+    for (int level = 0; level < LEVELS; level++) {
+        qDeleteAll(mUserLayers[level]);
+        qDeleteAll(mBlendLayers[level]);
+    }
+    mUserLayers.clear();
+    mBlendLayers.clear();
+    delete mRenderer;
+    delete mMap;
+}
+
+// Building tiles in most cells, user-drawn tiles in some of them.
+void test_BuildingPickIndex::fill(int level, const QRect &r, uint seed)
+{
+    for (int i = 0; i < LAYERS; i++) {
+        for (int y = r.top(); y <= r.bottom(); y++) {
+            for (int x = r.left(); x <= r.right(); x++) {
+                uint n = nextRandom(seed);
+                Tileset *ts = mTilesets[n % mTilesets.size()];
+                Tile *tile = (n % 5) ? ts->tileAt((n / 5) % ts->tileCount()) : 0;
+                mBlendLayers[level][i]->setCell(x, y, Cell(tile));
+                n = nextRandom(seed);
+                ts = mTilesets[n % mTilesets.size()];
+                tile = (n % 4) ? 0 : ts->tileAt((n / 4) % ts->tileCount());
+                mUserLayers[level][i]->setCell(x, y, Cell(tile));
+            }
+        }
+    }
+}
+
+// BuildingMap::buildingTileAt() before there was an index.
+Tile *test_BuildingPickIndex::bruteForceTileAt(int level, const QPoint &pos)
+{
+    Tile *tile = 0;
+    int x = pos.x(), y = pos.y();
+    QPoint tilePos = mRenderer->pixelToTileCoordsInt(QPoint(x, y), level);
+    for (int ty = tilePos.y() - 4; ty < tilePos.y() + 4; ty++) {
+        for (int tx = tilePos.x() - 4; tx < tilePos.x() + 4; tx++) {
+            QRectF tileBox = mRenderer->boundingRect(QRect(tx, ty, 1, 1), level);
+            for (int i = 0; i < LAYERS; i++) {
+                TileLayer *tlBlend = mBlendLayers[level][i];
+                TileLayer *tl = mUserLayers[level][i];
+                if (!mLayerVisible[level][i])
+                    continue;
+                if (!tl->contains(tx, ty)) continue;
+                Tile *test = tl->cellAt(tx, ty).tile; // user tile
+                if (!test)
+                    test = tlBlend->cellAt(tx, ty).tile; // building tile
+                if (test) {
+                    Tile *realTile = test;
+                    if (test->image().isNull()) {
+                        test = TilesetManager::instance()->missingTile();
+                    }
+                    QRect imageBox(test->offset(), test->image().size());
+                    QPoint p = QPoint(x, y) - (tileBox.bottomLeft().toPoint() - QPoint(0, test->height()));
+                    // Handle double-size tiles
+                    if (qRound(tileBox.width()) == test->width() * 2) {
+                        p = QPoint(x, y) - (tileBox.bottomLeft().toPoint() - QPoint(0, test->height() * 2));
+                        p.rx() /= 2;
+                        p.ry() /= 2;
+                    }
+                    if (imageBox.contains(p)) {
+                        QRgb pixel = test->image().pixel(p - imageBox.topLeft());
+                        if (qAlpha(pixel) > 0)
+                            tile = realTile;
+                    }
+                }
+            }
+        }
+    }
+    return tile;
+}
+
+void test_BuildingPickIndex::addRenderModes()
+{
+    QTest::addColumn<bool>("is2x");
+    QTest::newRow("1x") << false;
+    QTest::newRow("2x") << true;
+}
+
+void test_BuildingPickIndex::compareAll(const QString &when)
+{
+    int hits = 0, doubleSizeHits = 0;
+    for (int level = 0; level < LEVELS; level++) {
+        QRect bounds = mRenderer->boundingRect(QRect(0, 0, SIZE, SIZE), level)
+                .adjusted(-16, -256, 16, 16);
+        for (int y = bounds.top(); y <= bounds.bottom(); y += 3) {
+            for (int x = bounds.left(); x <= bounds.right(); x += 3) {
+                Tile *expected = bruteForceTileAt(level, QPoint(x, y));
+                Tile *actual = mIndex->tileAt(level, QPoint(x, y), mLayerVisible[level]);
+                if (actual != expected) {
+                    QFAIL(qPrintable(QString(QLatin1String("%1: level %2 pixel %3,%4"))
+                                     .arg(when).arg(level).arg(x).arg(y)));
+                }
+                if (actual) {
+                    hits++;
+                    if (mRenderer->is2x() && actual->tileset() == mTilesets[0])
+                        doubleSizeHits++;
+                }
+            }
+        }
+    }
+    QVERIFY(hits > 0);
+    if (mRenderer->is2x())
+        QVERIFY(doubleSizeHits > 0);
+}
+
+void test_BuildingPickIndex::sameAsBruteForce_data()
+{
+    addRenderModes();
+}
+
+void test_BuildingPickIndex::sameAsBruteForce()
+{
+    compareAll(QLatin1String("initial"));
+
+    mLayerVisible[0][1] = false;
+    mLayerVisible[1][2] = false;
+    compareAll(QLatin1String("hidden layers"));
+}
+
+void test_BuildingPickIndex::afterChanges_data()
+{
+    addRenderModes();
+}
+
+void test_BuildingPickIndex::afterChanges()
+{
+    compareAll(QLatin1String("initial"));
+
+    // Change some cells and report only those.
+    QRect r(3, 2, 4, 5);
+    fill(0, r, 99);
+    mIndex->invalidate(0, r);
+    mUserLayers[1][0]->setCell(5, 5, Cell(mTilesets[1]->tileAt(3)));
+    mBlendLayers[1][2]->setCell(6, 5, Cell());
+    mIndex->invalidate(1, QRect(5, 5, 2, 1));
+    compareAll(QLatin1String("after changes"));
+
+    // Empty a whole layer.
+    mBlendLayers[0][0]->erase();
+    mUserLayers[0][0]->erase();
+    mIndex->invalidate(0);
+    compareAll(QLatin1String("after erase"));
+}
+
+QTEST_MAIN(test_BuildingPickIndex)
+#include "test_buildingpickindex.moc"
@@ -0,0 +1,7 @@
+# The .tbx reader and writer need the tile managers of the editor.
+include(../editortest.pri)
+TARGET = test_buildingtbx
+include(../shared/testbuilding.pri)
+
+# Input
+SOURCES += test_buildingtbx.cpp
@@ -0,0 +1,283 @@
+#include "building.h"
+#include "buildingfloor.h"
+#include "buildingobjects.h"
+#include "buildingreader.h"
+#include "buildingtemplates.h"
+#include "buildingtiles.h"
+#include "buildingwriter.h"
+#include "tilenameatoms.h"
+
+#include "testbuilding.h"
+
+#include <QBuffer>
+#include <QtTest/QtTest>
+
+using namespace BuildingEditor;
+
+class test_BuildingTbx : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void roundTrip();
+    void oldWriterFormat();
+
+    void decodeRooms_data();
+    void decodeRooms();
+
+    void readBenchmark();
+    void writeBenchmark();
+
+private:
+    Building *createBuilding(int width, int height, int floors, int rooms, uint seed);
+    QString describe(BuildingTileEntry *entry);
+    void compare(Building *a, Building *b);
+    QString writeFile(const QString &fileName, const QByteArray &data);
+    QByteArray readFile(const QString &filePath);
+
+    QDir mDir;
+};
+
+void test_BuildingTbx::initTestCase()
+{
+    QString dirName = QString(QLatin1String("test_buildingtbx-%1"))
+            .arg(QCoreApplication::applicationPid());
+    QDir temp = QDir::temp();
+    QVERIFY(temp.mkpath(dirName));
+    mDir = QDir(temp.filePath(dirName));
+}
+
+void test_BuildingTbx::cleanupTestCase()
+{
+    foreach (QString fileName, mDir.entryList(QDir::Files))
+        mDir.remove(fileName);
+    QDir::temp().rmdir(mDir.dirName());
+    BuildingTilesMgr::deleteInstance();
+}
+
+// User tiles are scattered over two layers.
+Building *test_BuildingTbx::createBuilding(int width, int height, int floors,
+                                           int rooms, uint seed)
+{
+    QStringList layerNames;
+    layerNames << QLatin1String("Floor") << QLatin1String("Walls");
+    QVector<int> userTiles;
+    for (int i = 0; i < 40; i++)
+        userTiles += TileNameAtoms::atom(QLatin1String("floors_exterior_street_01"), i);
+    return createTestBuilding(width, height, floors, rooms, seed, layerNames, userTiles);
+}
+
+QString test_BuildingTbx::describe(BuildingTileEntry *entry)
+{
+    if (!entry || entry->isNone())
+        return QString();
+    QString s = entry->category()->name();
+    for (int i = 0; i < entry->tileCount(); i++)
+        s += QLatin1Char(' ') + entry->tile(i)->name();
+    return s;
+}
+
+void test_BuildingTbx::compare(Building *a, Building *b)
+{
+    QCOMPARE(b->width(), a->width());
+    QCOMPARE(b->height(), a->height());
+    for (int i = 0; i < Building::TileCount; i++)
+        QCOMPARE(describe(b->tile(i)), describe(a->tile(i)));
+
+    QCOMPARE(b->roomCount(), a->roomCount());
+    for (int i = 0; i < a->roomCount(); i++) {
+        Room *ra = a->room(i), *rb = b->room(i);
+        QCOMPARE(rb->Name, ra->Name);
+        QCOMPARE(rb->internalName, ra->internalName);
+        QCOMPARE(rb->Color, ra->Color);
+        for (int j = 0; j < Room::TileCount; j++)
+            QCOMPARE(describe(rb->tile(j)), describe(ra->tile(j)));
+    }
+
+    QCOMPARE(b->floorCount(), a->floorCount());
+    for (int level = 0; level < a->floorCount(); level++) {
+        BuildingFloor *fa = a->floor(level), *fb = b->floor(level);
+        for (int y = 0; y < a->height(); y++) {
+            for (int x = 0; x < a->width(); x++) {
+                int ia = a->rooms().indexOf(fa->GetRoomAt(x, y));
+                int ib = b->rooms().indexOf(fb->GetRoomAt(x, y));
+                if (ia != ib)
+                    QFAIL(qPrintable(QString(QLatin1String("room at %1,%2 on floor %3"))
+                                     .arg(x).arg(y).arg(level)));
+            }
+        }
+
+        QCOMPARE(fb->grimeLayers(), fa->grimeLayers());
+        foreach (QString layerName, fa->grimeLayers()) {
+            for (int y = 0; y <= a->height(); y++) {
+                for (int x = 0; x <= a->width(); x++) {
+                    if (fa->grimeAtomAt(layerName, x, y) != fb->grimeAtomAt(layerName, x, y))
+                        QFAIL(qPrintable(QString(QLatin1String("%1 tile at %2,%3 on floor %4"))
+                                         .arg(layerName).arg(x).arg(y).arg(level)));
+                }
+            }
+        }
+
+        QCOMPARE(fb->objectCount(), fa->objectCount());
+        for (int i = 0; i < fa->objectCount(); i++) {
+            BuildingObject *oa = fa->object(i), *ob = fb->object(i);
+            QCOMPARE(ob->pos(), oa->pos());
+            QCOMPARE(ob->dirString(), oa->dirString());
+            QCOMPARE(ob->tiles().size(), oa->tiles().size());
+            for (int j = 0; j < oa->tiles().size(); j++)
+                QCOMPARE(describe(ob->tile(j)), describe(oa->tile(j)));
+        }
+    }
+}
+
+QString test_BuildingTbx::writeFile(const QString &fileName, const QByteArray &data)
+{
+    QString filePath = mDir.filePath(fileName);
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly))
+        return QString();
+    file.write(data);
+    return filePath;
+}
+
+QByteArray test_BuildingTbx::readFile(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return file.readAll();
+}
+
+void test_BuildingTbx::roundTrip()
+{
+    Building *building = createBuilding(30, 20, 3, 6, 4321);
+
+    BuildingWriter writer;
+    QString path1 = mDir.filePath(QLatin1String("roundtrip1.tbx"));
+    QVERIFY2(writer.write(building, path1), qPrintable(writer.errorString()));
+
+    BuildingReader reader;
+    Building *readBack = reader.read(path1);
+    QVERIFY2(readBack, qPrintable(reader.errorString()));
+    compare(building, readBack);
+
+    // Writing what was read must give the same file.
+    BuildingWriter writer2;
+    QString path2 = mDir.filePath(QLatin1String("roundtrip2.tbx"));
+    QVERIFY2(writer2.write(readBack, path2), qPrintable(writer2.errorString()));
+    QByteArray data1 = readFile(path1), data2 = readFile(path2);
+    QVERIFY(!data1.isEmpty());
+    QVERIFY(data1 == data2);
+
+    delete readBack;
+    delete building;
+}
+
+// building.tbx was written the way the writer wrote files before it indexed
+// entries, rooms and user tiles by hash.  Reading it back and writing it again
+// must give the same bytes.
+void test_BuildingTbx::oldWriterFormat()
+{
+    const QString path = QLatin1String("../data/building.tbx");
+    QByteArray expected = readFile(path);
+    QVERIFY(!expected.isEmpty());
+
+    BuildingReader reader;
+    Building *building = reader.read(path);
+    QVERIFY2(building, qPrintable(reader.errorString()));
+
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    BuildingWriter writer;
+    writer.write(building, &buffer, QFileInfo(path).absolutePath());
+    delete building;
+
+    QCOMPARE(buffer.data(), expected);
+}
+
+void test_BuildingTbx::decodeRooms_data()
+{
+    QTest::addColumn<QString>("rooms");
+    QTest::addColumn<bool>("valid");
+    QTest::addColumn<QString>("expected");
+
+    QTest::newRow("plain") << QString(QLatin1String("1,0,2,0,1,2")) << true << QString(QLatin1String("102012"));
+    QTest::newRow("rows") << QString(QLatin1String("\n1,0,2,\n0,1,2\n")) << true << QString(QLatin1String("102012"));
+    QTest::newRow("spaces") << QString(QLatin1String("  1 ,0,\t2,0, 1,2  ")) << true << QString(QLatin1String("102012"));
+    QTest::newRow("short") << QString(QLatin1String("1,2")) << true << QString(QLatin1String("120000"));
+    QTest::newRow("trailing comma") << QString(QLatin1String("1,0,2,0,1,2,")) << false << QString();
+    QTest::newRow("too many") << QString(QLatin1String("1,0,2,0,1,2,0")) << false << QString();
+    QTest::newRow("empty entry") << QString(QLatin1String("1,,2")) << false << QString();
+    QTest::newRow("not a number") << QString(QLatin1String("1,x,2")) << false << QString();
+    QTest::newRow("bad room") << QString(QLatin1String("1,0,3")) << false << QString();
+    QTest::newRow("overflow") << QString(QLatin1String("1,99999999999")) << false << QString();
+}
+
+void test_BuildingTbx::decodeRooms()
+{
+    QFETCH(QString, rooms);
+    QFETCH(bool, valid);
+    QFETCH(QString, expected);
+
+    QString xml = QLatin1String(
+            "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            "<building version=\"2\" width=\"3\" height=\"2\">\n"
+            " <room Name=\"a\" InternalName=\"a\" Color=\"1 2 3\"/>\n"
+            " <room Name=\"b\" InternalName=\"b\" Color=\"4 5 6\"/>\n"
+            " <floor>\n"
+            "  <rooms>%1</rooms>\n"
+            " </floor>\n"
+            "</building>\n");
+    QString path = writeFile(QLatin1String("decode.tbx"), xml.arg(rooms).toUtf8());
+    QVERIFY(!path.isEmpty());
+
+    BuildingReader reader;
+    Building *building = reader.read(path);
+    QCOMPARE(building != 0, valid);
+    if (!building)
+        return;
+
+    QString actual;
+    BuildingFloor *floor = building->floor(0);
+    for (int y = 0; y < building->height(); y++)
+        for (int x = 0; x < building->width(); x++)
+            actual += QString::number(building->rooms().indexOf(floor->GetRoomAt(x, y)) + 1);
+    QCOMPARE(actual, expected);
+    delete building;
+}
+
+// A large building: 100 rooms over four 100x100 floors.
+void test_BuildingTbx::readBenchmark()
+{
+    Building *building = createBuilding(100, 100, 4, 100, 99);
+    QString path = mDir.filePath(QLatin1String("benchmark.tbx"));
+    BuildingWriter writer;
+    QVERIFY2(writer.write(building, path), qPrintable(writer.errorString()));
+    delete building;
+
+    QBENCHMARK {
+        BuildingReader reader;
+        Building *readBack = reader.read(path);
+        QVERIFY2(readBack, qPrintable(reader.errorString()));
+        delete readBack;
+    }
+}
+
+void test_BuildingTbx::writeBenchmark()
+{
+    Building *building = createBuilding(100, 100, 4, 100, 99);
+    QString path = mDir.filePath(QLatin1String("benchmark.tbx"));
+
+    QBENCHMARK {
+        BuildingWriter writer;
+        QVERIFY2(writer.write(building, path), qPrintable(writer.errorString()));
+    }
+
+    delete building;
+}
+
+QTEST_MAIN(test_BuildingTbx)
+#include "test_buildingtbx.moc"
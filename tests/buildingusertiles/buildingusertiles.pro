@@ -0,0 +1,6 @@
+# The building map needs the tile managers of the editor.
+include(../editortest.pri)
+TARGET = test_buildingusertiles
+
+# Input
+SOURCES += test_buildingusertiles.cpp
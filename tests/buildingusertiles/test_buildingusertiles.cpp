@@ -0,0 +1,251 @@
+#include "building.h"
+#include "buildingfloor.h"
+#include "buildingmap.h"
+#include "buildingtiles.h"
+#include "buildingtmx.h"
+#include "tilenameatoms.h"
+
+#include "mapmanager.h"
+#include "tilemetainfomgr.h"
+#include "tilesetmanager.h"
+
+#include "map.h"
+#include "tile.h"
+#include "tilelayer.h"
+#include "tileset.h"
+
+#include <QtTest/QtTest>
+
+using namespace BuildingEditor;
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+#if defined(__GLIBC__)
+// Every allocation made on this thread while counting, Qt's included, goes
+// through these wrappers around glibc's own functions.
+#define COUNT_ALLOCATIONS
+
+static thread_local bool countAllocations = false;
+static thread_local int allocationCount = 0;
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size) __THROW
+{
+    if (countAllocations)
+        ++allocationCount;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) __THROW
+{
+    if (countAllocations)
+        ++allocationCount;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) __THROW
+{
+    if (countAllocations)
+        ++allocationCount;
+    return __libc_realloc(ptr, size);
+}
+}
+#endif
+
+class test_BuildingUserTiles : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void tileFor_data();
+    void tileFor();
+
+    void userTilesToLayer();
+
+private:
+    void startCounting();
+    int stopCounting();
+    void checkAllocations(int allocations, int cells);
+    void redrawUserTiles();
+    bool checkLayer(QString &where);
+
+    QVector<int> mAtoms; // one per tile of the tileset
+    Building *mBuilding;
+    BuildingMap *mBuildingMap;
+};
+
+static const int SIZE = 300;
+static const int TILES = 64;
+
+void test_BuildingUserTiles::initTestCase()
+{
+    // The tiles are resolved through TileMetaInfoMgr, which takes ownership
+    // of the tileset.
+    QImage image(8 * 8, 16 * 8, QImage::Format_ARGB32);
+    image.fill(0xffff0000);
+    Tileset *tileset = new Tileset(QLatin1String("floors_exterior_street_01"), 8, 16);
+    QVERIFY(tileset->loadFromImage(image, QLatin1String("floors_exterior_street_01.png")));
+    QCOMPARE(tileset->tileCount(), TILES);
+    TileMetaInfoMgr::instance()->addTileset(tileset);
+
+    // Instead of TMXConfig.txt.
+    BuildingTMX::instance()->setTileLayerNames(BuildingMap::requiredLayerNames());
+
+    for (int i = 0; i < TILES; i++)
+        mAtoms += TileNameAtoms::atom(tileset->name(), i);
+
+    // One floor covered with user tiles in the Floor layer.
+    mBuilding = new Building(SIZE, SIZE);
+    BuildingFloor *floor = new BuildingFloor(mBuilding, 0);
+    mBuilding->insertFloor(0, floor);
+    for (int y = 0; y <= SIZE; y++)
+        for (int x = 0; x <= SIZE; x++)
+            floor->setGrimeAtom(QLatin1String("Floor"), x, y, mAtoms[(x + y) % TILES]);
+
+    mBuildingMap = new BuildingMap(mBuilding);
+    QString where;
+    QVERIFY2(checkLayer(where), qPrintable(where));
+}
+
+void test_BuildingUserTiles::cleanupTestCase()
+{
+    delete mBuildingMap;
+    delete mBuilding;
+    MapManager::deleteInstance();
+    TileMetaInfoMgr::deleteInstance();
+    BuildingTMX::deleteInstance();
+    BuildingTilesMgr::deleteInstance();
+    TilesetManager::deleteInstance();
+}
+
+void test_BuildingUserTiles::startCounting()
+{
+#ifdef COUNT_ALLOCATIONS
+    allocationCount = 0;
+    countAllocations = true;
+#endif
+}
+
+int test_BuildingUserTiles::stopCounting()
+{
+#ifdef COUNT_ALLOCATIONS
+    countAllocations = false;
+    return allocationCount;
+#else
+    return -1;
+#endif
+}
+
+// What resolving a cell's tile costs must not depend on the number of cells,
+// as it did when every cell's tile name was parsed.
+void test_BuildingUserTiles::checkAllocations(int allocations, int cells)
+{
+    if (allocations < 0)
+        return; // can't count on this platform
+    QVERIFY2(allocations < cells / 100,
+             qPrintable(QString(QLatin1String("%1 allocations for %2 cells"))
+                        .arg(allocations).arg(cells)));
+}
+
+// The names row is for callers that only have a tile's name.
+void test_BuildingUserTiles::tileFor_data()
+{
+    QTest::addColumn<bool>("atoms");
+
+    QTest::newRow("names") << false;
+    QTest::newRow("atoms") << true;
+}
+
+void test_BuildingUserTiles::tileFor()
+{
+    QFETCH(bool, atoms);
+
+    BuildingTilesMgr *mgr = BuildingTilesMgr::instance();
+    FloorTileGrid *grid = mBuilding->floor(0)->grime()[QLatin1String("Floor")];
+    QVERIFY(grid);
+
+    qint64 expected = 0;
+    for (int i = 0; i < grid->size(); i++)
+        expected += TileNameAtoms::index(grid->atomAt(i));
+
+    // The first pass fills the manager's cache.
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1)
+            startCounting();
+        qint64 sum = 0;
+        for (int i = 0; i < grid->size(); i++) {
+            Tile *tile = atoms ? mgr->tileFor(grid->atomAt(i)) : mgr->tileFor(grid->at(i));
+            sum += tile->id();
+        }
+        if (pass == 1)
+            checkAllocations(stopCounting(), grid->size());
+        QCOMPARE(sum, expected);
+    }
+
+    QBENCHMARK {
+        for (int i = 0; i < grid->size(); i++) {
+            if (atoms)
+                mgr->tileFor(grid->atomAt(i));
+            else
+                mgr->tileFor(grid->at(i));
+        }
+    }
+}
+
+// What the editor does after tiles are painted over the whole floor.
+void test_BuildingUserTiles::redrawUserTiles()
+{
+    BuildingFloor *floor = mBuilding->floor(0);
+    mBuildingMap->floorTilesChanged(floor, QLatin1String("Floor"), floor->bounds(1, 1));
+    QCoreApplication::sendPostedEvents(mBuildingMap, QEvent::MetaCall);
+}
+
+bool test_BuildingUserTiles::checkLayer(QString &where)
+{
+    TileLayer *layer = 0;
+    foreach (Layer *l, mBuildingMap->map()->layers()) {
+        if (l->name() == QLatin1String("0_Floor"))
+            layer = l->asTileLayer();
+    }
+    if (!layer) {
+        where = QLatin1String("no 0_Floor layer");
+        return false;
+    }
+    for (int y = 0; y <= SIZE; y++) {
+        for (int x = 0; x <= SIZE; x++) {
+            Tile *tile = layer->cellAt(x, y).tile;
+            if (!tile || tile->id() != (x + y) % TILES) {
+                where = QString(QLatin1String("wrong tile at %1,%2")).arg(x).arg(y);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void test_BuildingUserTiles::userTilesToLayer()
+{
+    const int cells = (SIZE + 1) * (SIZE + 1);
+    QString where;
+
+    redrawUserTiles();
+    startCounting();
+    redrawUserTiles();
+    checkAllocations(stopCounting(), cells);
+    QVERIFY2(checkLayer(where), qPrintable(where));
+
+    QBENCHMARK {
+        redrawUserTiles();
+    }
+    QVERIFY2(checkLayer(where), qPrintable(where));
+}
+
+QTEST_MAIN(test_BuildingUserTiles)
+#include "test_buildingusertiles.moc"
@@ -0,0 +1,16 @@
+# The editor's sources without its main.cpp, built once as a static library
+# that the tests of the editor's own classes link against.  See
+# ../editortest.pri.
+TILED_DIR = $$PWD/../../src/tiled
+include($$TILED_DIR/tiled.pro)
+
+TEMPLATE = lib
+CONFIG += staticlib
+TARGET = tilededitor
+DESTDIR = $$OUT_PWD
+INSTALLS =
+DEPENDPATH += .
+VPATH += $$TILED_DIR
+INCLUDEPATH += $$TILED_DIR $$TILED_DIR/BuildingEditor
+
+SOURCES -= main.cpp
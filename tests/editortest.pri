@@ -0,0 +1,40 @@
+# Tests of the editor's own classes.  A test includes this file, then sets
+# TARGET and adds its own source.  The editor's sources are compiled only once,
+# into the static library built by editor/editor.pro.
+TILED_DIR = $$PWD/../src/tiled
+EDITOR_LIB_DIR = $$OUT_PWD/../editor
+
+# Only the compiler and linker settings of tiled.pro are wanted, not its
+# files.
+include($$TILED_DIR/tiled.pro)
+SOURCES =
+HEADERS =
+FORMS =
+RESOURCES =
+OBJECTIVE_SOURCES =
+OTHER_FILES =
+TOLUA_PKG =
+RC_FILE =
+ICON =
+QMAKE_INFO_PLIST =
+
+TEMPLATE = app
+DESTDIR = $$OUT_PWD
+INSTALLS =
+CONFIG += qtestlib
+CONFIG -= app_bundle
+DEPENDPATH += .
+INCLUDEPATH += $$TILED_DIR $$TILED_DIR/BuildingEditor
+
+# The library has to come before the libraries it uses.
+LIBS = -L$$EDITOR_LIB_DIR -ltilededitor $$LIBS
+win32-msvc*:PRE_TARGETDEPS += $$EDITOR_LIB_DIR/tilededitor.lib
+*g++*:PRE_TARGETDEPS += $$EDITOR_LIB_DIR/libtilededitor.a
+
+!win32:!macx {
+    QMAKE_RPATHDIR += \$\$ORIGIN/../../lib
+
+    # It is not possible to use ORIGIN in QMAKE_RPATHDIR, so a bit manually
+    QMAKE_LFLAGS += -Wl,-z,origin \'-Wl,-rpath,$$join(QMAKE_RPATHDIR, ":")\'
+    QMAKE_RPATHDIR =
+}
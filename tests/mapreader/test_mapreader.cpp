@@ -1,7 +1,10 @@
+#include "gidmapper.h"
 #include "map.h"
 #include "mapobject.h"
 #include "objectgroup.h"
+#include "tile.h"
 #include "tilelayer.h"
+#include "tileset.h"
 #include "mapreader.h"
 
 #include <QtTest/QtTest>
@@ -14,8 +17,60 @@ class test_MapReader : public QObject
 
 private slots:
     void loadMap();
+    void loadCsvMap();
+    void benchmarkCsvMap_data();
+    void benchmarkCsvMap();
 };
 
+/**
+  * Reads the CSV layers of \a data the way MapReader did before it scanned
+  * the text in place: the text of each layer is copied into a QString, and
+  * every value is cut out with QString::mid() and converted on its own.
+  */
+static int readCsvLayersTheOldWay(const QByteArray &data, const GidMapper &gidMapper)
+{
+    QXmlStreamReader xml(data);
+    TileLayer *tileLayer = 0;
+    int layers = 0;
+    while (!xml.atEnd()) {
+        xml.readNext();
+        if (xml.isStartElement() && xml.name() == QLatin1String("layer")) {
+            const QXmlStreamAttributes atts = xml.attributes();
+            delete tileLayer;
+            tileLayer = new TileLayer(atts.value(QLatin1String("name")).toString(), 0, 0,
+                                      atts.value(QLatin1String("width")).toString().toInt(),
+                                      atts.value(QLatin1String("height")).toString().toInt());
+        } else if (xml.isStartElement() && xml.name() == QLatin1String("data")) {
+            xml.readNext();
+            const QString text = xml.text().toString();
+            int start = 0;
+            int end = text.length();
+            while (start < end && text.at(start).isSpace())
+                start++;
+            int x = 0, y = 0;
+            bool ok;
+            const QChar sep(QLatin1Char(','));
+            while (start < end) {
+                int next = text.indexOf(sep, start);
+                if (next == -1)
+                    next = end;
+                uint gid = text.mid(start, next - start).trimmed().toUInt(&ok);
+                if (!ok)
+                    return -1;
+                tileLayer->setCell(x, y, gidMapper.gidToCell(gid, ok));
+                if (++x == tileLayer->width()) {
+                    x = 0;
+                    ++y;
+                }
+                start = next + 1;
+            }
+            ++layers;
+        }
+    }
+    delete tileLayer;
+    return layers;
+}
+
 void test_MapReader::loadMap()
 {
     MapReader reader;
@@ -53,5 +108,69 @@ void test_MapReader::loadMap()
     QCOMPARE(mapObject->height(), qreal(64) / qreal(map->tileHeight()));
 }
 
+void test_MapReader::loadCsvMap()
+{
+    MapReader reader;
+    Map *map = reader.readMap("../data/csvlayers.tmx");
+
+    QVERIFY(map);
+    QCOMPARE(map->layerCount(), 3);
+
+    TileLayer *tileLayer = dynamic_cast<TileLayer*>(map->layerAt(0));
+
+    QVERIFY(tileLayer);
+    QCOMPARE(tileLayer->width(), 100);
+    QCOMPARE(tileLayer->height(), 80);
+    QVERIFY(tileLayer->cellAt(0, 0).tile);
+    QCOMPARE(tileLayer->cellAt(0, 0).tile->id(), 0);
+    QCOMPARE(tileLayer->cellAt(3, 2).tile->id(), 41);
+    QCOMPARE(tileLayer->cellAt(99, 79).tile->id(), (99 + 79) % 64);
+
+    delete map;
+}
+
+void test_MapReader::benchmarkCsvMap_data()
+{
+    QTest::addColumn<bool>("oldWay");
+
+    QTest::newRow("QString::mid (old)") << true;
+    QTest::newRow("in place (new)") << false;
+}
+
+// Both rows parse the same XML.  The new one also reads the tileset, so the
+// difference is if anything smaller than the decoders' own.
+void test_MapReader::benchmarkCsvMap()
+{
+    QFETCH(bool, oldWay);
+
+    QFile file(QLatin1String("../data/csvlayers.tmx"));
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QByteArray data = file.readAll();
+
+    MapReader reader;
+    Map *tilesetMap = reader.readMap(QLatin1String("../data/csvlayers.tmx"));
+    QVERIFY(tilesetMap);
+    GidMapper gidMapper;
+    gidMapper.insert(1, tilesetMap->tilesets().first());
+
+    if (oldWay) {
+        QBENCHMARK {
+            QCOMPARE(readCsvLayersTheOldWay(data, gidMapper), 3);
+        }
+    } else {
+        QBENCHMARK {
+            QBuffer buffer;
+            buffer.setData(data);
+            buffer.open(QIODevice::ReadOnly);
+            Map *map = reader.readMap(&buffer, QLatin1String("../data"));
+            QVERIFY(map);
+            delete map;
+        }
+    }
+
+    qDeleteAll(tilesetMap->tilesets());
+    delete tilesetMap;
+}
+
 QTEST_MAIN(test_MapReader)
 #include "test_mapreader.moc"
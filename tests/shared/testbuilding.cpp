@@ -0,0 +1,100 @@
+#include "testbuilding.h"
+
+#include "building.h"
+#include "buildingfloor.h"
+#include "buildingobjects.h"
+#include "buildingtiles.h"
+
+using namespace BuildingEditor;
+
+uint nextRandom(uint &seed)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) & 0x7fff;
+}
+
+static BuildingTileEntry *entry(BuildingTileCategory *category,
+                                const QString &tileName)
+{
+    BuildingTileEntry *entry = category->createEntryFromSingleTile(tileName);
+    Q_ASSERT(entry);
+    return entry;
+}
+
+Building *createTestBuilding(int width, int height, int floors, int rooms,
+                             uint seed, const QStringList &userLayers,
+                             const QVector<int> &userTiles)
+{
+    BuildingTilesMgr *mgr = BuildingTilesMgr::instance();
+
+    Building *building = new Building(width, height);
+    building->setTile(Building::ExteriorWall,
+                      entry(mgr->catEWalls(), QLatin1String("walls_exterior_house_01_0")));
+
+    for (int i = 0; i < rooms; i++) {
+        Room *room = new Room;
+        room->Name = QString(QLatin1String("Room %1")).arg(i);
+        room->internalName = QString(QLatin1String("room%1")).arg(i);
+        room->Color = qRgb(nextRandom(seed) % 256, nextRandom(seed) % 256, i % 256);
+        room->setTile(Room::InteriorWall,
+                      entry(mgr->catIWalls(), QString(QLatin1String("walls_interior_house_%1_0"))
+                            .arg(i % 4 + 1, 2, 10, QLatin1Char('0'))));
+        room->setTile(Room::Floor,
+                      entry(mgr->catFloors(), QString(QLatin1String("floors_interior_carpet_01_%1"))
+                            .arg(i % 8)));
+        building->insertRoom(i, room);
+    }
+
+    BuildingTileEntry *doorTile = entry(mgr->catDoors(), QLatin1String("fixtures_doors_01_0"));
+    BuildingTileEntry *frameTile = entry(mgr->catDoorFrames(), QLatin1String("fixtures_doors_frames_01_0"));
+    BuildingTileEntry *windowTile = entry(mgr->catWindows(), QLatin1String("fixtures_windows_01_0"));
+    BuildingTileEntry *stairsTile = entry(mgr->catStairs(), QLatin1String("fixtures_stairs_01_0"));
+    BuildingTileEntry *roofTile = entry(mgr->catRoofCaps(), QLatin1String("roofs_01_0"));
+
+    for (int level = 0; level < floors; level++) {
+        BuildingFloor *floor = new BuildingFloor(building, level);
+        building->insertFloor(level, floor);
+        for (int y = 0; y < height; y++) {
+            int x = 0;
+            while (x < width) {
+                int run = 1 + nextRandom(seed) % 12;
+                int room = nextRandom(seed) % (rooms + 1);
+                for (; run > 0 && x < width; run--, x++)
+                    floor->SetRoomAt(x, y, room ? building->room(room - 1) : 0);
+            }
+        }
+        foreach (QString layerName, userLayers) {
+            for (int y = 0; y <= height; y++) {
+                for (int x = 0; x <= width; x++) {
+                    if (nextRandom(seed) % 3 == 0)
+                        floor->setGrimeAtom(layerName, x, y,
+                                            userTiles[nextRandom(seed) % userTiles.size()]);
+                }
+            }
+        }
+
+        Door *door = new Door(floor, 1, 0, BuildingObject::N);
+        door->setTile(doorTile);
+        door->setTile(frameTile, 1);
+        floor->insertObject(floor->objectCount(), door);
+
+        Window *window = new Window(floor, 0, 2, BuildingObject::W);
+        window->setTile(windowTile);
+        floor->insertObject(floor->objectCount(), window);
+
+        Stairs *stairs = new Stairs(floor, 3, 3, BuildingObject::W);
+        stairs->setTile(stairsTile);
+        floor->insertObject(floor->objectCount(), stairs);
+
+        WallObject *wall = new WallObject(floor, 2, 1, BuildingObject::N, 4);
+        floor->insertObject(floor->objectCount(), wall);
+
+        RoofObject *roof = new RoofObject(floor, 1, 1, 3, 2,
+                                          RoofObject::PeakWE, RoofObject::Two,
+                                          true, false, true, false);
+        roof->setCapTiles(roofTile);
+        floor->insertObject(floor->objectCount(), roof);
+    }
+
+    return building;
+}
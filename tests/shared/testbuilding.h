@@ -0,0 +1,27 @@
+#ifndef TESTBUILDING_H
+#define TESTBUILDING_H
+
+#include <QStringList>
+#include <QVector>
+
+namespace BuildingEditor {
+class Building;
+}
+
+/**
+  * The same sequence on every platform, so a seed always gives the same
+  * building.
+  */
+uint nextRandom(uint &seed);
+
+/**
+  * Creates a building whose rooms are strips of random width.  The tile name
+  * atoms in \a userTiles are scattered over the layers \a userLayers, and
+  * each floor gets one object of every kind.
+  */
+BuildingEditor::Building *createTestBuilding(int width, int height, int floors,
+                                             int rooms, uint seed,
+                                             const QStringList &userLayers,
+                                             const QVector<int> &userTiles);
+
+#endif // TESTBUILDING_H
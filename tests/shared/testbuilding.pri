@@ -0,0 +1,6 @@
+# Buildings generated for the tests of the building editor.
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += $$PWD/testbuilding.cpp
+HEADERS += $$PWD/testbuilding.h
@@ -1,4 +1,11 @@
 TEMPLATE=subdirs
+CONFIG += ordered
 SUBDIRS = \
+    editor \
+    buildingconvert \
+    buildingfloor \
+    buildingpickindex \
+    buildingtbx \
+    buildingusertiles \
     mapreader \
     staggeredrenderer